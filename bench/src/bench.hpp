@@ -0,0 +1,100 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <embers/defines.hpp>
+#include <string>
+#include <vector>
+
+namespace embers::bench {
+
+using Clock = std::chrono::steady_clock;
+
+/// Runs `f` `repeats` times, returns the best time in seconds
+template <typename F>
+f64 measure(u32 repeats, F &&f);
+
+struct Result {
+  std::string group;
+  std::string name;
+  u64         items;
+  f64         seconds;
+};
+
+/// Prints a single line of results: throughput in items per second
+inline void report(
+    const char *group, const char *name, u64 items, f64 seconds
+);
+
+/// Everything report() printed so far
+inline std::vector<Result> &results();
+/// Writes results() as a JSON array, returns false when the file can't be
+/// written
+inline bool write_json(const char *path);
+
+}  // namespace embers::bench
+
+// implementation
+
+namespace embers::bench {
+
+template <typename F>
+f64 measure(u32 repeats, F &&f) {
+  f64 best = 1e300;
+  for (u32 i = 0; i < repeats; ++i) {
+    auto start = Clock::now();
+    f();
+    auto end = Clock::now();
+    best     = std::min(best, std::chrono::duration<f64>(end - start).count());
+  }
+  return best;
+}
+
+inline void report(
+    const char *group, const char *name, u64 items, f64 seconds
+) {
+  fmt::print(
+      "{:<12} {:<32} {:>10} items {:>10.3f} ms {:>14.0f} items/s\n",
+      group,
+      name,
+      items,
+      seconds * 1e3,
+      seconds > 0 ? items / seconds : 0.
+  );
+  results().push_back({group, name, items, seconds});
+}
+
+inline std::vector<Result> &results() {
+  static std::vector<Result> results;
+  return results;
+}
+
+inline bool write_json(const char *path) {
+  std::FILE *file = std::fopen(path, "w");
+  if (file == nullptr) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return false;
+  }
+  fmt::print(file, "[\n");
+  for (size_t i = 0; i < results().size(); ++i) {
+    const Result &result = results()[i];
+    fmt::print(
+        file,
+        "  {{\"group\": \"{}\", \"name\": \"{}\", \"items\": {}, "
+        "\"seconds\": {:.9f}, \"items_per_second\": {:.1f}}}{}\n",
+        result.group,
+        result.name,
+        result.items,
+        result.seconds,
+        result.seconds > 0 ? result.items / result.seconds : 0.,
+        i + 1 < results().size() ? "," : ""
+    );
+  }
+  fmt::print(file, "]\n");
+  return std::fclose(file) == 0;
+}
+
+}  // namespace embers::bench
\ No newline at end of file
@@ -0,0 +1,363 @@
+// Reproducible ECS workloads: linear iteration over 1 to 8 components,
+// random access by Entity, create/destroy churn, archetype migrations,
+// query matching over many archetypes, scheduler scaling and events
+// emitted by systems that wait on jobs. Fails when those events come out
+// of order.
+//
+// embers_bench_ecs [entity count] [results.json]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "ecs/events.hpp"
+#include "ecs/manager.hpp"
+#include "ecs/query.hpp"
+#include "ecs/scheduler.hpp"
+
+template <u32 N>
+struct Data {
+  f32 value[4];
+};
+
+template <u32 N>
+struct Tag {};
+
+EMBERS_ECS_COMPONENT(Data<0>, 0);
+EMBERS_ECS_COMPONENT(Data<1>, 1);
+EMBERS_ECS_COMPONENT(Data<2>, 2);
+EMBERS_ECS_COMPONENT(Data<3>, 3);
+EMBERS_ECS_COMPONENT(Data<4>, 4);
+EMBERS_ECS_COMPONENT(Data<5>, 5);
+EMBERS_ECS_COMPONENT(Data<6>, 6);
+EMBERS_ECS_COMPONENT(Data<7>, 7);
+EMBERS_ECS_COMPONENT(Tag<0>, 8);
+EMBERS_ECS_COMPONENT(Tag<1>, 9);
+EMBERS_ECS_COMPONENT(Tag<2>, 10);
+EMBERS_ECS_COMPONENT(Tag<3>, 11);
+EMBERS_ECS_COMPONENT(Tag<4>, 12);
+EMBERS_ECS_COMPONENT(Tag<5>, 13);
+EMBERS_ECS_COMPONENT(Tag<6>, 14);
+EMBERS_ECS_COMPONENT(Tag<7>, 15);
+
+using namespace embers;
+
+constexpr u32 kRepeats = 5;
+constexpr u32 kSeed    = 1234;
+
+static f64 sink = 0;  // keeps the optimizer away from the reads
+
+/// Entities with all 8 Data components
+static std::vector<ecs::Entity> populate(ecs::Manager &manager, u32 count) {
+  std::vector<ecs::Entity> entities;
+  entities.reserve(count);
+  for (u32 i = 0; i < count; ++i) {
+    entities.push_back(manager.create(
+        Data<0>{{(f32)i}},
+        Data<1>{{1}},
+        Data<2>{{2}},
+        Data<3>{{3}},
+        Data<4>{{4}},
+        Data<5>{{5}},
+        Data<6>{{6}},
+        Data<7>{{7}}
+    ));
+  }
+  return entities;
+}
+
+/// Writes Data<0> from the sum of Data<1..N-1>
+template <u32... I>
+static void iterate(
+    ecs::Manager &manager, u32 count, std::integer_sequence<u32, I...>
+) {
+  constexpr u32 kComponents = sizeof...(I) + 1;
+
+  ecs::Query<ecs::Write<Data<0>>, ecs::Read<Data<I + 1>>...> query(manager);
+  f64 time = bench::measure(kRepeats, [&] {
+    query.each([](Data<0> &out, const Data<I + 1> &...in) {
+      out.value[0] += (0.f + ... + in.value[0]);
+    });
+  });
+  bench::report(
+      "iterate",
+      fmt::format("{} components", kComponents).c_str(),
+      count,
+      time
+  );
+}
+
+template <u32... N>
+static void iterate_all(
+    ecs::Manager &manager, u32 count, std::integer_sequence<u32, N...>
+) {
+  (iterate(manager, count, std::make_integer_sequence<u32, N>()), ...);
+}
+
+static void random_access(
+    ecs::Manager &manager, const std::vector<ecs::Entity> &entities
+) {
+  std::vector<ecs::Entity> shuffled = entities;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(kSeed));
+
+  f64 time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : shuffled) {
+      sink += manager.get<const Data<0>>(entity)->value[0];
+    }
+  });
+  bench::report("access", "random get", (u64)entities.size(), time);
+
+  time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : shuffled) {
+      manager.get<Data<1>>(entity)->value[1] += 1;
+    }
+  });
+  bench::report("access", "random get and write", (u64)entities.size(), time);
+}
+
+static void churn(u32 count) {
+  ecs::Manager             manager;
+  std::vector<ecs::Entity> entities(count);
+
+  // the first round allocates the chunks, the others reuse them
+  f64 time = bench::measure(kRepeats, [&] {
+    for (u32 i = 0; i < count; ++i) {
+      entities[i] = manager.create(Data<0>{}, Data<1>{}, Tag<0>{});
+    }
+    for (ecs::Entity entity : entities) {
+      manager.destroy(entity);
+    }
+  });
+  bench::report("churn", "create+destroy", count, time);
+
+  ecs::Vector<ecs::RowRange> ranges;
+  time = bench::measure(kRepeats, [&] {
+    ranges.clear();
+    manager.create_batch(
+        ecs::component_mask<Data<0>, Data<1>, Tag<0>>(),
+        count,
+        entities.data(),
+        ranges
+    );
+    for (ecs::Entity entity : entities) {
+      manager.destroy(entity);
+    }
+  });
+  bench::report("churn", "create_batch+destroy", count, time);
+
+  std::mt19937 random(kSeed);
+  for (u32 i = 0; i < count; ++i) {
+    entities[i] = manager.create(Data<0>{}, Data<1>{});
+  }
+  time = bench::measure(kRepeats, [&] {
+    // a random tenth of the world dies and is replaced
+    for (u32 i = 0; i < count / 10; ++i) {
+      ecs::Entity &entity = entities[random() % count];
+      manager.destroy(entity);
+      entity = manager.create(Data<0>{}, Data<1>{});
+    }
+  });
+  bench::report("churn", "replace random 10%", count / 10, time);
+}
+
+static void migrations(
+    ecs::Manager &manager, const std::vector<ecs::Entity> &entities
+) {
+  f64 time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : entities) {
+      manager.add<Tag<0>>(entity);
+    }
+    for (ecs::Entity entity : entities) {
+      manager.remove<Tag<0>>(entity);
+    }
+  });
+  bench::report("migrate", "add+remove tag", (u64)entities.size() * 2, time);
+
+  time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : entities) {
+      manager.remove<Data<7>>(entity);
+    }
+    for (ecs::Entity entity : entities) {
+      manager.add<Data<7>>(entity, Data<7>{{7}});
+    }
+  });
+  bench::report(
+      "migrate",
+      "remove+add Data<7>",
+      (u64)entities.size() * 2,
+      time
+  );
+}
+
+/// Spreads the entities over 2^tags archetypes
+static void query_matching(u32 count) {
+  for (u32 tags = 2; tags <= 8; tags += 3) {
+    ecs::Manager manager;
+    u32          archetypes = 1u << tags;
+    for (u32 i = 0; i < count; ++i) {
+      ecs::Entity entity = manager.create(Data<0>{{1}}, Data<1>{{1}});
+      u32         combo  = i % archetypes;
+      if (combo & 1) manager.add<Tag<0>>(entity);
+      if (combo & 2) manager.add<Tag<1>>(entity);
+      if (combo & 4) manager.add<Tag<2>>(entity);
+      if (combo & 8) manager.add<Tag<3>>(entity);
+      if (combo & 16) manager.add<Tag<4>>(entity);
+      if (combo & 32) manager.add<Tag<5>>(entity);
+      if (combo & 64) manager.add<Tag<6>>(entity);
+      if (combo & 128) manager.add<Tag<7>>(entity);
+    }
+
+    f64 time = bench::measure(kRepeats, [&] {
+      ecs::Query<ecs::Read<Data<0>>, ecs::Without<Tag<0>>> query(manager);
+      sink += query.size();
+    });
+    bench::report(
+        "query",
+        fmt::format("match {} archetypes", archetypes).c_str(),
+        archetypes,
+        time
+    );
+
+    ecs::Query<ecs::Write<Data<0>>, ecs::Read<Data<1>>> query(manager);
+    time = bench::measure(kRepeats, [&] {
+      query.each([](Data<0> &out, const Data<1> &in) {
+        out.value[0] += in.value[0];
+      });
+    });
+    bench::report(
+        "query",
+        fmt::format("iterate {} archetypes", archetypes).c_str(),
+        count,
+        time
+    );
+  }
+}
+
+/// The same work with 1 to N threads. A single thread runs the query
+/// directly, Scheduler always has at least one worker
+static void scheduler_scaling(ecs::Manager &manager, u32 count) {
+  using Terms = ecs::ChunkView<
+      ecs::Write<Data<0>>,
+      ecs::Read<Data<1>>,
+      ecs::Read<Data<2>>>;
+
+  const auto work = [](const Terms &view) {
+    Data<0>       *out = view.get<Data<0>>();
+    const Data<1> *a   = view.get<Data<1>>();
+    const Data<2> *b   = view.get<Data<2>>();
+    for (u32 i = 0; i < view.size(); ++i) {
+      for (u32 k = 0; k < 4; ++k) {
+        out[i].value[k] = std::sqrt(
+            out[i].value[k] * out[i].value[k] + a[i].value[k] * b[i].value[k]
+        );
+      }
+    }
+  };
+
+  ecs::Query<ecs::Write<Data<0>>, ecs::Read<Data<1>>, ecs::Read<Data<2>>>
+      query(manager);
+  f64 time = bench::measure(kRepeats, [&] { query.each_chunk(work); });
+  bench::report("schedule", "1 thread", count, time);
+
+  u32 hardware = std::max(2u, std::thread::hardware_concurrency());
+  for (u32 threads = 2; threads <= hardware; threads *= 2) {
+    ecs::Scheduler scheduler(manager, threads - 1);
+    scheduler.add_chunk_system<
+        ecs::Write<Data<0>>,
+        ecs::Read<Data<1>>,
+        ecs::Read<Data<2>>>("work", work);
+
+    time = bench::measure(kRepeats, [&] { scheduler.run(); });
+    bench::report(
+        "schedule",
+        fmt::format("{} threads", threads).c_str(),
+        count,
+        time
+    );
+    if (threads < hardware && threads * 2 > hardware) {
+      threads = hardware / 2;  // the loop ends on the hardware count
+    }
+  }
+}
+
+/// A system waiting on a job between two events parks and may resume on
+/// another worker, the flush must still hand out the events in the order
+/// they were emitted. False when it doesn't
+static b8 waiting_events() {
+  constexpr u32 kItems  = 64;
+  constexpr u32 kEvents = 4;  // per item
+
+  jobs::System     jobs(std::max(2u, std::thread::hardware_concurrency()));
+  ecs::Manager     manager;
+  ecs::Scheduler   scheduler(manager, jobs);
+  ecs::Events<u32> events(scheduler);
+  ecs::SystemId    emitter = scheduler.add_range_system(
+      "emitter",
+      ecs::Access(),
+      [] { return kItems; },
+      [&](u32 first, u32 last) {
+        for (u32 item = first; item < last; ++item) {
+          for (u32 i = 0; i < kEvents; ++i) {
+            events.emit(item * kEvents + i);
+            // long enough to be stolen, the waiting task parks
+            jobs::Counter counter;
+            jobs.run(
+                [] {
+                  std::this_thread::sleep_for(std::chrono::microseconds(200));
+                },
+                &counter
+            );
+            jobs.wait(counter);
+          }
+        }
+      }
+  );
+  events.emitted_by(emitter);
+
+  b8  ordered = true;
+  f64 time    = bench::measure(kRepeats, [&] {
+    scheduler.run();
+    ordered = ordered && events.size() == kItems * kEvents;
+    for (u32 i = 0; ordered && i < events.size(); ++i) {
+      ordered = events.data()[i] == i;
+    }
+  });
+  bench::report("events", "emit between waits", kItems * kEvents, time);
+  return ordered;
+}
+
+int main(int argc, char **argv) {
+  u32 count = argc > 1 ? (u32)std::strtoul(argv[1], nullptr, 10) : 1000000;
+  const char *json = argc > 2 ? argv[2] : "embers_bench_ecs.json";
+
+  {
+    ecs::Manager             manager;
+    std::vector<ecs::Entity> entities = populate(manager, count);
+
+    iterate_all(
+        manager,
+        count,
+        std::integer_sequence<u32, 0, 1, 2, 3, 4, 5, 6, 7>()
+    );
+    random_access(manager, entities);
+    migrations(manager, entities);
+    scheduler_scaling(manager, count);
+  }
+  churn(count);
+  query_matching(count);
+  if (!waiting_events()) {
+    fmt::print(stderr, "Events of a waiting system came out of order\n");
+    return 1;
+  }
+
+  if (sink == 0.5) {
+    fmt::print("{}\n", sink);
+  }
+  return bench::write_json(json) ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+// Compares Storage::kTable and Storage::kSparseSet on the same workloads:
+// iteration, add/remove churn and joins with table components
+
+#include <cstdlib>
+#include <vector>
+
+#include "bench.hpp"
+#include "ecs/manager.hpp"
+
+struct Position {
+  f32 x, y, z;
+};
+
+struct Velocity {
+  f32 x, y, z;
+};
+
+struct Timer {
+  f32 left;
+};
+
+struct Dirty {};
+
+EMBERS_ECS_COMPONENT(Position, 0);
+EMBERS_ECS_COMPONENT(Velocity, 1);
+EMBERS_ECS_COMPONENT(Timer, 2);
+EMBERS_ECS_COMPONENT(Dirty, 3);
+
+using namespace embers;
+
+static void run(ecs::Storage storage, const char *group, u32 count) {
+  constexpr u32 kRepeats = 5;
+
+  ecs::Manager manager;
+  manager.register_component<Timer>(storage);
+  manager.register_component<Dirty>(storage);
+
+  std::vector<ecs::Entity> entities;
+  entities.reserve(count);
+  for (u32 i = 0; i < count; ++i) {
+    ecs::Entity entity =
+        manager.create(Position{(f32)i, 0, 0}, Velocity{1, 1, 1});
+    if (i % 2 == 0) {
+      manager.add<Timer>(entity, Timer{(f32)i});
+    }
+    entities.push_back(entity);
+  }
+
+  f64 sink = 0;
+
+  f64 time = bench::measure(kRepeats, [&] {
+    manager.each<Timer>([](Timer &timer) { timer.left -= 0.016f; });
+  });
+  bench::report(group, "iterate Timer", count / 2, time);
+
+  time = bench::measure(kRepeats, [&] {
+    manager.each<Position, const Velocity, const Timer>(
+        [](Position &position, const Velocity &velocity, const Timer &timer) {
+          position.x += velocity.x * timer.left;
+        }
+    );
+  });
+  bench::report(group, "join Position+Velocity+Timer", count / 2, time);
+
+  time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : entities) {
+      manager.add<Dirty>(entity);
+    }
+    for (ecs::Entity entity : entities) {
+      manager.remove<Dirty>(entity);
+    }
+  });
+  bench::report(group, "add+remove Dirty", count, time);
+
+  time = bench::measure(kRepeats, [&] {
+    for (ecs::Entity entity : entities) {
+      sink += manager.get<Position>(entity)->x;
+      if (manager.has<Timer>(entity)) {
+        sink += manager.get<Timer>(entity)->left;
+      }
+    }
+  });
+  bench::report(group, "random access get", count, time);
+
+  if (sink == 0.5) {  // keep the optimizer away from the reads
+    fmt::print("{}\n", sink);
+  }
+}
+
+int main(int argc, char **argv) {
+  u32 count = argc > 1 ? (u32)std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  run(ecs::Storage::kTable, "table", count);
+  run(ecs::Storage::kSparseSet, "sparse_set", count);
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+// Cost of a fiber switch against a switch between OS threads, and of the job
+// system running flat batches of jobs and jobs that wait on others
+//
+// embers_bench_fibers [results.json]
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bench.hpp"
+#include "jobs/fiber.hpp"
+#include "jobs/jobs.hpp"
+
+using namespace embers;
+
+constexpr u32 kRepeats  = 5;
+constexpr u32 kSwitches = 1000000;
+
+static jobs::Fiber *main_fiber;
+static jobs::Fiber *ping_fiber;
+
+static void ping(void *) {
+  while (true) {
+    jobs::Fiber::switch_to(*ping_fiber, *main_fiber);
+  }
+}
+
+/// Round trips between two fibers on one thread
+static void fiber_switch() {
+  jobs::Fiber main;
+  jobs::Fiber fiber(16 * 1024, &ping, nullptr);
+  main_fiber = &main;
+  ping_fiber = &fiber;
+
+  f64 time = bench::measure(kRepeats, [&] {
+    for (u32 i = 0; i < kSwitches / 2; ++i) {
+      jobs::Fiber::switch_to(main, fiber);
+    }
+  });
+  bench::report("switch", "fiber", kSwitches, time);
+}
+
+/// Ping pong between two threads, every handoff blocks one and wakes the
+/// other through the kernel
+static void thread_switch() {
+  constexpr u32 kHandoffs = kSwitches / 10;
+
+  std::mutex              mutex;
+  std::condition_variable changed;
+  u32                     turn = 0;
+  b8                      stop = false;
+
+  std::thread other([&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [&] { return turn % 2 == 1 || stop; });
+      if (stop) {
+        return;
+      }
+      turn++;
+      changed.notify_one();
+    }
+  });
+
+  f64 time = bench::measure(kRepeats, [&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (u32 i = 0; i < kHandoffs / 2; ++i) {
+      turn++;
+      changed.notify_one();
+      changed.wait(lock, [&] { return turn % 2 == 0; });
+    }
+  });
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  changed.notify_one();
+  other.join();
+  bench::report("switch", "os thread", kHandoffs, time);
+}
+
+static void jobs_throughput(u32 workers) {
+  constexpr u32 kJobs   = 100000;
+  constexpr u32 kChains = 1000;
+  constexpr u32 kSteps  = 16;
+
+  jobs::System     system(workers);
+  std::atomic<u64> sink(0);
+
+  f64 time = bench::measure(kRepeats, [&] {
+    jobs::Counter counter;
+    for (u32 i = 0; i < kJobs; ++i) {
+      system.run(
+          [&sink] { sink.fetch_add(1, std::memory_order_relaxed); },
+          &counter
+      );
+    }
+    system.wait(counter);
+  });
+  bench::report(
+      "jobs",
+      fmt::format("flat, {} workers", workers).c_str(),
+      kJobs,
+      time
+  );
+
+  // every chain waits on a job per step, parking its fiber each time
+  time = bench::measure(kRepeats, [&] {
+    jobs::Counter chains;
+    for (u32 c = 0; c < kChains; ++c) {
+      system.run(
+          [&system, &sink] {
+            for (u32 step = 0; step < kSteps; ++step) {
+              jobs::Counter counter;
+              system.run(
+                  [&sink] { sink.fetch_add(1, std::memory_order_relaxed); },
+                  &counter
+              );
+              system.wait(counter);
+            }
+          },
+          &chains
+      );
+    }
+    system.wait(chains);
+  });
+  bench::report(
+      "jobs",
+      fmt::format("waiting chains, {} workers", workers).c_str(),
+      kChains * kSteps,
+      time
+  );
+}
+
+int main(int argc, char **argv) {
+  const char *json = argc > 1 ? argv[1] : "embers_bench_fibers.json";
+
+  fiber_switch();
+  thread_switch();
+
+  u32 hardware = std::max(2u, std::thread::hardware_concurrency());
+  for (u32 workers = 1; workers < hardware - 1; workers *= 2) {
+    jobs_throughput(workers);
+  }
+  jobs_throughput(hardware - 1);
+
+  return bench::write_json(json) ? 0 : 1;
+}
\ No newline at end of file
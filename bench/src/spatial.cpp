@@ -0,0 +1,109 @@
+// LooseGrid and DynamicBvh behind SpatialIndex at 10k, 100k and 1M entities:
+// building, incremental updates after 10% of the entities moved, and batches
+// of radius, box and frustum queries
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench.hpp"
+#include "ecs/spatial.hpp"
+
+using namespace embers;
+
+// density stays the same, about one entity per 1000 cubic units
+static f32 world_extent(u32 count) {
+  return std::cbrt((f32)count * 1000) * 0.5f;
+}
+
+template <typename Index, typename... Args>
+static void run(const char *group, u32 count, Args &&...args) {
+  constexpr u32 kRepeats = 5;
+  constexpr u32 kQueries = 1000;
+
+  f32              extent = world_extent(count);
+  std::mt19937     random(count);
+  std::uniform_real_distribution<f32> position(-extent, extent);
+  std::uniform_real_distribution<f32> step(-0.5f, 0.5f);
+
+  ecs::Manager             manager;
+  std::vector<ecs::Entity> entities;
+  entities.reserve(count);
+  for (u32 i = 0; i < count; ++i) {
+    math::Vec3 at = {position(random), position(random), position(random)};
+    entities.push_back(manager.create(
+        ecs::WorldTransform{math::Mat4::translation(at)},
+        ecs::Bounds{0.5f + (i % 4) * 0.5f}
+    ));
+  }
+
+  Index index(manager, std::forward<Args>(args)...);
+  f64   time = bench::measure(1, [&] { index.update(); });
+  bench::report(group, "build", count, time);
+
+  // moves are spread over the whole world, so every chunk gets touched
+  time = bench::measure(kRepeats, [&] {
+    for (u32 i = 0; i < count; i += 10) {
+      math::Mat4 &matrix =
+          manager.get<ecs::WorldTransform>(entities[i])->matrix;
+      matrix.m[12] += step(random);
+      matrix.m[13] += step(random);
+      matrix.m[14] += step(random);
+    }
+    index.update();
+  });
+  bench::report(group, "update 10% moved", count / 10, time);
+
+  std::vector<math::Sphere>  spheres(kQueries);
+  std::vector<math::Aabb>    boxes(kQueries);
+  std::vector<math::Frustum> frustums(16);
+  for (u32 i = 0; i < kQueries; ++i) {
+    math::Vec3 at = {position(random), position(random), position(random)};
+    spheres[i]    = {at, 10};
+    boxes[i]      = math::Aabb::around(at, 10);
+  }
+  for (u32 i = 0; i < frustums.size(); ++i) {
+    // orthographic boxes of 100 units, offset through the world
+    math::Vec3 at = {position(random), position(random), position(random)};
+    frustums[i]   = math::Frustum::from_matrix(
+        math::Mat4::scale({0.02f, 0.02f, 0.01f}) *
+        math::Mat4::translation({-at.x, -at.y, -at.z})
+    );
+  }
+
+  ecs::Vector<ecs::Entity> results;
+  ecs::Vector<u32>         offsets;
+
+  time = bench::measure(kRepeats, [&] {
+    index.query(spheres.data(), kQueries, results, offsets);
+  });
+  bench::report(group, "radius queries", kQueries, time);
+
+  time = bench::measure(kRepeats, [&] {
+    index.query(boxes.data(), kQueries, results, offsets);
+  });
+  bench::report(group, "box queries", kQueries, time);
+
+  time = bench::measure(kRepeats, [&] {
+    index.query(frustums.data(), (u32)frustums.size(), results, offsets);
+  });
+  bench::report(group, "frustum queries", (u32)frustums.size(), time);
+}
+
+int main(int argc, char **argv) {
+  u32 largest = argc > 1 ? (u32)std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  for (u32 count = 10000; count <= largest; count *= 10) {
+    f32 extent = world_extent(count);
+    fmt::print("{} entities\n", count);
+    run<ecs::GridIndex>(
+        "loose_grid",
+        count,
+        math::Aabb{{-extent, -extent, -extent}, {extent, extent, extent}},
+        20.f
+    );
+    run<ecs::BvhIndex>("bvh", count, 0.5f);
+  }
+  return 0;
+}
\ No newline at end of file
@@ -23,11 +23,21 @@
 
 #if defined(_MSC_VER)
 #define EMBERS_ALWAYS_INLINE __forceinline
+#define EMBERS_NEVER_INLINE  __declspec(noinline)
 #else
 #define EMBERS_ALWAYS_INLINE __attribute__((always_inline)) inline
+#define EMBERS_NEVER_INLINE  __attribute__((noinline))
 
 #endif
 
+// lets the compiler vectorize loops over the pointer without peeling
+#if defined(__GNUC__) || defined(__clang__)
+#define EMBERS_ASSUME_ALIGNED(ptr, alignment)                                  \
+  ((decltype(ptr))__builtin_assume_aligned((ptr), (alignment)))
+#else
+#define EMBERS_ASSUME_ALIGNED(ptr, alignment) (ptr)
+#endif
+
 #define _EMBERS__STRINGIFY_INTERNAL(x) #x
 #define EMBERS_STRINGIFY(x)            _EMBERS__STRINGIFY_INTERNAL(x)
 
@@ -0,0 +1,59 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace embers::containers {
+
+Arena::Arena(size_t block_size)
+    : block_(0), offset_(0), block_size_(block_size) {}
+
+Arena::Arena(Arena &&other)
+    : blocks_(std::move(other.blocks_)),
+      block_(other.block_),
+      offset_(other.offset_),
+      block_size_(other.block_size_) {
+  other.blocks_.clear();
+  other.block_  = 0;
+  other.offset_ = 0;
+}
+
+Arena::~Arena() {
+  for (const Block &block : blocks_) {
+    ::operator delete(block.data, std::align_val_t{kMaxAlignment});
+  }
+  return;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  while (block_ < blocks_.size()) {
+    Block &block  = blocks_[block_];
+    size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= block.size) {
+      offset_ = offset + size;
+      return block.data + offset;
+    }
+    block_++;
+    offset_ = 0;
+  }
+
+  // big allocations get a block of their own
+  size_t block_size = std::max(size, block_size_);
+  u8    *data       = (u8 *)::operator new(
+      block_size,
+      std::align_val_t{kMaxAlignment}
+  );
+  blocks_.push_back({data, block_size});
+  block_  = blocks_.size() - 1;
+  offset_ = size;
+  return data;
+}
+
+void Arena::reset() {
+  block_  = 0;
+  offset_ = 0;
+  return;
+}
+
+}  // namespace embers::containers
\ No newline at end of file
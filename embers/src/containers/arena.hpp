@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <embers/defines.hpp>
+#include <vector>
+
+namespace embers::containers {
+
+/// Bump allocator over a list of blocks. Memory is given back all at once by
+/// reset(), which keeps the blocks for the next round. Nothing is destroyed,
+/// owners of non trivial values have to destroy them by themselves
+class Arena {
+  struct Block {
+    u8    *data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  size_t             block_;
+  size_t             offset_;
+  size_t             block_size_;
+
+ public:
+  constexpr static size_t kMaxAlignment = 64;
+
+  explicit Arena(size_t block_size = 64 * 1024);
+  Arena(const Arena &other) = delete;
+  Arena(Arena &&other);
+  ~Arena();
+
+  Arena &operator=(const Arena &rhs) = delete;
+  Arena &operator=(Arena &&rhs)      = delete;
+
+  /// alignment must be a power of two not bigger than kMaxAlignment
+  void *allocate(size_t size, size_t alignment);
+  void  reset();
+
+  template <typename T>
+  EMBERS_ALWAYS_INLINE T *allocate(size_t count = 1);
+};
+
+}  // namespace embers::containers
+
+// implementation
+
+namespace embers::containers {
+
+template <typename T>
+EMBERS_ALWAYS_INLINE T *Arena::allocate(size_t count) {
+  static_assert(alignof(T) <= kMaxAlignment, "Type is over aligned");
+  return (T *)allocate(sizeof(T) * count, alignof(T));
+}
+
+}  // namespace embers::containers
\ No newline at end of file
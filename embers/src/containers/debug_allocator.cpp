@@ -7,6 +7,32 @@ namespace embers::containers {
 DebugAllocatorInfo debug_allocator_info
     [(int)DebugAllocatorTags::kMax - (int)DebugAllocatorTags::kMin + 1] = {};
 
+static void store_max(std::atomic<size_t> &max, size_t value) {
+  size_t current = max.load(std::memory_order_relaxed);
+  // a failed exchange reloads current
+  while (current < value) {
+    if (max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  return;
+}
+
+void DebugAllocatorInfo::add(size_t bytes) {
+  size_t now = size.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  store_max(max_size, now);
+  store_max(max_size_single, bytes);
+  total_size.fetch_add(bytes, std::memory_order_relaxed);
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return;
+}
+
+void DebugAllocatorInfo::remove(size_t bytes) {
+  size.fetch_sub(bytes, std::memory_order_relaxed);
+  deallocations.fetch_add(1, std::memory_order_relaxed);
+  return;
+}
+
 }  // namespace embers::containers
 
 #endif
\ No newline at end of file
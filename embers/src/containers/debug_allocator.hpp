@@ -4,6 +4,8 @@
 
 #include <fmt/base.h>
 
+#include <algorithm>
+#include <atomic>
 #include <embers/defines.hpp>
 #include <memory>
 
@@ -13,16 +15,22 @@ enum class DebugAllocatorTags {
   kMin    = 0,
   kVulkan = 0,
   kLogger = 1,
-  kMax    = 1,
+  kEcs    = 2,
+  kJobs   = 3,
+  kMax    = 3,
 };
 
+// containers allocate from every worker, the counters are atomic
 struct DebugAllocatorInfo {
-  size_t size            = 0;
-  size_t max_size        = 0;
-  size_t max_size_single = 0;
-  float  avg_mean        = 0;
-  u32    allocations     = 0;
-  u32    deallocations   = 0;
+  std::atomic<size_t> size            = 0;
+  std::atomic<size_t> max_size        = 0;
+  std::atomic<size_t> max_size_single = 0;
+  std::atomic<size_t> total_size      = 0;  // of every allocation
+  std::atomic<u32>    allocations     = 0;
+  std::atomic<u32>    deallocations   = 0;
+
+  void add(size_t bytes);
+  void remove(size_t bytes);
 };
 
 extern DebugAllocatorInfo debug_allocator_info
@@ -50,30 +58,23 @@ class with {
 
     constexpr T *allocate(std::size_t n) {
       T *p = allocator_traits::allocate(inner, n);
-      debug_allocator_info[(int)tag].size += sizeof(T) * n;
-      debug_allocator_info[(int)tag].max_size = std::max(
-          debug_allocator_info[(int)tag].max_size,
-          debug_allocator_info[(int)tag].size
-      );
-      debug_allocator_info[(int)tag].max_size_single = std::max(
-          debug_allocator_info[(int)tag].max_size_single,
-          sizeof(T) * n
-      );
-      debug_allocator_info[(int)tag].avg_mean =
-          (debug_allocator_info[(int)tag].avg_mean *
-               debug_allocator_info[(int)tag].allocations +
-           sizeof(T) * n) /
-          (debug_allocator_info[(int)tag].allocations + 1);
-      debug_allocator_info[(int)tag].allocations++;
-
+      debug_allocator_info[(int)tag].add(sizeof(T) * n);
       return p;
     }
     constexpr void deallocate(T *p, std::size_t n) noexcept {
       allocator_traits::deallocate(inner, p, n);
-      debug_allocator_info[(int)tag].deallocations++;
-      debug_allocator_info[(int)tag].size -= sizeof(T) * n;
+      debug_allocator_info[(int)tag].remove(sizeof(T) * n);
       return;
     }
+
+    template <typename U>
+    constexpr bool operator==(const DebugAllocator<U> &rhs) const noexcept {
+      return inner == rhs.inner;
+    }
+    template <typename U>
+    constexpr bool operator!=(const DebugAllocator<U> &rhs) const noexcept {
+      return !(*this == rhs);
+    }
   };
 };
 
@@ -93,12 +94,14 @@ class fmt::formatter<embers::containers::DebugAllocatorInfo> {
         "Max total/single: {}/{}; "
         "Allocs/Dealllocs: {}/{}; "
         "Average allocation: {:.2f}>",
-        info.size,
-        info.max_size,
-        info.max_size_single,
-        info.allocations,
-        info.deallocations,
-        info.avg_mean
+        info.size.load(),
+        info.max_size.load(),
+        info.max_size_single.load(),
+        info.allocations.load(),
+        info.deallocations.load(),
+        info.allocations.load() != 0
+            ? (f64)info.total_size.load() / info.allocations.load()
+            : 0.0
     );
   }
 };
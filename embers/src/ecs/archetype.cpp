@@ -0,0 +1,238 @@
+#include "archetype.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <embers/logger.hpp>
+#include <new>
+
+namespace embers::ecs {
+
+constexpr static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+ChunkPool::~ChunkPool() {
+  for (u8 *chunk : free_) {
+    bool borrowed = false;
+    for (const Range &range : borrowed_) {
+      borrowed |= chunk >= range.begin && chunk < range.end;
+    }
+    if (!borrowed) {
+      ::operator delete(chunk, std::align_val_t{kColumnAlignment});
+    }
+  }
+  return;
+}
+
+u8 *ChunkPool::allocate() {
+  if (free_.empty()) {
+    return (u8 *)::operator new(kChunkSize, std::align_val_t{kColumnAlignment});
+  }
+  u8 *chunk = free_.back();
+  free_.pop_back();
+  return chunk;
+}
+
+void ChunkPool::release(u8 *chunk) {
+  free_.push_back(chunk);
+  return;
+}
+
+void ChunkPool::borrow(u8 *begin, u8 *end) {
+  borrowed_.push_back({begin, end});
+  return;
+}
+
+void ChunkPool::give_back() {
+  auto borrowed = [this](u8 *chunk) {
+    for (const Range &range : borrowed_) {
+      if (chunk >= range.begin && chunk < range.end) {
+        return true;
+      }
+    }
+    return false;
+  };
+  free_.erase(
+      std::remove_if(free_.begin(), free_.end(), borrowed),
+      free_.end()
+  );
+  borrowed_.clear();
+  return;
+}
+
+Archetype::Archetype(const ComponentMask &mask, const ComponentInfo *components)
+    : mask_(mask), capacity_(0), size_(0), entities_offset_(0) {
+  size_t row_size = sizeof(Entity);
+
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    column_of_[id]    = kNoColumn;
+    add_edges_[id]    = kInvalidArchetype;
+    remove_edges_[id] = kInvalidArchetype;
+
+    if (!mask.test(id)) {
+      continue;
+    }
+    const ComponentInfo &info = components[id];
+    if (info.alignment > kColumnAlignment) {
+      EMBERS_ERROR(
+          "Component {} is aligned to {}, chunk columns are aligned to {}",
+          info.name,
+          info.alignment,
+          kColumnAlignment
+      );
+    }
+    column_of_[id] = (u16)columns_.size();
+    columns_.push_back({id, 0, info.size, info.relocate, info.destroy});
+    row_size += info.size;
+  }
+
+  entities_offset_ = (u32)align_up(
+      sizeof(Tick) * 2 * columns_.size(),
+      kColumnAlignment
+  );
+
+  // padding of every column is at most kColumnAlignment
+  size_t usable =
+      kChunkSize - entities_offset_ - kColumnAlignment * columns_.size();
+  capacity_ = (u32)(usable / row_size);
+  if (capacity_ == 0) {
+    EMBERS_FATAL(
+        "Archetype row of {} bytes doesn't fit into a chunk of {} bytes",
+        row_size,
+        kChunkSize
+    );
+    return;
+  }
+
+  size_t offset = entities_offset_ + sizeof(Entity) * capacity_;
+  for (Column &column : columns_) {
+    offset        = align_up(offset, kColumnAlignment);
+    column.offset = (u32)offset;
+    offset += (size_t)column.size * capacity_;
+  }
+}
+
+void Archetype::add_chunk(ChunkPool &pool) {
+  u8 *data = pool.allocate();
+  std::memset(data, 0, entities_offset_);
+  chunks_.push_back({data, 0});
+  return;
+}
+
+Location Archetype::push(ChunkPool &pool, Entity entity) {
+  if (chunks_.empty() || chunks_.back().count == capacity_) {
+    add_chunk(pool);
+  }
+  u32 chunk = (u32)chunks_.size() - 1;
+  u32 row   = chunks_.back().count++;
+
+  entities(chunk)[row] = entity;
+  size_++;
+  return {chunk, row};
+}
+
+void Archetype::push_batch(
+    ChunkPool        &pool,
+    const Entity     *entities,
+    u32               count,
+    Vector<RowRange> &ranges
+) {
+  while (count > 0) {
+    if (chunks_.empty() || chunks_.back().count == capacity_) {
+      add_chunk(pool);
+    }
+    Chunk &chunk = chunks_.back();
+    u32    rows  = std::min(count, capacity_ - chunk.count);
+
+    std::memcpy(
+        this->entities((u32)chunks_.size() - 1) + chunk.count,
+        entities,
+        sizeof(Entity) * rows
+    );
+    ranges.push_back({(u32)chunks_.size() - 1, chunk.count, rows});
+
+    chunk.count += rows;
+    size_ += rows;
+    entities += rows;
+    count -= rows;
+  }
+  return;
+}
+
+void Archetype::adopt(u8 *data, u32 count) {
+  chunks_.push_back({data, count});
+  size_ += count;
+  return;
+}
+
+Entity Archetype::swap_remove(
+    ChunkPool &pool, Location location, bool destroy
+) {
+  if (destroy) {
+    for (u16 i = 0; i < columns_.size(); ++i) {
+      if (columns_[i].destroy != nullptr) {
+        columns_[i].destroy(get(location, i));
+      }
+    }
+  }
+
+  Entity   moved = {};
+  Chunk   &last  = chunks_.back();
+  Location from  = {(u32)chunks_.size() - 1, last.count - 1};
+
+  if (from.chunk != location.chunk || from.row != location.row) {
+    for (u16 i = 0; i < columns_.size(); ++i) {
+      void *dst = get(location, i);
+      void *src = get(from, i);
+      if (columns_[i].relocate != nullptr) {
+        columns_[i].relocate(dst, src);
+      } else {
+        std::memcpy(dst, src, columns_[i].size);
+      }
+    }
+    moved = entities(from.chunk)[from.row];
+    entities(location.chunk)[location.row] = moved;
+
+    // the moved row keeps its ticks, so the chunk takes the newer ones
+    if (from.chunk != location.chunk) {
+      for (u16 i = 0; i < columns_.size(); ++i) {
+        mark_added(location.chunk, i, added_tick(from.chunk, i));
+        mark_changed(location.chunk, i, changed_tick(from.chunk, i));
+      }
+    }
+  }
+
+  last.count--;
+  size_--;
+  if (last.count == 0) {
+    pool.release(last.data);
+    chunks_.pop_back();
+  }
+  return moved;
+}
+
+void Archetype::mark_row_added(u32 chunk, Tick tick) const {
+  for (u16 i = 0; i < columns_.size(); ++i) {
+    mark_added(chunk, i, tick);
+  }
+  return;
+}
+
+void Archetype::clear(ChunkPool &pool) {
+  for (u32 c = 0; c < chunks_.size(); ++c) {
+    for (u16 i = 0; i < columns_.size(); ++i) {
+      if (columns_[i].destroy == nullptr) {
+        continue;
+      }
+      for (u32 row = 0; row < chunks_[c].count; ++row) {
+        columns_[i].destroy(get({c, row}, i));
+      }
+    }
+    pool.release(chunks_[c].data);
+  }
+  chunks_.clear();
+  size_ = 0;
+  return;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <embers/defines.hpp>
+
+#include "common.hpp"
+#include "component.hpp"
+#include "entity.hpp"
+
+namespace embers::ecs {
+
+using ArchetypeId = u32;
+
+constexpr ArchetypeId kInvalidArchetype = u32_MAX;
+
+struct Location {
+  u32 chunk;
+  u32 row;
+};
+
+/// Recycles kChunkSize blocks between archetypes
+class ChunkPool {
+  struct Range {
+    u8 *begin;
+    u8 *end;
+  };
+
+  Vector<u8 *>  free_;
+  Vector<Range> borrowed_;
+
+ public:
+  ChunkPool() = default;
+  ChunkPool(const ChunkPool &other) = delete;
+  ChunkPool(ChunkPool &&other)      = default;
+  ~ChunkPool();
+
+  ChunkPool &operator=(const ChunkPool &rhs) = delete;
+  ChunkPool &operator=(ChunkPool &&rhs)      = default;
+
+  u8  *allocate();
+  void release(u8 *chunk);
+  /// Chunks inside of [begin, end) are owned by someone else (e.g. a mapped
+  /// snapshot), they are recycled like the others but never deleted
+  void borrow(u8 *begin, u8 *end);
+  /// Forgets the borrowed chunks, all of them must have been released: their
+  /// owner can free them
+  void give_back();
+};
+
+/// Rows [first, first + count) of a chunk
+struct RowRange {
+  u32 chunk;
+  u32 first;
+  u32 count;
+};
+
+/// Block of kChunkSize bytes, laid out as struct of arrays:
+/// [ticks][Entity x capacity][column 0 x capacity][column 1 x capacity]...
+/// Every array starts at kColumnAlignment. The ticks header holds the changed
+/// tick of every column followed by the added tick of every column
+struct Chunk {
+  u8 *data;
+  u32 count;
+};
+
+/// All entities with exactly the same set of components. Every chunk but the
+/// last one is always full, removal fills the hole with the very last row
+class Archetype {
+ public:
+  struct Column {
+    ComponentId             id;
+    u32                     offset;
+    u32                     size;
+    ComponentInfo::Relocate relocate;
+    ComponentInfo::Destroy  destroy;
+  };
+
+  constexpr static u16 kNoColumn = u16_MAX;
+
+ private:
+  ComponentMask  mask_;
+  Vector<Column> columns_;
+  Vector<Chunk>  chunks_;
+  u32            capacity_;
+  u32            size_;
+  u32            entities_offset_;
+  u16            column_of_[kMaxComponents];
+  ArchetypeId    add_edges_[kMaxComponents];
+  ArchetypeId    remove_edges_[kMaxComponents];
+
+  void add_chunk(ChunkPool &pool);
+
+ public:
+  Archetype() = delete;
+  Archetype(const ComponentMask &mask, const ComponentInfo *components);
+
+  EMBERS_ALWAYS_INLINE const ComponentMask  &mask() const;
+  EMBERS_ALWAYS_INLINE const Vector<Column> &columns() const;
+  EMBERS_ALWAYS_INLINE u32                   capacity() const;
+  EMBERS_ALWAYS_INLINE u32                   size() const;
+  EMBERS_ALWAYS_INLINE u32                   chunk_count() const;
+  EMBERS_ALWAYS_INLINE const Chunk          &chunk(u32 chunk) const;
+  EMBERS_ALWAYS_INLINE u16                   column_index(ComponentId id) const;
+
+  EMBERS_ALWAYS_INLINE Entity *entities(u32 chunk) const;
+  EMBERS_ALWAYS_INLINE void   *column_data(u32 chunk, u16 column) const;
+  EMBERS_ALWAYS_INLINE void   *get(Location location, u16 column) const;
+  template <typename T>
+  EMBERS_ALWAYS_INLINE T *column_data(u32 chunk) const;
+
+  /// Tick of the last write to a column of the chunk and of the last time a
+  /// row of the chunk got the component. Marking never moves a tick back
+  EMBERS_ALWAYS_INLINE Tick changed_tick(u32 chunk, u16 column) const;
+  EMBERS_ALWAYS_INLINE Tick added_tick(u32 chunk, u16 column) const;
+  EMBERS_ALWAYS_INLINE void mark_changed(u32 chunk, u16 column, Tick tick)
+      const;
+  /// Marks the column both added and changed
+  EMBERS_ALWAYS_INLINE void mark_added(u32 chunk, u16 column, Tick tick) const;
+  /// Marks every column, for new rows
+  void                      mark_row_added(u32 chunk, Tick tick) const;
+
+  EMBERS_ALWAYS_INLINE ArchetypeId add_edge(ComponentId id) const;
+  EMBERS_ALWAYS_INLINE ArchetypeId remove_edge(ComponentId id) const;
+  EMBERS_ALWAYS_INLINE void        set_add_edge(ComponentId id, ArchetypeId to);
+  EMBERS_ALWAYS_INLINE void set_remove_edge(ComponentId id, ArchetypeId to);
+
+  /// Appends a row, components of the row are left uninitialized
+  Location push(ChunkPool &pool, Entity entity);
+  /// Appends a row for every entity, filling chunk after chunk; the touched
+  /// ranges are appended to `ranges`
+  void     push_batch(
+      ChunkPool        &pool,
+      const Entity     *entities,
+      u32               count,
+      Vector<RowRange> &ranges
+  );
+  /// Appends a chunk laid out by an archetype with the same mask and the
+  /// same component sizes, e.g. from a snapshot
+  void     adopt(u8 *data, u32 count);
+  /// Removes a row, returns the entity that was moved into its place (if any)
+  Entity   swap_remove(ChunkPool &pool, Location location, bool destroy);
+  /// Destroys all the rows and gives the chunks back
+  void     clear(ChunkPool &pool);
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+EMBERS_ALWAYS_INLINE const ComponentMask &Archetype::mask() const {
+  return mask_;
+}
+
+EMBERS_ALWAYS_INLINE const Vector<Archetype::Column> &Archetype::columns(
+) const {
+  return columns_;
+}
+
+EMBERS_ALWAYS_INLINE u32 Archetype::capacity() const { return capacity_; }
+
+EMBERS_ALWAYS_INLINE u32 Archetype::size() const { return size_; }
+
+EMBERS_ALWAYS_INLINE u32 Archetype::chunk_count() const {
+  return (u32)chunks_.size();
+}
+
+EMBERS_ALWAYS_INLINE const Chunk &Archetype::chunk(u32 chunk) const {
+  return chunks_[chunk];
+}
+
+EMBERS_ALWAYS_INLINE u16 Archetype::column_index(ComponentId id) const {
+  return column_of_[id];
+}
+
+EMBERS_ALWAYS_INLINE Entity *Archetype::entities(u32 chunk) const {
+  return (Entity *)(chunks_[chunk].data + entities_offset_);
+}
+
+EMBERS_ALWAYS_INLINE void *Archetype::column_data(u32 chunk, u16 column)
+    const {
+  return chunks_[chunk].data + columns_[column].offset;
+}
+
+EMBERS_ALWAYS_INLINE void *Archetype::get(Location location, u16 column)
+    const {
+  return chunks_[location.chunk].data + columns_[column].offset +
+         (size_t)location.row * columns_[column].size;
+}
+
+template <typename T>
+EMBERS_ALWAYS_INLINE T *Archetype::column_data(u32 chunk) const {
+  return (T *)column_data(chunk, column_of_[component_id<T>]);
+}
+
+EMBERS_ALWAYS_INLINE Tick Archetype::changed_tick(u32 chunk, u16 column)
+    const {
+  return ((const Tick *)chunks_[chunk].data)[column];
+}
+
+EMBERS_ALWAYS_INLINE Tick Archetype::added_tick(u32 chunk, u16 column) const {
+  return ((const Tick *)chunks_[chunk].data)[columns_.size() + column];
+}
+
+EMBERS_ALWAYS_INLINE void Archetype::mark_changed(
+    u32 chunk, u16 column, Tick tick
+) const {
+  Tick *ticks = (Tick *)chunks_[chunk].data;
+  if (is_newer(tick, ticks[column])) {
+    ticks[column] = tick;
+  }
+}
+
+EMBERS_ALWAYS_INLINE void Archetype::mark_added(
+    u32 chunk, u16 column, Tick tick
+) const {
+  Tick *ticks = (Tick *)chunks_[chunk].data;
+  if (is_newer(tick, ticks[columns_.size() + column])) {
+    ticks[columns_.size() + column] = tick;
+  }
+  mark_changed(chunk, column, tick);
+}
+
+EMBERS_ALWAYS_INLINE ArchetypeId Archetype::add_edge(ComponentId id) const {
+  return add_edges_[id];
+}
+
+EMBERS_ALWAYS_INLINE ArchetypeId Archetype::remove_edge(ComponentId id) const {
+  return remove_edges_[id];
+}
+
+EMBERS_ALWAYS_INLINE void Archetype::set_add_edge(
+    ComponentId id, ArchetypeId to
+) {
+  add_edges_[id] = to;
+}
+
+EMBERS_ALWAYS_INLINE void Archetype::set_remove_edge(
+    ComponentId id, ArchetypeId to
+) {
+  remove_edges_[id] = to;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
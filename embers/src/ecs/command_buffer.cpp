@@ -0,0 +1,192 @@
+#include "command_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "scheduler.hpp"
+
+namespace embers::ecs {
+
+CommandBuffer::CommandBuffer() {}
+
+CommandBuffer::~CommandBuffer() {
+  clear();
+  return;
+}
+
+CommandBuffer::Command &CommandBuffer::record(Type type, u32 value_count) {
+  // tasks number their commands themselves, so the order doesn't depend on
+  // which threads they ran on or shared
+  Command &command    = commands_.emplace_back();
+  command.key         = Scheduler::task_key();
+  command.sequence    = Scheduler::task_sequence();
+  command.type        = type;
+  command.values      = value_count ? arena_.allocate<Value>(value_count)
+                                    : nullptr;
+  command.value_count = value_count;
+  return command;
+}
+
+void CommandBuffer::destroy(Entity entity) {
+  Command &command = record(Type::kDestroy, 0);
+  command.entity   = entity;
+  return;
+}
+
+void CommandBuffer::clear() {
+  for (Command &command : commands_) {
+    for (u32 i = 0; i < command.value_count; ++i) {
+      Value &value = command.values[i];
+      if (value.data != nullptr && value.info->destroy != nullptr) {
+        value.info->destroy(value.data);
+      }
+    }
+  }
+  commands_.clear();
+  arena_.reset();
+  return;
+}
+
+CommandQueue::CommandQueue(u32 thread_count) {
+  buffers_.reserve(thread_count);
+  for (u32 i = 0; i < thread_count; ++i) {
+    buffers_.emplace_back(new CommandBuffer());
+  }
+}
+
+CommandBuffer &CommandQueue::local() {
+  return *buffers_[Scheduler::thread_index()];
+}
+
+CommandBuffer &CommandQueue::buffer(u32 thread) { return *buffers_[thread]; }
+
+/// Moves a recorded value into its final storage
+static void move_value(CommandBuffer::Value &value, void *destination) {
+  if (destination == nullptr) {
+    if (value.info->destroy != nullptr) {
+      value.info->destroy(value.data);
+    }
+  } else if (value.info->relocate != nullptr) {
+    value.info->relocate(destination, value.data);
+  } else if (value.info->size != 0) {
+    std::memcpy(destination, value.data, value.info->size);
+  }
+  value.data = nullptr;
+  return;
+}
+
+void CommandQueue::playback(Manager &manager) {
+  using Command = CommandBuffer::Command;
+  using Type    = CommandBuffer::Type;
+
+  sorted_.clear();
+  for (const std::unique_ptr<CommandBuffer> &buffer : buffers_) {
+    for (Command &command : buffer->commands()) {
+      sorted_.push_back(&command);
+    }
+  }
+  if (sorted_.empty()) {
+    return;
+  }
+  // (key, sequence) is unique apart from key 0, which keeps the order of
+  // the buffers
+  std::stable_sort(
+      sorted_.begin(),
+      sorted_.end(),
+      [](const Command *lhs, const Command *rhs) {
+        if (lhs->key != rhs->key) {
+          return lhs->key < rhs->key;
+        }
+        return lhs->key != 0 && lhs->sequence < rhs->sequence;
+      }
+  );
+
+  // register what was recorded before being registered
+  for (Command *command : sorted_) {
+    for (u32 i = 0; i < command->value_count; ++i) {
+      const CommandBuffer::Value &value = command->values[i];
+      if (!manager.component_info(value.id).registered()) {
+        manager.register_component(value.id, *value.info);
+      }
+    }
+  }
+
+  for (Command *command : sorted_) {
+    switch (command->type) {
+      case Type::kDestroy:
+        manager.destroy(command->entity);
+        break;
+      case Type::kAdd:
+        move_value(
+            command->values[0],
+            manager.emplace(command->entity, command->component)
+        );
+        break;
+      case Type::kRemove:
+        if (manager.component_info(command->component).registered()) {
+          manager.remove(command->entity, command->component);
+        }
+        break;
+      case Type::kSpawn:
+        break;
+    }
+  }
+
+  // spawns grouped by archetype, in order of the first spawn of each one
+  spawns_.clear();
+  groups_.clear();
+  for (Command *command : sorted_) {
+    if (command->type == Type::kSpawn) {
+      auto group = groups_.emplace(command->mask, (u32)groups_.size()).first;
+      spawns_.push_back({group->second, command});
+    }
+  }
+  std::stable_sort(
+      spawns_.begin(),
+      spawns_.end(),
+      [](const Spawn &lhs, const Spawn &rhs) { return lhs.group < rhs.group; }
+  );
+
+  for (size_t first = 0; first < spawns_.size();) {
+    u32    group = spawns_[first].group;
+    size_t last  = first + 1;
+    while (last < spawns_.size() && spawns_[last].group == group) {
+      last++;
+    }
+
+    u32 count = (u32)(last - first);
+    entities_.resize(count);
+    ranges_.clear();
+    const Archetype &arch = manager.archetype(manager.create_batch(
+        spawns_[first].command->mask,
+        count,
+        entities_.data(),
+        ranges_
+    ));
+
+    u32 i = 0;
+    for (const RowRange &range : ranges_) {
+      for (u32 row = 0; row < range.count; ++row, ++i) {
+        Command *command = spawns_[first + i].command;
+        for (u32 v = 0; v < command->value_count; ++v) {
+          CommandBuffer::Value &value  = command->values[v];
+          u16                   column = arch.column_index(value.id);
+          if (column != Archetype::kNoColumn) {
+            Location location = {range.chunk, range.first + row};
+            move_value(value, arch.get(location, column));
+          } else {
+            move_value(value, manager.emplace(entities_[i], value.id));
+          }
+        }
+      }
+    }
+    first = last;
+  }
+
+  for (const std::unique_ptr<CommandBuffer> &buffer : buffers_) {
+    buffer->clear();
+  }
+  return;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include "../containers/arena.hpp"
+#include "archetype.hpp"
+#include "common.hpp"
+#include "component.hpp"
+#include "entity.hpp"
+#include "manager.hpp"
+
+namespace embers::ecs {
+
+/// Structural changes recorded by a single thread while systems run. Values
+/// are kept in an arena until a CommandQueue plays them back
+class CommandBuffer {
+ public:
+  enum class Type : u8 {
+    kSpawn   = 0,
+    kDestroy = 1,
+    kAdd     = 2,
+    kRemove  = 3,
+  };
+
+  struct Value {
+    ComponentId          id;
+    const ComponentInfo *info;
+    void                *data;  // nullptr once moved into the world
+  };
+
+  struct Command {
+    u64           key;  // Scheduler::task_key() of the recording task
+    u32           sequence;  // Scheduler::task_sequence()
+    Type          type;
+    ComponentId   component;  // kAdd, kRemove
+    Entity        entity;     // kDestroy, kAdd, kRemove
+    ComponentMask mask;       // kSpawn
+    Value        *values;
+    u32           value_count;
+  };
+
+ private:
+  containers::Arena arena_;
+  Vector<Command>   commands_;
+
+  Command &record(Type type, u32 value_count);
+
+  template <typename T, typename... Args>
+  EMBERS_ALWAYS_INLINE void store(Value &value, Args &&...args);
+
+ public:
+  CommandBuffer();
+  CommandBuffer(const CommandBuffer &other) = delete;
+  CommandBuffer(CommandBuffer &&other)      = delete;
+  ~CommandBuffer();
+
+  CommandBuffer &operator=(const CommandBuffer &rhs) = delete;
+  CommandBuffer &operator=(CommandBuffer &&rhs)      = delete;
+
+  template <typename... T>
+  void spawn(T &&...components);
+  void destroy(Entity entity);
+  template <typename T, typename... Args>
+  void add(Entity entity, Args &&...args);
+  template <typename T>
+  void remove(Entity entity);
+
+  /// Destroys the values that weren't played back and drops the commands
+  void clear();
+
+  EMBERS_ALWAYS_INLINE Vector<Command> &commands();
+  EMBERS_ALWAYS_INLINE bool             empty() const;
+};
+
+/// One CommandBuffer per scheduler thread, played back at sync points (after
+/// Scheduler::run() or from an Access::exclusive() system).
+/// Playback is deterministic: commands are sorted by the task that recorded
+/// them and their order in the task (Scheduler::task_key(), then
+/// task_sequence()), not by the thread that happened to run the task.
+/// Destroy, add and remove commands are applied in the sorted order, mixed
+/// as they were recorded. Spawns come last, grouped by their component set,
+/// and every group is created with a single batch.
+/// Play back once per Scheduler::run(), task keys repeat between runs
+class CommandQueue {
+  struct Spawn {
+    u32                     group;
+    CommandBuffer::Command *command;
+  };
+
+  using SpawnGroups = std::unordered_map<
+      ComponentMask,
+      u32,
+      ComponentMask::Hash,
+      std::equal_to<ComponentMask>,
+      Allocator<std::pair<const ComponentMask, u32>>>;
+
+  Vector<std::unique_ptr<CommandBuffer>> buffers_;
+  Vector<CommandBuffer::Command *>       sorted_;
+  Vector<Spawn>                          spawns_;
+  SpawnGroups                            groups_;  // by component set
+  Vector<Entity>                         entities_;
+  Vector<RowRange>                       ranges_;
+
+ public:
+  CommandQueue() = delete;
+  /// thread_count is usually Scheduler::worker_count() + 1
+  explicit CommandQueue(u32 thread_count);
+
+  /// Buffer of the calling thread
+  CommandBuffer &local();
+  CommandBuffer &buffer(u32 thread);
+
+  void playback(Manager &manager);
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+template <typename T, typename... Args>
+EMBERS_ALWAYS_INLINE void CommandBuffer::store(Value &value, Args &&...args) {
+  static_assert(
+      alignof(T) <= containers::Arena::kMaxAlignment,
+      "Component is over aligned"
+  );
+  value.id   = component_id<T>;
+  value.info = &kComponentInfo<T>;
+  value.data = arena_.allocate(sizeof(T), alignof(T));
+  new (value.data) T(std::forward<Args>(args)...);
+}
+
+template <typename... T>
+void CommandBuffer::spawn(T &&...components) {
+  Command &command = record(Type::kSpawn, sizeof...(T));
+  command.mask     = component_mask<std::decay_t<T>...>();
+
+  u32 i = 0;
+  (store<std::decay_t<T>>(command.values[i++], std::forward<T>(components)),
+   ...);
+}
+
+template <typename T, typename... Args>
+void CommandBuffer::add(Entity entity, Args &&...args) {
+  Command &command  = record(Type::kAdd, 1);
+  command.entity    = entity;
+  command.component = component_id<T>;
+  store<T>(command.values[0], std::forward<Args>(args)...);
+}
+
+template <typename T>
+void CommandBuffer::remove(Entity entity) {
+  Command &command  = record(Type::kRemove, 0);
+  command.entity    = entity;
+  command.component = component_id<T>;
+}
+
+EMBERS_ALWAYS_INLINE Vector<CommandBuffer::Command> &CommandBuffer::commands(
+) {
+  return commands_;
+}
+
+EMBERS_ALWAYS_INLINE bool CommandBuffer::empty() const {
+  return commands_.empty();
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <vector>
+
+#include "../containers/allocator.hpp"
+#include "../containers/debug_allocator.hpp"
+
+namespace embers::ecs {
+
+#ifdef EMBERS_CONFIG_DEBUG
+template <typename T>
+using Allocator = containers::with<
+    containers::DefaultAllocator,
+    containers::DebugAllocatorTags::kEcs>::DebugAllocator<T>;
+
+#else
+template <typename T>
+using Allocator = embers::containers::DefaultAllocator<T>;
+#endif
+
+template <typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+/// Size of a single block of archetype storage
+constexpr size_t kChunkSize = 16 * 1024;
+
+/// Every component column inside of a chunk starts at this alignment, so
+/// iteration code gets cache line aligned arrays
+constexpr size_t kColumnAlignment = 64;
+
+/// Version counter of the world, see Manager::advance_tick()
+using Tick = u32;
+
+/// Ticks wrap around, `tick` is newer when it is less than 2^31 ahead
+constexpr bool is_newer(Tick tick, Tick than) {
+  return (i32)(tick - than) > 0;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace embers::ecs {
+
+using ComponentId = u32;
+
+constexpr ComponentId kMaxComponents = 128;
+
+/// Ids from here up are taken by the components of the engine itself
+constexpr ComponentId kFirstEngineComponent = 112;
+
+/// Every component type must be declared with EMBERS_ECS_COMPONENT, which
+/// gives it a compile time id (the project is built without rtti)
+template <typename T>
+struct ComponentTraits;
+
+// Must be used in the global namespace
+#define EMBERS_ECS_COMPONENT(type, id)                                         \
+  template <>                                                                  \
+  struct embers::ecs::ComponentTraits<type> {                                  \
+    static_assert(                                                             \
+        (id) < embers::ecs::kMaxComponents,                                    \
+        "Component id is too big"                                              \
+    );                                                                         \
+    static constexpr embers::ecs::ComponentId kId   = (id);                    \
+    static constexpr const char              *kName = #type;                   \
+  }
+
+template <typename T>
+constexpr ComponentId component_id = ComponentTraits<std::remove_cv_t<T>>::kId;
+
+class ComponentMask {
+  constexpr static u32 kWords = (kMaxComponents + 63) / 64;
+
+  u64 words_[kWords];
+
+ public:
+  constexpr ComponentMask();
+
+  constexpr ComponentMask &set(ComponentId id);
+  constexpr ComponentMask &reset(ComponentId id);
+  constexpr bool           test(ComponentId id) const;
+  constexpr bool           contains(const ComponentMask &other) const;
+  constexpr bool           intersects(const ComponentMask &other) const;
+  constexpr bool           empty() const;
+  constexpr size_t         hash() const;
+
+  constexpr ComponentMask operator~() const;
+  constexpr ComponentMask operator|(const ComponentMask &rhs) const;
+  constexpr ComponentMask operator&(const ComponentMask &rhs) const;
+  constexpr bool          operator==(const ComponentMask &rhs) const;
+  constexpr bool          operator!=(const ComponentMask &rhs) const;
+
+  struct Hash {
+    constexpr size_t operator()(const ComponentMask &mask) const {
+      return mask.hash();
+    }
+  };
+};
+
+template <typename... T>
+constexpr ComponentMask component_mask();
+
+/// Where the values of a component live, chosen at registration
+enum class Storage : u8 {
+  /// In the archetype chunks: fastest iteration, adding and removing moves
+  /// the whole entity into another archetype
+  kTable     = 0,
+  /// In a separate pool: cheap to add and remove, slower to iterate and join
+  kSparseSet = 1,
+};
+
+/// Type erased description of a component, used by the storages to move
+/// and destroy values they know nothing about
+struct ComponentInfo {
+  using Relocate = void (*)(void *dst, void *src);
+  using Destroy  = void (*)(void *ptr);
+  using Copy     = void (*)(void *dst, const void *src);
+
+  const char *name      = nullptr;
+  u32         size      = 0;  // 0 for tags
+  u32         alignment = 1;
+  Relocate    relocate  = nullptr;  // nullptr means memcpy is enough
+  Destroy     destroy   = nullptr;  // nullptr means trivially destructible
+  Copy        copy      = nullptr;  // nullptr means memcpy is enough
+  b8          copyable  = true;     // false when T can't be copy constructed
+  Storage     storage   = Storage::kTable;
+
+  constexpr bool registered() const { return name != nullptr; }
+};
+
+template <typename T>
+constexpr ComponentInfo make_component_info(Storage storage = Storage::kTable);
+
+/// Table storage description of T with a stable address
+template <typename T>
+inline constexpr ComponentInfo kComponentInfo = make_component_info<T>();
+
+/// Marks a template entity for Manager::instantiate(). Queries and
+/// Manager::each() skip prefabs unless they name this component
+struct Prefab {};
+
+}  // namespace embers::ecs
+
+EMBERS_ECS_COMPONENT(
+    embers::ecs::Prefab,
+    embers::ecs::kFirstEngineComponent + 4
+);
+
+// implementation
+
+namespace embers::ecs {
+
+constexpr ComponentMask::ComponentMask() : words_() {}
+
+constexpr ComponentMask &ComponentMask::set(ComponentId id) {
+  words_[id / 64] |= u64(1) << (id % 64);
+  return *this;
+}
+
+constexpr ComponentMask &ComponentMask::reset(ComponentId id) {
+  words_[id / 64] &= ~(u64(1) << (id % 64));
+  return *this;
+}
+
+constexpr bool ComponentMask::test(ComponentId id) const {
+  return (words_[id / 64] >> (id % 64)) & 1;
+}
+
+constexpr bool ComponentMask::contains(const ComponentMask &other) const {
+  for (u32 i = 0; i < kWords; ++i) {
+    if ((words_[i] & other.words_[i]) != other.words_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr bool ComponentMask::intersects(const ComponentMask &other) const {
+  for (u32 i = 0; i < kWords; ++i) {
+    if ((words_[i] & other.words_[i]) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr bool ComponentMask::empty() const {
+  for (u32 i = 0; i < kWords; ++i) {
+    if (words_[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr size_t ComponentMask::hash() const {
+  u64 hash = 0xcbf29ce484222325;  // fnv-1a over words
+  for (u32 i = 0; i < kWords; ++i) {
+    hash = (hash ^ words_[i]) * 0x100000001b3;
+  }
+  return (size_t)hash;
+}
+
+constexpr ComponentMask ComponentMask::operator~() const {
+  ComponentMask result;
+  for (u32 i = 0; i < kWords; ++i) {
+    result.words_[i] = ~words_[i];
+  }
+  return result;
+}
+
+constexpr ComponentMask ComponentMask::operator|(const ComponentMask &rhs
+) const {
+  ComponentMask result;
+  for (u32 i = 0; i < kWords; ++i) {
+    result.words_[i] = words_[i] | rhs.words_[i];
+  }
+  return result;
+}
+
+constexpr ComponentMask ComponentMask::operator&(const ComponentMask &rhs
+) const {
+  ComponentMask result;
+  for (u32 i = 0; i < kWords; ++i) {
+    result.words_[i] = words_[i] & rhs.words_[i];
+  }
+  return result;
+}
+
+constexpr bool ComponentMask::operator==(const ComponentMask &rhs) const {
+  for (u32 i = 0; i < kWords; ++i) {
+    if (words_[i] != rhs.words_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr bool ComponentMask::operator!=(const ComponentMask &rhs) const {
+  return !operator==(rhs);
+}
+
+template <typename... T>
+constexpr ComponentMask component_mask() {
+  ComponentMask mask;
+  (mask.set(component_id<T>), ...);
+  return mask;
+}
+
+template <typename T>
+constexpr ComponentInfo make_component_info(Storage storage) {
+  ComponentInfo info = {};
+  info.name          = ComponentTraits<T>::kName;
+  info.size          = std::is_empty_v<T> ? 0 : sizeof(T);
+  info.alignment     = alignof(T);
+  info.storage       = storage;
+  if constexpr (!std::is_trivially_copyable_v<T>) {
+    info.relocate = [](void *dst, void *src) {
+      new (dst) T(std::move(*(T *)src));
+      ((T *)src)->~T();
+    };
+  }
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    info.destroy = [](void *ptr) { ((T *)ptr)->~T(); };
+  }
+  if constexpr (!std::is_copy_constructible_v<T>) {
+    info.copyable = false;
+  } else if constexpr (!std::is_trivially_copyable_v<T>) {
+    info.copy = [](void *dst, const void *src) {
+      new (dst) T(*(const T *)src);
+    };
+  }
+  return info;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
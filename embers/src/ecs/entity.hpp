@@ -8,22 +8,24 @@ class Entity {
  public:  // todo
   union {
     struct {
-      u16 index_;
-      u16 counter_;
+      u32 index_;
+      u32 counter_;
     };
-    u32 index_and_counter_;
+    u64 index_and_counter_;
   };
 
  public:
-  constexpr Entity(u16 index, u16 counter) : index_(index), counter_(counter) {}
+  constexpr Entity(u32 index, u32 counter) : index_(index), counter_(counter) {}
   constexpr Entity() : Entity(0, 0) {}
 
-  constexpr bool valid() { return index_and_counter_ != 0; }
+  constexpr bool valid() const { return index_and_counter_ != 0; }
 
-  constexpr bool operator==(const Entity &rhs) {
+  constexpr bool operator==(const Entity &rhs) const {
     return index_and_counter_ == rhs.index_and_counter_;
   }
-  constexpr bool operator!=(const Entity &rhs) { return !(*this == rhs); }
+  constexpr bool operator!=(const Entity &rhs) const { return !(*this == rhs); }
 };
 
+static_assert(sizeof(Entity) == 8, "Size of Entity must be 64 bits");
+
 }  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+
+#include "common.hpp"
+#include "manager.hpp"
+#include "scheduler.hpp"
+
+namespace embers::ecs {
+
+/// Typed events, emitted from any thread into a buffer of its own and
+/// handed to the observers in a single batch.
+///
+/// Buffers are merged at a sync point, flush(), ordered by the task that
+/// emitted them (see Scheduler::task_key()) so the batch is the same from
+/// run to run whatever the threads did. Connected to a Scheduler, the flush
+/// is a system that runs after the systems declared with emitted_by(), and
+/// observers are systems that run after the flush: they are ordered by
+/// their dependencies and run in parallel when their access allows it
+template <typename T>
+class Events {
+  // events emitted in a row by a single task, contiguous in the buffer of a
+  // thread
+  struct Run {
+    u64 key;
+    u32 sequence;  // Scheduler::task_sequence() of the first event
+    u32 thread;
+    u32 first;
+    u32 count;
+  };
+
+  struct alignas(64) Buffer {
+    Vector<T>   events;
+    Vector<Run> runs;
+  };
+
+  Scheduler     *scheduler_;
+  Vector<Buffer> buffers_;
+  Vector<Run>    runs_;
+  Vector<T>      batch_;
+  SystemId       flush_system_;
+
+ public:
+  Events() = delete;
+  /// Standalone, threads are numbered like the workers of a Scheduler
+  explicit Events(u32 thread_count);
+  /// Registers the flush as a system of the scheduler
+  explicit Events(Scheduler &scheduler);
+  Events(const Events &other) = delete;
+  Events(Events &&other)      = delete;
+
+  Events &operator=(const Events &rhs) = delete;
+  Events &operator=(Events &&rhs)      = delete;
+
+  /// Constructs an event in the buffer of the calling thread
+  template <typename... Args>
+  void emit(Args &&...args);
+
+  /// Merges the buffers into the batch, the previous batch is dropped.
+  /// Nothing may emit concurrently
+  void flush();
+
+  /// Orders the flush after `system`, every system emitting the events has
+  /// to be declared
+  void     emitted_by(SystemId system);
+  /// Adds `f(Manager&, const T *events, u32 count)` as a system running
+  /// after the flush and after the `after` systems
+  template <typename F>
+  SystemId observe(
+      const char                     *name,
+      Access                          access,
+      F                             &&f,
+      std::initializer_list<SystemId> after = {}
+  );
+
+  /// Events merged by the last flush
+  EMBERS_ALWAYS_INLINE const T *data() const;
+  EMBERS_ALWAYS_INLINE u32      size() const;
+  EMBERS_ALWAYS_INLINE SystemId flush_system() const;
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+template <typename T>
+Events<T>::Events(u32 thread_count)
+    : scheduler_(nullptr), buffers_(thread_count), flush_system_(u32_MAX) {}
+
+template <typename T>
+Events<T>::Events(Scheduler &scheduler)
+    : scheduler_(&scheduler),
+      buffers_(scheduler.worker_count() + 1),
+      flush_system_(scheduler.add("events_flush", Access(), [this](Manager &) {
+        flush();
+      })) {}
+
+template <typename T>
+template <typename... Args>
+void Events<T>::emit(Args &&...args) {
+  u32     thread   = Scheduler::thread_index();
+  u64     key      = Scheduler::task_key();
+  u32     sequence = Scheduler::task_sequence();
+  Buffer &buffer   = buffers_[thread];
+  // a task resumed on another thread continues in the buffer of that one
+  if (buffer.runs.empty() || buffer.runs.back().key != key ||
+      (key != 0 &&
+       buffer.runs.back().sequence + buffer.runs.back().count != sequence)) {
+    buffer.runs.push_back(
+        {key, sequence, thread, (u32)buffer.events.size(), 0}
+    );
+  }
+  buffer.events.emplace_back(std::forward<Args>(args)...);
+  buffer.runs.back().count++;
+}
+
+template <typename T>
+void Events<T>::flush() {
+  runs_.clear();
+  u32 count = 0;
+  for (Buffer &buffer : buffers_) {
+    runs_.insert(runs_.end(), buffer.runs.begin(), buffer.runs.end());
+    count += (u32)buffer.events.size();
+  }
+  // a task emitting from several threads has its runs put back in order,
+  // the stable sort keeps the ones from outside of tasks in thread order
+  std::stable_sort(runs_.begin(), runs_.end(), [](const Run &a, const Run &b) {
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+    return a.sequence < b.sequence;
+  });
+
+  batch_.clear();
+  batch_.reserve(count);
+  for (const Run &run : runs_) {
+    auto first = buffers_[run.thread].events.begin() + run.first;
+    batch_.insert(
+        batch_.end(),
+        std::make_move_iterator(first),
+        std::make_move_iterator(first + run.count)
+    );
+  }
+  for (Buffer &buffer : buffers_) {
+    buffer.events.clear();
+    buffer.runs.clear();
+  }
+  return;
+}
+
+template <typename T>
+void Events<T>::emitted_by(SystemId system) {
+  scheduler_->add_dependency(system, flush_system_);
+  return;
+}
+
+template <typename T>
+template <typename F>
+SystemId Events<T>::observe(
+    const char                     *name,
+    Access                          access,
+    F                             &&f,
+    std::initializer_list<SystemId> after
+) {
+  SystemId system = scheduler_->add(
+      name,
+      access,
+      [this, f = std::forward<F>(f)](Manager &manager) mutable {
+        if (!batch_.empty()) {
+          f(manager, batch_.data(), (u32)batch_.size());
+        }
+      }
+  );
+  scheduler_->add_dependency(flush_system_, system);
+  for (SystemId before : after) {
+    scheduler_->add_dependency(before, system);
+  }
+  return system;
+}
+
+template <typename T>
+EMBERS_ALWAYS_INLINE const T *Events<T>::data() const {
+  return batch_.data();
+}
+
+template <typename T>
+EMBERS_ALWAYS_INLINE u32 Events<T>::size() const {
+  return (u32)batch_.size();
+}
+
+template <typename T>
+EMBERS_ALWAYS_INLINE SystemId Events<T>::flush_system() const {
+  return flush_system_;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
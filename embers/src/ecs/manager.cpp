@@ -0,0 +1,374 @@
+#include "manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <embers/logger.hpp>
+
+namespace embers::ecs {
+
+Manager::Manager() : components_(), alive_(0), change_tick_(1) {
+  // index 0 is never used, so a zeroed Entity is always invalid
+  records_.push_back({0, kInvalidArchetype, {0, 0}});
+  find_or_create_archetype({});
+}
+
+Manager::~Manager() {
+  for (Archetype &arch : archetypes_) {
+    arch.clear(chunk_pool_);
+  }
+  return;
+}
+
+void Manager::register_component(ComponentId id, const ComponentInfo &info) {
+  ComponentInfo &slot = components_[id];
+
+  if (slot.registered()) {
+    if (std::strcmp(slot.name, info.name) != 0) {
+      EMBERS_ERROR(
+          "Component id {} is used by both {} and {}",
+          id,
+          slot.name,
+          info.name
+      );
+    } else if (slot.storage != info.storage) {
+      EMBERS_ERROR("Storage of component {} can't be changed", info.name);
+    }
+    return;
+  }
+  slot = info;
+
+  if (info.storage == Storage::kSparseSet) {
+    sparse_sets_[id].init(info);
+    sparse_mask_.set(id);
+    sparse_ids_.push_back(id);
+  }
+  return;
+}
+
+Entity Manager::create() {
+  Entity    entity = allocate_entity();
+  Record   &record = records_[entity.index_];
+  record.archetype = 0;
+  record.location  = archetypes_[0].push(chunk_pool_, entity);
+  archetypes_[0].mark_row_added(record.location.chunk, change_tick());
+  return entity;
+}
+
+void Manager::destroy(Entity entity) {
+  if (!alive(entity)) {
+    return;
+  }
+  for (ComponentId id : sparse_ids_) {
+    sparse_sets_[id].erase(entity);
+  }
+
+  Record &record = records_[entity.index_];
+  Entity  moved  = archetypes_[record.archetype].swap_remove(
+      chunk_pool_,
+      record.location,
+      true
+  );
+  if (moved.valid()) {
+    records_[moved.index_].location = record.location;
+  }
+
+  record.counter++;
+  if (record.counter == 0) {  // keep {index, 0} invalid after a wrap
+    record.counter = 1;
+  }
+  record.archetype = kInvalidArchetype;
+  free_indices_.push_back(entity.index_);
+  alive_--;
+  return;
+}
+
+void Manager::clear() {
+  for (Archetype &arch : archetypes_) {
+    arch.clear(chunk_pool_);
+  }
+  for (ComponentId id : sparse_ids_) {
+    sparse_sets_[id].clear();
+  }
+  // bumping the counters keeps the old handles dead
+  free_indices_.clear();
+  for (u32 index = (u32)records_.size() - 1; index > 0; --index) {
+    Record &record = records_[index];
+    if (record.archetype != kInvalidArchetype) {
+      record.counter   = record.counter + 1 == 0 ? 1 : record.counter + 1;
+      record.archetype = kInvalidArchetype;
+    }
+    free_indices_.push_back(index);
+  }
+  alive_ = 0;
+  return;
+}
+
+ArchetypeId Manager::create_batch(
+    const ComponentMask &mask,
+    u32                  count,
+    Entity              *entities,
+    Vector<RowRange>    &ranges
+) {
+  ArchetypeId id = find_or_create_archetype(mask & ~sparse_mask_);
+
+  for (u32 i = 0; i < count; ++i) {
+    entities[i] = allocate_entity();
+  }
+
+  size_t first_range = ranges.size();
+  archetypes_[id].push_batch(chunk_pool_, entities, count, ranges);
+
+  u32 i = 0;
+  for (size_t r = first_range; r < ranges.size(); ++r) {
+    archetypes_[id].mark_row_added(ranges[r].chunk, change_tick());
+    for (u32 row = 0; row < ranges[r].count; ++row, ++i) {
+      Record &record   = records_[entities[i].index_];
+      record.archetype = id;
+      record.location  = {ranges[r].chunk, ranges[r].first + row};
+    }
+  }
+  return id;
+}
+
+/// Copies `src` into `count` consecutive values at `dst`
+static void broadcast(
+    const ComponentInfo &info, u8 *dst, const void *src, u32 count
+) {
+  if (info.copy != nullptr) {
+    for (u32 i = 0; i < count; ++i) {
+      info.copy(dst + (size_t)i * info.size, src);
+    }
+    return;
+  }
+  // every copy doubles the filled part, large blocks keep memcpy fast
+  std::memcpy(dst, src, info.size);
+  for (u32 filled = 1; filled < count;) {
+    u32 block = std::min(filled, count - filled);
+    std::memcpy(
+        dst + (size_t)filled * info.size,
+        dst,
+        (size_t)block * info.size
+    );
+    filled += block;
+  }
+  return;
+}
+
+bool Manager::instantiate_rows(
+    Entity               prefab,
+    const ComponentMask &extra,
+    u32                  count,
+    Entity              *entities,
+    Vector<RowRange>    &ranges,
+    ArchetypeId         &id
+) {
+  if (!alive(prefab)) {
+    EMBERS_ERROR("Prefab {} isn't alive", prefab.index_);
+    return false;
+  }
+  const Record  source = records_[prefab.index_];
+  ComponentMask mask   = archetypes_[source.archetype].mask();
+  mask.reset(component_id<Prefab>);
+
+  Vector<ComponentId> copied;
+  for (const Archetype::Column &column :
+       archetypes_[source.archetype].columns()) {
+    copied.push_back(column.id);
+  }
+  size_t first_sparse = copied.size();
+  for (ComponentId sparse_id : sparse_ids_) {
+    if (sparse_sets_[sparse_id].get(prefab) != nullptr) {
+      copied.push_back(sparse_id);
+    }
+  }
+  for (ComponentId component : copied) {
+    if (!components_[component].copyable) {
+      EMBERS_ERROR(
+          "Component {} can't be copied, prefab {} can't be instantiated",
+          components_[component].name,
+          prefab.index_
+      );
+      return false;
+    }
+  }
+
+  id = create_batch(mask | extra, count, entities, ranges);
+
+  // chunks don't move when archetypes are created, the pointers stay valid
+  const Archetype &src = archetypes_[source.archetype];
+  const Archetype &dst = archetypes_[id];
+  for (u16 column = 0; column < dst.columns().size(); ++column) {
+    ComponentId component = dst.columns()[column].id;
+    u16         from      = src.column_index(component);
+    if (from == Archetype::kNoColumn || components_[component].size == 0) {
+      continue;
+    }
+    const void *value = src.get(source.location, from);
+    for (const RowRange &range : ranges) {
+      u8 *rows = (u8 *)dst.column_data(range.chunk, column) +
+                 (size_t)range.first * components_[component].size;
+      broadcast(components_[component], rows, value, range.count);
+    }
+  }
+
+  for (size_t i = first_sparse; i < copied.size(); ++i) {
+    ComponentId          component = copied[i];
+    const ComponentInfo &info      = components_[component];
+    for (u32 e = 0; e < count; ++e) {
+      // the pool may grow, the prefab value is looked up every time
+      void       *slot  = sparse_sets_[component].emplace(entities[e]);
+      const void *value = sparse_sets_[component].get(prefab);
+      if (info.copy != nullptr) {
+        info.copy(slot, value);
+      } else {
+        std::memcpy(slot, value, info.size);
+      }
+    }
+  }
+  return true;
+}
+
+void *Manager::emplace(Entity entity, ComponentId id) {
+  if (!alive(entity)) {
+    return nullptr;
+  }
+  const ComponentInfo &info = components_[id];
+
+  if (info.storage == Storage::kSparseSet) {
+    SparseSet &set      = sparse_sets_[id];
+    void      *existing = set.get(entity);
+    if (existing == nullptr) {
+      return set.emplace(entity);
+    }
+    if (info.destroy != nullptr) {
+      info.destroy(existing);
+    }
+    return existing;
+  }
+
+  Record &record = records_[entity.index_];
+  u16     column = archetypes_[record.archetype].column_index(id);
+  if (column != Archetype::kNoColumn) {
+    const Archetype &arch     = archetypes_[record.archetype];
+    void            *existing = arch.get(record.location, column);
+    if (info.destroy != nullptr) {
+      info.destroy(existing);
+    }
+    arch.mark_changed(record.location.chunk, column, change_tick());
+    return existing;
+  }
+
+  move_entity(entity, add_transition(record.archetype, id));
+  const Archetype &arch = archetypes_[record.archetype];
+  column                = arch.column_index(id);
+  arch.mark_added(record.location.chunk, column, change_tick());
+  return arch.get(record.location, column);
+}
+
+void Manager::remove(Entity entity, ComponentId id) {
+  if (!alive(entity)) {
+    return;
+  }
+  if (components_[id].storage == Storage::kSparseSet) {
+    sparse_sets_[id].erase(entity);
+    return;
+  }
+  const Record &record = records_[entity.index_];
+  if (!archetypes_[record.archetype].mask().test(id)) {
+    return;
+  }
+  move_entity(entity, remove_transition(record.archetype, id));
+  return;
+}
+
+bool Manager::alive(Entity entity) const {
+  return entity.index_ != 0 && entity.index_ < records_.size() &&
+         records_[entity.index_].counter == entity.counter_ &&
+         records_[entity.index_].archetype != kInvalidArchetype;
+}
+
+Entity Manager::allocate_entity() {
+  alive_++;
+  if (!free_indices_.empty()) {
+    u32 index = free_indices_.back();
+    free_indices_.pop_back();
+    return {index, records_[index].counter};
+  }
+  u32 index = (u32)records_.size();
+  records_.push_back({1, kInvalidArchetype, {0, 0}});
+  return {index, 1};
+}
+
+ArchetypeId Manager::find_or_create_archetype(const ComponentMask &mask) {
+  auto iter = archetype_lookup_.find(mask);
+  if (iter != archetype_lookup_.end()) {
+    return iter->second;
+  }
+  ArchetypeId id = (ArchetypeId)archetypes_.size();
+  archetypes_.emplace_back(mask, components_);
+  archetype_lookup_.insert({mask, id});
+  return id;
+}
+
+ArchetypeId Manager::add_transition(ArchetypeId from, ComponentId id) {
+  ArchetypeId to = archetypes_[from].add_edge(id);
+  if (to != kInvalidArchetype) {
+    return to;
+  }
+  ComponentMask mask = archetypes_[from].mask();
+  to                 = find_or_create_archetype(mask.set(id));
+  archetypes_[from].set_add_edge(id, to);
+  archetypes_[to].set_remove_edge(id, from);
+  return to;
+}
+
+ArchetypeId Manager::remove_transition(ArchetypeId from, ComponentId id) {
+  ArchetypeId to = archetypes_[from].remove_edge(id);
+  if (to != kInvalidArchetype) {
+    return to;
+  }
+  ComponentMask mask = archetypes_[from].mask();
+  to                 = find_or_create_archetype(mask.reset(id));
+  archetypes_[from].set_remove_edge(id, to);
+  archetypes_[to].set_add_edge(id, from);
+  return to;
+}
+
+void Manager::move_entity(Entity entity, ArchetypeId to) {
+  Record    &record = records_[entity.index_];
+  Archetype &src    = archetypes_[record.archetype];
+  Archetype &dst    = archetypes_[to];
+  Location   from   = record.location;
+  Location   loc    = dst.push(chunk_pool_, entity);
+
+  const auto &columns = src.columns();
+  for (u16 i = 0; i < columns.size(); ++i) {
+    void *src_ptr    = src.get(from, i);
+    u16   dst_column = dst.column_index(columns[i].id);
+
+    if (dst_column == Archetype::kNoColumn) {
+      if (columns[i].destroy != nullptr) {
+        columns[i].destroy(src_ptr);
+      }
+      continue;
+    }
+    if (columns[i].relocate != nullptr) {
+      columns[i].relocate(dst.get(loc, dst_column), src_ptr);
+    } else {
+      std::memcpy(dst.get(loc, dst_column), src_ptr, columns[i].size);
+    }
+    // the values keep their ticks
+    dst.mark_added(loc.chunk, dst_column, src.added_tick(from.chunk, i));
+    dst.mark_changed(loc.chunk, dst_column, src.changed_tick(from.chunk, i));
+  }
+
+  Entity moved = src.swap_remove(chunk_pool_, from, false);
+  if (moved.valid()) {
+    records_[moved.index_].location = from;
+  }
+  record.archetype = to;
+  record.location  = loc;
+  return;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
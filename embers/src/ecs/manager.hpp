@@ -1,12 +1,479 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <embers/logger.hpp>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "../io/file.hpp"
+#include "archetype.hpp"
+#include "common.hpp"
+#include "component.hpp"
 #include "entity.hpp"
+#include "sparse_set.hpp"
 
 namespace embers::ecs {
 
 class Manager {
+  friend class Snapshot;
+
+  struct Record {
+    u32         counter;
+    ArchetypeId archetype;
+    Location    location;
+  };
+
+  using ArchetypeLookup = std::unordered_map<
+      ComponentMask,
+      ArchetypeId,
+      ComponentMask::Hash,
+      std::equal_to<ComponentMask>,
+      Allocator<std::pair<const ComponentMask, ArchetypeId>>>;
+
+  ChunkPool              chunk_pool_;
+  ComponentInfo          components_[kMaxComponents];
+  SparseSet              sparse_sets_[kMaxComponents];
+  ComponentMask          sparse_mask_;
+  Vector<ComponentId>    sparse_ids_;
+  Vector<Archetype>      archetypes_;
+  ArchetypeLookup        archetype_lookup_;
+  Vector<Record>         records_;
+  Vector<u32>            free_indices_;
+  u32                    alive_;
+  std::atomic<Tick>      change_tick_;
+  Vector<io::MappedFile> mappings_;  // snapshots with adopted chunks
+
+  ArchetypeId find_or_create_archetype(const ComponentMask &mask);
+  ArchetypeId add_transition(ArchetypeId from, ComponentId id);
+  ArchetypeId remove_transition(ArchetypeId from, ComponentId id);
+  Entity      allocate_entity();
+  void        move_entity(Entity entity, ArchetypeId to);
+
+  template <typename T>
+  EMBERS_ALWAYS_INLINE void ensure_registered();
+  template <typename T>
+  EMBERS_ALWAYS_INLINE bool is_sparse() const;
+  template <typename T>
+  EMBERS_ALWAYS_INLINE T *fetch(
+      const Archetype &arch, Location location, Entity entity
+  ) const;
+  template <typename... T, typename F>
+  void each_joined(F &f, const ComponentMask &table_mask);
+  template <typename... T>
+  EMBERS_ALWAYS_INLINE void mark_written(const Archetype &arch, u32 chunk)
+      const;
+  template <typename... T>
+  EMBERS_ALWAYS_INLINE static bool skips(const Archetype &arch);
+
+  bool instantiate_rows(
+      Entity               prefab,
+      const ComponentMask &extra,
+      u32                  count,
+      Entity              *entities,
+      Vector<RowRange>    &ranges,
+      ArchetypeId         &id
+  );
+  template <typename T>
+  void override_rows(
+      ArchetypeId             id,
+      bool                    constructed,
+      const Vector<RowRange> &ranges,
+      u32                     count,
+      const Entity           *entities,
+      const T                *values
+  );
 
  public:
+  Manager();
+  Manager(const Manager &other) = delete;
+  Manager(Manager &&other)      = delete;
+  ~Manager();
+
+  Manager &operator=(const Manager &rhs) = delete;
+  Manager &operator=(Manager &&rhs)      = delete;
+
+  template <typename T>
+  void register_component(Storage storage = Storage::kTable);
+  void register_component(ComponentId id, const ComponentInfo &info);
+
+  Entity create();
+  template <typename... T>
+  Entity create(T &&...components);
+  void   destroy(Entity entity);
+  bool   alive(Entity entity) const;
+  /// Destroys every entity, archetypes and registrations are kept
+  void   clear();
+
+  /// Creates `count` entities in the archetype of the table components of
+  /// `mask` in one go. Table components are left uninitialized, `ranges`
+  /// receives the rows the entities got, in order. Sparse components of the
+  /// mask have to be added with emplace()
+  ArchetypeId create_batch(
+      const ComponentMask &mask,
+      u32                  count,
+      Entity              *entities,
+      Vector<RowRange>    &ranges
+  );
+
+  /// Creates `count` copies of the `prefab` entity, without the Prefab tag.
+  /// The component values of the prefab are broadcast into the new rows
+  /// with doubling memcpy, then every `overrides` array (`count` values of
+  /// one component) is copied over its column, one block per chunk.
+  /// Overrides of components the prefab doesn't have add them. Returns false
+  /// when the prefab is dead or has a component that can't be copied
+  template <typename... T>
+  bool instantiate(
+      Entity prefab, u32 count, Entity *entities, const T *...overrides
+  );
+
+  /// Type erased add: returns uninitialized storage for the component, an
+  /// old value is destroyed first. Returns nullptr for dead entities
+  void *emplace(Entity entity, ComponentId id);
+  void  remove(Entity entity, ComponentId id);
+
+  template <typename T, typename... Args>
+  T *add(Entity entity, Args &&...args);
+  template <typename T>
+  void remove(Entity entity);
+  /// `get<T>()` marks the chunk changed, `get<const T>()` doesn't
+  template <typename T>
+  T *get(Entity entity) const;
+  template <typename T>
+  bool has(Entity entity) const;
+
+  /// Calls `f(T&...)` or `f(Entity, T&...)` for every entity that has all of
+  /// the components, walking the chunk arrays linearly. Sparse components are
+  /// joined by entity lookups. Chunks of non const components are marked
+  /// changed. Prefabs are skipped unless T names Prefab
+  template <typename... T, typename F>
+  void each(F &&f);
+
+  /// Changes made outside of queries (structural changes, get() and each())
+  /// are marked with the current tick
+  EMBERS_ALWAYS_INLINE Tick change_tick() const;
+  /// Starts a run of a query and returns its tick, everything marked later
+  /// is newer than it. Thread safe
+  EMBERS_ALWAYS_INLINE Tick advance_tick();
+
+  EMBERS_ALWAYS_INLINE u32              size() const;
+  EMBERS_ALWAYS_INLINE u32              archetype_count() const;
+  EMBERS_ALWAYS_INLINE const Archetype &archetype(ArchetypeId id) const;
+  EMBERS_ALWAYS_INLINE const ComponentInfo &component_info(ComponentId id
+  ) const;
 };
 
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+template <typename T>
+EMBERS_ALWAYS_INLINE void Manager::ensure_registered() {
+  if (!components_[component_id<T>].registered()) {
+    register_component<T>();
+  }
+}
+
+template <typename T>
+EMBERS_ALWAYS_INLINE bool Manager::is_sparse() const {
+  return components_[component_id<T>].storage == Storage::kSparseSet;
+}
+
+template <typename T>
+void Manager::register_component(Storage storage) {
+  register_component(component_id<T>, make_component_info<T>(storage));
+}
+
+template <typename... T>
+Entity Manager::create(T &&...components) {
+  (ensure_registered<std::decay_t<T>>(), ...);
+
+  constexpr ComponentMask mask = component_mask<std::decay_t<T>...>();
+
+  ArchetypeId id     = find_or_create_archetype(mask & ~sparse_mask_);
+  Entity      entity = allocate_entity();
+  Archetype  &arch   = archetypes_[id];
+  Location    loc    = arch.push(chunk_pool_, entity);
+  arch.mark_row_added(loc.chunk, change_tick());
+
+  const auto place = [&](auto &&component) {
+    using Type = std::decay_t<decltype(component)>;
+    void *slot =
+        is_sparse<Type>()
+            ? sparse_sets_[component_id<Type>].emplace(entity)
+            : arch.get(loc, arch.column_index(component_id<Type>));
+    new (slot) Type(std::forward<decltype(component)>(component));
+  };
+  (place(std::forward<T>(components)), ...);
+
+  records_[entity.index_].archetype = id;
+  records_[entity.index_].location  = loc;
+  return entity;
+}
+
+template <typename T, typename... Args>
+T *Manager::add(Entity entity, Args &&...args) {
+  ensure_registered<T>();
+
+  void *slot = emplace(entity, component_id<T>);
+  if (slot == nullptr) {
+    return nullptr;
+  }
+  return new (slot) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+void Manager::remove(Entity entity) {
+  remove(entity, component_id<T>);
+}
+
+template <typename... T>
+bool Manager::instantiate(
+    Entity prefab, u32 count, Entity *entities, const T *...overrides
+) {
+  (ensure_registered<T>(), ...);
+
+  Vector<RowRange> ranges;
+  ArchetypeId      id;
+  if (!instantiate_rows(
+          prefab,
+          component_mask<T...>(),
+          count,
+          entities,
+          ranges,
+          id
+      )) {
+    return false;
+  }
+
+  // components of the prefab hold copies already, the others are raw rows
+  const ComponentMask &from_prefab =
+      archetypes_[records_[prefab.index_].archetype].mask();
+  (override_rows<T>(
+       id,
+       from_prefab.test(component_id<T>),
+       ranges,
+       count,
+       entities,
+       overrides
+   ),
+   ...);
+  return true;
+}
+
+template <typename T>
+void Manager::override_rows(
+    ArchetypeId             id,
+    bool                    constructed,
+    const Vector<RowRange> &ranges,
+    u32                     count,
+    const Entity           *entities,
+    const T                *values
+) {
+  if constexpr (std::is_empty_v<T>) {
+    return;
+  } else if (is_sparse<T>()) {
+    for (u32 i = 0; i < count; ++i) {
+      new (emplace(entities[i], component_id<T>)) T(values[i]);
+    }
+  } else {
+    const Archetype &arch = archetypes_[id];
+    for (const RowRange &range : ranges) {
+      T *rows = arch.template column_data<T>(range.chunk) + range.first;
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memcpy(rows, values, sizeof(T) * range.count);
+      } else if (constructed) {
+        std::copy(values, values + range.count, rows);
+      } else {
+        std::uninitialized_copy(values, values + range.count, rows);
+      }
+      values += range.count;
+    }
+  }
+}
+
+template <typename T>
+T *Manager::get(Entity entity) const {
+  if (!alive(entity)) {
+    return nullptr;
+  }
+  if (is_sparse<T>()) {
+    return (T *)sparse_sets_[component_id<T>].get(entity);
+  }
+  const Record    &record = records_[entity.index_];
+  const Archetype &arch   = archetypes_[record.archetype];
+  u16              column = arch.column_index(component_id<T>);
+  if (column == Archetype::kNoColumn) {
+    return nullptr;
+  }
+  if constexpr (!std::is_const_v<T>) {
+    arch.mark_changed(record.location.chunk, column, change_tick());
+  }
+  return (T *)arch.get(record.location, column);
+}
+
+template <typename T>
+bool Manager::has(Entity entity) const {
+  if (!alive(entity)) {
+    return false;
+  }
+  if (is_sparse<T>()) {
+    return sparse_sets_[component_id<T>].contains(entity);
+  }
+  return archetypes_[records_[entity.index_].archetype].mask().test(
+      component_id<T>
+  );
+}
+
+namespace internal {
+
+template <typename F, typename... T>
+EMBERS_ALWAYS_INLINE void invoke_rows(
+    F &f, const Entity *entities, u32 count, T *...columns
+) {
+  for (u32 i = 0; i < count; ++i) {
+    if constexpr (std::is_invocable_v<F &, Entity, T &...>) {
+      f(entities[i], columns[i]...);
+    } else {
+      f(columns[i]...);
+    }
+  }
+}
+
+}  // namespace internal
+
+template <typename T>
+EMBERS_ALWAYS_INLINE T *Manager::fetch(
+    const Archetype &arch, Location location, Entity entity
+) const {
+  if (is_sparse<T>()) {
+    return (T *)sparse_sets_[component_id<T>].get(entity);
+  }
+  return (T *)arch.get(location, arch.column_index(component_id<T>));
+}
+
+template <typename... T>
+EMBERS_ALWAYS_INLINE void Manager::mark_written(
+    const Archetype &arch, u32 chunk
+) const {
+  const Tick tick = change_tick();
+  const auto mark = [&](ComponentId id) {
+    u16 column = arch.column_index(id);
+    if (column != Archetype::kNoColumn) {
+      arch.mark_changed(chunk, column, tick);
+    }
+  };
+  ((std::is_const_v<T> ? (void)0 : mark(component_id<T>)), ...);
+}
+
+template <typename... T>
+EMBERS_ALWAYS_INLINE bool Manager::skips(const Archetype &arch) {
+  // prefabs are only visited when asked for
+  constexpr ComponentId kPrefab = component_id<Prefab>;
+  return !component_mask<T...>().test(kPrefab) && arch.mask().test(kPrefab);
+}
+
+template <typename... T, typename F>
+void Manager::each_joined(F &f, const ComponentMask &table_mask) {
+  const auto call = [&](Entity entity, T *...components) {
+    if (((components == nullptr) || ...)) {
+      return;
+    }
+    if constexpr (std::is_invocable_v<F &, Entity, T &...>) {
+      f(entity, *components...);
+    } else {
+      f(*components...);
+    }
+  };
+
+  if (!table_mask.empty()) {
+    for (const Archetype &arch : archetypes_) {
+      if (arch.size() == 0 || !arch.mask().contains(table_mask) ||
+          skips<T...>(arch)) {
+        continue;
+      }
+      for (u32 c = 0; c < arch.chunk_count(); ++c) {
+        mark_written<T...>(arch, c);
+        const Entity *entities = arch.entities(c);
+        for (u32 row = 0; row < arch.chunk(c).count; ++row) {
+          call(entities[row], fetch<T>(arch, {c, row}, entities[row])...);
+        }
+      }
+    }
+    return;
+  }
+
+  // only sparse components: drive the join by the smallest pool
+  const SparseSet *smallest = nullptr;
+  for (ComponentId id : {component_id<T>...}) {
+    if (smallest == nullptr || sparse_sets_[id].size() < smallest->size()) {
+      smallest = &sparse_sets_[id];
+    }
+  }
+  const Archetype &none = archetypes_[0];
+  for (u32 i = 0; i < smallest->size(); ++i) {
+    Entity entity = smallest->entities()[i];
+    if (!skips<T...>(archetypes_[records_[entity.index_].archetype])) {
+      call(entity, fetch<T>(none, {0, 0}, entity)...);
+    }
+  }
+}
+
+template <typename... T, typename F>
+void Manager::each(F &&f) {
+  constexpr ComponentMask mask = component_mask<T...>();
+
+  if (mask.intersects(sparse_mask_)) {
+    each_joined<T...>(f, mask & ~sparse_mask_);
+    return;
+  }
+
+  for (const Archetype &arch : archetypes_) {
+    if (arch.size() == 0 || !arch.mask().contains(mask) ||
+        skips<T...>(arch)) {
+      continue;
+    }
+    for (u32 c = 0; c < arch.chunk_count(); ++c) {
+      mark_written<T...>(arch, c);
+      internal::invoke_rows(
+          f,
+          arch.entities(c),
+          arch.chunk(c).count,
+          arch.template column_data<T>(c)...
+      );
+    }
+  }
+}
+
+EMBERS_ALWAYS_INLINE u32 Manager::size() const { return alive_; }
+
+EMBERS_ALWAYS_INLINE Tick Manager::change_tick() const {
+  return change_tick_.load(std::memory_order_relaxed);
+}
+
+EMBERS_ALWAYS_INLINE Tick Manager::advance_tick() {
+  return change_tick_.fetch_add(1, std::memory_order_relaxed);
+}
+
+EMBERS_ALWAYS_INLINE u32 Manager::archetype_count() const {
+  return (u32)archetypes_.size();
+}
+
+EMBERS_ALWAYS_INLINE const Archetype &Manager::archetype(ArchetypeId id
+) const {
+  return archetypes_[id];
+}
+
+EMBERS_ALWAYS_INLINE const ComponentInfo &Manager::component_info(
+    ComponentId id
+) const {
+  return components_[id];
+}
+
 }  // namespace embers::ecs
\ No newline at end of file
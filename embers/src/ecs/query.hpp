@@ -0,0 +1,441 @@
+#pragma once
+
+#include <embers/logger.hpp>
+#include <tuple>
+#include <type_traits>
+
+#include "archetype.hpp"
+#include "common.hpp"
+#include "component.hpp"
+#include "manager.hpp"
+
+namespace embers::ecs {
+
+// Query terms
+
+/// Component is fetched as `const T*`
+template <typename T>
+struct Read {};
+
+/// Component is fetched as `T*`
+template <typename T>
+struct Write {};
+
+/// Archetypes with the component are skipped
+template <typename T>
+struct Without {};
+
+/// Only chunks where the component was written since the previous run of the
+/// query. Granularity is the chunk, unchanged rows of a changed chunk are
+/// visited too
+template <typename T>
+struct Changed {};
+
+/// Only chunks where a row got the component since the previous run of the
+/// query, with the granularity of Changed<T>
+template <typename T>
+struct Added {};
+
+namespace internal {
+
+template <typename Term>
+struct TermTraits;
+
+template <typename T>
+struct TermTraits<Read<T>> {
+  using Component                 = T;
+  using Pointer                   = const T *;
+  constexpr static bool kFetch    = true;
+  constexpr static bool kRequired = true;
+  constexpr static bool kRead     = true;
+  constexpr static bool kWrite    = false;
+  constexpr static bool kExcluded = false;
+  constexpr static bool kChanged  = false;
+  constexpr static bool kAdded    = false;
+};
+
+template <typename T>
+struct TermTraits<Write<T>> {
+  using Component                 = T;
+  using Pointer                   = T *;
+  constexpr static bool kFetch    = true;
+  constexpr static bool kRequired = true;
+  constexpr static bool kRead     = false;
+  constexpr static bool kWrite    = true;
+  constexpr static bool kExcluded = false;
+  constexpr static bool kChanged  = false;
+  constexpr static bool kAdded    = false;
+};
+
+template <typename T>
+struct TermTraits<Without<T>> {
+  using Component                 = T;
+  using Pointer                   = void;
+  constexpr static bool kFetch    = false;
+  constexpr static bool kRequired = false;
+  constexpr static bool kRead     = false;
+  constexpr static bool kWrite    = false;
+  constexpr static bool kExcluded = true;
+  constexpr static bool kChanged  = false;
+  constexpr static bool kAdded    = false;
+};
+
+// filters read the ticks, so a writer of the component conflicts with them
+
+template <typename T>
+struct TermTraits<Changed<T>> {
+  using Component                 = T;
+  using Pointer                   = void;
+  constexpr static bool kFetch    = false;
+  constexpr static bool kRequired = true;
+  constexpr static bool kRead     = true;
+  constexpr static bool kWrite    = false;
+  constexpr static bool kExcluded = false;
+  constexpr static bool kChanged  = true;
+  constexpr static bool kAdded    = false;
+};
+
+template <typename T>
+struct TermTraits<Added<T>> {
+  using Component                 = T;
+  using Pointer                   = void;
+  constexpr static bool kFetch    = false;
+  constexpr static bool kRequired = true;
+  constexpr static bool kRead     = true;
+  constexpr static bool kWrite    = false;
+  constexpr static bool kExcluded = false;
+  constexpr static bool kChanged  = false;
+  constexpr static bool kAdded    = true;
+};
+
+template <template <typename> typename Flag, typename... Terms>
+constexpr ComponentMask terms_mask() {
+  ComponentMask mask;
+  ((Flag<Terms>::value
+        ? (void)mask.set(component_id<typename TermTraits<Terms>::Component>)
+        : (void)0),
+   ...);
+  return mask;
+}
+
+template <typename Term>
+struct IsRequired : std::bool_constant<TermTraits<Term>::kRequired> {};
+template <typename Term>
+struct IsRead : std::bool_constant<TermTraits<Term>::kRead> {};
+template <typename Term>
+struct IsWrite : std::bool_constant<TermTraits<Term>::kWrite> {};
+template <typename Term>
+struct IsExcluded : std::bool_constant<TermTraits<Term>::kExcluded> {};
+template <typename Term>
+struct IsFilter : std::bool_constant<
+                      TermTraits<Term>::kChanged || TermTraits<Term>::kAdded> {
+};
+
+template <typename T, typename... Terms>
+constexpr u32 term_index() {
+  constexpr bool matches[] = {
+      (TermTraits<Terms>::kFetch &&
+       std::is_same_v<
+           std::remove_cv_t<T>,
+           typename TermTraits<Terms>::Component>)...,
+      false
+  };
+  for (u32 i = 0; i < sizeof...(Terms); ++i) {
+    if (matches[i]) {
+      return i;
+    }
+  }
+  return u32_MAX;
+}
+
+template <typename Term>
+EMBERS_ALWAYS_INLINE auto fetch_column(const Archetype &arch, u32 chunk) {
+  using Traits = TermTraits<Term>;
+  if constexpr (Traits::kFetch) {
+    auto column = arch.template column_data<typename Traits::Component>(chunk);
+    return std::tuple<typename Traits::Pointer>(
+        EMBERS_ASSUME_ALIGNED(column, kColumnAlignment)
+    );
+  } else {
+    return std::tuple<>();
+  }
+}
+
+template <typename Term>
+EMBERS_ALWAYS_INLINE bool passes_filter(
+    const Archetype &arch, u32 chunk, Tick since
+) {
+  using Traits = TermTraits<Term>;
+  if constexpr (Traits::kChanged || Traits::kAdded) {
+    u16 column = arch.column_index(component_id<typename Traits::Component>);
+    Tick tick  = Traits::kChanged ? arch.changed_tick(chunk, column)
+                                  : arch.added_tick(chunk, column);
+    return is_newer(tick, since);
+  } else {
+    return true;
+  }
+}
+
+template <typename Term>
+EMBERS_ALWAYS_INLINE void mark_written(
+    const Archetype &arch, u32 chunk, Tick tick
+) {
+  using Traits = TermTraits<Term>;
+  if constexpr (Traits::kWrite) {
+    arch.mark_changed(
+        chunk,
+        arch.column_index(component_id<typename Traits::Component>),
+        tick
+    );
+  }
+}
+
+}  // namespace internal
+
+/// Columns of a single chunk, matched by a Query
+template <typename... Terms>
+class ChunkView {
+  const Entity *entities_;
+  u32           size_;
+  void         *columns_[sizeof...(Terms) + 1];
+
+ public:
+  /// Marks the Write<T> columns changed at `tick`
+  ChunkView(const Archetype &arch, u32 chunk, Tick tick);
+
+  EMBERS_ALWAYS_INLINE u32           size() const;
+  EMBERS_ALWAYS_INLINE const Entity *entities() const;
+
+  /// `const T*` for Read<T>, `T*` for Write<T>; aligned to kColumnAlignment
+  template <typename T>
+  EMBERS_ALWAYS_INLINE auto get() const;
+};
+
+/// Typed view over the archetypes of a Manager, e.g.
+/// `Query<Read<Velocity>, Write<Position>, Without<Frozen>>`.
+/// Masks are computed at compile time, matching archetypes are cached and
+/// the cache only looks at the archetypes created since the last use.
+/// Every run gets a tick from the Manager: Write<T> columns are marked with
+/// it and Changed<T>/Added<T> skip the chunks that weren't touched since the
+/// previous run. Prefabs are skipped unless a term names Prefab. Terms must
+/// use Storage::kTable components
+template <typename... Terms>
+class Query {
+ public:
+  constexpr static ComponentMask kRequired =
+      internal::terms_mask<internal::IsRequired, Terms...>();
+  constexpr static ComponentMask kReads =
+      internal::terms_mask<internal::IsRead, Terms...>();
+  constexpr static ComponentMask kWrites =
+      internal::terms_mask<internal::IsWrite, Terms...>();
+  constexpr static ComponentMask kExcluded =
+      internal::terms_mask<internal::IsExcluded, Terms...>();
+  constexpr static ComponentMask kFilters =
+      internal::terms_mask<internal::IsFilter, Terms...>();
+  /// Excluded terms, plus prefabs unless a term names them
+  constexpr static ComponentMask kSkipped =
+      (kRequired | kExcluded).test(component_id<Prefab>)
+          ? kExcluded
+          : kExcluded | component_mask<Prefab>();
+
+  using View = ChunkView<Terms...>;
+
+ private:
+  Manager            *manager_;
+  Vector<ArchetypeId> archetypes_;
+  u32                 seen_;
+  Tick                last_tick_;
+  Tick                tick_;
+
+ public:
+  Query() = delete;
+  explicit Query(Manager &manager);
+
+  /// Picks up archetypes created since the last call
+  void update();
+  /// Starts a new run, each() and each_chunk() do it by themselves. Returns
+  /// the tick of the run
+  Tick advance();
+  /// Whether the chunk passes the filters of the current run
+  EMBERS_ALWAYS_INLINE bool matches(const Archetype &arch, u32 chunk) const;
+
+  /// Calls `f(const View&)` for every non empty chunk that passes the filters
+  template <typename F>
+  void each_chunk(F &&f);
+
+  /// Calls `f(T&...)` or `f(Entity, T&...)` for every entity of the chunks
+  /// that pass the filters, components are passed in the order of the terms,
+  /// Read<T> as `const T&`
+  template <typename F>
+  void each(F &&f);
+
+  u32 size();
+
+  EMBERS_ALWAYS_INLINE const Vector<ArchetypeId> &archetypes() const;
+  EMBERS_ALWAYS_INLINE Manager                   &manager() const;
+  EMBERS_ALWAYS_INLINE Tick                       tick() const;
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+template <typename... Terms>
+ChunkView<Terms...>::ChunkView(const Archetype &arch, u32 chunk, Tick tick)
+    : entities_(arch.entities(chunk)),
+      size_(arch.chunk(chunk).count),
+      columns_{
+          (internal::TermTraits<Terms>::kFetch
+               ? arch.column_data(
+                     chunk,
+                     arch.column_index(component_id<
+                                       typename internal::TermTraits<
+                                           Terms>::Component>)
+                 )
+               : nullptr)...,
+          nullptr
+      } {
+  (internal::mark_written<Terms>(arch, chunk, tick), ...);
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE u32 ChunkView<Terms...>::size() const {
+  return size_;
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE const Entity *ChunkView<Terms...>::entities() const {
+  return entities_;
+}
+
+template <typename... Terms>
+template <typename T>
+EMBERS_ALWAYS_INLINE auto ChunkView<Terms...>::get() const {
+  constexpr u32 index = internal::term_index<T, Terms...>();
+  static_assert(index != u32_MAX, "Component isn't fetched by the query");
+
+  using Term    = std::tuple_element_t<index, std::tuple<Terms...>>;
+  using Pointer = typename internal::TermTraits<Term>::Pointer;
+  return EMBERS_ASSUME_ALIGNED((Pointer)columns_[index], kColumnAlignment);
+}
+
+template <typename... Terms>
+Query<Terms...>::Query(Manager &manager)
+    : manager_(&manager), seen_(0), last_tick_(0), tick_(0) {
+  const ComponentMask terms = kRequired | kExcluded;
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    if (terms.test(id) &&
+        manager.component_info(id).storage == Storage::kSparseSet) {
+      EMBERS_ERROR(
+          "Component {} uses sparse set storage, queries only see table "
+          "components",
+          manager.component_info(id).name
+      );
+    }
+  }
+  update();
+}
+
+template <typename... Terms>
+void Query<Terms...>::update() {
+  u32 count = manager_->archetype_count();
+  for (ArchetypeId id = seen_; id < count; ++id) {
+    const ComponentMask &mask = manager_->archetype(id).mask();
+    if (mask.contains(kRequired) && !mask.intersects(kSkipped)) {
+      archetypes_.push_back(id);
+    }
+  }
+  seen_ = count;
+}
+
+template <typename... Terms>
+Tick Query<Terms...>::advance() {
+  // ticks are taken at the start of a run, so the writes of a run are never
+  // newer than the run itself and a query doesn't see its own changes
+  last_tick_ = tick_;
+  tick_      = manager_->advance_tick();
+  return tick_;
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE bool Query<Terms...>::matches(
+    const Archetype &arch, u32 chunk
+) const {
+  if constexpr (kFilters.empty()) {
+    return true;
+  } else {
+    return (internal::passes_filter<Terms>(arch, chunk, last_tick_) && ...);
+  }
+}
+
+template <typename... Terms>
+template <typename F>
+void Query<Terms...>::each_chunk(F &&f) {
+  update();
+  advance();
+  for (ArchetypeId id : archetypes_) {
+    const Archetype &arch = manager_->archetype(id);
+    for (u32 c = 0; c < arch.chunk_count(); ++c) {
+      if (matches(arch, c)) {
+        f(View(arch, c, tick_));
+      }
+    }
+  }
+}
+
+template <typename... Terms>
+template <typename F>
+void Query<Terms...>::each(F &&f) {
+  update();
+  advance();
+  for (ArchetypeId id : archetypes_) {
+    const Archetype &arch = manager_->archetype(id);
+    for (u32 c = 0; c < arch.chunk_count(); ++c) {
+      if (!matches(arch, c)) {
+        continue;
+      }
+      (internal::mark_written<Terms>(arch, c, tick_), ...);
+      std::apply(
+          [&](auto *...columns) {
+            internal::invoke_rows(
+                f,
+                arch.entities(c),
+                arch.chunk(c).count,
+                columns...
+            );
+          },
+          std::tuple_cat(internal::fetch_column<Terms>(arch, c)...)
+      );
+    }
+  }
+}
+
+template <typename... Terms>
+u32 Query<Terms...>::size() {
+  update();
+  u32 size = 0;
+  for (ArchetypeId id : archetypes_) {
+    size += manager_->archetype(id).size();
+  }
+  return size;
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE const Vector<ArchetypeId> &Query<Terms...>::archetypes(
+) const {
+  return archetypes_;
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE Manager &Query<Terms...>::manager() const {
+  return *manager_;
+}
+
+template <typename... Terms>
+EMBERS_ALWAYS_INLINE Tick Query<Terms...>::tick() const {
+  return tick_;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
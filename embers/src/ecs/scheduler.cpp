@@ -0,0 +1,194 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <embers/logger.hpp>
+#include <functional>
+
+namespace embers::ecs {
+
+Scheduler::Scheduler(Manager &manager, u32 worker_count)
+    : manager_(&manager),
+      tasks_per_thread_(4),
+      owned_jobs_(new jobs::System(worker_count)),
+      jobs_(owned_jobs_.get()) {}
+
+Scheduler::Scheduler(Manager &manager, jobs::System &jobs)
+    : manager_(&manager), tasks_per_thread_(4), jobs_(&jobs) {}
+
+Scheduler::~Scheduler() = default;
+
+SystemId Scheduler::add_system(System *system) {
+  systems_.emplace_back(system);
+  explicit_after_.emplace_back();
+  return (SystemId)systems_.size() - 1;
+}
+
+void Scheduler::add_dependency(SystemId before, SystemId after) {
+  explicit_after_[before].push_back(after);
+  return;
+}
+
+bool Scheduler::sort_systems(Vector<SystemId> &order) const {
+  u32 count = (u32)systems_.size();
+
+  // Kahn's algorithm, always taking the first registered ready system
+  Vector<u32> incoming(count, 0);
+  for (SystemId system = 0; system < count; ++system) {
+    for (SystemId after : explicit_after_[system]) {
+      incoming[after]++;
+    }
+  }
+  Vector<SystemId> ready;
+  for (SystemId system = 0; system < count; ++system) {
+    if (incoming[system] == 0) {
+      ready.push_back(system);
+    }
+  }
+  const auto first = std::greater<SystemId>();
+  std::make_heap(ready.begin(), ready.end(), first);
+
+  order.clear();
+  while (!ready.empty()) {
+    std::pop_heap(ready.begin(), ready.end(), first);
+    SystemId system = ready.back();
+    ready.pop_back();
+    order.push_back(system);
+    for (SystemId after : explicit_after_[system]) {
+      if (--incoming[after] == 0) {
+        ready.push_back(after);
+        std::push_heap(ready.begin(), ready.end(), first);
+      }
+    }
+  }
+  return order.size() == count;
+}
+
+void Scheduler::build_graph() {
+  u32 count = (u32)systems_.size();
+
+  dependents_.assign(count, {});
+  dependencies_.assign(count, 0);
+  states_.reset(new State[count]);
+
+  Vector<SystemId> order;
+  bool             sorted = sort_systems(order);
+  if (!sorted) {
+    EMBERS_ERROR(
+        "System dependencies have a cycle, {} systems run one after the "
+        "other in registration order",
+        count
+    );
+    order.resize(count);
+    for (SystemId system = 0; system < count; ++system) {
+      order[system] = system;
+    }
+  }
+
+  const auto add_edge = [&](SystemId from, SystemId to) {
+    dependents_[from].push_back(to);
+    dependencies_[to]++;
+  };
+
+  // an edge for every conflicting pair in that order, plus the explicit ones
+  Vector<u8> explicit_edge(count);
+  for (u32 i = 0; i < count; ++i) {
+    SystemId earlier = order[i];
+    std::fill(explicit_edge.begin(), explicit_edge.end(), 0);
+    if (sorted) {
+      for (SystemId after : explicit_after_[earlier]) {
+        if (!explicit_edge[after]) {
+          explicit_edge[after] = 1;
+          add_edge(earlier, after);
+        }
+      }
+    } else if (i + 1 < count) {
+      // the dependencies can't be honored, don't run anything concurrently
+      explicit_edge[order[i + 1]] = 1;
+      add_edge(earlier, order[i + 1]);
+    }
+    for (u32 j = i + 1; j < count; ++j) {
+      SystemId later = order[j];
+      if (!explicit_edge[later] &&
+          systems_[earlier]->access.conflicts(systems_[later]->access)) {
+        add_edge(earlier, later);
+      }
+    }
+  }
+  return;
+}
+
+void Scheduler::run() {
+  u32 count = (u32)systems_.size();
+  if (count == 0) {
+    return;
+  }
+  build_graph();
+
+  for (SystemId system = 0; system < count; ++system) {
+    states_[system].dependencies.store(dependencies_[system]);
+  }
+  for (SystemId system = 0; system < count; ++system) {
+    if (dependencies_[system] == 0) {
+      schedule(system);
+    }
+  }
+
+  // dependents are scheduled before the task completing them is done, so
+  // the counter only gets to 0 once the whole graph ran
+  jobs_->wait(tasks_left_);
+  return;
+}
+
+void Scheduler::schedule(SystemId system) {
+  u32 items = systems_[system]->prepare();
+  if (items == 0) {
+    complete(system);
+    return;
+  }
+
+  u32 splits = (jobs_->worker_count() + 1) * tasks_per_thread_;
+  u32 batch  = std::max<u32>(1, (items + splits - 1) / splits);
+  states_[system].tasks.store((items + batch - 1) / batch);
+  for (u32 first = 0; first < items; first += batch) {
+    Task task = {system, first, std::min(first + batch, items)};
+    jobs_->run([this, task] { execute(task); }, &tasks_left_);
+  }
+  return;
+}
+
+void Scheduler::complete(SystemId system) {
+  for (SystemId dependent : dependents_[system]) {
+    if (states_[dependent].dependencies.fetch_sub(1) == 1) {
+      schedule(dependent);
+    }
+  }
+  return;
+}
+
+void Scheduler::execute(const Task &task) {
+  // a task waiting on jobs may run another task in the meantime, or resume
+  // on another thread
+  Running running = {((u64)task.system + 1) << 32 | task.first, 0};
+  void   *outer   = jobs::System::job_local();
+  jobs::System::set_job_local(&running);
+  systems_[task.system]->run(task.first, task.last);
+  jobs::System::set_job_local(outer);
+  if (states_[task.system].tasks.fetch_sub(1) == 1) {
+    complete(task.system);
+  }
+  return;
+}
+
+u32 Scheduler::thread_index() { return jobs::System::thread_index(); }
+
+u64 Scheduler::task_key() {
+  const Running *running = (const Running *)jobs::System::job_local();
+  return running != nullptr ? running->key : 0;
+}
+
+u32 Scheduler::task_sequence() {
+  Running *running = (Running *)jobs::System::job_local();
+  return running != nullptr ? running->sequence++ : 0;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
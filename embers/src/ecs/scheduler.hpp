@@ -0,0 +1,271 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "../jobs/jobs.hpp"
+#include "common.hpp"
+#include "component.hpp"
+#include "manager.hpp"
+#include "query.hpp"
+
+namespace embers::ecs {
+
+/// Components a system reads and writes. Two systems conflict when one of
+/// them writes something the other one touches
+struct Access {
+  ComponentMask reads;
+  ComponentMask writes;
+
+  constexpr bool conflicts(const Access &other) const;
+
+  template <typename... Terms>
+  constexpr static Access of();
+  /// Conflicts with every other system, for structural changes
+  constexpr static Access exclusive();
+};
+
+using SystemId = u32;
+
+/// Runs systems in parallel as jobs of a jobs::System. Every frame the
+/// systems are ordered into a DAG by their declared dependencies and access
+/// (earlier systems win on a conflict), systems without conflicts run
+/// concurrently and chunk systems are split into batches of chunks, chunks
+/// filtered out by Changed<T> and Added<T> terms don't make it into a batch.
+/// No structural changes are allowed while the systems run
+class Scheduler {
+  class System {
+   public:
+    const char *name;
+    Access      access;
+
+    System(const char *name, Access access) : name(name), access(access) {}
+    virtual ~System() = default;
+
+    /// Returns the number of work items, tasks get ranges of them
+    virtual u32  prepare()                = 0;
+    virtual void run(u32 first, u32 last) = 0;
+  };
+
+  template <typename F>
+  class FunctionSystem;
+  template <typename F, typename... Terms>
+  class ChunkSystem;
+  template <typename P, typename R>
+  class RangeSystem;
+
+  struct Task {
+    SystemId system;
+    u32      first;
+    u32      last;
+  };
+
+  struct State {
+    std::atomic<u32> dependencies;
+    std::atomic<u32> tasks;
+  };
+
+  // jobs::System::job_local() of a running task
+  struct Running {
+    u64 key;
+    u32 sequence;
+  };
+
+  Manager                        *manager_;
+  Vector<std::unique_ptr<System>> systems_;
+  Vector<Vector<SystemId>>        explicit_after_;  // from add_dependency()
+  Vector<Vector<SystemId>>        dependents_;
+  Vector<u32>                     dependencies_;
+  std::unique_ptr<State[]>        states_;
+  u32                             tasks_per_thread_;
+
+  std::unique_ptr<jobs::System> owned_jobs_;
+  jobs::System                 *jobs_;
+  jobs::Counter                 tasks_left_;
+
+  SystemId add_system(System *system);
+  /// Registration order with the explicit dependencies applied
+  bool     sort_systems(Vector<SystemId> &order) const;
+  void     build_graph();
+  void schedule(SystemId system);
+  void complete(SystemId system);
+  void execute(const Task &task);
+
+ public:
+  Scheduler() = delete;
+  /// Runs on a jobs::System of its own, worker_count of 0 picks one worker
+  /// per hardware thread but one, the calling thread of run() works too
+  explicit Scheduler(Manager &manager, u32 worker_count = 0);
+  /// Runs on the workers of `jobs`, shared with the rest of the engine
+  Scheduler(Manager &manager, jobs::System &jobs);
+  Scheduler(const Scheduler &other) = delete;
+  Scheduler(Scheduler &&other)      = delete;
+  ~Scheduler();
+
+  Scheduler &operator=(const Scheduler &rhs) = delete;
+  Scheduler &operator=(Scheduler &&rhs)      = delete;
+
+  /// `f(Manager&)`, runs as a single task
+  template <typename F>
+  SystemId add(const char *name, Access access, F &&f);
+
+  /// `f(const ChunkView<Terms...>&)`, access is taken from the terms and the
+  /// matched chunks are split between the workers
+  template <typename... Terms, typename F>
+  SystemId add_chunk_system(const char *name, F &&f);
+
+  /// `prepare()` runs as part of the scheduling and returns a number of work
+  /// items, ranges of them are then split between the workers as
+  /// `run(first, last)`
+  template <typename P, typename R>
+  SystemId add_range_system(
+      const char *name, Access access, P &&prepare, R &&run
+  );
+
+  /// `after` doesn't start before `before` is done, whatever the order of
+  /// registration. Conflicts between the other systems are then resolved in
+  /// the order this gives
+  void add_dependency(SystemId before, SystemId after);
+
+  /// Runs all the systems once, returns when all of them are done
+  void run();
+
+  EMBERS_ALWAYS_INLINE u32 worker_count() const;
+
+  /// Workers are numbered from 1, any other thread (including the one
+  /// calling run()) is 0, see jobs::System::thread_index()
+  static u32 thread_index();
+  /// Identifies the running task independently of the thread it runs on:
+  /// `(system + 1) << 32 | first item`, 0 outside of tasks
+  static u64 task_key();
+  /// Numbers what the running task records in order, from 0 for every
+  /// task: it may wait in between and resume on another thread. 0 outside
+  /// of tasks
+  static u32 task_sequence();
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+constexpr bool Access::conflicts(const Access &other) const {
+  return writes.intersects(other.reads) || writes.intersects(other.writes) ||
+         other.writes.intersects(reads);
+}
+
+template <typename... Terms>
+constexpr Access Access::of() {
+  return {Query<Terms...>::kReads, Query<Terms...>::kWrites};
+}
+
+constexpr Access Access::exclusive() { return {{}, ~ComponentMask()}; }
+
+template <typename F>
+class Scheduler::FunctionSystem : public Scheduler::System {
+  Manager &manager_;
+  F        f_;
+
+ public:
+  template <typename G>
+  FunctionSystem(const char *name, Access access, Manager &manager, G &&f)
+      : System(name, access), manager_(manager), f_(std::forward<G>(f)) {}
+
+  u32  prepare() override { return 1; }
+  void run(u32, u32) override { f_(manager_); }
+};
+
+template <typename F, typename... Terms>
+class Scheduler::ChunkSystem : public Scheduler::System {
+  struct ChunkRef {
+    ArchetypeId archetype;
+    u32         chunk;
+  };
+
+  Query<Terms...>  query_;
+  Vector<ChunkRef> chunks_;
+  F                f_;
+
+ public:
+  template <typename G>
+  ChunkSystem(const char *name, Manager &manager, G &&f)
+      : System(name, Access::of<Terms...>()),
+        query_(manager),
+        f_(std::forward<G>(f)) {}
+
+  u32 prepare() override {
+    query_.update();
+    query_.advance();
+    chunks_.clear();
+    for (ArchetypeId id : query_.archetypes()) {
+      const Archetype &arch = query_.manager().archetype(id);
+      for (u32 c = 0; c < arch.chunk_count(); ++c) {
+        if (query_.matches(arch, c)) {
+          chunks_.push_back({id, c});
+        }
+      }
+    }
+    return (u32)chunks_.size();
+  }
+
+  void run(u32 first, u32 last) override {
+    const Manager &manager = query_.manager();
+    for (u32 i = first; i < last; ++i) {
+      f_(ChunkView<Terms...>(
+          manager.archetype(chunks_[i].archetype),
+          chunks_[i].chunk,
+          query_.tick()
+      ));
+    }
+  }
+};
+
+template <typename P, typename R>
+class Scheduler::RangeSystem : public Scheduler::System {
+  P prepare_;
+  R run_;
+
+ public:
+  template <typename Q, typename S>
+  RangeSystem(const char *name, Access access, Q &&prepare, S &&run)
+      : System(name, access),
+        prepare_(std::forward<Q>(prepare)),
+        run_(std::forward<S>(run)) {}
+
+  u32  prepare() override { return prepare_(); }
+  void run(u32 first, u32 last) override { run_(first, last); }
+};
+
+template <typename F>
+SystemId Scheduler::add(const char *name, Access access, F &&f) {
+  using System = FunctionSystem<std::decay_t<F>>;
+  return add_system(new System(name, access, *manager_, std::forward<F>(f)));
+}
+
+template <typename... Terms, typename F>
+SystemId Scheduler::add_chunk_system(const char *name, F &&f) {
+  using System = ChunkSystem<std::decay_t<F>, Terms...>;
+  return add_system(new System(name, *manager_, std::forward<F>(f)));
+}
+
+template <typename P, typename R>
+SystemId Scheduler::add_range_system(
+    const char *name, Access access, P &&prepare, R &&run
+) {
+  using System = RangeSystem<std::decay_t<P>, std::decay_t<R>>;
+  return add_system(new System(
+      name,
+      access,
+      std::forward<P>(prepare),
+      std::forward<R>(run)
+  ));
+}
+
+EMBERS_ALWAYS_INLINE u32 Scheduler::worker_count() const {
+  return jobs_->worker_count();
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
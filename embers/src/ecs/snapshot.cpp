@@ -0,0 +1,391 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <embers/logger.hpp>
+#include <string>
+#include <unordered_set>
+
+#include "../io/file.hpp"
+
+namespace embers::ecs {
+
+using String =
+    std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+
+constexpr static char kMagic[8]  = {'E', 'M', 'B', 'E', 'R', 'S', 'W', 'S'};
+constexpr static u64  kPageSize = 4096;
+
+// file layout, in this order:
+// Header
+// ComponentEntry x component_count
+// ArchetypeEntry x archetype_count
+// u32 rows of every chunk x chunk_count
+// RecordEntry x record_count
+// u32 free index x free_count
+// padding up to chunks_offset, aligned to kPageSize
+// chunks x chunk_count, kChunkSize each
+
+struct Header {
+  char magic[8];
+  u32  version;
+  u32  chunk_size;
+  u32  component_count;
+  u32  archetype_count;
+  u32  chunk_count;
+  u32  record_count;
+  u32  free_count;
+  u32  alive;
+  Tick change_tick;
+  u32  reserved;
+  u64  chunks_offset;
+};
+
+struct ComponentEntry {
+  ComponentId id;
+  u32         size;
+  u32         alignment;
+  u32         name_hash;
+};
+
+struct ArchetypeEntry {
+  ComponentMask mask;
+  u32           chunk_count;
+  u32           reserved;
+};
+
+struct RecordEntry {
+  u32 counter;
+  u32 archetype;  // index into the archetype entries
+  u32 chunk;
+  u32 row;
+};
+
+constexpr static u64 align_up(u64 value, u64 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/// fnv-1a, catches components that changed their meaning but not their id
+constexpr static u32 hash_name(const char *name) {
+  u32 hash = 2166136261u;
+  for (; *name != '\0'; ++name) {
+    hash = (hash ^ (u8)*name) * 16777619u;
+  }
+  return hash;
+}
+
+/// Next `size` bytes of the file, nullptr when the file is too short
+static u8 *take(const io::MappedFile &file, u64 &offset, u64 size) {
+  if (offset + size > file.size()) {
+    return nullptr;
+  }
+  u8 *data = file.data() + offset;
+  offset += size;
+  return data;
+}
+
+Error Snapshot::save(const Manager &manager, const char *path) {
+  Vector<ComponentEntry> components;
+  for (ComponentId id = 0; id < kMaxComponents; ++id) {
+    const ComponentInfo &info = manager.components_[id];
+    if (info.registered() && info.storage == Storage::kTable) {
+      components.push_back(
+          {id, info.size, info.alignment, hash_name(info.name)}
+      );
+    }
+  }
+  if (!manager.sparse_ids_.empty()) {
+    EMBERS_WARN(
+        "{} sparse set components are left out of the snapshot",
+        manager.sparse_ids_.size()
+    );
+  }
+
+  Vector<ArchetypeEntry> archetypes;
+  Vector<u32>            chunk_rows;
+  Vector<u32>            file_archetype(
+      manager.archetypes_.size(),
+      kInvalidArchetype
+  );
+  for (ArchetypeId id = 0; id < manager.archetypes_.size(); ++id) {
+    const Archetype &arch = manager.archetypes_[id];
+    if (arch.size() == 0) {
+      continue;
+    }
+    for (const Archetype::Column &column : arch.columns()) {
+      if (column.relocate != nullptr || column.destroy != nullptr) {
+        EMBERS_ERROR(
+            "Component {} isn't trivially copyable, it can't be saved",
+            manager.components_[column.id].name
+        );
+        return Error::kEcsSnapshotNotTrivial;
+      }
+    }
+    file_archetype[id] = (u32)archetypes.size();
+    archetypes.push_back({arch.mask(), arch.chunk_count(), 0});
+    for (u32 c = 0; c < arch.chunk_count(); ++c) {
+      chunk_rows.push_back(arch.chunk(c).count);
+    }
+  }
+
+  Vector<RecordEntry> records(manager.records_.size());
+  for (u32 i = 0; i < records.size(); ++i) {
+    const Manager::Record &record = manager.records_[i];
+    records[i] = {
+        record.counter,
+        record.archetype == kInvalidArchetype
+            ? kInvalidArchetype
+            : file_archetype[record.archetype],
+        record.location.chunk,
+        record.location.row
+    };
+  }
+  const Vector<u32> &free_indices = manager.free_indices_;
+
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version         = kVersion;
+  header.chunk_size      = kChunkSize;
+  header.component_count = (u32)components.size();
+  header.archetype_count = (u32)archetypes.size();
+  header.chunk_count     = (u32)chunk_rows.size();
+  header.record_count    = (u32)records.size();
+  header.free_count      = (u32)free_indices.size();
+  header.alive           = manager.alive_;
+  header.change_tick     = manager.change_tick();
+
+  u64 tables_end = sizeof(Header) +
+                   sizeof(ComponentEntry) * components.size() +
+                   sizeof(ArchetypeEntry) * archetypes.size() +
+                   sizeof(u32) * chunk_rows.size() +
+                   sizeof(RecordEntry) * records.size() +
+                   sizeof(u32) * free_indices.size();
+  header.chunks_offset = align_up(tables_end, kPageSize);
+
+  String temporary = String(path) + ".tmp";
+  {
+    io::File file(temporary.c_str());
+    if (!file) {
+      return io::File::get_last_error();
+    }
+
+    static const u8 padding[kPageSize] = {};
+
+    bool written =
+        file.write(&header, sizeof(header)) &&
+        file.write(
+            components.data(),
+            sizeof(ComponentEntry) * components.size()
+        ) &&
+        file.write(
+            archetypes.data(),
+            sizeof(ArchetypeEntry) * archetypes.size()
+        ) &&
+        file.write(chunk_rows.data(), sizeof(u32) * chunk_rows.size()) &&
+        file.write(records.data(), sizeof(RecordEntry) * records.size()) &&
+        file.write(free_indices.data(), sizeof(u32) * free_indices.size()) &&
+        file.write(padding, header.chunks_offset - tables_end);
+
+    for (const Archetype &arch : manager.archetypes_) {
+      if (arch.size() == 0) {
+        continue;
+      }
+      for (u32 c = 0; c < arch.chunk_count() && written; ++c) {
+        written = file.write(arch.chunk(c).data, kChunkSize);
+      }
+    }
+    if (!written || !file.sync()) {
+      EMBERS_ERROR("Unable to write snapshot {}", temporary.c_str());
+      return Error::kIoWriteFile;
+    }
+  }
+
+  if (!io::replace_file(temporary.c_str(), path)) {
+    EMBERS_ERROR("Unable to replace {} with the new snapshot", path);
+    return Error::kIoWriteFile;
+  }
+  return Error::kOk;
+}
+
+Error Snapshot::load(Manager &manager, const char *path) {
+  io::MappedFile file(path);
+  if (!file) {
+    return io::MappedFile::get_last_error();
+  }
+
+  // validate everything before the world is touched
+  u64           offset = 0;
+  const Header *header = (const Header *)take(file, offset, sizeof(Header));
+  if (header == nullptr ||
+      std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+    return Error::kEcsSnapshotInvalid;
+  }
+  if (header->version != kVersion || header->chunk_size != kChunkSize) {
+    EMBERS_ERROR(
+        "Snapshot {} has version {} and chunks of {} bytes, expected {} and "
+        "{}",
+        path,
+        header->version,
+        header->chunk_size,
+        kVersion,
+        kChunkSize
+    );
+    return Error::kEcsSnapshotVersion;
+  }
+
+  const auto *components = (const ComponentEntry *)take(
+      file,
+      offset,
+      sizeof(ComponentEntry) * header->component_count
+  );
+  const auto *archetypes = (const ArchetypeEntry *)take(
+      file,
+      offset,
+      sizeof(ArchetypeEntry) * header->archetype_count
+  );
+  const auto *chunk_rows =
+      (const u32 *)take(file, offset, sizeof(u32) * header->chunk_count);
+  const auto *records = (const RecordEntry *)take(
+      file,
+      offset,
+      sizeof(RecordEntry) * header->record_count
+  );
+  const auto *free_indices =
+      (const u32 *)take(file, offset, sizeof(u32) * header->free_count);
+  if (components == nullptr || archetypes == nullptr ||
+      chunk_rows == nullptr || records == nullptr || free_indices == nullptr ||
+      header->chunks_offset < offset ||
+      header->chunks_offset % kPageSize != 0 ||
+      header->record_count == 0) {
+    return Error::kEcsSnapshotInvalid;
+  }
+  offset     = header->chunks_offset;
+  u8 *chunks = take(file, offset, kChunkSize * header->chunk_count);
+  if (chunks == nullptr) {
+    return Error::kEcsSnapshotInvalid;
+  }
+
+  ComponentMask saved;
+  for (u32 i = 0; i < header->component_count; ++i) {
+    const ComponentEntry &entry = components[i];
+    if (entry.id >= kMaxComponents) {
+      return Error::kEcsSnapshotInvalid;
+    }
+    const ComponentInfo &info = manager.components_[entry.id];
+    if (!info.registered() || info.storage != Storage::kTable ||
+        info.size != entry.size || info.alignment != entry.alignment ||
+        hash_name(info.name) != entry.name_hash || info.relocate != nullptr ||
+        info.destroy != nullptr) {
+      EMBERS_ERROR(
+          "Component {} of snapshot {} doesn't match the registered one",
+          entry.id,
+          path
+      );
+      return Error::kEcsSnapshotComponents;
+    }
+    saved.set(entry.id);
+  }
+
+  // chunks are checked against the layout of their archetype, adopted by a
+  // copy of it: every chunk but the last one is full
+  Vector<Archetype> layouts;
+  u32               chunk = 0;
+  std::unordered_set<ComponentMask, ComponentMask::Hash> masks;
+  for (u32 a = 0; a < header->archetype_count; ++a) {
+    const ArchetypeEntry &entry = archetypes[a];
+    if (!saved.contains(entry.mask) || !masks.insert(entry.mask).second ||
+        entry.chunk_count > header->chunk_count - chunk) {
+      return Error::kEcsSnapshotInvalid;
+    }
+    Archetype &layout = layouts.emplace_back(entry.mask, manager.components_);
+    for (u32 c = 0; c < entry.chunk_count; ++c, ++chunk) {
+      u32 rows = chunk_rows[chunk];
+      if (rows == 0 || rows > layout.capacity() ||
+          (c + 1 < entry.chunk_count && rows != layout.capacity())) {
+        return Error::kEcsSnapshotInvalid;
+      }
+      layout.adopt(chunks + (size_t)chunk * kChunkSize, rows);
+    }
+  }
+  if (chunk != header->chunk_count) {
+    return Error::kEcsSnapshotInvalid;
+  }
+
+  // every row belongs to the record pointing at it, record 0 is never used
+  u32 live = 0;
+  for (u32 i = 0; i < header->record_count; ++i) {
+    const RecordEntry &entry = records[i];
+    if (entry.archetype == kInvalidArchetype) {
+      continue;
+    }
+    if (i == 0 || entry.archetype >= header->archetype_count) {
+      return Error::kEcsSnapshotInvalid;
+    }
+    const Archetype &layout = layouts[entry.archetype];
+    if (entry.chunk >= layout.chunk_count() ||
+        entry.row >= layout.chunk(entry.chunk).count ||
+        layout.entities(entry.chunk)[entry.row] != Entity(i, entry.counter)) {
+      return Error::kEcsSnapshotInvalid;
+    }
+    live++;
+  }
+  u64 rows = 0;
+  for (const Archetype &layout : layouts) {
+    rows += layout.size();
+  }
+  if (live != rows || live != header->alive ||
+      (u64)live + header->free_count + 1 != header->record_count) {
+    return Error::kEcsSnapshotInvalid;
+  }
+  Vector<u8> freed(header->record_count, 0);
+  for (u32 i = 0; i < header->free_count; ++i) {
+    u32 index = free_indices[i];
+    if (index == 0 || index >= header->record_count ||
+        records[index].archetype != kInvalidArchetype || freed[index]) {
+      return Error::kEcsSnapshotInvalid;
+    }
+    freed[index] = 1;
+  }
+
+  // adopt the chunks as they are. The ones of a previous snapshot were all
+  // given back by the clear, its mapping can go
+  manager.clear();
+  manager.chunk_pool_.give_back();
+  manager.mappings_.clear();
+
+  Vector<ArchetypeId> local(header->archetype_count);
+  chunk = 0;
+  for (u32 a = 0; a < header->archetype_count; ++a) {
+    local[a]        = manager.find_or_create_archetype(archetypes[a].mask);
+    Archetype &arch = manager.archetypes_[local[a]];
+    for (u32 c = 0; c < archetypes[a].chunk_count; ++c, ++chunk) {
+      arch.adopt(chunks + (size_t)chunk * kChunkSize, chunk_rows[chunk]);
+    }
+  }
+
+  manager.records_.resize(header->record_count);
+  for (u32 i = 0; i < header->record_count; ++i) {
+    const RecordEntry &entry  = records[i];
+    Manager::Record   &record = manager.records_[i];
+    record.counter            = entry.counter;
+    record.archetype          = entry.archetype == kInvalidArchetype
+                                    ? kInvalidArchetype
+                                    : local[entry.archetype];
+    record.location           = {entry.chunk, entry.row};
+  }
+  manager.free_indices_.assign(free_indices, free_indices + header->free_count);
+  manager.alive_ = header->alive;
+
+  // keep the ticks moving forward, the chunks carry the saved ones
+  if (is_newer(header->change_tick, manager.change_tick())) {
+    manager.change_tick_.store(header->change_tick);
+  }
+
+  manager.chunk_pool_.borrow(
+      chunks,
+      chunks + (size_t)header->chunk_count * kChunkSize
+  );
+  manager.mappings_.push_back(std::move(file));
+  return Error::kOk;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <embers/defines.hpp>
+
+#include "../error_code.hpp"
+#include "manager.hpp"
+
+namespace embers::ecs {
+
+/// Whole world snapshots: the entity table followed by the archetype chunks
+/// stored byte for byte as they are in memory.
+///
+/// Loading maps the file copy on write and hands the chunks over to the
+/// archetypes as they are, nothing is deserialized per entity: the pages
+/// are read by the first access and copied by the first write.
+///
+/// Only table components that can be copied as bytes (no relocate and no
+/// destroy) can be saved, sparse set components are left out. Snapshots are
+/// meant for the build that wrote them: the component layout and kChunkSize
+/// have to match, the components have to be registered before loading
+class Snapshot {
+ public:
+  constexpr static u32 kVersion = 1;
+
+  Snapshot() = delete;
+
+  /// Writes into a temporary file first and replaces `path` with it, so a
+  /// crash never leaves a half written snapshot behind
+  static Error save(const Manager &manager, const char *path);
+  /// Replaces the world of `manager` by the snapshot. The whole snapshot is
+  /// checked first, `manager` is left as it was when it is invalid
+  static Error load(Manager &manager, const char *path);
+};
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "sparse_set.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace embers::ecs {
+
+SparseSet::SparseSet() : data_(nullptr), capacity_(0), info_() {}
+
+SparseSet::SparseSet(SparseSet &&other)
+    : pages_(std::move(other.pages_)),
+      dense_(std::move(other.dense_)),
+      data_(other.data_),
+      capacity_(other.capacity_),
+      info_(other.info_) {
+  other.data_     = nullptr;
+  other.capacity_ = 0;
+  other.dense_.clear();
+  return;
+}
+
+SparseSet::~SparseSet() {
+  clear();
+  if (data_ != nullptr) {
+    ::operator delete(data_, std::align_val_t{kColumnAlignment});
+  }
+  return;
+}
+
+void SparseSet::init(const ComponentInfo &info) {
+  info_ = info;
+  return;
+}
+
+void SparseSet::grow() {
+  u32 capacity = capacity_ == 0 ? 64 : capacity_ * 2;
+  // tags still get a block, so get() never returns nullptr for them
+  u8 *data = (u8 *)::operator new(
+      std::max((size_t)capacity * info_.size, kColumnAlignment),
+      std::align_val_t{kColumnAlignment}
+  );
+  for (u32 i = 0; i < dense_.size(); ++i) {
+    void *dst = data + (size_t)i * info_.size;
+    void *src = data_ + (size_t)i * info_.size;
+    if (info_.relocate != nullptr) {
+      info_.relocate(dst, src);
+    } else {
+      std::memcpy(dst, src, info_.size);
+    }
+  }
+  if (data_ != nullptr) {
+    ::operator delete(data_, std::align_val_t{kColumnAlignment});
+  }
+  data_     = data;
+  capacity_ = capacity;
+  return;
+}
+
+void *SparseSet::emplace(Entity entity) {
+  u32 page = entity.index_ / kPageSize;
+  if (page >= pages_.size()) {
+    pages_.resize(page + 1);
+  }
+  if (pages_[page].empty()) {
+    pages_[page].resize(kPageSize, kEmpty);
+  }
+  if (dense_.size() == capacity_) {
+    grow();
+  }
+
+  u32 dense = (u32)dense_.size();
+  pages_[page][entity.index_ % kPageSize] = dense;
+  dense_.push_back(entity);
+  return data_ + (size_t)dense * info_.size;
+}
+
+bool SparseSet::erase(Entity entity) {
+  void *value = get(entity);
+  if (value == nullptr) {
+    return false;
+  }
+  u32 &slot = pages_[entity.index_ / kPageSize][entity.index_ % kPageSize];
+  u32  last = (u32)dense_.size() - 1;
+
+  if (info_.destroy != nullptr) {
+    info_.destroy(value);
+  }
+  if (slot != last) {
+    void *src = data_ + (size_t)last * info_.size;
+    if (info_.relocate != nullptr) {
+      info_.relocate(value, src);
+    } else {
+      std::memcpy(value, src, info_.size);
+    }
+    Entity moved = dense_[last];
+    dense_[slot] = moved;
+    pages_[moved.index_ / kPageSize][moved.index_ % kPageSize] = slot;
+  }
+  slot = kEmpty;
+  dense_.pop_back();
+  return true;
+}
+
+void SparseSet::clear() {
+  for (u32 i = 0; i < dense_.size(); ++i) {
+    if (info_.destroy != nullptr) {
+      info_.destroy(data_ + (size_t)i * info_.size);
+    }
+    Entity entity = dense_[i];
+    pages_[entity.index_ / kPageSize][entity.index_ % kPageSize] = kEmpty;
+  }
+  dense_.clear();
+  return;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
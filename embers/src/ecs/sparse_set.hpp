@@ -0,0 +1,81 @@
+#pragma once
+
+#include <embers/defines.hpp>
+
+#include "common.hpp"
+#include "component.hpp"
+#include "entity.hpp"
+
+namespace embers::ecs {
+
+/// Per component pool for Storage::kSparseSet components. Adding and removing
+/// never moves the entity between archetypes, values are kept densely packed
+/// and indexed by entity index through a paged sparse array
+class SparseSet {
+  constexpr static u32 kPageSize = 1024;
+  constexpr static u32 kEmpty    = u32_MAX;
+
+  Vector<Vector<u32>> pages_;
+  Vector<Entity>      dense_;
+  u8                 *data_;
+  u32                 capacity_;
+  ComponentInfo       info_;
+
+  void grow();
+
+ public:
+  SparseSet();
+  SparseSet(const SparseSet &other) = delete;
+  SparseSet(SparseSet &&other);
+  ~SparseSet();
+
+  SparseSet &operator=(const SparseSet &rhs) = delete;
+  SparseSet &operator=(SparseSet &&rhs)      = delete;
+
+  void init(const ComponentInfo &info);
+
+  EMBERS_ALWAYS_INLINE bool          contains(Entity entity) const;
+  EMBERS_ALWAYS_INLINE void         *get(Entity entity) const;
+  EMBERS_ALWAYS_INLINE u32           size() const;
+  EMBERS_ALWAYS_INLINE const Entity *entities() const;
+  EMBERS_ALWAYS_INLINE void         *data() const;
+
+  /// Returns uninitialized storage for the value of the entity
+  void *emplace(Entity entity);
+  bool  erase(Entity entity);
+  void  clear();
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+EMBERS_ALWAYS_INLINE bool SparseSet::contains(Entity entity) const {
+  u32 page = entity.index_ / kPageSize;
+  return page < pages_.size() && !pages_[page].empty() &&
+         pages_[page][entity.index_ % kPageSize] != kEmpty;
+}
+
+EMBERS_ALWAYS_INLINE void *SparseSet::get(Entity entity) const {
+  u32 page = entity.index_ / kPageSize;
+  if (page >= pages_.size() || pages_[page].empty()) {
+    return nullptr;
+  }
+  u32 dense = pages_[page][entity.index_ % kPageSize];
+  if (dense == kEmpty) {
+    return nullptr;
+  }
+  return data_ + (size_t)dense * info_.size;
+}
+
+EMBERS_ALWAYS_INLINE u32 SparseSet::size() const { return (u32)dense_.size(); }
+
+EMBERS_ALWAYS_INLINE const Entity *SparseSet::entities() const {
+  return dense_.data();
+}
+
+EMBERS_ALWAYS_INLINE void *SparseSet::data() const { return data_; }
+
+}  // namespace embers::ecs
\ No newline at end of file
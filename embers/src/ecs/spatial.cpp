@@ -0,0 +1,516 @@
+#include "spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace embers::ecs {
+
+static math::Vec3 cross(math::Vec3 a, math::Vec3 b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static f32 dot(math::Vec3 a, math::Vec3 b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static f32 half_extent(const math::Aabb &box) {
+  return std::max(
+      {box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z}
+  ) * 0.5f;
+}
+
+static math::Aabb grow(const math::Aabb &box, f32 margin) {
+  return {
+      {box.min.x - margin, box.min.y - margin, box.min.z - margin},
+      {box.max.x + margin, box.max.y + margin, box.max.z + margin}
+  };
+}
+
+static u32 cells_along(f32 extent, f32 cell_size) {
+  return std::max(1u, (u32)std::ceil(extent / cell_size));
+}
+
+LooseGrid::LooseGrid(const math::Aabb &bounds, f32 cell_size)
+    : origin_(bounds.min),
+      cell_size_(cell_size),
+      inverse_cell_size_(1 / cell_size),
+      dimensions_{
+          cells_along(bounds.max.x - bounds.min.x, cell_size),
+          cells_along(bounds.max.y - bounds.min.y, cell_size),
+          cells_along(bounds.max.z - bounds.min.z, cell_size)
+      },
+      max_extent_(0),
+      size_(0),
+      cells_((size_t)dimensions_[0] * dimensions_[1] * dimensions_[2]),
+      extents_(cells_.size(), 0),
+      free_(kNull) {}
+
+void LooseGrid::grow_extent(u32 cell, const math::Aabb &box) {
+  f32 extent     = half_extent(box);
+  extents_[cell] = std::max(extents_[cell], extent);
+  max_extent_    = std::max(max_extent_, extent);
+  return;
+}
+
+LooseGrid::CellRange LooseGrid::cell_range(const math::Aabb &bounds) const {
+  // boxes reach out of their cells by up to max_extent_
+  math::Aabb loose = grow(bounds, max_extent_);
+  return {
+      {cell_coordinate(loose.min.x - origin_.x, 0),
+       cell_coordinate(loose.min.y - origin_.y, 1),
+       cell_coordinate(loose.min.z - origin_.z, 2)},
+      {cell_coordinate(loose.max.x - origin_.x, 0),
+       cell_coordinate(loose.max.y - origin_.y, 1),
+       cell_coordinate(loose.max.z - origin_.z, 2)}
+  };
+}
+
+math::Aabb LooseGrid::bounds_of(const math::Aabb &box) {
+  return box;
+}
+
+math::Aabb LooseGrid::bounds_of(const math::Sphere &sphere) {
+  return math::Aabb::around(sphere.center, sphere.radius);
+}
+
+math::Aabb LooseGrid::bounds_of(const math::Frustum &frustum) {
+  // corners are where three planes meet, a near or far one, a left or right
+  // one and a bottom or top one
+  const math::Plane *planes = frustum.planes;
+
+  math::Aabb bounds = {
+      {INFINITY, INFINITY, INFINITY},
+      {-INFINITY, -INFINITY, -INFINITY}
+  };
+  for (u32 depth = 4; depth < 6; ++depth) {
+    for (u32 side = 0; side < 2; ++side) {
+      for (u32 height = 2; height < 4; ++height) {
+        const math::Plane &a = planes[depth];
+        const math::Plane &b = planes[side];
+        const math::Plane &c = planes[height];
+
+        math::Vec3 bc          = cross(b.normal, c.normal);
+        math::Vec3 ca          = cross(c.normal, a.normal);
+        math::Vec3 ab          = cross(a.normal, b.normal);
+        f32        denominator = dot(a.normal, bc);
+        math::Vec3 corner      = {
+            -(a.distance * bc.x + b.distance * ca.x + c.distance * ab.x) /
+                denominator,
+            -(a.distance * bc.y + b.distance * ca.y + c.distance * ab.y) /
+                denominator,
+            -(a.distance * bc.z + b.distance * ca.z + c.distance * ab.z) /
+                denominator
+        };
+        // an infinite far plane, the whole grid is a candidate
+        if (!std::isfinite(corner.x) || !std::isfinite(corner.y) ||
+            !std::isfinite(corner.z)) {
+          return {
+              {-INFINITY, -INFINITY, -INFINITY},
+              {INFINITY, INFINITY, INFINITY}
+          };
+        }
+        bounds = math::merge(bounds, {corner, corner});
+      }
+    }
+  }
+  return bounds;
+}
+
+u32 LooseGrid::insert(const math::Aabb &box, u32 value) {
+  u32 proxy;
+  if (free_ != kNull) {
+    proxy = free_;
+    free_ = proxies_[proxy].slot;
+  } else {
+    proxy = (u32)proxies_.size();
+    proxies_.push_back({});
+  }
+
+  u32 cell        = cell_of(box);
+  proxies_[proxy] = {cell, (u32)cells_[cell].size()};
+  cells_[cell].push_back({box, value, proxy});
+  grow_extent(cell, box);
+  ++size_;
+  return proxy;
+}
+
+void LooseGrid::insert(
+    const math::Aabb *boxes, const u32 *values, u32 count, u32 *proxies
+) {
+  // reserve every touched cell once instead of growing them box by box
+  Vector<u32> cells(count);
+  for (u32 i = 0; i < count; ++i) {
+    cells[i] = cell_of(boxes[i]);
+  }
+  Vector<u32> added(cells_.size(), 0);
+  for (u32 cell : cells) {
+    added[cell]++;
+  }
+  for (u32 cell = 0; cell < cells_.size(); ++cell) {
+    if (added[cell] > 0) {
+      cells_[cell].reserve(cells_[cell].size() + added[cell]);
+    }
+  }
+  proxies_.reserve(proxies_.size() + count);
+
+  for (u32 i = 0; i < count; ++i) {
+    proxies[i] = insert(boxes[i], values[i]);
+  }
+  return;
+}
+
+void LooseGrid::move(u32 proxy, const math::Aabb &box) {
+  Proxy &current = proxies_[proxy];
+  Entry &entry   = cells_[current.cell][current.slot];
+  if (entry.box == box) {
+    return;
+  }
+
+  u32 cell = cell_of(box);
+  if (cell == current.cell) {
+    entry.box = box;
+    grow_extent(cell, box);
+    return;
+  }
+  u32 value = entry.value;
+  remove(proxy);
+
+  // the proxy is the head of the free list now, take it back
+  free_           = proxies_[proxy].slot;
+  proxies_[proxy] = {cell, (u32)cells_[cell].size()};
+  cells_[cell].push_back({box, value, proxy});
+  grow_extent(cell, box);
+  ++size_;
+  return;
+}
+
+void LooseGrid::remove(u32 proxy) {
+  Proxy          current = proxies_[proxy];
+  Vector<Entry> &cell    = cells_[current.cell];
+
+  // swap with the last entry of the cell
+  cell[current.slot]                      = cell.back();
+  proxies_[cell[current.slot].proxy].slot = current.slot;
+  cell.pop_back();
+
+  // queries stop growing for the large boxes that left
+  if (cell.empty()) {
+    f32 extent             = extents_[current.cell];
+    extents_[current.cell] = 0;
+    if (extent == max_extent_) {
+      max_extent_ = *std::max_element(extents_.begin(), extents_.end());
+    }
+  }
+
+  proxies_[proxy] = {kNull, free_};
+  free_           = proxy;
+  --size_;
+  return;
+}
+
+DynamicBvh::DynamicBvh(f32 margin)
+    : margin_(margin), root_(kNull), free_(kNull), size_(0) {}
+
+u32 DynamicBvh::allocate_node() {
+  if (free_ == kNull) {
+    nodes_.push_back({});
+    nodes_.back().parent = kNull;
+    nodes_.back().height = -1;
+    free_                = (u32)nodes_.size() - 1;
+  }
+  u32 node            = free_;
+  free_               = nodes_[node].parent;
+  nodes_[node].parent = kNull;
+  nodes_[node].left   = kNull;
+  nodes_[node].right  = kNull;
+  nodes_[node].height = 0;
+  return node;
+}
+
+void DynamicBvh::free_node(u32 node) {
+  nodes_[node].parent = free_;
+  nodes_[node].height = -1;
+  free_               = node;
+  return;
+}
+
+u32 DynamicBvh::build(
+    const math::Aabb *boxes,
+    const u32        *values,
+    BuildItem        *items,
+    u32               count,
+    u32              *proxies
+) {
+  u32 node = allocate_node();
+  if (count == 1) {
+    u32 index          = items->index;
+    nodes_[node].box   = grow(boxes[index], margin_);
+    nodes_[node].value = values[index];
+    proxies[index]     = node;
+    return node;
+  }
+
+  f32 low[3]  = {INFINITY, INFINITY, INFINITY};
+  f32 high[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (u32 i = 0; i < count; ++i) {
+    for (u32 axis = 0; axis < 3; ++axis) {
+      low[axis]  = std::min(low[axis], items[i].center[axis]);
+      high[axis] = std::max(high[axis], items[i].center[axis]);
+    }
+  }
+  u32 axis = 0;
+  for (u32 a = 1; a < 3; ++a) {
+    if (high[a] - low[a] > high[axis] - low[axis]) {
+      axis = a;
+    }
+  }
+
+  u32 half = count / 2;
+  std::nth_element(
+      items,
+      items + half,
+      items + count,
+      [axis](const BuildItem &a, const BuildItem &b) {
+        return a.center[axis] < b.center[axis];
+      }
+  );
+
+  // children are allocated after the parent, subtrees end up contiguous
+  u32 left  = build(boxes, values, items, half, proxies);
+  u32 right = build(boxes, values, items + half, count - half, proxies);
+
+  nodes_[left].parent  = node;
+  nodes_[right].parent = node;
+  nodes_[node].left    = left;
+  nodes_[node].right   = right;
+  nodes_[node].box     = math::merge(nodes_[left].box, nodes_[right].box);
+  nodes_[node].height =
+      1 + std::max(nodes_[left].height, nodes_[right].height);
+  return node;
+}
+
+void DynamicBvh::insert_leaf(u32 leaf) {
+  if (root_ == kNull) {
+    root_               = leaf;
+    nodes_[leaf].parent = kNull;
+    return;
+  }
+
+  // walk down to the sibling that grows the surface area the least, the
+  // ancestors grow either way
+  math::Aabb box  = nodes_[leaf].box;
+  u32        node = root_;
+  while (!is_leaf(node)) {
+    const Node &current  = nodes_[node];
+    f32         area     = math::surface_area(current.box);
+    f32         combined = math::surface_area(math::merge(current.box, box));
+
+    f32 cost        = 2 * combined;
+    f32 inheritance = 2 * (combined - area);
+
+    const auto descend_cost = [&](u32 child) {
+      const math::Aabb &child_box = nodes_[child].box;
+      f32 merged = math::surface_area(math::merge(child_box, box));
+      return (is_leaf(child) ? merged
+                             : merged - math::surface_area(child_box)) +
+             inheritance;
+    };
+    f32 left_cost  = descend_cost(current.left);
+    f32 right_cost = descend_cost(current.right);
+    if (cost < left_cost && cost < right_cost) {
+      break;
+    }
+    node = left_cost < right_cost ? current.left : current.right;
+  }
+
+  u32 sibling    = node;
+  u32 old_parent = nodes_[sibling].parent;
+  u32 parent     = allocate_node();
+
+  nodes_[parent].parent  = old_parent;
+  nodes_[parent].box     = math::merge(box, nodes_[sibling].box);
+  nodes_[parent].height  = nodes_[sibling].height + 1;
+  nodes_[parent].left    = sibling;
+  nodes_[parent].right   = leaf;
+  nodes_[sibling].parent = parent;
+  nodes_[leaf].parent    = parent;
+  if (old_parent == kNull) {
+    root_ = parent;
+  } else if (nodes_[old_parent].left == sibling) {
+    nodes_[old_parent].left = parent;
+  } else {
+    nodes_[old_parent].right = parent;
+  }
+
+  fix_upwards(nodes_[leaf].parent);
+  return;
+}
+
+void DynamicBvh::remove_leaf(u32 leaf) {
+  if (leaf == root_) {
+    root_ = kNull;
+    return;
+  }
+
+  // the sibling takes the place of the parent
+  u32 parent      = nodes_[leaf].parent;
+  u32 grandparent = nodes_[parent].parent;
+  u32 sibling     = nodes_[parent].left == leaf ? nodes_[parent].right
+                                                : nodes_[parent].left;
+  nodes_[sibling].parent = grandparent;
+  free_node(parent);
+
+  if (grandparent == kNull) {
+    root_ = sibling;
+    return;
+  }
+  if (nodes_[grandparent].left == parent) {
+    nodes_[grandparent].left = sibling;
+  } else {
+    nodes_[grandparent].right = sibling;
+  }
+  fix_upwards(grandparent);
+  return;
+}
+
+void DynamicBvh::fix_upwards(u32 node) {
+  while (node != kNull) {
+    // balance() looks at the height of the node, rotate() recomputes the
+    // nodes it moves
+    Node &current  = nodes_[node];
+    current.height = 1 + std::max(
+                             nodes_[current.left].height,
+                             nodes_[current.right].height
+                         );
+    current.box    = math::merge(
+        nodes_[current.left].box,
+        nodes_[current.right].box
+    );
+
+    node = balance(node);
+    node = nodes_[node].parent;
+  }
+  return;
+}
+
+u32 DynamicBvh::balance(u32 node) {
+  if (is_leaf(node) || nodes_[node].height < 2) {
+    return node;
+  }
+  u32 left       = nodes_[node].left;
+  u32 right      = nodes_[node].right;
+  i32 difference = nodes_[right].height - nodes_[left].height;
+  if (difference > 1) {
+    return rotate(node, right, left);
+  }
+  if (difference < -1) {
+    return rotate(node, left, right);
+  }
+  return node;
+}
+
+u32 DynamicBvh::rotate(u32 node, u32 up, u32 other) {
+  // `up` takes the place of `node`, which keeps `other` and gets the shorter
+  // child of `up` in place of it
+  u32 first   = nodes_[up].left;
+  u32 second  = nodes_[up].right;
+  u32 taller  = nodes_[first].height > nodes_[second].height ? first : second;
+  u32 shorter = taller == first ? second : first;
+
+  u32 parent          = nodes_[node].parent;
+  nodes_[up].parent   = parent;
+  nodes_[up].left     = node;
+  nodes_[up].right    = taller;
+  nodes_[node].parent = up;
+  if (parent == kNull) {
+    root_ = up;
+  } else if (nodes_[parent].left == node) {
+    nodes_[parent].left = up;
+  } else {
+    nodes_[parent].right = up;
+  }
+
+  if (nodes_[node].left == up) {
+    nodes_[node].left = shorter;
+  } else {
+    nodes_[node].right = shorter;
+  }
+  nodes_[shorter].parent = node;
+
+  nodes_[node].box    = math::merge(nodes_[other].box, nodes_[shorter].box);
+  nodes_[node].height =
+      1 + std::max(nodes_[other].height, nodes_[shorter].height);
+  nodes_[up].box    = math::merge(nodes_[node].box, nodes_[taller].box);
+  nodes_[up].height = 1 + std::max(nodes_[node].height, nodes_[taller].height);
+  return up;
+}
+
+u32 DynamicBvh::insert(const math::Aabb &box, u32 value) {
+  u32 leaf           = allocate_node();
+  nodes_[leaf].box   = grow(box, margin_);
+  nodes_[leaf].value = value;
+  insert_leaf(leaf);
+  ++size_;
+  return leaf;
+}
+
+void DynamicBvh::insert(
+    const math::Aabb *boxes, const u32 *values, u32 count, u32 *proxies
+) {
+  if (count == 0) {
+    return;
+  }
+  Vector<BuildItem> items(count);
+  for (u32 i = 0; i < count; ++i) {
+    const math::Aabb &box = boxes[i];
+    items[i]              = {
+        {box.min.x + box.max.x, box.min.y + box.max.y, box.min.z + box.max.z},
+        i
+    };
+  }
+  nodes_.reserve(nodes_.size() + 2 * count);
+  insert_leaf(build(boxes, values, items.data(), count, proxies));
+  size_ += count;
+  return;
+}
+
+void DynamicBvh::move(u32 proxy, const math::Aabb &box) {
+  math::Aabb &current = nodes_[proxy].box;
+  if (math::contains(current, box)) {
+    return;
+  }
+
+  // a short move keeps the leaf where it is, the ancestors are refitted and
+  // stop as soon as one of them already fits
+  if (math::overlaps(current, box)) {
+    current  = grow(box, margin_);
+    u32 node = nodes_[proxy].parent;
+    while (node != kNull) {
+      Node      &ancestor = nodes_[node];
+      math::Aabb fitted   = math::merge(
+          nodes_[ancestor.left].box,
+          nodes_[ancestor.right].box
+      );
+      if (fitted == ancestor.box) {
+        break;
+      }
+      ancestor.box = fitted;
+      node         = ancestor.parent;
+    }
+    return;
+  }
+
+  remove_leaf(proxy);
+  nodes_[proxy].box = grow(box, margin_);
+  insert_leaf(proxy);
+  return;
+}
+
+void DynamicBvh::remove(u32 proxy) {
+  remove_leaf(proxy);
+  free_node(proxy);
+  --size_;
+  return;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
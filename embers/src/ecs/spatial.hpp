@@ -0,0 +1,558 @@
+#pragma once
+
+#include "../math/math.hpp"
+#include "common.hpp"
+#include "component.hpp"
+#include "entity.hpp"
+#include "manager.hpp"
+#include "query.hpp"
+#include "scheduler.hpp"
+#include "transform.hpp"
+
+namespace embers::ecs {
+
+/// Makes the entity visible to spatial indices: a sphere of `radius` around
+/// the translation of its WorldTransform
+struct Bounds {
+  f32 radius;
+};
+
+}  // namespace embers::ecs
+
+EMBERS_ECS_COMPONENT(
+    embers::ecs::Bounds,
+    embers::ecs::kFirstEngineComponent + 3
+);
+
+namespace embers::ecs {
+
+/// Uniform grid over `bounds`, for dense scenes with objects spread evenly.
+///
+/// Boxes are stored in the cell of their center only, so a cell holds boxes
+/// reaching up to half of the largest box outside of it (loose grid). Queries
+/// grow by that amount, moves only touch two cells and never allocate once
+/// the cells warmed up. The amount shrinks back as cells holding large boxes
+/// get empty. Boxes outside of `bounds` go to the border cells
+class LooseGrid {
+  constexpr static u32 kNull = u32_MAX;
+
+  // boxes are copied into the cells, so queries scan contiguous memory
+  struct Entry {
+    math::Aabb box;
+    u32        value;
+    u32        proxy;
+  };
+
+  struct Proxy {
+    u32 cell;  // kNull when free
+    u32 slot;  // next free proxy when free
+  };
+
+  struct CellRange {
+    u32 min[3];
+    u32 max[3];
+  };
+
+  math::Vec3 origin_;
+  f32        cell_size_;
+  f32        inverse_cell_size_;
+  u32        dimensions_[3];
+  f32        max_extent_;  // largest of extents_
+  u32        size_;
+
+  Vector<Vector<Entry>> cells_;
+  // largest half extent of every cell since it was last empty
+  Vector<f32>           extents_;
+  Vector<Proxy>         proxies_;
+  u32                   free_;
+
+  void grow_extent(u32 cell, const math::Aabb &box);
+
+  EMBERS_ALWAYS_INLINE u32 cell_coordinate(f32 position, u32 axis) const;
+  EMBERS_ALWAYS_INLINE u32 cell_of(const math::Aabb &box) const;
+  EMBERS_ALWAYS_INLINE math::Aabb cell_box(u32 x, u32 y, u32 z) const;
+  CellRange                       cell_range(const math::Aabb &bounds) const;
+
+  static math::Aabb bounds_of(const math::Aabb &box);
+  static math::Aabb bounds_of(const math::Sphere &sphere);
+  static math::Aabb bounds_of(const math::Frustum &frustum);
+
+ public:
+  LooseGrid() = delete;
+  LooseGrid(const math::Aabb &bounds, f32 cell_size);
+
+  /// Returns the proxy of the box, `value` is passed to the query callbacks
+  u32  insert(const math::Aabb &box, u32 value);
+  /// Inserts `count` boxes, their proxies are written to `proxies`
+  void insert(
+      const math::Aabb *boxes, const u32 *values, u32 count, u32 *proxies
+  );
+  void move(u32 proxy, const math::Aabb &box);
+  void remove(u32 proxy);
+
+  /// Calls `f(u32 value)` for every box overlapping `shape`, a math::Aabb,
+  /// math::Sphere or math::Frustum
+  template <typename Shape, typename F>
+  void query(const Shape &shape, F &&f) const;
+
+  EMBERS_ALWAYS_INLINE u32 size() const;
+};
+
+/// Bounding volume hierarchy built incrementally, for sparse or uneven
+/// scenes.
+///
+/// Leaves store boxes grown by `margin`, moves inside of them are free. Small
+/// moves refit the ancestors of the leaf, larger ones reinsert it where it
+/// grows the surface area of the tree the least. Insertions and removals
+/// rotate the nodes on the way up to keep the tree balanced
+class DynamicBvh {
+  constexpr static u32 kNull = u32_MAX;
+
+  struct Node {
+    math::Aabb box;
+    u32        parent;  // next free node when free
+    u32        left;    // kNull for leaves
+    u32        right;
+    u32        value;
+    i32        height;  // 0 for leaves, -1 when free
+  };
+
+  // sorted in place by build(), the centers are kept next to the indices
+  struct BuildItem {
+    f32 center[3];
+    u32 index;
+  };
+
+  f32          margin_;
+  Vector<Node> nodes_;
+  u32          root_;
+  u32          free_;
+  u32          size_;
+
+  u32  allocate_node();
+  void free_node(u32 node);
+  /// Top down, splits at the median center along the longest axis
+  u32  build(
+      const math::Aabb *boxes,
+      const u32        *values,
+      BuildItem        *items,
+      u32               count,
+      u32              *proxies
+  );
+  void insert_leaf(u32 leaf);
+  void remove_leaf(u32 leaf);
+  /// Recomputes the boxes and heights from `node` up, rotating on the way
+  void fix_upwards(u32 node);
+  u32  balance(u32 node);
+  u32  rotate(u32 node, u32 up, u32 other);
+
+  EMBERS_ALWAYS_INLINE bool is_leaf(u32 node) const;
+
+ public:
+  DynamicBvh() = delete;
+  explicit DynamicBvh(f32 margin);
+
+  /// Returns the proxy of the box, `value` is passed to the query callbacks
+  u32  insert(const math::Aabb &box, u32 value);
+  /// Inserts `count` boxes, their proxies are written to `proxies`. They are
+  /// built into a subtree first, which is inserted as a whole: the result
+  /// is better than inserting them one by one, and a lot faster
+  void insert(
+      const math::Aabb *boxes, const u32 *values, u32 count, u32 *proxies
+  );
+  void move(u32 proxy, const math::Aabb &box);
+  void remove(u32 proxy);
+
+  /// Calls `f(u32 value)` for every box whose grown box overlaps `shape`, a
+  /// math::Aabb, math::Sphere or math::Frustum
+  template <typename Shape, typename F>
+  void query(const Shape &shape, F &&f) const;
+
+  EMBERS_ALWAYS_INLINE u32 size() const;
+  EMBERS_ALWAYS_INLINE u32 height() const;
+};
+
+/// Keeps a LooseGrid or a DynamicBvh in sync with the entities having a
+/// WorldTransform and Bounds.
+///
+/// update() only looks at the chunks where one of them changed, removals are
+/// noticed by the entity count and swept. Queries report entities, the
+/// batched ones write the results of every query into a single array and can
+/// run on several threads at the same time
+template <typename Backend>
+class SpatialIndex {
+  constexpr static u32 kNoProxy = u32_MAX;
+  // new entities are inserted together at the end of update(), until then
+  // the proxy is a position in the pending arrays
+  constexpr static u32 kPending = 1u << 31;
+
+  struct Slot {
+    Entity     entity;
+    u32        proxy;
+    math::Aabb box;  // last one given to the backend
+  };
+
+  Manager *manager_;
+  Backend  backend_;
+
+  Query<Changed<WorldTransform>, Read<WorldTransform>, Read<Bounds>> moved_;
+  Query<Changed<Bounds>, Read<WorldTransform>, Read<Bounds>> resized_;
+  Query<Read<WorldTransform>, Read<Bounds>>                  all_;
+
+  Vector<Slot>       slots_;  // by entity index
+  Vector<math::Aabb> pending_boxes_;
+  Vector<u32>        pending_indices_;
+  Vector<u32>        pending_proxies_;
+  u32                size_;
+
+  void apply(Entity entity, const WorldTransform &world, const Bounds &bounds);
+  void sweep();
+
+  template <typename Shape>
+  void query_batch(
+      const Shape    *shapes,
+      u32             count,
+      Vector<Entity> &results,
+      Vector<u32>    &offsets
+  ) const;
+
+ public:
+  SpatialIndex() = delete;
+  /// `args` are passed to the backend
+  template <typename... Args>
+  explicit SpatialIndex(Manager &manager, Args &&...args);
+  SpatialIndex(const SpatialIndex &other) = delete;
+  SpatialIndex(SpatialIndex &&other)      = delete;
+
+  SpatialIndex &operator=(const SpatialIndex &rhs) = delete;
+  SpatialIndex &operator=(SpatialIndex &&rhs)      = delete;
+
+  /// Picks up the changes of the world since the previous call
+  void     update();
+  /// Registers update() as a system of the scheduler, run as one task
+  SystemId add_system(Scheduler &scheduler);
+
+  /// Calls `f(Entity)` for every entity overlapping the shape
+  template <typename F>
+  void query(const math::Aabb &box, F &&f) const;
+  template <typename F>
+  void query(const math::Sphere &sphere, F &&f) const;
+  template <typename F>
+  void query(const math::Frustum &frustum, F &&f) const;
+
+  /// The entities of query `i` end up in `results[offsets[i], offsets[i+1])`
+  void query(
+      const math::Aabb *boxes,
+      u32               count,
+      Vector<Entity>   &results,
+      Vector<u32>      &offsets
+  ) const;
+  void query(
+      const math::Sphere *spheres,
+      u32                 count,
+      Vector<Entity>     &results,
+      Vector<u32>        &offsets
+  ) const;
+  void query(
+      const math::Frustum *frustums,
+      u32                  count,
+      Vector<Entity>      &results,
+      Vector<u32>         &offsets
+  ) const;
+
+  EMBERS_ALWAYS_INLINE u32            size() const;
+  EMBERS_ALWAYS_INLINE const Backend &backend() const;
+
+  constexpr static Access kAccess = {
+      component_mask<WorldTransform, Bounds>(),
+      ComponentMask()
+  };
+};
+
+using GridIndex = SpatialIndex<LooseGrid>;
+using BvhIndex  = SpatialIndex<DynamicBvh>;
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+EMBERS_ALWAYS_INLINE u32 LooseGrid::cell_coordinate(f32 position, u32 axis)
+    const {
+  f32 cell = std::floor(position * inverse_cell_size_);
+  if (!(cell > 0)) {  // also catches NaN
+    return 0;
+  }
+  return cell < dimensions_[axis] - 1 ? (u32)cell : dimensions_[axis] - 1;
+}
+
+EMBERS_ALWAYS_INLINE u32 LooseGrid::cell_of(const math::Aabb &box) const {
+  u32 x = cell_coordinate((box.min.x + box.max.x) * 0.5f - origin_.x, 0);
+  u32 y = cell_coordinate((box.min.y + box.max.y) * 0.5f - origin_.y, 1);
+  u32 z = cell_coordinate((box.min.z + box.max.z) * 0.5f - origin_.z, 2);
+  return (z * dimensions_[1] + y) * dimensions_[0] + x;
+}
+
+EMBERS_ALWAYS_INLINE math::Aabb LooseGrid::cell_box(u32 x, u32 y, u32 z)
+    const {
+  math::Vec3 min = {
+      origin_.x + x * cell_size_ - max_extent_,
+      origin_.y + y * cell_size_ - max_extent_,
+      origin_.z + z * cell_size_ - max_extent_
+  };
+  f32 size = cell_size_ + 2 * max_extent_;
+  return {min, {min.x + size, min.y + size, min.z + size}};
+}
+
+template <typename Shape, typename F>
+void LooseGrid::query(const Shape &shape, F &&f) const {
+  if (size_ == 0) {
+    return;
+  }
+  CellRange range = cell_range(bounds_of(shape));
+  for (u32 z = range.min[2]; z <= range.max[2]; ++z) {
+    for (u32 y = range.min[1]; y <= range.max[1]; ++y) {
+      u32 row = (z * dimensions_[1] + y) * dimensions_[0];
+      for (u32 x = range.min[0]; x <= range.max[0]; ++x) {
+        const Vector<Entry> &cell = cells_[row + x];
+        // border cells hold everything outside, their box would lie
+        if (cell.empty() ||
+            (x > 0 && y > 0 && z > 0 && x + 1 < dimensions_[0] &&
+             y + 1 < dimensions_[1] && z + 1 < dimensions_[2] &&
+             !math::overlaps(cell_box(x, y, z), shape))) {
+          continue;
+        }
+        for (const Entry &entry : cell) {
+          if (math::overlaps(entry.box, shape)) {
+            f(entry.value);
+          }
+        }
+      }
+    }
+  }
+}
+
+EMBERS_ALWAYS_INLINE u32 LooseGrid::size() const {
+  return size_;
+}
+
+EMBERS_ALWAYS_INLINE bool DynamicBvh::is_leaf(u32 node) const {
+  return nodes_[node].left == kNull;
+}
+
+template <typename Shape, typename F>
+void DynamicBvh::query(const Shape &shape, F &&f) const {
+  // stackless, the parent links lead to the next subtree
+  u32 node = root_;
+  while (node != kNull) {
+    const Node &current = nodes_[node];
+    if (math::overlaps(current.box, shape)) {
+      if (current.left != kNull) {
+        node = current.left;
+        continue;
+      }
+      f(current.value);
+    }
+    while (true) {
+      u32 parent = nodes_[node].parent;
+      if (parent == kNull) {
+        node = kNull;
+        break;
+      }
+      if (nodes_[parent].left == node) {
+        node = nodes_[parent].right;
+        break;
+      }
+      node = parent;
+    }
+  }
+}
+
+EMBERS_ALWAYS_INLINE u32 DynamicBvh::size() const {
+  return size_;
+}
+
+EMBERS_ALWAYS_INLINE u32 DynamicBvh::height() const {
+  return root_ == kNull ? 0 : (u32)nodes_[root_].height + 1;
+}
+
+template <typename Backend>
+template <typename... Args>
+SpatialIndex<Backend>::SpatialIndex(Manager &manager, Args &&...args)
+    : manager_(&manager),
+      backend_(std::forward<Args>(args)...),
+      moved_(manager),
+      resized_(manager),
+      all_(manager),
+      size_(0) {}
+
+template <typename Backend>
+void SpatialIndex<Backend>::apply(
+    Entity entity, const WorldTransform &world, const Bounds &bounds
+) {
+  math::Aabb box =
+      math::Aabb::around(math::translation_of(world.matrix), bounds.radius);
+
+  if (entity.index_ >= slots_.size()) {
+    slots_.resize(entity.index_ + 1, {Entity(), kNoProxy, {}});
+  }
+  Slot &slot = slots_[entity.index_];
+  if (slot.proxy == kNoProxy) {
+    slot.proxy = kPending | (u32)pending_boxes_.size();
+    pending_boxes_.push_back(box);
+    pending_indices_.push_back(entity.index_);
+  } else if (slot.proxy & kPending) {
+    pending_boxes_[slot.proxy & ~kPending] = box;
+  } else if (slot.entity != entity || slot.box != box) {
+    // a reused index replaces the destroyed entity in place. Chunks are
+    // marked as a whole, the copy of the box skips the rows that didn't move
+    backend_.move(slot.proxy, box);
+  }
+  slot.entity = entity;
+  slot.box    = box;
+  return;
+}
+
+template <typename Backend>
+void SpatialIndex<Backend>::sweep() {
+  for (Slot &slot : slots_) {
+    if (slot.proxy != kNoProxy &&
+        !(manager_->alive(slot.entity) &&
+          manager_->has<WorldTransform>(slot.entity) &&
+          manager_->has<Bounds>(slot.entity))) {
+      backend_.remove(slot.proxy);
+      slot = {Entity(), kNoProxy, {}};
+      --size_;
+    }
+  }
+  return;
+}
+
+template <typename Backend>
+void SpatialIndex<Backend>::update() {
+  // new rows are marked changed too, so both queries see the insertions
+  const auto apply_row = [this](
+                             Entity                entity,
+                             const WorldTransform &world,
+                             const Bounds         &bounds
+                         ) { apply(entity, world, bounds); };
+  moved_.each(apply_row);
+  resized_.each(apply_row);
+
+  u32 count = (u32)pending_boxes_.size();
+  if (count > 0) {
+    pending_proxies_.resize(count);
+    backend_.insert(
+        pending_boxes_.data(),
+        pending_indices_.data(),
+        count,
+        pending_proxies_.data()
+    );
+    for (u32 i = 0; i < count; ++i) {
+      slots_[pending_indices_[i]].proxy = pending_proxies_[i];
+    }
+    size_ += count;
+    pending_boxes_.clear();
+    pending_indices_.clear();
+  }
+
+  // removals don't leave ticks behind, but every insertion was counted, so
+  // the counts only differ when something left
+  if (size_ != all_.size()) {
+    sweep();
+  }
+  return;
+}
+
+template <typename Backend>
+SystemId SpatialIndex<Backend>::add_system(Scheduler &scheduler) {
+  // a single task: the backends aren't thread safe
+  return scheduler.add("spatial_index", kAccess, [this](Manager &) {
+    update();
+  });
+}
+
+template <typename Backend>
+template <typename F>
+void SpatialIndex<Backend>::query(const math::Aabb &box, F &&f) const {
+  backend_.query(box, [&](u32 index) { f(slots_[index].entity); });
+}
+
+template <typename Backend>
+template <typename F>
+void SpatialIndex<Backend>::query(const math::Sphere &sphere, F &&f) const {
+  backend_.query(sphere, [&](u32 index) { f(slots_[index].entity); });
+}
+
+template <typename Backend>
+template <typename F>
+void SpatialIndex<Backend>::query(const math::Frustum &frustum, F &&f)
+    const {
+  backend_.query(frustum, [&](u32 index) { f(slots_[index].entity); });
+}
+
+template <typename Backend>
+template <typename Shape>
+void SpatialIndex<Backend>::query_batch(
+    const Shape    *shapes,
+    u32             count,
+    Vector<Entity> &results,
+    Vector<u32>    &offsets
+) const {
+  results.clear();
+  offsets.resize(count + 1);
+  for (u32 i = 0; i < count; ++i) {
+    offsets[i] = (u32)results.size();
+    backend_.query(shapes[i], [&](u32 index) {
+      results.push_back(slots_[index].entity);
+    });
+  }
+  offsets[count] = (u32)results.size();
+  return;
+}
+
+template <typename Backend>
+void SpatialIndex<Backend>::query(
+    const math::Aabb *boxes,
+    u32               count,
+    Vector<Entity>   &results,
+    Vector<u32>      &offsets
+) const {
+  query_batch(boxes, count, results, offsets);
+  return;
+}
+
+template <typename Backend>
+void SpatialIndex<Backend>::query(
+    const math::Sphere *spheres,
+    u32                 count,
+    Vector<Entity>     &results,
+    Vector<u32>        &offsets
+) const {
+  query_batch(spheres, count, results, offsets);
+  return;
+}
+
+template <typename Backend>
+void SpatialIndex<Backend>::query(
+    const math::Frustum *frustums,
+    u32                  count,
+    Vector<Entity>      &results,
+    Vector<u32>         &offsets
+) const {
+  query_batch(frustums, count, results, offsets);
+  return;
+}
+
+template <typename Backend>
+EMBERS_ALWAYS_INLINE u32 SpatialIndex<Backend>::size() const {
+  return size_;
+}
+
+template <typename Backend>
+EMBERS_ALWAYS_INLINE const Backend &SpatialIndex<Backend>::backend() const {
+  return backend_;
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "transform.hpp"
+
+#include <algorithm>
+#include <embers/logger.hpp>
+
+namespace embers::ecs {
+
+TransformHierarchy::TransformHierarchy(Manager &manager)
+    : manager_(&manager),
+      nodes_query_(manager),
+      parents_query_(manager),
+      parent_changes_(manager),
+      added_nodes_(manager),
+      local_changes_(manager),
+      parent_count_(0),
+      batch_nodes_(1024) {}
+
+bool TransformHierarchy::structure_changed() {
+  // both queries have to run to move their ticks forward
+  bool changed = false;
+  parent_changes_.each_chunk([&](const auto &) { changed = true; });
+  added_nodes_.each_chunk([&](const auto &) { changed = true; });
+
+  // removals don't leave ticks behind, the counts catch them
+  return changed || nodes_query_.size() != entities_.size() ||
+         parents_query_.size() != parent_count_;
+}
+
+void TransformHierarchy::rebuild() {
+  Vector<Entity>     gathered;
+  Vector<math::Mat4> gathered_locals;
+
+  nodes_query_.each([&](Entity entity, const LocalTransform &local, auto &) {
+    gathered.push_back(entity);
+    gathered_locals.push_back(local.matrix);
+  });
+  u32 count = (u32)gathered.size();
+
+  u32 max_index = 0;
+  for (Entity entity : gathered) {
+    max_index = std::max(max_index, entity.index_);
+  }
+  node_of_.assign(max_index + 1, kNoNode);
+  for (u32 i = 0; i < count; ++i) {
+    node_of_[gathered[i].index_] = i;
+  }
+
+  const auto find = [&](Entity entity) {
+    if (entity.index_ >= node_of_.size()) {
+      return kNoNode;
+    }
+    u32 node = node_of_[entity.index_];
+    return node != kNoNode && gathered[node] == entity ? node : kNoNode;
+  };
+
+  Vector<u32> parent_of(count, kNoNode);
+  parents_query_.each([&](Entity entity, const Parent &parent, auto &) {
+    u32 node = find(entity);
+    if (node != kNoNode) {
+      parent_of[node] = find(parent.entity);
+    }
+  });
+  parent_count_ = parents_query_.size();
+
+  // children as offsets into a single array
+  Vector<u32> child_offsets(count + 1, 0);
+  for (u32 i = 0; i < count; ++i) {
+    if (parent_of[i] != kNoNode) {
+      child_offsets[parent_of[i] + 1]++;
+    }
+  }
+  for (u32 i = 0; i < count; ++i) {
+    child_offsets[i + 1] += child_offsets[i];
+  }
+  Vector<u32> children(child_offsets[count]);
+  Vector<u32> cursor(child_offsets.begin(), child_offsets.end() - 1);
+  for (u32 i = 0; i < count; ++i) {
+    if (parent_of[i] != kNoNode) {
+      children[cursor[parent_of[i]]++] = i;
+    }
+  }
+
+  // breadth first from every root, the order array doubles as the queue
+  Vector<u32> order;
+  Vector<u8>  visited(count, 0);
+  order.reserve(count);
+  islands_.clear();
+  levels_.clear();
+
+  const auto visit_island = [&](u32 root) {
+    Island island      = {(u32)levels_.size(), 0, true};
+    u32    level_begin = (u32)order.size();
+
+    visited[root] = 1;
+    order.push_back(root);
+    while (level_begin < order.size()) {
+      u32 level_end = (u32)order.size();
+      levels_.push_back(level_begin);
+      for (u32 i = level_begin; i < level_end; ++i) {
+        for (u32 c = child_offsets[order[i]]; c < child_offsets[order[i] + 1];
+             ++c) {
+          if (!visited[children[c]]) {
+            visited[children[c]] = 1;
+            order.push_back(children[c]);
+          }
+        }
+      }
+      level_begin = level_end;
+    }
+    island.last_level = (u32)levels_.size();
+    islands_.push_back(island);
+  };
+
+  for (u32 i = 0; i < count; ++i) {
+    if (parent_of[i] == kNoNode) {
+      visit_island(i);
+    }
+  }
+  // whatever is left hangs off a cycle, it's cut where it was found
+  for (u32 i = 0; i < count; ++i) {
+    if (!visited[i]) {
+      EMBERS_WARN(
+          "Transform hierarchy has a cycle, cut at entity {}",
+          gathered[i].index_
+      );
+      parent_of[i] = kNoNode;
+      visit_island(i);
+    }
+  }
+  levels_.push_back(count);
+
+  Vector<u32> position(count);
+  for (u32 n = 0; n < count; ++n) {
+    position[order[n]] = n;
+  }
+
+  entities_.resize(count);
+  parents_.resize(count);
+  locals_.resize(count);
+  worlds_.resize(count);
+  slots_.assign(count, nullptr);
+  dirty_.assign(count, 1);
+  island_of_.resize(count);
+  for (u32 n = 0; n < count; ++n) {
+    u32 node                        = order[n];
+    entities_[n]                    = gathered[node];
+    locals_[n]                      = gathered_locals[node];
+    node_of_[gathered[node].index_] = n;
+
+    parents_[n] =
+        parent_of[node] != kNoNode ? position[parent_of[node]] : kNoNode;
+  }
+
+  dirty_islands_.clear();
+  for (u32 i = 0; i < islands_.size(); ++i) {
+    for (u32 n = levels_[islands_[i].first_level];
+         n < levels_[islands_[i].last_level];
+         ++n) {
+      island_of_[n] = i;
+    }
+    dirty_islands_.push_back(i);
+  }
+  return;
+}
+
+u32 TransformHierarchy::prepare() {
+  // the islands of the previous run are done
+  dirty_islands_.clear();
+
+  if (structure_changed()) {
+    rebuild();
+    local_changes_.advance();
+  } else {
+    local_changes_.each([&](Entity entity, const LocalTransform &local) {
+      u32 node = entity.index_ < node_of_.size() ? node_of_[entity.index_]
+                                                 : kNoNode;
+      // chunks are marked as a whole, only really changed nodes count
+      if (node == kNoNode || locals_[node] == local.matrix) {
+        return;
+      }
+      locals_[node] = local.matrix;
+      dirty_[node]  = 1;
+
+      Island &island = islands_[island_of_[node]];
+      if (!island.dirty) {
+        island.dirty = true;
+        dirty_islands_.push_back(island_of_[node]);
+      }
+    });
+    std::sort(dirty_islands_.begin(), dirty_islands_.end());
+  }
+
+  // dirty parents make dirty children, the destinations are looked up here
+  // so the workers only touch their own islands
+  batches_.clear();
+  u32 batch_size = 0;
+  for (u32 i = 0; i < dirty_islands_.size(); ++i) {
+    Island &island = islands_[dirty_islands_[i]];
+    island.dirty   = false;
+
+    u32 first = levels_[island.first_level];
+    u32 last  = levels_[island.last_level];
+    for (u32 n = first; n < last; ++n) {
+      if (parents_[n] != kNoNode) {
+        dirty_[n] |= dirty_[parents_[n]];
+      }
+      if (dirty_[n]) {
+        slots_[n] = manager_->get<WorldTransform>(entities_[n]);
+      }
+    }
+
+    if (batch_size == 0) {
+      batches_.push_back(i);
+    }
+    batch_size += last - first;
+    if (batch_size >= batch_nodes_) {
+      batch_size = 0;
+    }
+  }
+  u32 count = (u32)batches_.size();
+  batches_.push_back((u32)dirty_islands_.size());
+  return count;
+}
+
+void TransformHierarchy::propagate_island(const Island &island) {
+  for (u32 level = island.first_level; level < island.last_level; ++level) {
+    u32 first = levels_[level];
+    u32 last  = levels_[level + 1];
+
+    // parents are on the previous level, so nodes of a level are independent
+    for (u32 n = first; n < last; ++n) {
+      if (!dirty_[n]) {
+        continue;
+      }
+      worlds_[n] = parents_[n] == kNoNode ? locals_[n]
+                                          : worlds_[parents_[n]] * locals_[n];
+      dirty_[n]  = 0;
+      if (slots_[n] != nullptr) {
+        slots_[n]->matrix = worlds_[n];
+      }
+    }
+  }
+  return;
+}
+
+void TransformHierarchy::propagate(u32 first, u32 last) {
+  for (u32 batch = first; batch < last; ++batch) {
+    for (u32 i = batches_[batch]; i < batches_[batch + 1]; ++i) {
+      propagate_island(islands_[dirty_islands_[i]]);
+    }
+  }
+  return;
+}
+
+void TransformHierarchy::update() {
+  propagate(0, prepare());
+  return;
+}
+
+SystemId TransformHierarchy::add_system(Scheduler &scheduler) {
+  return scheduler.add_range_system(
+      "transform_hierarchy",
+      kAccess,
+      [this] { return prepare(); },
+      [this](u32 first, u32 last) { propagate(first, last); }
+  );
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../math/math.hpp"
+#include "common.hpp"
+#include "component.hpp"
+#include "entity.hpp"
+#include "manager.hpp"
+#include "query.hpp"
+#include "scheduler.hpp"
+
+namespace embers::ecs {
+
+/// Makes the entity a child of another one. Both of them need a
+/// LocalTransform and a WorldTransform, otherwise the child is a root
+struct Parent {
+  Entity entity;
+};
+
+/// Relative to the parent, or to the world for roots
+struct LocalTransform {
+  math::Mat4 matrix;
+};
+
+/// Written by TransformHierarchy
+struct WorldTransform {
+  math::Mat4 matrix;
+};
+
+}  // namespace embers::ecs
+
+EMBERS_ECS_COMPONENT(
+    embers::ecs::Parent,
+    embers::ecs::kFirstEngineComponent + 0
+);
+EMBERS_ECS_COMPONENT(
+    embers::ecs::LocalTransform,
+    embers::ecs::kFirstEngineComponent + 1
+);
+EMBERS_ECS_COMPONENT(
+    embers::ecs::WorldTransform,
+    embers::ecs::kFirstEngineComponent + 2
+);
+
+namespace embers::ecs {
+
+/// Propagates LocalTransform down the Parent links into WorldTransform.
+///
+/// The hierarchy is mirrored into flat arrays: every tree (island) is stored
+/// breadth first, so its levels are contiguous and a parent always comes
+/// before its children. World matrices are computed level after level in
+/// linear passes reading the parents from the previous level, islands don't
+/// depend on each other and are split between the workers.
+///
+/// Only islands with a changed LocalTransform are recomputed, and inside of
+/// them only the changed nodes and their descendants. The arrays are rebuilt
+/// when Parent components change or entities with transforms come and go
+class TransformHierarchy {
+  constexpr static u32 kNoNode = u32_MAX;
+
+  struct Island {
+    u32 first_level;
+    u32 last_level;
+    b8  dirty;
+  };
+
+  Manager *manager_;
+
+  Query<Read<LocalTransform>, Read<WorldTransform>>    nodes_query_;
+  Query<Read<Parent>, Read<LocalTransform>>            parents_query_;
+  Query<Changed<Parent>>                               parent_changes_;
+  Query<Added<LocalTransform>>                         added_nodes_;
+  Query<Changed<LocalTransform>, Read<LocalTransform>> local_changes_;
+
+  // nodes, in island and depth order
+  Vector<Entity>           entities_;
+  Vector<u32>              parents_;
+  Vector<math::Mat4>       locals_;
+  Vector<math::Mat4>       worlds_;
+  Vector<u8>               dirty_;
+  Vector<WorldTransform *> slots_;
+  Vector<u32>              island_of_;
+
+  Vector<Island> islands_;
+  Vector<u32>    levels_;  // first node of every level, plus the node count
+  Vector<u32>    node_of_;  // by entity index
+  u32            parent_count_;
+
+  Vector<u32> dirty_islands_;
+  Vector<u32> batches_;  // first entry of dirty_islands_ of every batch
+  u32         batch_nodes_;
+
+  bool structure_changed();
+  void rebuild();
+  void propagate_island(const Island &island);
+
+ public:
+  TransformHierarchy() = delete;
+  explicit TransformHierarchy(Manager &manager);
+  TransformHierarchy(const TransformHierarchy &other) = delete;
+  TransformHierarchy(TransformHierarchy &&other)      = delete;
+
+  TransformHierarchy &operator=(const TransformHierarchy &rhs) = delete;
+  TransformHierarchy &operator=(TransformHierarchy &&rhs)      = delete;
+
+  /// Picks up the changes of the world, returns the number of batches of
+  /// dirty islands
+  u32  prepare();
+  /// Computes the world matrices of batches [first, last)
+  void propagate(u32 first, u32 last);
+
+  /// prepare() and propagate() on the calling thread
+  void     update();
+  /// Registers the hierarchy as a system of the scheduler
+  SystemId add_system(Scheduler &scheduler);
+
+  EMBERS_ALWAYS_INLINE u32 node_count() const;
+  EMBERS_ALWAYS_INLINE u32 island_count() const;
+
+  constexpr static Access kAccess = {
+      component_mask<Parent, LocalTransform>(),
+      component_mask<WorldTransform>()
+  };
+};
+
+}  // namespace embers::ecs
+
+// implementation
+
+namespace embers::ecs {
+
+EMBERS_ALWAYS_INLINE u32 TransformHierarchy::node_count() const {
+  return (u32)entities_.size();
+}
+
+EMBERS_ALWAYS_INLINE u32 TransformHierarchy::island_count() const {
+  return (u32)islands_.size();
+}
+
+}  // namespace embers::ecs
\ No newline at end of file
@@ -24,7 +24,30 @@ enum class Error : ErrorType {
   kVulkanEnumerateDeviceLayers                = 0x00000029,
   kVulkanRequiredDeviceLayersArentPresent     = 0x0000002a,
   kVulkanGetInstanceProcAddr                  = 0x0000002b,
+  kVulkanNoSuitableDevice                     = 0x0000002c,
   kVulkanCreateSurface                        = 0x00000030,
+  kVulkanMemoryType                           = 0x00000031,
+  kVulkanAllocateMemory                       = 0x00000032,
+  kVulkanMapMemory                            = 0x00000033,
+  kVulkanCreateBuffer                         = 0x00000034,
+  kVulkanCreateCommands                       = 0x00000035,
+  kVulkanCreateSync                           = 0x00000036,
+  kVulkanSubmit                               = 0x00000037,
+  kVulkanUploadSize                           = 0x00000038,
+  kVulkanCreateSwapchain                      = 0x00000039,
+  kVulkanPresent                              = 0x0000003a,
+  kVulkanPipelineCache                        = 0x0000003b,
+  kVulkanCreatePipeline                       = 0x0000003c,
+  kVulkanCreateDescriptors                    = 0x0000003d,
+  kVulkanDescriptorsFull                      = 0x0000003e,
+  kIoOpenFile                                 = 0x00000040,
+  kIoWriteFile                                = 0x00000041,
+  kIoMapFile                                  = 0x00000042,
+  kIoRegisterBuffers                          = 0x00000043,
+  kEcsSnapshotInvalid                         = 0x00000050,
+  kEcsSnapshotVersion                         = 0x00000051,
+  kEcsSnapshotComponents                      = 0x00000052,
+  kEcsSnapshotNotTrivial                      = 0x00000053,
 };
 
 }  // namespace embers
@@ -60,6 +83,52 @@ constexpr const char *fmt::formatter<embers::Error>::get_error_description(
       return "Unable to init GLFW";
     case Error::kWindowCreateWindow:
       return "Unable to create a window";
+    case Error::kVulkanNoSuitableDevice:
+      return "No Vulkan 1.1 device with the required extensions";
+    case Error::kVulkanMemoryType:
+      return "No Vulkan memory type fits the allocation";
+    case Error::kVulkanAllocateMemory:
+      return "Unable to allocate Vulkan device memory";
+    case Error::kVulkanMapMemory:
+      return "Unable to map Vulkan device memory";
+    case Error::kVulkanCreateBuffer:
+      return "Unable to create a Vulkan buffer";
+    case Error::kVulkanCreateCommands:
+      return "Unable to create Vulkan command pools or buffers";
+    case Error::kVulkanCreateSync:
+      return "Unable to create Vulkan fences or semaphores";
+    case Error::kVulkanSubmit:
+      return "Unable to submit to a Vulkan queue";
+    case Error::kVulkanUploadSize:
+      return "Upload larger than the staging ring";
+    case Error::kVulkanCreateSwapchain:
+      return "Unable to create a Vulkan swapchain";
+    case Error::kVulkanPresent:
+      return "Unable to acquire or present a swapchain image";
+    case Error::kVulkanPipelineCache:
+      return "Unable to create or read a Vulkan pipeline cache";
+    case Error::kVulkanCreatePipeline:
+      return "Unable to create a Vulkan pipeline";
+    case Error::kVulkanCreateDescriptors:
+      return "Unable to create Vulkan descriptor pools or sets";
+    case Error::kVulkanDescriptorsFull:
+      return "No descriptor left in the bindless descriptor set";
+    case Error::kIoOpenFile:
+      return "Unable to open a file";
+    case Error::kIoWriteFile:
+      return "Unable to write to a file";
+    case Error::kIoMapFile:
+      return "Unable to map a file";
+    case Error::kIoRegisterBuffers:
+      return "Unable to register I/O buffers";
+    case Error::kEcsSnapshotInvalid:
+      return "Not an ECS snapshot or a truncated one";
+    case Error::kEcsSnapshotVersion:
+      return "ECS snapshot of another version or chunk size";
+    case Error::kEcsSnapshotComponents:
+      return "ECS snapshot components don't match the registered ones";
+    case Error::kEcsSnapshotNotTrivial:
+      return "Component can't be copied as bytes into an ECS snapshot";
     default:
       break;
   }
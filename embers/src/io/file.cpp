@@ -0,0 +1,265 @@
+#include "file.hpp"
+
+#include <embers/logger.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
+namespace embers::io {
+
+// File
+
+#if defined(_WIN32)
+
+File::File(const char *path) {
+  handle_ = CreateFileA(
+      path,
+      GENERIC_WRITE,
+      0,
+      nullptr,
+      CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr
+  );
+  if (handle_ == INVALID_HANDLE_VALUE) {
+    EMBERS_ERROR("Unable to open {}; GetLastError: {}", path, GetLastError());
+    handle_     = nullptr;
+    last_error_ = Error::kIoOpenFile;
+  }
+}
+
+File::File(File &&other) : handle_(other.handle_) { other.handle_ = nullptr; }
+
+File::~File() {
+  if (handle_ != nullptr) {
+    CloseHandle(handle_);
+  }
+  return;
+}
+
+File::operator bool() const { return handle_ != nullptr; }
+
+bool File::write(const void *data, size_t size) {
+  const u8 *bytes = (const u8 *)data;
+  while (size > 0) {
+    DWORD chunk   = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+    DWORD written = 0;
+    if (!WriteFile(handle_, bytes, chunk, &written, nullptr)) {
+      last_error_ = Error::kIoWriteFile;
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool File::sync() { return FlushFileBuffers(handle_) != 0; }
+
+#else
+
+File::File(const char *path) {
+  descriptor_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (descriptor_ < 0) {
+    EMBERS_ERROR("Unable to open {}; errno: {}", path, errno);
+    last_error_ = Error::kIoOpenFile;
+  }
+}
+
+File::File(File &&other) : descriptor_(other.descriptor_) {
+  other.descriptor_ = -1;
+}
+
+File::~File() {
+  if (descriptor_ >= 0) {
+    close(descriptor_);
+  }
+  return;
+}
+
+File::operator bool() const { return descriptor_ >= 0; }
+
+bool File::write(const void *data, size_t size) {
+  const u8 *bytes = (const u8 *)data;
+  while (size > 0) {
+    ssize_t written = ::write(descriptor_, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      last_error_ = Error::kIoWriteFile;
+      return false;
+    }
+    bytes += written;
+    size -= (size_t)written;
+  }
+  return true;
+}
+
+bool File::sync() { return fsync(descriptor_) == 0; }
+
+#endif
+
+// MappedFile
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const char *path) : data_(nullptr), size_(0) {
+  HANDLE        file    = INVALID_HANDLE_VALUE;
+  HANDLE        mapping = nullptr;
+  LARGE_INTEGER size;
+
+  file = CreateFileA(
+      path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    last_error_ = Error::kIoOpenFile;
+    goto mapped_file_fail;
+  }
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    last_error_ = Error::kIoMapFile;
+    goto mapped_file_fail;
+  }
+  mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    last_error_ = Error::kIoMapFile;
+    goto mapped_file_fail;
+  }
+  data_ = (u8 *)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if (data_ == nullptr) {
+    last_error_ = Error::kIoMapFile;
+    goto mapped_file_fail;
+  }
+  size_ = (size_t)size.QuadPart;
+
+  // the view keeps the file alive
+  CloseHandle(mapping);
+  CloseHandle(file);
+  return;
+mapped_file_fail:
+  EMBERS_ERROR("Unable to map {}; GetLastError: {}", path, GetLastError());
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+  }
+  return;
+}
+
+void MappedFile::unmap() {
+  UnmapViewOfFile(data_);
+  return;
+}
+
+bool replace_file(const char *from, const char *to) {
+  return MoveFileExA(
+             from,
+             to,
+             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+         ) != 0;
+}
+
+bool file_exists(const char *path) {
+  return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+#else
+
+MappedFile::MappedFile(const char *path) : data_(nullptr), size_(0) {
+  struct stat info;
+  void       *data;
+
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    last_error_ = Error::kIoOpenFile;
+    goto mapped_file_fail;
+  }
+  if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+    last_error_ = Error::kIoMapFile;
+    goto mapped_file_fail;
+  }
+  data = mmap(
+      nullptr,
+      (size_t)info.st_size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE,
+      descriptor,
+      0
+  );
+  if (data == MAP_FAILED) {
+    last_error_ = Error::kIoMapFile;
+    goto mapped_file_fail;
+  }
+  data_ = (u8 *)data;
+  size_ = (size_t)info.st_size;
+
+  // the mapping keeps the file alive
+  close(descriptor);
+  return;
+mapped_file_fail:
+  EMBERS_ERROR("Unable to map {}; errno: {}", path, errno);
+  if (descriptor >= 0) {
+    close(descriptor);
+  }
+  return;
+}
+
+void MappedFile::unmap() {
+  munmap(data_, size_);
+  return;
+}
+
+bool replace_file(const char *from, const char *to) {
+  return std::rename(from, to) == 0;
+}
+
+bool file_exists(const char *path) { return access(path, F_OK) == 0; }
+
+#endif
+
+MappedFile::MappedFile(MappedFile &&other)
+    : data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    unmap();
+  }
+  return;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) {
+  if (data_ != nullptr) {
+    unmap();
+  }
+  data_     = rhs.data_;
+  size_     = rhs.size_;
+  rhs.data_ = nullptr;
+  rhs.size_ = 0;
+  return *this;
+}
+
+Error File::last_error_       = Error::kUnknown;
+Error MappedFile::last_error_ = Error::kUnknown;
+
+}  // namespace embers::io
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <embers/defines.hpp>
+
+#include "../error_code.hpp"
+
+namespace embers::io {
+
+/// File opened for writing from scratch
+class File {
+  static Error last_error_;
+#if defined(_WIN32)
+  void *handle_;
+#else
+  int descriptor_;
+#endif
+
+ public:
+  File() = delete;
+  explicit File(const char *path);
+  File(const File &other) = delete;
+  File(File &&other);
+  ~File();
+
+  File &operator=(const File &rhs) = delete;
+  File &operator=(File &&rhs)      = delete;
+
+  explicit operator bool() const;
+
+  /// Writes all of the bytes, returns false on failure
+  bool write(const void *data, size_t size);
+  /// Flushes the data to the disk
+  bool sync();
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+/// Whole file mapped copy on write: the mapping can be written to, but the
+/// changes never reach the file
+class MappedFile {
+  static Error last_error_;
+  u8          *data_;
+  size_t       size_;
+
+  void unmap();
+
+ public:
+  MappedFile() = delete;
+  explicit MappedFile(const char *path);
+  MappedFile(const MappedFile &other) = delete;
+  MappedFile(MappedFile &&other);
+  ~MappedFile();
+
+  MappedFile &operator=(const MappedFile &rhs) = delete;
+  MappedFile &operator=(MappedFile &&rhs);
+
+  EMBERS_ALWAYS_INLINE explicit operator bool() const;
+  EMBERS_ALWAYS_INLINE u8      *data() const;
+  EMBERS_ALWAYS_INLINE size_t   size() const;
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+/// Replaces `to` by `from` in one step, readers see either the old or the new
+/// file
+bool replace_file(const char *from, const char *to);
+
+/// Whether something is at `path`, to tell a missing file from a failure
+bool file_exists(const char *path);
+
+}  // namespace embers::io
+
+// implementation
+
+namespace embers::io {
+
+EMBERS_ALWAYS_INLINE Error File::get_last_error() { return last_error_; }
+
+EMBERS_ALWAYS_INLINE MappedFile::operator bool() const {
+  return data_ != nullptr;
+}
+
+EMBERS_ALWAYS_INLINE u8 *MappedFile::data() const { return data_; }
+
+EMBERS_ALWAYS_INLINE size_t MappedFile::size() const { return size_; }
+
+EMBERS_ALWAYS_INLINE Error MappedFile::get_last_error() { return last_error_; }
+
+}  // namespace embers::io
\ No newline at end of file
@@ -0,0 +1,639 @@
+#include "queue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <embers/logger.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace embers::io {
+
+#if defined(__linux__)
+
+// user data of the request stopping the completion thread
+constexpr u64 kStopRequest = u64_MAX;
+
+// the system calls themselves, there is no need for liburing
+static int io_uring_setup(u32 entries, io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring, u32 to_submit, u32 wait, u32 flags) {
+  return (int)syscall(
+      __NR_io_uring_enter,
+      ring,
+      to_submit,
+      wait,
+      flags,
+      nullptr,
+      0
+  );
+}
+
+static int io_uring_register(int ring, u32 opcode, void *arg, u32 count) {
+  return (int)syscall(__NR_io_uring_register, ring, opcode, arg, count);
+}
+
+#endif
+
+/// Registered buffer holding all of [data, data + size), u32_MAX for none
+static u32 find_buffer(
+    const jobs::Vector<Buffer> &buffers, const void *data, u32 size
+) {
+  for (u32 i = 0; i < buffers.size(); ++i) {
+    const u8 *begin = (const u8 *)buffers[i].data;
+    if ((const u8 *)data >= begin &&
+        (const u8 *)data + size <= begin + buffers[i].size) {
+      return i;
+    }
+  }
+  return u32_MAX;
+}
+
+#if defined(_WIN32)
+
+static i64 transfer(void *handle, b8 write, u64 offset, void *data, u32 size) {
+  OVERLAPPED overlapped = {};
+  overlapped.Offset     = (DWORD)offset;
+  overlapped.OffsetHigh = (DWORD)(offset >> 32);
+  DWORD done            = 0;
+  BOOL  succeeded;
+  if (write) {
+    succeeded = WriteFile(handle, data, size, &done, &overlapped);
+  } else {
+    succeeded = ReadFile(handle, data, size, &done, &overlapped);
+  }
+  if (!succeeded && GetLastError() != ERROR_HANDLE_EOF) {
+    return -(i64)GetLastError();
+  }
+  return (i64)done;
+}
+
+#else
+
+static i64 transfer(int file, b8 write, u64 offset, void *data, u32 size) {
+  u8 *bytes = (u8 *)data;
+  u32 done  = 0;
+  while (done < size) {
+    ssize_t result =
+        write ? pwrite(file, bytes + done, size - done, (off_t)(offset + done))
+              : pread(file, bytes + done, size - done, (off_t)(offset + done));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -(i64)errno;
+    }
+    if (result == 0) {
+      break;
+    }
+    done += (u32)result;
+  }
+  return (i64)done;
+}
+
+#endif
+
+Queue::Queue(jobs::System &jobs)
+    : jobs_(&jobs),
+      requests_(new Request[kMaxRequests]),
+      free_(0),
+      in_flight_(0),
+      queued_(0),
+      uring_(false),
+      fixed_files_(false),
+      stop_(false) {
+  for (u32 i = 0; i < kMaxRequests; ++i) {
+    requests_[i].next_free = i + 1 < kMaxRequests ? i + 1 : u32_MAX;
+  }
+#if defined(__linux__)
+  uring_ = setup_uring();
+  if (uring_) {
+    completer_ = std::thread([this] { complete_uring(); });
+    return;
+  }
+#endif
+  EMBERS_WARN("Reads and writes run on {} threads", kThreads);
+  for (u32 i = 0; i < kThreads; ++i) {
+    threads_.emplace_back([this] { work(); });
+  }
+}
+
+Queue::~Queue() {
+  // callbacks of the requests in flight may start more of them
+  while (in_flight_.load(std::memory_order_acquire) != 0) {
+    submit();
+    if (!jobs_->help()) {
+      std::this_thread::yield();
+    }
+  }
+
+#if defined(__linux__)
+  if (uring_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      u32           tail = *sq_tail_;
+      u32           slot = tail & *sq_mask_;
+      io_uring_sqe &sqe  = sqes_[slot];
+      memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode      = IORING_OP_NOP;
+      sqe.user_data   = kStopRequest;
+      sq_array_[slot] = slot;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      queued_++;
+      submit_locked();
+    }
+    completer_.join();
+    destroy_uring();
+  }
+#endif
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_ready_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+
+  for (FileId file = 0; file < files_.size(); ++file) {
+#if defined(_WIN32)
+    if (files_[file] != nullptr) {
+      CloseHandle(files_[file]);
+    }
+#else
+    if (files_[file] >= 0) {
+      ::close(files_[file]);
+    }
+#endif
+  }
+  return;
+}
+
+#if defined(__linux__)
+
+b8 Queue::setup_uring() {
+  io_uring_params   params;
+  void             *mapping;
+  b8                single;
+  jobs::Vector<int> table(kMaxFiles, -1);
+
+  sq_ring_ = nullptr;
+  cq_ring_ = nullptr;
+  sqes_    = nullptr;
+  memset(&params, 0, sizeof(params));
+  // room for every request in flight and the stop request
+  params.flags      = IORING_SETUP_CQSIZE;
+  params.cq_entries = kMaxRequests * 2;
+  ring_             = io_uring_setup(kEntries, &params);
+  if (ring_ < 0) {
+    EMBERS_WARN("io_uring is unavailable; errno: {}", errno);
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(u32);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  single        = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+  mapping = mmap(
+      nullptr,
+      sq_ring_size_,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring_,
+      IORING_OFF_SQ_RING
+  );
+  if (mapping == MAP_FAILED) {
+    goto setup_uring_fail;
+  }
+  sq_ring_ = (u8 *)mapping;
+  cq_ring_ = sq_ring_;
+  if (!single) {
+    mapping = mmap(
+        nullptr,
+        cq_ring_size_,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring_,
+        IORING_OFF_CQ_RING
+    );
+    if (mapping == MAP_FAILED) {
+      cq_ring_ = nullptr;
+      goto setup_uring_fail;
+    }
+    cq_ring_ = (u8 *)mapping;
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  mapping    = mmap(
+      nullptr,
+      sqes_size_,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring_,
+      IORING_OFF_SQES
+  );
+  if (mapping == MAP_FAILED) {
+    goto setup_uring_fail;
+  }
+  sqes_ = (io_uring_sqe *)mapping;
+
+  sq_head_  = (u32 *)(sq_ring_ + params.sq_off.head);
+  sq_tail_  = (u32 *)(sq_ring_ + params.sq_off.tail);
+  sq_mask_  = (u32 *)(sq_ring_ + params.sq_off.ring_mask);
+  sq_array_ = (u32 *)(sq_ring_ + params.sq_off.array);
+  cq_head_  = (u32 *)(cq_ring_ + params.cq_off.head);
+  cq_tail_  = (u32 *)(cq_ring_ + params.cq_off.tail);
+  cq_mask_  = (u32 *)(cq_ring_ + params.cq_off.ring_mask);
+  cqes_     = (io_uring_cqe *)(cq_ring_ + params.cq_off.cqes);
+
+  // a sparse table, files take a slot as they open. Older kernels can't
+  // register it, requests then use the descriptors
+  fixed_files_ = io_uring_register(
+                     ring_,
+                     IORING_REGISTER_FILES,
+                     table.data(),
+                     kMaxFiles
+                 ) == 0;
+  return true;
+setup_uring_fail:
+  EMBERS_ERROR("Unable to map the io_uring rings; errno: {}", errno);
+  destroy_uring();
+  return false;
+}
+
+void Queue::destroy_uring() {
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  ::close(ring_);
+  return;
+}
+
+void Queue::complete_uring() {
+  b8 stop = false;
+  while (!stop) {
+    // the only consumer, the kernel only reads the head
+    u32 head = *cq_head_;
+    u32 tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      if (io_uring_enter(ring_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+          errno != EINTR) {
+        EMBERS_FATAL("Unable to wait for I/O completions; errno: {}", errno);
+        return;
+      }
+      continue;
+    }
+    b8 continued = false;
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+      if (cqe.user_data == kStopRequest) {
+        stop = true;
+        continue;
+      }
+      u32      index   = (u32)cqe.user_data;
+      Request &request = requests_[index];
+      if (cqe.res > 0 && (u32)cqe.res < request.size) {
+        // short, the rest is requested like the fallback loops on it
+        request.offset += (u32)cqe.res;
+        request.data    = (u8 *)request.data + cqe.res;
+        request.size   -= (u32)cqe.res;
+        request.done   += (u32)cqe.res;
+        enqueue(index);
+        continued = true;
+      } else {
+        complete(index, cqe.res < 0 ? cqe.res : request.done + cqe.res);
+      }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    if (continued) {
+      submit();
+    }
+  }
+  return;
+}
+
+#endif
+
+void Queue::work() {
+  while (true) {
+    u32 index;
+#if defined(_WIN32)
+    void *file;
+#else
+    int file;
+#endif
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this] { return stop_ || !work_.empty(); });
+      if (stop_) {
+        return;
+      }
+      // oldest first
+      index = work_.front();
+      work_.erase(work_.begin());
+      file = files_[requests_[index].file];
+    }
+    const Request &request = requests_[index];
+    complete(
+        index,
+        transfer(
+            file,
+            request.operation == kOperationWrite,
+            request.offset,
+            request.data,
+            request.size
+        )
+    );
+  }
+}
+
+u32 Queue::take_request() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (free_ == u32_MAX) {
+    // requests complete once submitted, their callbacks free them
+    submit_locked();
+    lock.unlock();
+    if (!jobs_->help()) {
+      std::this_thread::yield();
+    }
+    lock.lock();
+  }
+  u32 index = free_;
+  free_     = requests_[index].next_free;
+  in_flight_.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+void Queue::enqueue(u32 index) {
+  const Request               &request = requests_[index];
+  std::unique_lock<std::mutex> lock(mutex_);
+#if defined(_WIN32)
+  b8 valid = request.file < files_.size() && files_[request.file] != nullptr;
+#else
+  b8 valid = request.file < files_.size() && files_[request.file] >= 0;
+#endif
+  if (!valid) {
+    lock.unlock();
+    complete(index, -EBADF);
+    return;
+  }
+
+#if defined(__linux__)
+  if (uring_) {
+    // a full ring is handed to the kernel first
+    while (*sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) ==
+           kEntries) {
+      i32 error = submit_locked();
+      if (error != 0) {
+        lock.unlock();
+        complete(index, error);
+        return;
+      }
+    }
+    u32           tail   = *sq_tail_;
+    u32           slot   = tail & *sq_mask_;
+    io_uring_sqe &sqe    = sqes_[slot];
+    b8            write  = request.operation == kOperationWrite;
+    u32           buffer = find_buffer(buffers_, request.data, request.size);
+    memset(&sqe, 0, sizeof(sqe));
+    if (buffer != u32_MAX) {
+      sqe.opcode    = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe.buf_index = (u16)buffer;
+    } else {
+      sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    if (fixed_files_) {
+      sqe.fd    = (i32)request.file;
+      sqe.flags = IOSQE_FIXED_FILE;
+    } else {
+      sqe.fd = files_[request.file];
+    }
+    sqe.off         = request.offset;
+    sqe.addr        = (u64)(uintptr_t)request.data;
+    sqe.len         = request.size;
+    sqe.user_data   = index;
+    sq_array_[slot] = slot;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    queued_++;
+    return;
+  }
+#endif
+  work_.push_back(index);
+  queued_++;
+  return;
+}
+
+void Queue::submit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  submit_locked();
+  return;
+}
+
+i32 Queue::submit_locked() {
+#if defined(__linux__)
+  if (uring_) {
+    while (queued_ > 0) {
+      int submitted = io_uring_enter(ring_, queued_, 0, 0);
+      if (submitted < 0) {
+        i32 error = errno;
+        if (error == EINTR) {
+          continue;
+        }
+        EMBERS_ERROR("Unable to submit {} requests; errno: {}", queued_, error);
+        return -error;
+      }
+      queued_ -= (u32)submitted;
+    }
+    return 0;
+  }
+#endif
+  if (queued_ > 0) {
+    queued_ = 0;
+    work_ready_.notify_all();
+  }
+  return 0;
+}
+
+void Queue::complete(u32 index, i64 result) {
+  // the job takes over the hold on the counter
+  jobs::Counter *counter = requests_[index].counter;
+  jobs_->run(
+      [this, index, result] {
+        Request &request = requests_[index];
+        request.function(request.storage, result);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          request.next_free = free_;
+          free_             = index;
+        }
+        in_flight_.fetch_sub(1, std::memory_order_release);
+      },
+      counter
+  );
+  if (counter != nullptr) {
+    jobs_->release(*counter);
+  }
+  return;
+}
+
+FileId Queue::open(const char *path, Mode mode) {
+#if defined(_WIN32)
+  DWORD access      = mode == Mode::kRead    ? GENERIC_READ
+                      : mode == Mode::kWrite ? GENERIC_WRITE
+                                             : GENERIC_READ | GENERIC_WRITE;
+  DWORD disposition = mode == Mode::kRead    ? OPEN_EXISTING
+                      : mode == Mode::kWrite ? CREATE_ALWAYS
+                                             : OPEN_ALWAYS;
+  void *handle      = CreateFileA(
+      path,
+      access,
+      FILE_SHARE_READ,
+      nullptr,
+      disposition,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr
+  );
+  if (handle == INVALID_HANDLE_VALUE) {
+    EMBERS_ERROR("Unable to open {}; GetLastError: {}", path, GetLastError());
+    last_error_ = Error::kIoOpenFile;
+    return kInvalidFile;
+  }
+#else
+  int flags = mode == Mode::kRead    ? O_RDONLY
+              : mode == Mode::kWrite ? O_WRONLY | O_CREAT | O_TRUNC
+                                     : O_RDWR | O_CREAT;
+  int handle = ::open(path, flags | O_CLOEXEC, 0644);
+  if (handle < 0) {
+    EMBERS_ERROR("Unable to open {}; errno: {}", path, errno);
+    last_error_ = Error::kIoOpenFile;
+    return kInvalidFile;
+  }
+#endif
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  FileId                      file = 0;
+#if defined(_WIN32)
+  while (file < files_.size() && files_[file] != nullptr) {
+#else
+  while (file < files_.size() && files_[file] >= 0) {
+#endif
+    file++;
+  }
+  if (file == kMaxFiles) {
+    EMBERS_ERROR("Unable to open {}, {} files are open", path, kMaxFiles);
+    last_error_ = Error::kIoOpenFile;
+#if defined(_WIN32)
+    CloseHandle(handle);
+#else
+    ::close(handle);
+#endif
+    return kInvalidFile;
+  }
+  if (file == files_.size()) {
+    files_.push_back(handle);
+  }
+  files_[file] = handle;
+
+#if defined(__linux__)
+  if (fixed_files_) {
+    io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = file;
+    update.fds    = (u64)(uintptr_t)&handle;
+    if (io_uring_register(ring_, IORING_REGISTER_FILES_UPDATE, &update, 1) !=
+        1) {
+      EMBERS_ERROR("Unable to register {}; errno: {}", path, errno);
+      last_error_  = Error::kIoOpenFile;
+      files_[file] = -1;
+      ::close(handle);
+      return kInvalidFile;
+    }
+  }
+#endif
+  return file;
+}
+
+void Queue::close(FileId file) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file >= files_.size()) {
+    return;
+  }
+#if defined(_WIN32)
+  if (files_[file] != nullptr) {
+    CloseHandle(files_[file]);
+    files_[file] = nullptr;
+  }
+#else
+  if (files_[file] < 0) {
+    return;
+  }
+#if defined(__linux__)
+  if (fixed_files_) {
+    int                   removed = -1;
+    io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = file;
+    update.fds    = (u64)(uintptr_t)&removed;
+    io_uring_register(ring_, IORING_REGISTER_FILES_UPDATE, &update, 1);
+  }
+#endif
+  ::close(files_[file]);
+  files_[file] = -1;
+#endif
+  return;
+}
+
+bool Queue::register_buffers(const Buffer *buffers, u32 count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_.assign(buffers, buffers + count);
+#if defined(__linux__)
+  if (uring_) {
+    jobs::Vector<iovec> vectors(count);
+    for (u32 i = 0; i < count; ++i) {
+      vectors[i].iov_base = buffers[i].data;
+      vectors[i].iov_len  = buffers[i].size;
+    }
+    if (io_uring_register(
+            ring_,
+            IORING_REGISTER_BUFFERS,
+            vectors.data(),
+            count
+        ) != 0) {
+      EMBERS_ERROR("Unable to register {} buffers; errno: {}", count, errno);
+      last_error_ = Error::kIoRegisterBuffers;
+      buffers_.clear();
+      return false;
+    }
+  }
+#endif
+  return true;
+}
+
+Error Queue::last_error_ = Error::kUnknown;
+
+}  // namespace embers::io
\ No newline at end of file
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <embers/defines.hpp>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "../error_code.hpp"
+#include "../jobs/common.hpp"
+#include "../jobs/jobs.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace embers::io {
+
+using FileId = u32;
+
+constexpr FileId kInvalidFile = u32_MAX;
+
+enum class Mode : u8 {
+  kRead,
+  kWrite,  // created or truncated
+  kReadWrite,
+};
+
+/// Memory reads and writes may use, see Queue::register_buffers()
+struct Buffer {
+  void  *data;
+  size_t size;
+};
+
+/// Asynchronous reads and writes, completed as jobs. On Linux requests go
+/// through io_uring: they are written to the submission ring and submit()
+/// hands all of them to the kernel in a single system call, files are
+/// registered with the ring and requests into registered buffers skip the
+/// mapping of their pages. Elsewhere, or when the kernel has no io_uring,
+/// a pool of threads runs blocking reads and writes.
+///
+/// A completion starts `f(result)` as a job of the jobs::System, the
+/// result is the number of bytes transferred or a negative errno. Short
+/// transfers are continued on both paths, fewer bytes than requested are
+/// only transferred at the end of the file. The
+/// counter of a request (if any) is held from the request to the end of
+/// its callback, a job waiting on it parks until then, so a single thread
+/// can keep thousands of reads in flight
+class Queue {
+ public:
+  constexpr static u32    kEntries         = 256;
+  constexpr static u32    kMaxRequests     = 4096;
+  constexpr static u32    kMaxFiles        = 1024;
+  constexpr static u32    kThreads         = 4;  // of the fallback
+  constexpr static size_t kCallbackStorage = 32;
+
+ private:
+  enum Operation : u8 {
+    kOperationRead,
+    kOperationWrite,
+  };
+
+  struct Request {
+    void (*function)(void *storage, i64 result);
+    jobs::Counter *counter;
+    alignas(16) u8 storage[kCallbackStorage];
+    // kept for the fallback
+    Operation operation;
+    FileId    file;
+    u64       offset;
+    void     *data;
+    u32       size;
+    u32       done;  // by the earlier parts of a short transfer
+    u32       next_free;
+  };
+
+  static Error last_error_;
+
+  jobs::System              *jobs_;
+  std::unique_ptr<Request[]> requests_;
+  u32                        free_;  // list through next_free
+  std::atomic<u32>           in_flight_;
+  u32                        queued_;  // not submitted yet
+  jobs::Vector<Buffer>       buffers_;
+  std::mutex                 mutex_;  // all but the consumers of completions
+
+#if defined(_WIN32)
+  jobs::Vector<void *> files_;
+#else
+  jobs::Vector<int> files_;
+#endif
+
+  b8          uring_;
+  b8          fixed_files_;
+  std::thread completer_;
+#if defined(__linux__)
+  int           ring_;
+  u8           *sq_ring_;
+  size_t        sq_ring_size_;
+  u8           *cq_ring_;
+  size_t        cq_ring_size_;
+  io_uring_sqe *sqes_;
+  size_t        sqes_size_;
+  u32          *sq_head_;
+  u32          *sq_tail_;
+  u32          *sq_mask_;
+  u32          *sq_array_;
+  u32          *cq_head_;
+  u32          *cq_tail_;
+  u32          *cq_mask_;
+  io_uring_cqe *cqes_;
+#endif
+
+  // fallback
+  jobs::Vector<std::thread> threads_;
+  jobs::Vector<u32>         work_;
+  std::condition_variable   work_ready_;
+  b8                        stop_;
+
+  template <typename F>
+  static void invoke(void *storage, i64 result);
+
+  b8   setup_uring();
+  void destroy_uring();
+  /// Completions of the ring, until the stop request completes
+  void complete_uring();
+  /// Blocking reads and writes of the fallback
+  void work();
+
+  /// A free request, submits and runs jobs while there is none
+  u32  take_request();
+  /// Completes the request with the error when it can't be queued
+  void enqueue(u32 request);
+  /// 0 or a negative errno
+  i32  submit_locked();
+  /// Starts the callback of `request` as a job and frees the request
+  void complete(u32 request, i64 result);
+
+  template <typename F>
+  void start(
+      Operation      operation,
+      FileId         file,
+      u64            offset,
+      void          *data,
+      u32            size,
+      F            &&f,
+      jobs::Counter *counter
+  );
+
+ public:
+  Queue() = delete;
+  /// Completions run on the workers of `jobs`
+  explicit Queue(jobs::System &jobs);
+  Queue(const Queue &other) = delete;
+  Queue(Queue &&other)      = delete;
+  /// Waits for the requests in flight
+  ~Queue();
+
+  Queue &operator=(const Queue &rhs) = delete;
+  Queue &operator=(Queue &&rhs)      = delete;
+
+  /// kInvalidFile on failure
+  FileId open(const char *path, Mode mode);
+  /// No request on the file may be in flight
+  void   close(FileId file);
+
+  /// Registers the memory reads and writes will mostly target, once and
+  /// before any request. Requests within a buffer use it as is
+  bool register_buffers(const Buffer *buffers, u32 count);
+
+  /// Reads `size` bytes at `offset` into `data` then starts `f(result)`
+  template <typename F>
+  void read(
+      FileId         file,
+      u64            offset,
+      void          *data,
+      u32            size,
+      F            &&f,
+      jobs::Counter *counter = nullptr
+  );
+  /// Writes `size` bytes of `data` at `offset` then starts `f(result)`
+  template <typename F>
+  void write(
+      FileId         file,
+      u64            offset,
+      const void    *data,
+      u32            size,
+      F            &&f,
+      jobs::Counter *counter = nullptr
+  );
+
+  /// Hands the requests queued since the last call to the kernel (or the
+  /// threads), queuing more requests than the ring holds submits as well
+  void submit();
+
+  /// True when requests go through io_uring
+  EMBERS_ALWAYS_INLINE b8 uring() const;
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::io
+
+// implementation
+
+namespace embers::io {
+
+template <typename F>
+void Queue::invoke(void *storage, i64 result) {
+  F &f = *(F *)storage;
+  f(result);
+  f.~F();
+  return;
+}
+
+template <typename F>
+void Queue::start(
+    Operation      operation,
+    FileId         file,
+    u64            offset,
+    void          *data,
+    u32            size,
+    F            &&f,
+    jobs::Counter *counter
+) {
+  using Function = std::decay_t<F>;
+  static_assert(
+      sizeof(Function) <= kCallbackStorage,
+      "I/O callback is too big, capture a pointer to the data instead"
+  );
+  static_assert(alignof(Function) <= 16, "I/O callback is over aligned");
+
+  if (counter != nullptr) {
+    jobs_->hold(*counter);
+  }
+  u32      index   = take_request();
+  Request &request = requests_[index];
+  new (request.storage) Function(std::forward<F>(f));
+  request.function  = &invoke<Function>;
+  request.counter   = counter;
+  request.operation = operation;
+  request.file      = file;
+  request.offset    = offset;
+  request.data      = data;
+  request.size      = size;
+  request.done      = 0;
+  enqueue(index);
+  return;
+}
+
+template <typename F>
+void Queue::read(
+    FileId         file,
+    u64            offset,
+    void          *data,
+    u32            size,
+    F            &&f,
+    jobs::Counter *counter
+) {
+  start(kOperationRead, file, offset, data, size, std::forward<F>(f), counter);
+  return;
+}
+
+template <typename F>
+void Queue::write(
+    FileId         file,
+    u64            offset,
+    const void    *data,
+    u32            size,
+    F            &&f,
+    jobs::Counter *counter
+) {
+  start(
+      kOperationWrite,
+      file,
+      offset,
+      (void *)data,
+      size,
+      std::forward<F>(f),
+      counter
+  );
+  return;
+}
+
+EMBERS_ALWAYS_INLINE b8 Queue::uring() const { return uring_; }
+
+EMBERS_ALWAYS_INLINE Error Queue::get_last_error() { return last_error_; }
+
+}  // namespace embers::io
\ No newline at end of file
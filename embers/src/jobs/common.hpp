@@ -0,0 +1,28 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <vector>
+
+#include "../containers/allocator.hpp"
+#include "../containers/debug_allocator.hpp"
+
+namespace embers::jobs {
+
+#ifdef EMBERS_CONFIG_DEBUG
+template <typename T>
+using Allocator = containers::with<
+    containers::DefaultAllocator,
+    containers::DebugAllocatorTags::kJobs>::DebugAllocator<T>;
+
+#else
+template <typename T>
+using Allocator = embers::containers::DefaultAllocator<T>;
+#endif
+
+template <typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+/// Keeps data written by different threads on different cache lines
+constexpr size_t kCacheLine = 64;
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+
+#include "common.hpp"
+
+namespace embers::jobs {
+
+/// Chase-Lev work-stealing deque of a fixed capacity, with the memory
+/// orderings of Lê et al. "Correct and Efficient Work-Stealing for Weak
+/// Memory Models". A single owner pushes and pops at the bottom, any thread
+/// steals from the top. T has to be small and trivially copyable, usually a
+/// pointer
+template <typename T, u32 kCapacity>
+class Deque {
+  static_assert(
+      kCapacity != 0 && (kCapacity & (kCapacity - 1)) == 0,
+      "Capacity must be a power of two"
+  );
+
+  alignas(kCacheLine) std::atomic<i64> top_;
+  alignas(kCacheLine) std::atomic<i64> bottom_;
+  alignas(kCacheLine) std::atomic<T> items_[kCapacity];
+
+ public:
+  Deque();
+  Deque(const Deque &other) = delete;
+  Deque(Deque &&other)      = delete;
+
+  Deque &operator=(const Deque &rhs) = delete;
+  Deque &operator=(Deque &&rhs)      = delete;
+
+  /// Owner only, returns false when the deque is full
+  bool push(T item);
+  /// Owner only, takes the most recently pushed item
+  bool pop(T &item);
+  /// Any thread, takes the oldest item. Fails when empty or when another
+  /// thread took the item first
+  bool steal(T &item);
+
+  /// Approximate when other threads use the deque
+  EMBERS_ALWAYS_INLINE u32 size() const;
+};
+
+}  // namespace embers::jobs
+
+// implementation
+
+namespace embers::jobs {
+
+template <typename T, u32 kCapacity>
+Deque<T, kCapacity>::Deque() : top_(0), bottom_(0), items_() {}
+
+template <typename T, u32 kCapacity>
+bool Deque<T, kCapacity>::push(T item) {
+  i64 bottom = bottom_.load(std::memory_order_relaxed);
+  i64 top    = top_.load(std::memory_order_acquire);
+  if (bottom - top >= (i64)kCapacity) {
+    return false;
+  }
+  items_[bottom & (kCapacity - 1)].store(item, std::memory_order_relaxed);
+  // release so a thief that sees the new bottom also sees what the item
+  // points to
+  bottom_.store(bottom + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T, u32 kCapacity>
+bool Deque<T, kCapacity>::pop(T &item) {
+  i64 bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  i64 top = top_.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  item = items_[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (top < bottom) {
+    return true;
+  }
+  // last item, race the thieves for it
+  bool won = top_.compare_exchange_strong(
+      top,
+      top + 1,
+      std::memory_order_seq_cst,
+      std::memory_order_relaxed
+  );
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+  return won;
+}
+
+template <typename T, u32 kCapacity>
+bool Deque<T, kCapacity>::steal(T &item) {
+  i64 top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  i64 bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+  item = items_[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+  return top_.compare_exchange_strong(
+      top,
+      top + 1,
+      std::memory_order_seq_cst,
+      std::memory_order_relaxed
+  );
+}
+
+template <typename T, u32 kCapacity>
+EMBERS_ALWAYS_INLINE u32 Deque<T, kCapacity>::size() const {
+  i64 bottom = bottom_.load(std::memory_order_relaxed);
+  i64 top    = top_.load(std::memory_order_relaxed);
+  return bottom > top ? (u32)(bottom - top) : 0;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
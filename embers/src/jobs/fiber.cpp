@@ -0,0 +1,286 @@
+#include "fiber.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <embers/logger.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(EMBERS_FIBER_ASAN)
+#include <sanitizer/asan_interface.h>
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#if defined(EMBERS_FIBER_ASSEMBLY)
+// System V x86-64: the callee saved registers and the floating point control
+// words are pushed on the stack of `from`, the stack pointer is swapped and
+// the ones of `to` are popped. A new fiber "returns" into the trampoline,
+// which calls r13(r12)
+extern "C" void embers_fiber_switch(void **from, void *to);
+extern "C" void embers_fiber_trampoline();
+
+asm(R"(
+  .text
+  .globl embers_fiber_switch
+  .hidden embers_fiber_switch
+  .type embers_fiber_switch, @function
+embers_fiber_switch:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size embers_fiber_switch, .-embers_fiber_switch
+
+  .globl embers_fiber_trampoline
+  .hidden embers_fiber_trampoline
+  .type embers_fiber_trampoline, @function
+embers_fiber_trampoline:
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .size embers_fiber_trampoline, .-embers_fiber_trampoline
+)");
+#endif
+
+namespace embers::jobs {
+
+void *Fiber::local() const { return local_; }
+
+void Fiber::set_local(void *local) {
+  local_ = local;
+  return;
+}
+
+#if !defined(_WIN32)
+static size_t page_size() {
+  static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+  return size;
+}
+#endif
+
+void Fiber::start(Fiber *fiber) {
+#if defined(EMBERS_FIBER_ASAN)
+  finish_switch(*fiber, nullptr);
+#endif
+  fiber->entry_(fiber->argument_);
+  EMBERS_FATAL("Fiber entry {} returned", (void *)fiber);
+  std::abort();
+}
+
+#if defined(_WIN32)
+
+void __stdcall Fiber::start_windows(void *fiber) { start((Fiber *)fiber); }
+
+Fiber::Fiber()
+    : entry_(nullptr),
+      argument_(nullptr),
+      local_(nullptr),
+      handle_(nullptr),
+      converted_(false) {
+  if (IsThreadAFiber()) {
+    handle_ = GetCurrentFiber();
+  } else {
+    handle_    = ConvertThreadToFiber(nullptr);
+    converted_ = true;
+  }
+}
+
+Fiber::Fiber(size_t stack_size, Entry entry, void *argument)
+    : entry_(entry), argument_(argument), local_(nullptr), converted_(false) {
+  handle_ = CreateFiber(stack_size, &start_windows, this);
+  if (handle_ == nullptr) {
+    EMBERS_ERROR("Unable to create a fiber: {}", GetLastError());
+  }
+}
+
+Fiber::~Fiber() {
+  if (converted_) {
+    ConvertFiberToThread();
+  } else if (entry_ != nullptr && handle_ != nullptr) {
+    DeleteFiber(handle_);
+  }
+  return;
+}
+
+Fiber::operator bool() const { return handle_ != nullptr; }
+
+void Fiber::switch_to(Fiber &, Fiber &to) {
+  SwitchToFiber(to.handle_);
+  return;
+}
+
+#else
+
+Fiber::Fiber()
+    : entry_(nullptr),
+      argument_(nullptr),
+      local_(nullptr),
+      stack_(nullptr),
+      stack_size_(0) {
+#if defined(EMBERS_FIBER_ASAN)
+  asan_bottom_ = nullptr;
+  asan_size_   = 0;
+  asan_from_   = nullptr;
+#endif
+}
+
+Fiber::Fiber(size_t stack_size, Entry entry, void *argument)
+    : entry_(entry),
+      argument_(argument),
+      local_(nullptr),
+      stack_(nullptr),
+      stack_size_(0) {
+#if defined(EMBERS_FIBER_ASAN)
+  asan_bottom_ = nullptr;
+  asan_size_   = 0;
+  asan_from_   = nullptr;
+#endif
+  // rounded to pages, plus the guard page catching overflows
+  size_t page = page_size();
+  stack_size  = (stack_size + page - 1) / page * page + page;
+  void *stack = mmap(
+      nullptr,
+      stack_size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0
+  );
+  if (stack == MAP_FAILED) {
+    EMBERS_ERROR("Unable to allocate a fiber stack of {} bytes", stack_size);
+    return;
+  }
+  mprotect(stack, page, PROT_NONE);
+  stack_      = (u8 *)stack;
+  stack_size_ = stack_size;
+#if defined(EMBERS_FIBER_ASAN)
+  asan_bottom_ = stack_ + page;
+  asan_size_   = stack_size_ - page;
+#endif
+
+#if defined(EMBERS_FIBER_ASSEMBLY)
+  // frame popped by the first switch: control words, r15, r14, r13, r12,
+  // rbx, rbp and the return address. The trampoline is entered with a 16
+  // byte aligned stack, as the call it makes requires
+  uintptr_t top        = ((uintptr_t)stack_ + stack_size_) & ~(uintptr_t)15;
+  void    **frame      = (void **)(top - 8 * 8);
+  u32       control[2] = {0x1f80, 0x037f};  // default MXCSR and x87 words
+  memcpy(&frame[0], control, sizeof(control));
+  frame[1]       = nullptr;
+  frame[2]       = nullptr;
+  frame[3]       = (void *)&start;
+  frame[4]       = this;
+  frame[5]       = nullptr;
+  frame[6]       = nullptr;
+  frame[7]       = (void *)&embers_fiber_trampoline;
+  stack_pointer_ = frame;
+#else
+  getcontext(&context_);
+  context_.uc_stack.ss_sp   = stack_ + page;
+  context_.uc_stack.ss_size = stack_size_ - page;
+  context_.uc_link          = nullptr;
+  // makecontext only passes ints
+  makecontext(
+      &context_,
+      (void (*)())&start_context,
+      2,
+      (u32)((uintptr_t)this >> 32),
+      (u32)(uintptr_t)this
+  );
+#endif
+}
+
+Fiber::~Fiber() {
+  if (stack_ != nullptr) {
+#if defined(EMBERS_FIBER_ASAN)
+    // frames left on the stack keep their red zones poisoned, the next
+    // mapping at this address would inherit them
+    size_t page = page_size();
+    ASAN_UNPOISON_MEMORY_REGION(stack_ + page, stack_size_ - page);
+#endif
+    munmap(stack_, stack_size_);
+  }
+  return;
+}
+
+Fiber::operator bool() const { return entry_ == nullptr || stack_ != nullptr; }
+
+#if defined(EMBERS_FIBER_ASAN)
+
+void Fiber::finish_switch(Fiber &fiber, void *fake_stack) {
+  const void *bottom;
+  size_t      size;
+  __sanitizer_finish_switch_fiber(fake_stack, &bottom, &size);
+  Fiber *from = fiber.asan_from_;
+  if (from != nullptr && from->stack_ == nullptr) {
+    from->asan_bottom_ = bottom;
+    from->asan_size_   = size;
+  }
+  return;
+}
+
+#endif
+
+#if defined(EMBERS_FIBER_ASSEMBLY)
+
+void Fiber::switch_to(Fiber &from, Fiber &to) {
+#if defined(EMBERS_FIBER_ASAN)
+  // without it, ASan takes the other stack for a huge frame of this one
+  void *fake_stack = nullptr;
+  to.asan_from_    = &from;
+  __sanitizer_start_switch_fiber(&fake_stack, to.asan_bottom_, to.asan_size_);
+#endif
+  embers_fiber_switch(&from.stack_pointer_, to.stack_pointer_);
+#if defined(EMBERS_FIBER_ASAN)
+  finish_switch(from, fake_stack);
+#endif
+  return;
+}
+
+#else
+
+void Fiber::start_context(u32 high, u32 low) {
+  start((Fiber *)((uintptr_t)high << 32 | low));
+}
+
+void Fiber::switch_to(Fiber &from, Fiber &to) {
+#if defined(EMBERS_FIBER_ASAN)
+  void *fake_stack = nullptr;
+  to.asan_from_    = &from;
+  __sanitizer_start_switch_fiber(&fake_stack, to.asan_bottom_, to.asan_size_);
+#endif
+  swapcontext(&from.context_, &to.context_);
+#if defined(EMBERS_FIBER_ASAN)
+  finish_switch(from, fake_stack);
+#endif
+  return;
+}
+
+#endif
+#endif
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <embers/defines.hpp>
+
+#if defined(__x86_64__) && defined(__ELF__)
+#define EMBERS_FIBER_ASSEMBLY
+#elif !defined(_WIN32)
+#include <ucontext.h>
+#endif
+
+#if !defined(_WIN32)
+#if defined(__SANITIZE_ADDRESS__)
+#define EMBERS_FIBER_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define EMBERS_FIBER_ASAN
+#endif
+#endif
+#endif
+
+namespace embers::jobs {
+
+/// Cooperative execution context with a stack of its own. A switch saves the
+/// callee saved registers of the current context and restores those of the
+/// next one (hand written on x86-64, Windows fibers or ucontext elsewhere):
+/// nanoseconds, where a switch between OS threads goes through the kernel
+class Fiber {
+ public:
+  using Entry = void (*)(void *argument);
+
+ private:
+  Entry entry_;
+  void *argument_;
+  void *local_;
+#if defined(_WIN32)
+  void *handle_;
+  b8    converted_;  // the thread was turned into a fiber by this one
+#else
+  u8    *stack_;  // starts with a guard page
+  size_t stack_size_;
+#if defined(EMBERS_FIBER_ASSEMBLY)
+  void *stack_pointer_;
+#else
+  ucontext_t context_;
+#endif
+#if defined(EMBERS_FIBER_ASAN)
+  // stack told to AddressSanitizer on switches, the one of a thread is
+  // learned when it first switches away
+  const void *asan_bottom_;
+  size_t      asan_size_;
+  Fiber      *asan_from_;  // switched from, to fill in its stack
+#endif
+#endif
+
+  static void start(Fiber *fiber);
+#if defined(EMBERS_FIBER_ASAN)
+  /// Completes a switch to `fiber`, `fake_stack` is the one it left with
+  static void finish_switch(Fiber &fiber, void *fake_stack);
+#endif
+#if defined(_WIN32)
+  static void __stdcall start_windows(void *fiber);
+#elif !defined(EMBERS_FIBER_ASSEMBLY)
+  static void start_context(u32 high, u32 low);
+#endif
+
+ public:
+  /// The calling thread, to switch back to it
+  Fiber();
+  /// Runs `entry(argument)` the first time it is switched to, entry must
+  /// never return
+  Fiber(size_t stack_size, Entry entry, void *argument);
+  Fiber(const Fiber &other) = delete;
+  Fiber(Fiber &&other)      = delete;
+  ~Fiber();
+
+  Fiber &operator=(const Fiber &rhs) = delete;
+  Fiber &operator=(Fiber &&rhs)      = delete;
+
+  /// False when the stack couldn't be allocated
+  explicit operator bool() const;
+
+  /// Free for the code running on the fiber, follows it from thread to
+  /// thread
+  void *local() const;
+  void  set_local(void *local);
+
+  /// Saves the running context into `from` and continues `to`, returns once
+  /// something switches back to `from`
+  static void switch_to(Fiber &from, Fiber &to);
+};
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "frame_graph.hpp"
+
+#include <algorithm>
+#include <embers/logger.hpp>
+#include <thread>
+
+namespace embers::jobs {
+
+FrameGraph::FrameGraph(System &jobs, u32 frames_in_flight)
+    : jobs_(&jobs),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      built_(false),
+      slots_(new Slot[frames_in_flight_]),
+      next_frame_(0),
+      completed_(0),
+      stop_(false),
+      frame_timing_(),
+      interval_() {
+  for (u32 slot = 0; slot < frames_in_flight_; ++slot) {
+    slots_[slot].stages_left.store(0, std::memory_order_relaxed);
+    slots_[slot].finished = false;
+  }
+}
+
+FrameGraph::~FrameGraph() = default;
+
+StageId FrameGraph::add_stage(Stage *stage) {
+  stages_.emplace_back(stage);
+  dependents_.emplace_back();
+  dependencies_.push_back(0);
+  timings_.push_back({});
+  return (StageId)stages_.size() - 1;
+}
+
+void FrameGraph::add_dependency(StageId before, StageId after) {
+  dependents_[before].push_back(after);
+  dependencies_[after]++;
+  return;
+}
+
+void FrameGraph::build() {
+  u32 count = stage_count();
+
+  // Kahn's algorithm, only looking for cycles
+  Vector<u32>     incoming(dependencies_);
+  Vector<StageId> ready;
+  u32             sorted = 0;
+  for (StageId stage = 0; stage < count; ++stage) {
+    if (incoming[stage] == 0) {
+      ready.push_back(stage);
+    }
+  }
+  while (!ready.empty()) {
+    StageId stage = ready.back();
+    ready.pop_back();
+    sorted++;
+    for (StageId dependent : dependents_[stage]) {
+      if (--incoming[dependent] == 0) {
+        ready.push_back(dependent);
+      }
+    }
+  }
+  if (sorted != count) {
+    EMBERS_ERROR(
+        "Frame stage dependencies have a cycle, {} stages run one after the "
+        "other in registration order",
+        count
+    );
+    for (StageId stage = 0; stage < count; ++stage) {
+      dependents_[stage].clear();
+      dependencies_[stage] = stage == 0 ? 0 : 1;
+      if (stage + 1 < count) {
+        dependents_[stage].push_back(stage + 1);
+      }
+    }
+  }
+
+  // nothing precedes the first frame
+  pending_.reset(new std::atomic<u32>[frames_in_flight_ * count]);
+  for (u32 i = 0; i < frames_in_flight_; ++i) {
+    u64 frame = next_frame_ + i;
+    for (StageId stage = 0; stage < count; ++stage) {
+      pending(frame, stage).store(
+          dependencies_[stage] + (i == 0 ? 1 : 2),
+          std::memory_order_relaxed
+      );
+    }
+  }
+  built_ = true;
+  return;
+}
+
+void FrameGraph::run(u64 frame_count) {
+  if (stages_.empty() || frame_count == 0) {
+    return;
+  }
+  if (!built_) {
+    build();
+  }
+  u64 end = next_frame_ + std::min(frame_count, u64_MAX - next_frame_);
+  stop_.store(false, std::memory_order_relaxed);
+
+  while (true) {
+    u64 completed = completed_.load(std::memory_order_acquire);
+    while (next_frame_ < end && next_frame_ < completed + frames_in_flight_ &&
+           !stop_.load(std::memory_order_relaxed)) {
+      begin(next_frame_++);
+    }
+    if (completed == next_frame_ &&
+        (next_frame_ == end || stop_.load(std::memory_order_relaxed))) {
+      break;
+    }
+    if (!run_main() && !jobs_->help()) {
+      std::this_thread::yield();
+    }
+  }
+  // the last jobs may still be returning
+  jobs_->wait(running_);
+  return;
+}
+
+void FrameGraph::stop() {
+  stop_.store(true, std::memory_order_relaxed);
+  return;
+}
+
+void FrameGraph::begin(u64 frame) {
+  Slot &slot = slots_[frame % frames_in_flight_];
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.begin = Clock::now();
+    slot.stages_left.store(stage_count(), std::memory_order_relaxed);
+  }
+  for (StageId stage = 0; stage < stage_count(); ++stage) {
+    release(stage, frame);
+  }
+  return;
+}
+
+void FrameGraph::release(StageId stage, u64 frame) {
+  if (pending(frame, stage).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    dispatch(stage, frame);
+  }
+  return;
+}
+
+void FrameGraph::dispatch(StageId stage, u64 frame) {
+  if (stages_[stage]->main_thread) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    main_ready_.push_back({stage, frame});
+    return;
+  }
+  jobs_->run([this, stage, frame] { execute(stage, frame); }, &running_);
+  return;
+}
+
+bool FrameGraph::run_main() {
+  Ready ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (main_ready_.empty()) {
+      return false;
+    }
+    // oldest frame first
+    auto oldest = std::min_element(
+        main_ready_.begin(),
+        main_ready_.end(),
+        [](const Ready &a, const Ready &b) { return a.frame < b.frame; }
+    );
+    ready   = *oldest;
+    *oldest = main_ready_.back();
+    main_ready_.pop_back();
+  }
+  execute(ready.stage, ready.frame);
+  return true;
+}
+
+void FrameGraph::execute(StageId stage, u64 frame) {
+  Clock::time_point start = Clock::now();
+  stages_[stage]->run(frame, (u32)(frame % frames_in_flight_));
+  // instances of a stage never overlap, the next one waits on this one
+  record(
+      timings_[stage],
+      std::chrono::duration<f64>(Clock::now() - start).count()
+  );
+
+  // the instance of frame + frames_in_flight can't be released before this
+  // frame is done, its counter is free again
+  pending(frame, stage).store(
+      dependencies_[stage] + 2,
+      std::memory_order_relaxed
+  );
+  release(stage, frame + 1);
+  for (StageId dependent : dependents_[stage]) {
+    release(dependent, frame);
+  }
+  Slot &slot = slots_[frame % frames_in_flight_];
+  if (slot.stages_left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    finish(frame);
+  }
+  return;
+}
+
+void FrameGraph::finish(u64 frame) {
+  Clock::time_point           end = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Slot &slot = slots_[frame % frames_in_flight_];
+  record(frame_timing_, std::chrono::duration<f64>(end - slot.begin).count());
+  if (last_end_ != Clock::time_point() && end > last_end_) {
+    record(interval_, std::chrono::duration<f64>(end - last_end_).count());
+  }
+  last_end_ = std::max(last_end_, end);
+
+  // a frame is done once all of its stages are, but its finish() may come
+  // after the one of the next frame: completed_ only counts whole prefixes
+  slot.finished = true;
+  u64 completed = completed_.load(std::memory_order_relaxed);
+  while (slots_[completed % frames_in_flight_].finished) {
+    slots_[completed % frames_in_flight_].finished = false;
+    completed++;
+  }
+  completed_.store(completed, std::memory_order_release);
+  return;
+}
+
+void FrameGraph::record(Timing &timing, f64 seconds) {
+  timing.last   = seconds;
+  timing.max    = std::max(timing.max, seconds);
+  timing.total += seconds;
+  timing.count++;
+  return;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
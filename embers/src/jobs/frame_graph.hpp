@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "common.hpp"
+#include "jobs.hpp"
+
+namespace embers::jobs {
+
+using StageId = u32;
+
+/// Durations in seconds, of a stage or of whole frames, over the frames run
+struct Timing {
+  f64 last;
+  f64 max;
+  f64 total;
+  u64 count;
+
+  constexpr f64 average() const;
+};
+
+/// Main loop where every frame is a DAG of CPU stages (input, simulation,
+/// culling, recording, submission, present) run as jobs. Frames overlap: a
+/// stage starts once the stages it depends on are done in its frame and
+/// the same stage is done in the previous frame, so frame N + 1 simulates
+/// while frame N records and submits. At most frames_in_flight frames run
+/// at once, `frame % frames_in_flight` is the slot of per frame resources.
+///
+/// Stages added with add_on_main() run on the thread calling run() (window
+/// events, presentation), the others on any thread of the jobs::System.
+/// Stages are added before the first run(), timings are read once run()
+/// returned
+class FrameGraph {
+  using Clock = std::chrono::steady_clock;
+
+  class Stage {
+   public:
+    const char *name;
+    b8          main_thread;
+
+    Stage(const char *name, b8 main_thread)
+        : name(name), main_thread(main_thread) {}
+    virtual ~Stage() = default;
+
+    virtual void run(u64 frame, u32 slot) = 0;
+  };
+
+  template <typename F>
+  class FunctionStage;
+
+  struct Ready {
+    StageId stage;
+    u64     frame;
+  };
+
+  struct Slot {
+    Clock::time_point begin;
+    std::atomic<u32>  stages_left;
+    b8                finished;  // not counted in completed_ yet
+  };
+
+  System                        *jobs_;
+  u32                            frames_in_flight_;
+  Vector<std::unique_ptr<Stage>> stages_;
+  Vector<Vector<StageId>>        dependents_;
+  Vector<u32>                    dependencies_;  // within a frame
+  b8                             built_;
+
+  // stage instances: dependencies within the frame, the previous frame and
+  // the start of the frame, by slot then stage
+  std::unique_ptr<std::atomic<u32>[]> pending_;
+  std::unique_ptr<Slot[]>             slots_;
+
+  u64              next_frame_;
+  std::atomic<u64> completed_;  // frames done, in order
+  std::atomic<b8>  stop_;
+  Counter          running_;
+
+  std::mutex        mutex_;  // frames beginning and ending, main_ready_
+  Vector<Ready>     main_ready_;
+  Vector<Timing>    timings_;
+  Timing            frame_timing_;
+  Timing            interval_;
+  Clock::time_point last_end_;
+
+  StageId add_stage(Stage *stage);
+  void    build();
+
+  EMBERS_ALWAYS_INLINE std::atomic<u32> &pending(u64 frame, StageId stage);
+
+  void begin(u64 frame);
+  /// One dependency less for the stage, dispatches it on the last one
+  void release(StageId stage, u64 frame);
+  void dispatch(StageId stage, u64 frame);
+  void execute(StageId stage, u64 frame);
+  void finish(u64 frame);
+  /// Runs a ready main thread stage, false when there is none
+  bool run_main();
+
+  static void record(Timing &timing, f64 seconds);
+
+ public:
+  FrameGraph() = delete;
+  explicit FrameGraph(System &jobs, u32 frames_in_flight = 2);
+  FrameGraph(const FrameGraph &other) = delete;
+  FrameGraph(FrameGraph &&other)      = delete;
+  ~FrameGraph();
+
+  FrameGraph &operator=(const FrameGraph &rhs) = delete;
+  FrameGraph &operator=(FrameGraph &&rhs)      = delete;
+
+  /// `f(frame, slot)`, on any thread
+  template <typename F>
+  StageId add(const char *name, F &&f);
+  /// `f(frame, slot)`, on the thread calling run()
+  template <typename F>
+  StageId add_on_main(const char *name, F &&f);
+
+  /// `after` doesn't start before `before` is done in the same frame
+  void add_dependency(StageId before, StageId after);
+
+  /// Runs `frame_count` frames or until stop(), returns when the frames in
+  /// flight are done. The calling thread runs main thread stages and jobs
+  void run(u64 frame_count = u64_MAX);
+  /// No more frames begin, from any thread
+  void stop();
+
+  /// Number of the next frame to begin
+  EMBERS_ALWAYS_INLINE u64 frame() const;
+  EMBERS_ALWAYS_INLINE u32 frames_in_flight() const;
+
+  EMBERS_ALWAYS_INLINE const char   *name(StageId stage) const;
+  EMBERS_ALWAYS_INLINE u32           stage_count() const;
+  EMBERS_ALWAYS_INLINE const Timing &timing(StageId stage) const;
+  /// From the beginning of frames to their last stage
+  EMBERS_ALWAYS_INLINE const Timing &frame_timing() const;
+  /// Between the ends of consecutive frames
+  EMBERS_ALWAYS_INLINE const Timing &interval() const;
+};
+
+}  // namespace embers::jobs
+
+// implementation
+
+namespace embers::jobs {
+
+constexpr f64 Timing::average() const {
+  return count == 0 ? 0 : total / (f64)count;
+}
+
+template <typename F>
+class FrameGraph::FunctionStage : public FrameGraph::Stage {
+  F f_;
+
+ public:
+  template <typename G>
+  FunctionStage(const char *name, b8 main_thread, G &&f)
+      : Stage(name, main_thread), f_(std::forward<G>(f)) {}
+
+  void run(u64 frame, u32 slot) override { f_(frame, slot); }
+};
+
+template <typename F>
+StageId FrameGraph::add(const char *name, F &&f) {
+  using Stage = FunctionStage<std::decay_t<F>>;
+  return add_stage(new Stage(name, false, std::forward<F>(f)));
+}
+
+template <typename F>
+StageId FrameGraph::add_on_main(const char *name, F &&f) {
+  using Stage = FunctionStage<std::decay_t<F>>;
+  return add_stage(new Stage(name, true, std::forward<F>(f)));
+}
+
+EMBERS_ALWAYS_INLINE std::atomic<u32> &FrameGraph::pending(
+    u64 frame, StageId stage
+) {
+  return pending_[(frame % frames_in_flight_) * stages_.size() + stage];
+}
+
+EMBERS_ALWAYS_INLINE u64 FrameGraph::frame() const { return next_frame_; }
+
+EMBERS_ALWAYS_INLINE u32 FrameGraph::frames_in_flight() const {
+  return frames_in_flight_;
+}
+
+EMBERS_ALWAYS_INLINE const char *FrameGraph::name(StageId stage) const {
+  return stages_[stage]->name;
+}
+
+EMBERS_ALWAYS_INLINE u32 FrameGraph::stage_count() const {
+  return (u32)stages_.size();
+}
+
+EMBERS_ALWAYS_INLINE const Timing &FrameGraph::timing(StageId stage) const {
+  return timings_[stage];
+}
+
+EMBERS_ALWAYS_INLINE const Timing &FrameGraph::frame_timing() const {
+  return frame_timing_;
+}
+
+EMBERS_ALWAYS_INLINE const Timing &FrameGraph::interval() const {
+  return interval_;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
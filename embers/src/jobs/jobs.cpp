@@ -0,0 +1,451 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <embers/logger.hpp>
+
+namespace embers::jobs {
+
+// rounds of stealing before an idle worker goes to sleep
+constexpr u32 kSpinsBeforeSleep = 64;
+
+struct ThreadState {
+  const System  *system;
+  u32            index;
+  u32            random;
+  Fiber         *fiber;  // pooled fiber running on this thread, if any
+  void          *local;  // job_local() when not on a fiber
+  // switch in progress, completed by after_switch() on the next fiber
+  Fiber         *release;
+  Fiber         *park;
+  const Counter *park_counter;
+};
+
+static thread_local ThreadState thread_state = {};
+
+// Fibers move between threads: the address of the thread locals must not be
+// kept across a switch, which the compiler may do with an inlined access
+static EMBERS_NEVER_INLINE ThreadState &current() {
+#if !defined(_MSC_VER)
+  asm volatile("" ::: "memory");
+#endif
+  return thread_state;
+}
+
+// xorshift, picks the first victim to steal from
+static u32 next_random(ThreadState &state) {
+  if (state.random == 0) {
+    state.random = 0x9e3779b9u ^ (u32)(uintptr_t)&state;
+  }
+  state.random ^= state.random << 13;
+  state.random ^= state.random >> 17;
+  state.random ^= state.random << 5;
+  return state.random;
+}
+
+Counter::Counter() : pending_(0) {}
+
+System::System(u32 worker_count)
+    : worker_count_(worker_count),
+      parked_count_(0),
+      sleeping_(0),
+      epoch_(0),
+      waking_(false),
+      stop_(false) {
+  if (worker_count_ == 0) {
+    u32 hardware  = std::thread::hardware_concurrency();
+    worker_count_ = hardware > 1 ? hardware - 1 : 1;
+  }
+  workers_.reset(new Worker[worker_count_ + 1]);
+  for (u32 i = 0; i <= worker_count_; ++i) {
+    workers_[i].cpu              = u32_MAX;
+    workers_[i].neighbours_first = 0;
+    workers_[i].neighbours_count = worker_count_ + 1;
+  }
+  start();
+}
+
+System::System(const Placement &placement)
+    : worker_count_(std::max((u32)placement.workers.size(), 1u)),
+      parked_count_(0),
+      sleeping_(0),
+      epoch_(0),
+      waking_(false),
+      stop_(false) {
+  workers_.reset(new Worker[worker_count_ + 1]);
+  workers_[0].cpu              = u32_MAX;
+  workers_[0].neighbours_first = 0;
+  workers_[0].neighbours_count = worker_count_ + 1;
+  for (u32 i = 1; i <= worker_count_; ++i) {
+    workers_[i].cpu              = u32_MAX;
+    workers_[i].neighbours_first = 1;
+    workers_[i].neighbours_count = worker_count_;
+  }
+  // workers come grouped by cache domain
+  u32 first = 1;
+  for (u32 i = 1; i <= placement.workers.size(); ++i) {
+    workers_[i].cpu = placement.workers[i - 1].id;
+    if (i == placement.workers.size() ||
+        placement.workers[i].cache != placement.workers[i - 1].cache) {
+      for (u32 j = first; j <= i; ++j) {
+        workers_[j].neighbours_first = first;
+        workers_[j].neighbours_count = i + 1 - first;
+      }
+      first = i + 1;
+    }
+  }
+  start();
+}
+
+void System::start() {
+  for (u32 i = 0; i <= worker_count_; ++i) {
+    workers_[i].jobs.reset(new Job[kJobsPerThread]());
+    workers_[i].next_job = 0;
+    workers_[i].native   = nullptr;
+  }
+
+  u32 fiber_count = worker_count_ * kFibersPerWorker;
+  fibers_.reserve(fiber_count);
+  free_fibers_.reserve(fiber_count);
+  parked_.reserve(fiber_count);
+  for (u32 i = 0; i < fiber_count; ++i) {
+    fibers_.emplace_back(new Fiber(kFiberStackSize, &loop, this));
+    if ((bool)*fibers_.back()) {
+      free_fibers_.push_back(fibers_.back().get());
+    }
+  }
+  if (free_fibers_.size() < worker_count_) {
+    EMBERS_FATAL("Unable to allocate fibers for {} workers", worker_count_);
+  }
+
+  for (u32 i = 1; i <= worker_count_; ++i) {
+    workers_[i].thread = std::thread([this, i] {
+      if (workers_[i].cpu != u32_MAX) {
+        pin_thread(CpuSet(1, workers_[i].cpu));
+      }
+      ThreadState &state = current();
+      state.system       = this;
+      state.index        = i;
+      state.fiber        = take_fiber();
+
+      Fiber native;
+      workers_[i].native = &native;
+      Fiber::switch_to(native, *state.fiber);
+      // back once the loop saw stop_
+    });
+  }
+  return;
+}
+
+System::~System() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    epoch_++;
+  }
+  wake_.notify_all();
+  for (u32 i = 1; i <= worker_count_; ++i) {
+    workers_[i].thread.join();
+  }
+  return;
+}
+
+u32 System::index() const {
+  const ThreadState &state = current();
+  return state.system == this ? state.index : 0;
+}
+
+System::Job *System::allocate(
+    u32 &index, std::unique_lock<std::mutex> &lock
+) {
+  while (true) {
+    // read again after help(), the ring of another thread isn't ours to take
+    // from
+    index          = this->index();
+    Worker &worker = workers_[index];
+    if (index == 0) {
+      lock = std::unique_lock<std::mutex>(worker.mutex);
+    }
+    // jobs finish out of order, unfinished ones (maybe parked or waiting
+    // further up the stack) are skipped
+    for (u32 i = 0; i < kJobsPerThread; ++i) {
+      Job *job = &worker.jobs[worker.next_job++ & (kJobsPerThread - 1)];
+      if (!job->busy.load(std::memory_order_acquire)) {
+        job->busy.store(true, std::memory_order_relaxed);
+        return job;
+      }
+    }
+    // every job of the ring is running or queued
+    if (lock.owns_lock()) {
+      lock.unlock();
+    }
+    if (!help()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void System::push(Worker &worker, Job *job) {
+  // the ring and the deque have the same size and the job is free, so the
+  // deque can't be full
+  bool pushed = worker.deque.push(job);
+  if (!pushed) {
+    EMBERS_FATAL("Job deque overflow, {} jobs", worker.deque.size());
+  }
+  wake();
+  return;
+}
+
+void System::wake() {
+  // pairs with the fence of a worker going to sleep: either it finds the
+  // work or the work finds it sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  {
+    // a woken worker that didn't run yet will find the work as well
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (waking_) {
+      return;
+    }
+    waking_ = true;
+    epoch_++;
+  }
+  wake_.notify_one();
+  return;
+}
+
+bool System::find(u32 index, Job *&job) {
+  Worker &own = workers_[index];
+  if (index == 0) {
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.deque.pop(job)) {
+      return true;
+    }
+  } else if (own.deque.pop(job)) {
+    return true;
+  }
+
+  // neighbours first, what they work on may still be in the shared cache
+  u32 count = worker_count_ + 1;
+  if (own.neighbours_count < count &&
+      steal(index, own.neighbours_first, own.neighbours_count, job)) {
+    return true;
+  }
+  return steal(index, 0, count, job);
+}
+
+bool System::steal(u32 index, u32 first, u32 count, Job *&job) {
+  u32 victim = next_random(current()) % count;
+  for (u32 i = 0; i < count; ++i) {
+    if (first + victim != index && workers_[first + victim].deque.steal(job)) {
+      return true;
+    }
+    victim = victim + 1 == count ? 0 : victim + 1;
+  }
+  return false;
+}
+
+void System::execute(Job *job) {
+  job->function(job->storage);
+  Counter *counter = job->counter;
+  job->busy.store(false, std::memory_order_release);
+  if (counter != nullptr) {
+    release(*counter);
+  }
+  return;
+}
+
+void System::hold(Counter &counter) {
+  counter.pending_.fetch_add(1, std::memory_order_relaxed);
+  return;
+}
+
+void System::release(Counter &counter) {
+  if (counter.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+      parked_count_.load(std::memory_order_relaxed) != 0) {
+    // a parked job may wait on it
+    wake();
+  }
+  return;
+}
+
+bool System::help() {
+  Job *job;
+  if (!find(index(), job)) {
+    return false;
+  }
+  execute(job);
+  return true;
+}
+
+void System::wait(const Counter &counter) {
+  if (counter.done()) {
+    return;
+  }
+  ThreadState &state = current();
+  Fiber       *next  = nullptr;
+  if (state.system == this && state.fiber != nullptr) {
+    next = take_fiber();
+  }
+
+  if (next != nullptr) {
+    // parked by after_switch(), once nothing runs on this fiber anymore
+    state.park         = state.fiber;
+    state.park_counter = &counter;
+    switch_to(*next);
+    return;
+  }
+  while (!counter.done()) {
+    if (!help()) {
+      std::this_thread::yield();
+    }
+  }
+  return;
+}
+
+void System::loop(void *system) {
+  System *self = (System *)system;
+  self->after_switch();
+  self->work();
+  return;
+}
+
+void System::work() {
+  Job *job;
+  u32  idle = 0;
+  while (true) {
+    // the loop moves between threads along with its fiber
+    u32 index = current().index;
+
+    Fiber *resumable = take_resumable();
+    if (resumable != nullptr) {
+      current().release = current().fiber;
+      switch_to(*resumable);
+      idle = 0;
+      continue;
+    }
+    if (find(index, job)) {
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kSpinsBeforeSleep) {
+      std::this_thread::yield();
+      continue;
+    }
+    idle = 0;
+
+    u64 epoch;
+    b8  stop;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop  = stop_;
+      epoch = epoch_;
+    }
+    if (stop) {
+      break;
+    }
+    sleeping_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    resumable = take_resumable();
+    if (resumable != nullptr) {
+      sleeping_.fetch_sub(1, std::memory_order_relaxed);
+      current().release = current().fiber;
+      switch_to(*resumable);
+      continue;
+    }
+    if (find(index, job)) {
+      sleeping_.fetch_sub(1, std::memory_order_relaxed);
+      execute(job);
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // a wake pending since before the epoch was read can't be for this one
+      waking_ = false;
+      wake_.wait(lock, [this, epoch] { return epoch_ != epoch; });
+      waking_ = false;
+    }
+    sleeping_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // the thread goes back to its own stack and exits
+  ThreadState &state = current();
+  Fiber::switch_to(*state.fiber, *workers_[state.index].native);
+  return;
+}
+
+Fiber *System::take_fiber() {
+  std::lock_guard<std::mutex> lock(fibers_mutex_);
+  if (free_fibers_.empty()) {
+    return nullptr;
+  }
+  Fiber *fiber = free_fibers_.back();
+  free_fibers_.pop_back();
+  return fiber;
+}
+
+Fiber *System::take_resumable() {
+  if (parked_count_.load(std::memory_order_acquire) == 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(fibers_mutex_);
+  for (size_t i = 0; i < parked_.size(); ++i) {
+    if (parked_[i].counter->done()) {
+      Fiber *fiber = parked_[i].fiber;
+      parked_[i]   = parked_.back();
+      parked_.pop_back();
+      parked_count_.fetch_sub(1, std::memory_order_relaxed);
+      return fiber;
+    }
+  }
+  return nullptr;
+}
+
+void System::switch_to(Fiber &to) {
+  ThreadState &state = current();
+  Fiber       *from  = state.fiber;
+  state.fiber        = &to;
+  Fiber::switch_to(*from, to);
+  after_switch();
+  return;
+}
+
+void System::after_switch() {
+  ThreadState &state = current();
+  if (state.release == nullptr && state.park == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(fibers_mutex_);
+  if (state.release != nullptr) {
+    free_fibers_.push_back(state.release);
+    state.release = nullptr;
+  }
+  if (state.park != nullptr) {
+    parked_.push_back({state.park, state.park_counter});
+    parked_count_.fetch_add(1, std::memory_order_release);
+    state.park = nullptr;
+  }
+  return;
+}
+
+u32 System::thread_index() { return current().index; }
+
+void *System::job_local() {
+  ThreadState &state = current();
+  return state.fiber != nullptr ? state.fiber->local() : state.local;
+}
+
+void System::set_job_local(void *local) {
+  ThreadState &state = current();
+  if (state.fiber != nullptr) {
+    state.fiber->set_local(local);
+  } else {
+    state.local = local;
+  }
+  return;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
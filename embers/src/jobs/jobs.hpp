@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "common.hpp"
+#include "deque.hpp"
+#include "fiber.hpp"
+#include "topology.hpp"
+
+namespace embers::jobs {
+
+/// Number of unfinished jobs started with it, the handle to wait on. A job
+/// depending on others waits on their counter, which runs other jobs in the
+/// meantime
+class Counter {
+  friend class System;
+
+  std::atomic<u32> pending_;
+
+ public:
+  Counter();
+  Counter(const Counter &other) = delete;
+  Counter(Counter &&other)      = delete;
+
+  Counter &operator=(const Counter &rhs) = delete;
+  Counter &operator=(Counter &&rhs)      = delete;
+
+  EMBERS_ALWAYS_INLINE u32 pending() const;
+  EMBERS_ALWAYS_INLINE b8  done() const;
+};
+
+/// Work-stealing job system, one worker thread per core. Every worker owns
+/// a Chase-Lev deque: jobs it starts are pushed to the bottom and popped
+/// back in LIFO order, idle workers steal the oldest jobs from the top of
+/// the others. Threads that aren't workers share one more deque, guarded by
+/// a mutex. Workers only sleep when there is nothing left to steal.
+///
+/// Workers run on fibers from a preallocated pool. A job waiting on a
+/// Counter that isn't done parks its fiber and the worker continues on a
+/// fresh one, the parked fiber is resumed by the first worker seeing the
+/// counter done, maybe on another thread. Threads that aren't workers (or
+/// workers when the pool is empty) run pending jobs while they wait.
+///
+/// Jobs are closures of at most kJobStorage bytes, stored in a ring of
+/// kJobsPerThread preallocated jobs per thread, no allocation happens when
+/// starting them.
+///
+/// Started from a Placement, every worker is pinned to its cpu and steals
+/// from the workers sharing its last level cache before the others
+class System {
+ public:
+  constexpr static u32    kJobsPerThread   = 4096;
+  constexpr static size_t kJobStorage      = 40;
+  constexpr static u32    kFibersPerWorker = 16;
+  constexpr static size_t kFiberStackSize  = 64 * 1024;
+
+ private:
+  struct alignas(kCacheLine) Job {
+    void (*function)(void *storage);
+    Counter *counter;
+    alignas(16) u8 storage[kJobStorage];
+    std::atomic<b8> busy;
+  };
+
+  struct alignas(kCacheLine) Worker {
+    Deque<Job *, kJobsPerThread> deque;
+    std::unique_ptr<Job[]>       jobs;  // ring, indexed by next_job
+    u32                          next_job;
+    std::mutex                   mutex;  // threads sharing the deque
+    std::thread                  thread;
+    Fiber                       *native;  // context of the thread itself
+    u32                          cpu;     // pinned to it, u32_MAX for none
+    // workers sharing its last level cache, stolen from first
+    u32                          neighbours_first;
+    u32                          neighbours_count;
+  };
+
+  struct Parked {
+    Fiber         *fiber;
+    const Counter *counter;
+  };
+
+  std::unique_ptr<Worker[]> workers_;  // 0 is shared by non workers
+  u32                       worker_count_;
+
+  Vector<std::unique_ptr<Fiber>> fibers_;
+  std::mutex                     fibers_mutex_;
+  Vector<Fiber *>                free_fibers_;
+  Vector<Parked>                 parked_;
+  std::atomic<u32>               parked_count_;
+
+  std::atomic<u32>        sleeping_;
+  std::mutex              mutex_;
+  std::condition_variable wake_;
+  u64                     epoch_;   // bumped to wake sleeping workers
+  b8                      waking_;  // a worker was woken and didn't run yet
+  b8                      stop_;
+
+  template <typename F>
+  static void invoke(void *storage);
+
+  /// Creates the workers, worker_count_ and their cpus are set
+  void start();
+
+  /// Deque of the calling thread
+  u32  index() const;
+  /// The next free job of the ring of the calling thread, runs other jobs
+  /// while all are busy. Those may park the caller and resume it on another
+  /// thread: `index` is the deque of the thread it returns on, which `lock`
+  /// holds when it is the shared one
+  Job *allocate(u32 &index, std::unique_lock<std::mutex> &lock);
+  void push(Worker &worker, Job *job);
+  bool find(u32 index, Job *&job);
+  /// Steals from the workers [first, first + count) but `index`
+  bool steal(u32 index, u32 first, u32 count, Job *&job);
+  void execute(Job *job);
+  void wake();
+
+  static void loop(void *system);
+  void        work();
+  /// Fiber of the pool ready to run the loop, nullptr when all are taken
+  Fiber      *take_fiber();
+  /// Parked fiber whose counter is done
+  Fiber      *take_resumable();
+  /// Leaves the current fiber for `to`, returns when switched back to
+  void        switch_to(Fiber &to);
+  /// Finishes the switch, on the fiber that was switched to
+  void        after_switch();
+
+ public:
+  System() = delete;
+  /// worker_count of 0 picks one worker per hardware thread but one, the
+  /// thread waiting on counters works too
+  explicit System(u32 worker_count);
+  /// A worker per cpu of `placement.workers`, pinned to it
+  explicit System(const Placement &placement);
+  System(const System &other) = delete;
+  System(System &&other)      = delete;
+  ~System();
+
+  System &operator=(const System &rhs) = delete;
+  System &operator=(System &&rhs)      = delete;
+
+  /// Starts `f()` as a job, `counter` (if any) is incremented now and
+  /// decremented once the job returns
+  template <typename F>
+  void run(F &&f, Counter *counter = nullptr);
+
+  /// Returns once `counter` gets to 0. Parks the calling job when it runs
+  /// on a fiber, runs other jobs in the meantime otherwise
+  void wait(const Counter &counter);
+  /// Runs a single pending job, returns false when none could be found
+  bool help();
+
+  /// Counts work done outside of the system (I/O...) on `counter`, waiters
+  /// wait for it until release()
+  void hold(Counter &counter);
+  void release(Counter &counter);
+
+  EMBERS_ALWAYS_INLINE u32 worker_count() const;
+
+  /// Workers are numbered from 1, any other thread is 0
+  static u32 thread_index();
+  /// Pointer kept for the running job, nullptr by default. Unlike a thread
+  /// local it follows the job when it waits and resumes on another thread.
+  /// Jobs setting it put the previous one back before returning
+  static void *job_local();
+  static void  set_job_local(void *local);
+};
+
+}  // namespace embers::jobs
+
+// implementation
+
+namespace embers::jobs {
+
+EMBERS_ALWAYS_INLINE u32 Counter::pending() const {
+  return pending_.load(std::memory_order_acquire);
+}
+
+EMBERS_ALWAYS_INLINE b8 Counter::done() const { return pending() == 0; }
+
+template <typename F>
+void System::invoke(void *storage) {
+  F &f = *(F *)storage;
+  f();
+  f.~F();
+  return;
+}
+
+template <typename F>
+void System::run(F &&f, Counter *counter) {
+  using Function = std::decay_t<F>;
+  static_assert(
+      sizeof(Function) <= kJobStorage,
+      "Job closure is too big, capture a pointer to the data instead"
+  );
+  static_assert(alignof(Function) <= 16, "Job closure is over aligned");
+
+  if (counter != nullptr) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  u32                          index;
+  std::unique_lock<std::mutex> lock;
+  Job                         *job = allocate(index, lock);
+  new (job->storage) Function(std::forward<F>(f));
+  job->function = &invoke<Function>;
+  job->counter  = counter;
+  push(workers_[index], job);
+  return;
+}
+
+EMBERS_ALWAYS_INLINE u32 System::worker_count() const {
+  return worker_count_;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+#include "jobs.hpp"
+
+namespace embers::jobs {
+
+/// `f(first, last)` over the items of [0, count), in parallel on `system`.
+/// With a grain of 0 the caller times the first items itself, doubling the
+/// number it runs until the run is long enough to measure, and sizes the
+/// chunks from the measured cost per item: long enough to hide the cost of
+/// taking one, short enough to give every thread a few. Work too small to be
+/// worth spreading stays on the caller. Chunks are handed out in order from
+/// a shared cursor, to the caller and to up to worker_count() jobs
+template <typename F>
+void parallel_for(System &system, u32 count, F &&f, u32 grain = 0);
+
+/// Reduces [0, count) in blocks: `reduce(first, last, identity)` gives the
+/// value of a block, `combine(a, b)` merges two values. The blocks only
+/// depend on count (and `block` when given) and their values are combined
+/// left to right on the caller, so the result is the same for any number of
+/// threads and any timing, floating point sums included
+template <typename T, typename R, typename C>
+T parallel_reduce(
+    System &system,
+    u32     count,
+    T       identity,
+    R     &&reduce,
+    C     &&combine,
+    u32     block = 0
+);
+
+/// Stable merge sort: runs sorted in parallel then merged pairwise, every
+/// merge split between the threads along its merge path. Takes a scratch
+/// buffer as large as `values`, T has to be default constructible
+template <typename T, typename A, typename Less = std::less<T>>
+void parallel_sort(
+    System &system, std::vector<T, A> &values, Less less = Less()
+);
+
+}  // namespace embers::jobs
+
+// implementation
+
+namespace embers::jobs {
+
+namespace internal {
+
+using Clock = std::chrono::steady_clock;
+
+// the caller times at least this long before sizing the chunks
+constexpr f64 kProbeSeconds      = 5e-6;
+// a chunk costs an atomic increment, this long makes it negligible
+constexpr f64 kChunkSeconds      = 10e-6;
+constexpr u32 kChunksPerThread   = 4;
+// reductions: values per block, and the most blocks a reduction makes
+constexpr u32 kReduceBlock       = 1024;
+constexpr u32 kMaxReduceBlocks   = 4096;
+// sorts: the smallest run sorted by a single thread
+constexpr u32 kSortRun           = 4096;
+
+struct Chunks {
+  alignas(kCacheLine) std::atomic<u64> next;
+  u32 count;
+  u32 chunk;
+};
+
+template <typename F>
+void drain(Chunks &chunks, F &f) {
+  while (true) {
+    u64 first = chunks.next.fetch_add(chunks.chunk, std::memory_order_relaxed);
+    if (first >= chunks.count) {
+      return;
+    }
+    f((u32)first, (u32)std::min<u64>(first + chunks.chunk, chunks.count));
+  }
+}
+
+/// [first, count) in chunks, on the caller and on as many jobs as needed
+template <typename F>
+void run_chunks(System &system, u32 first, u32 count, u32 chunk, F &f) {
+  Chunks chunks;
+  chunks.next.store(first, std::memory_order_relaxed);
+  chunks.count = count;
+  chunks.chunk = chunk;
+
+  u32     chunk_count = (count - first + chunk - 1) / chunk;
+  u32     helpers     = std::min(chunk_count - 1, system.worker_count());
+  Counter counter;
+  for (u32 i = 0; i < helpers; ++i) {
+    system.run([&chunks, &f] { drain(chunks, f); }, &counter);
+  }
+  drain(chunks, f);
+  system.wait(counter);
+  return;
+}
+
+/// Items of `a` among the first `k` items of the stable merge of a and b
+template <typename T, typename Less>
+size_t co_rank(
+    size_t k, const T *a, size_t a_size, const T *b, size_t b_size, Less &less
+) {
+  size_t low  = k > b_size ? k - b_size : 0;
+  size_t high = std::min(k, a_size);
+  while (low < high) {
+    size_t i = low + (high - low) / 2;
+    size_t j = k - i;
+    // a wins ties, a[i] belongs before b[j - 1] unless it is greater
+    if (j > 0 && !less(b[j - 1], a[i])) {
+      low = i + 1;
+    } else {
+      high = i;
+    }
+  }
+  return low;
+}
+
+}  // namespace internal
+
+template <typename F>
+void parallel_for(System &system, u32 count, F &&f, u32 grain) {
+  u32 first = 0;
+  u32 chunk = grain;
+  if (chunk == 0) {
+    f64 elapsed = 0;
+    u32 probe   = 1;
+    while (first < count && elapsed < internal::kProbeSeconds) {
+      u32  last  = first + std::min(probe, count - first);
+      auto start = internal::Clock::now();
+      f(first, last);
+      elapsed += std::chrono::duration<f64>(internal::Clock::now() - start)
+                     .count();
+      first  = last;
+      probe *= 2;
+    }
+    u32 remaining = count - first;
+    f64 per_item  = std::max(elapsed / std::max(first, 1u), 1e-12);
+    if (remaining == 0 || remaining * per_item < internal::kChunkSeconds) {
+      if (remaining != 0) {
+        f(first, count);
+      }
+      return;
+    }
+    u32 threads  = system.worker_count() + 1;
+    f64 timed    = internal::kChunkSeconds / per_item;
+    u32 balanced = (remaining + threads * internal::kChunksPerThread - 1) /
+                   (threads * internal::kChunksPerThread);
+    chunk        = (u32)std::max(1., std::min(timed, (f64)balanced));
+  }
+  if (first < count) {
+    internal::run_chunks(system, first, count, chunk, f);
+  }
+  return;
+}
+
+template <typename T, typename R, typename C>
+T parallel_reduce(
+    System &system,
+    u32     count,
+    T       identity,
+    R     &&reduce,
+    C     &&combine,
+    u32     block
+) {
+  if (block == 0) {
+    block = std::max(
+        internal::kReduceBlock,
+        (count + internal::kMaxReduceBlocks - 1) / internal::kMaxReduceBlocks
+    );
+  }
+  u32            block_count = (count + block - 1) / block;
+  Vector<T>      values(block_count, identity);
+  const auto     reduce_blocks = [&](u32 first, u32 last) {
+    for (u32 b = first; b < last; ++b) {
+      u32 begin = b * block;
+      values[b] = reduce(begin, std::min(begin + block, count), identity);
+    }
+  };
+  parallel_for(system, block_count, reduce_blocks);
+
+  T result = identity;
+  for (u32 b = 0; b < block_count; ++b) {
+    result = combine(result, values[b]);
+  }
+  return result;
+}
+
+template <typename T, typename A, typename Less>
+void parallel_sort(System &system, std::vector<T, A> &values, Less less) {
+  size_t size    = values.size();
+  u32    threads = system.worker_count() + 1;
+  if (size < 2 * (size_t)internal::kSortRun) {
+    std::stable_sort(values.begin(), values.end(), less);
+    return;
+  }
+
+  // a power of two of runs, a few per thread
+  u32 runs = 1;
+  while (runs < threads * 2 && size / (runs * 2) >= internal::kSortRun) {
+    runs *= 2;
+  }
+  const auto bound = [size, runs](u32 run) {
+    return (size_t)((u64)size * run / runs);
+  };
+
+  std::vector<T, A> scratch(values.get_allocator());
+  scratch.resize(size);
+  T *source = values.data();
+  T *target = scratch.data();
+
+  parallel_for(
+      system,
+      runs,
+      [&](u32 first, u32 last) {
+        for (u32 run = first; run < last; ++run) {
+          std::stable_sort(source + bound(run), source + bound(run + 1), less);
+        }
+      },
+      1
+  );
+
+  // every round merges pairs of runs, the output is cut in equal pieces so
+  // the last rounds, with a few long merges, stay parallel
+  u32 pieces = threads * internal::kChunksPerThread;
+  for (u32 width = 1; width < runs; width *= 2) {
+    const auto merge_pieces = [&](u32 first_piece, u32 last_piece) {
+      for (u32 piece = first_piece; piece < last_piece; ++piece) {
+        size_t k0 = (size_t)((u64)size * piece / pieces);
+        size_t k1 = (size_t)((u64)size * (piece + 1) / pieces);
+        for (u32 run = 0; run < runs; run += 2 * width) {
+          size_t begin  = bound(run);
+          size_t middle = bound(run + width);
+          size_t end    = bound(run + 2 * width);
+          if (end <= k0 || begin >= k1) {
+            continue;
+          }
+          const T *a      = source + begin;
+          const T *b      = source + middle;
+          size_t   a_size = middle - begin;
+          size_t   b_size = end - middle;
+          size_t   from   = std::max(k0, begin) - begin;
+          size_t   to     = std::min(k1, end) - begin;
+          size_t   i0 = internal::co_rank(from, a, a_size, b, b_size, less);
+          size_t   i1 = internal::co_rank(to, a, a_size, b, b_size, less);
+          std::merge(
+              std::make_move_iterator(source + begin + i0),
+              std::make_move_iterator(source + begin + i1),
+              std::make_move_iterator(source + middle + (from - i0)),
+              std::make_move_iterator(source + middle + (to - i1)),
+              target + begin + from,
+              less
+          );
+        }
+      }
+    };
+    parallel_for(system, pieces, merge_pieces, 1);
+    std::swap(source, target);
+  }
+
+  if (source != values.data()) {
+    values.swap(scratch);
+  }
+  return;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
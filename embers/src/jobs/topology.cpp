@@ -0,0 +1,414 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <embers/logger.hpp>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+namespace embers::jobs {
+
+#if defined(__linux__)
+
+static b8 read_text(const char *path, char *text, size_t size) {
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+  ssize_t length = read(descriptor, text, size - 1);
+  close(descriptor);
+  if (length <= 0) {
+    return false;
+  }
+  text[length] = 0;
+  return true;
+}
+
+/// `f(id)` for every cpu of a sysfs list such as "0-3,8,10-11"
+template <typename F>
+static void parse_list(const char *list, F &&f) {
+  const char *c = list;
+  while (*c >= '0' && *c <= '9') {
+    char *end;
+    u32   first = (u32)strtoul(c, &end, 10);
+    u32   last  = first;
+    if (*end == '-') {
+      last = (u32)strtoul(end + 1, &end, 10);
+    }
+    for (u32 id = first; id <= last; ++id) {
+      f(id);
+    }
+    c = *end == ',' ? end + 1 : end;
+  }
+  return;
+}
+
+void Topology::detect() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+
+  char list[4096];
+  char text[4096];
+  char path[128];
+  if (!read_text("/sys/devices/system/cpu/online", list, sizeof(list))) {
+    return;
+  }
+  u32 max_id = 0;
+  parse_list(list, [&](u32 id) {
+    if (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)) {
+      return;
+    }
+    // cores, caches and nodes are known by their first cpu until normalize()
+    Cpu cpu = {id, id, 0, 0, 1};
+    snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+        id
+    );
+    if (read_text(path, text, sizeof(text))) {
+      cpu.core = (u32)strtoul(text, nullptr, 10);
+    }
+
+    // the highest level of cache the cpu has is the last level
+    u32 cache_level = 0;
+    for (u32 index = 0;; ++index) {
+      snprintf(
+          path,
+          sizeof(path),
+          "/sys/devices/system/cpu/cpu%u/cache/index%u/level",
+          id,
+          index
+      );
+      if (!read_text(path, text, sizeof(text))) {
+        break;
+      }
+      u32 level = (u32)strtoul(text, nullptr, 10);
+      if (level < cache_level) {
+        continue;
+      }
+      snprintf(
+          path,
+          sizeof(path),
+          "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list",
+          id,
+          index
+      );
+      if (read_text(path, text, sizeof(text))) {
+        cache_level = level;
+        cpu.cache   = (u32)strtoul(text, nullptr, 10);
+      }
+    }
+
+    // hybrid and big.LITTLE parts report a capacity, fall back on the
+    // highest frequency
+    snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/cpu_capacity",
+        id
+    );
+    if (!read_text(path, text, sizeof(text))) {
+      snprintf(
+          path,
+          sizeof(path),
+          "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq",
+          id
+      );
+      if (!read_text(path, text, sizeof(text))) {
+        strcpy(text, "1");
+      }
+    }
+    cpu.capacity = std::max((u32)strtoul(text, nullptr, 10), 1u);
+
+    max_id = std::max(max_id, id);
+    cpus_.push_back(cpu);
+  });
+
+  Vector<u32> index_of(max_id + 1, u32_MAX);
+  for (u32 i = 0; i < cpus_.size(); ++i) {
+    index_of[cpus_[i].id] = i;
+  }
+  DIR *nodes = opendir("/sys/devices/system/node");
+  if (nodes == nullptr) {
+    return;
+  }
+  while (dirent *entry = readdir(nodes)) {
+    u32 node;
+    if (sscanf(entry->d_name, "node%u", &node) != 1) {
+      continue;
+    }
+    snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/node/node%u/cpulist",
+        node
+    );
+    if (!read_text(path, text, sizeof(text))) {
+      continue;
+    }
+    parse_list(text, [&](u32 id) {
+      if (id <= max_id && index_of[id] != u32_MAX) {
+        cpus_[index_of[id]].node = node;
+      }
+    });
+  }
+  closedir(nodes);
+  return;
+}
+
+bool pin_thread(const CpuSet &cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (u32 id : cpus) {
+    if (id < CPU_SETSIZE) {
+      CPU_SET(id, &set);
+    }
+  }
+  int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (result != 0) {
+    EMBERS_ERROR("Unable to set the affinity of a thread; errno: {}", result);
+    return false;
+  }
+  return true;
+}
+
+#elif defined(_WIN32)
+
+// cpu ids are group * 64 + number in the group
+constexpr u32 kGroupSize = 64;
+
+void Topology::detect() {
+  using Information = SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX;
+
+  DWORD size = 0;
+  GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+  Vector<u8> buffer(size);
+  if (!GetLogicalProcessorInformationEx(
+          RelationAll,
+          (Information *)buffer.data(),
+          &size
+      )) {
+    EMBERS_ERROR(
+        "Unable to get the processor information; GetLastError: {}",
+        GetLastError()
+    );
+    return;
+  }
+  const auto for_each = [&](LOGICAL_PROCESSOR_RELATIONSHIP relation, auto f) {
+    for (DWORD offset = 0; offset < size;) {
+      const Information *information = (Information *)(buffer.data() + offset);
+      if (information->Relationship == relation) {
+        f(*information);
+      }
+      offset += information->Size;
+    }
+  };
+  const auto for_each_cpu = [](const GROUP_AFFINITY &affinity, auto f) {
+    for (u32 bit = 0; bit < kGroupSize; ++bit) {
+      if (affinity.Mask & ((KAFFINITY)1 << bit)) {
+        f(affinity.Group * kGroupSize + bit);
+      }
+    }
+  };
+
+  // efficiency classes are higher on faster cores
+  u32 core = 0;
+  for_each(RelationProcessorCore, [&](const Information &information) {
+    const PROCESSOR_RELATIONSHIP &processor = information.Processor;
+    for (WORD group = 0; group < processor.GroupCount; ++group) {
+      for_each_cpu(processor.GroupMask[group], [&](u32 id) {
+        cpus_.push_back({id, core, 0, 0, processor.EfficiencyClass + 1u});
+      });
+    }
+    core++;
+  });
+  const auto cpu = [this](u32 id) -> Cpu * {
+    for (Cpu &cpu : cpus_) {
+      if (cpu.id == id) {
+        return &cpu;
+      }
+    }
+    return nullptr;
+  };
+
+  Vector<u32> cache_level(cpus_.size(), 0);
+  u32         cache = 0;
+  for_each(RelationCache, [&](const Information &information) {
+    const CACHE_RELATIONSHIP &relation = information.Cache;
+    if (relation.Type == CacheInstruction) {
+      return;
+    }
+    for_each_cpu(relation.GroupMask, [&](u32 id) {
+      Cpu *found = cpu(id);
+      if (found == nullptr) {
+        return;
+      }
+      u32 &level = cache_level[found - cpus_.data()];
+      if (relation.Level >= level) {
+        level        = relation.Level;
+        found->cache = cache;
+      }
+    });
+    cache++;
+  });
+  for_each(RelationNumaNode, [&](const Information &information) {
+    const NUMA_NODE_RELATIONSHIP &relation = information.NumaNode;
+    for_each_cpu(relation.GroupMask, [&](u32 id) {
+      Cpu *found = cpu(id);
+      if (found != nullptr) {
+        found->node = relation.NodeNumber;
+      }
+    });
+  });
+  return;
+}
+
+bool pin_thread(const CpuSet &cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+  // a thread runs in a single group, the one of the first cpu
+  GROUP_AFFINITY affinity = {};
+  affinity.Group          = (WORD)(cpus[0] / kGroupSize);
+  for (u32 id : cpus) {
+    if (id / kGroupSize == affinity.Group) {
+      affinity.Mask |= (KAFFINITY)1 << (id % kGroupSize);
+    }
+  }
+  if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+    EMBERS_ERROR(
+        "Unable to set the affinity of a thread; GetLastError: {}",
+        GetLastError()
+    );
+    return false;
+  }
+  return true;
+}
+
+#else
+
+void Topology::detect() { return; }
+
+bool pin_thread(const CpuSet &cpus) { return cpus.empty(); }
+
+#endif
+
+Topology::Topology() : core_count_(0), cache_count_(0), node_count_(0) {
+  detect();
+  if (cpus_.empty()) {
+    // nothing known, a core per hardware thread sharing a cache
+    u32 count = std::max(std::thread::hardware_concurrency(), 1u);
+    for (u32 id = 0; id < count; ++id) {
+      cpus_.push_back({id, id, 0, 0, 1});
+    }
+  }
+  normalize();
+}
+
+void Topology::normalize() {
+  std::sort(cpus_.begin(), cpus_.end(), [](const Cpu &a, const Cpu &b) {
+    if (a.node != b.node) {
+      return a.node < b.node;
+    }
+    if (a.cache != b.cache) {
+      return a.cache < b.cache;
+    }
+    if (a.core != b.core) {
+      return a.core < b.core;
+    }
+    return a.id < b.id;
+  });
+
+  // the cpus of a core, a cache or a node are now next to each other
+  u32 max_capacity = 1;
+  for (const Cpu &cpu : cpus_) {
+    max_capacity = std::max(max_capacity, cpu.capacity);
+  }
+  Cpu previous = {};
+  for (size_t i = 0; i < cpus_.size(); ++i) {
+    Cpu &cpu       = cpus_[i];
+    b8   new_node  = i == 0 || cpu.node != previous.node;
+    b8   new_cache = new_node || cpu.cache != previous.cache;
+    b8   new_core  = new_cache || cpu.core != previous.core;
+    previous       = cpu;
+
+    node_count_  += new_node;
+    cache_count_ += new_cache;
+    core_count_  += new_core;
+    cpu.node      = node_count_ - 1;
+    cpu.cache     = cache_count_ - 1;
+    cpu.core      = core_count_ - 1;
+    cpu.capacity  = (u32)((u64)cpu.capacity * 1024 / max_capacity);
+  }
+  return;
+}
+
+Placement Topology::place(u32 dedicated, b8 smt) const {
+  // index of the first cpu of every core, and its position in its core
+  Vector<u32> cores;
+  Vector<u32> sibling(cpus_.size());
+  for (u32 i = 0; i < cpus_.size(); ++i) {
+    if (i == 0 || cpus_[i].core != cpus_[i - 1].core) {
+      cores.push_back(i);
+    }
+    sibling[i] = i - cores.back();
+  }
+
+  // the fastest cores, the first ones (on the first node) among equals
+  Vector<u32> fastest(cores);
+  std::stable_sort(fastest.begin(), fastest.end(), [this](u32 a, u32 b) {
+    return cpus_[a].capacity > cpus_[b].capacity;
+  });
+  Placement placement;
+  Vector<b8> reserved(core_count_, false);
+  u32        count = std::min(dedicated, core_count_ - 1);
+  placement.dedicated.resize(dedicated);
+  for (u32 d = 0; d < count; ++d) {
+    u32 core       = cpus_[fastest[d]].core;
+    reserved[core] = true;
+    for (u32 i = fastest[d]; i < cpus_.size() && cpus_[i].core == core; ++i) {
+      placement.dedicated[d].push_back(cpus_[i].id);
+    }
+  }
+
+  // by cache domain, every core once before the SMT siblings
+  Vector<u32> workers;
+  for (u32 i = 0; i < cpus_.size(); ++i) {
+    if (!reserved[cpus_[i].core] && (smt || sibling[i] == 0)) {
+      workers.push_back(i);
+    }
+  }
+  std::stable_sort(workers.begin(), workers.end(), [&](u32 a, u32 b) {
+    if (cpus_[a].cache != cpus_[b].cache) {
+      return cpus_[a].cache < cpus_[b].cache;
+    }
+    return sibling[a] < sibling[b];
+  });
+  for (u32 i : workers) {
+    placement.workers.push_back(cpus_[i]);
+  }
+  return placement;
+}
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace embers::jobs {
+
+/// Logical CPU (hardware thread) and what it shares with the others. Cores,
+/// cache domains and nodes are numbered from 0 in the order of the topology
+struct Cpu {
+  u32 id;        // as the OS numbers it, what affinities are made of
+  u32 core;      // physical core, shared by SMT siblings
+  u32 cache;     // last level cache domain
+  u32 node;      // NUMA node
+  u32 capacity;  // relative performance, 1024 for the fastest cores
+};
+
+/// Ids of the cpus a thread may run on, empty for anywhere
+using CpuSet = Vector<u32>;
+
+/// Where the threads of the engine run. Dedicated threads (main, render)
+/// get a physical core each, SMT siblings included so nothing else shares
+/// its caches, workers get one of the remaining cpus each
+struct Placement {
+  Vector<CpuSet> dedicated;
+  Vector<Cpu>    workers;  // in worker order, grouped by cache domain
+};
+
+/// CPUs the process may run on: sysfs on Linux, processor information on
+/// Windows, a core per hardware thread elsewhere
+class Topology {
+  Vector<Cpu> cpus_;  // by node, cache domain, core then id
+  u32         core_count_;
+  u32         cache_count_;
+  u32         node_count_;
+
+  void detect();
+  /// Sorts the cpus and numbers cores, caches, nodes and capacities densely
+  void normalize();
+
+ public:
+  /// Detects the topology of the machine
+  Topology();
+  Topology(const Topology &other) = delete;
+  Topology(Topology &&other)      = default;
+  ~Topology()                     = default;
+
+  Topology &operator=(const Topology &rhs) = delete;
+  Topology &operator=(Topology &&rhs)      = default;
+
+  EMBERS_ALWAYS_INLINE const Vector<Cpu> &cpus() const;
+  EMBERS_ALWAYS_INLINE u32                core_count() const;
+  EMBERS_ALWAYS_INLINE u32                cache_count() const;
+  EMBERS_ALWAYS_INLINE u32                node_count() const;
+
+  /// Gives the `dedicated` fastest physical cores to dedicated threads, at
+  /// least one core is left to the workers (dedicated threads beyond that
+  /// get an empty set). Workers take a cpu of every other core, then the
+  /// remaining SMT siblings unless `smt` is false
+  Placement place(u32 dedicated, b8 smt = true) const;
+};
+
+/// Restricts the calling thread to `cpus`, false when the OS refused or has
+/// no notion of affinity. An empty set does nothing
+bool pin_thread(const CpuSet &cpus);
+
+}  // namespace embers::jobs
+
+// implementation
+
+namespace embers::jobs {
+
+EMBERS_ALWAYS_INLINE const Vector<Cpu> &Topology::cpus() const {
+  return cpus_;
+}
+
+EMBERS_ALWAYS_INLINE u32 Topology::core_count() const { return core_count_; }
+
+EMBERS_ALWAYS_INLINE u32 Topology::cache_count() const {
+  return cache_count_;
+}
+
+EMBERS_ALWAYS_INLINE u32 Topology::node_count() const { return node_count_; }
+
+}  // namespace embers::jobs
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cmath>
+#include <embers/defines.hpp>
+
+namespace embers::math {
+
+struct Vec3 {
+  f32 x;
+  f32 y;
+  f32 z;
+};
+
+/// Column major 4x4 matrix, `m[column * 4 + row]`
+struct alignas(16) Mat4 {
+  f32 m[16];
+
+  constexpr static Mat4 identity();
+  constexpr static Mat4 translation(Vec3 offset);
+  constexpr static Mat4 scale(Vec3 factors);
+};
+
+/// Axis aligned box, empty when any component of min is above max
+struct Aabb {
+  Vec3 min;
+  Vec3 max;
+
+  constexpr static Aabb around(Vec3 center, f32 radius);
+};
+
+struct Sphere {
+  Vec3 center;
+  f32  radius;
+};
+
+/// Points with `dot(normal, p) + distance >= 0` are inside
+struct Plane {
+  Vec3 normal;
+  f32  distance;
+};
+
+/// Six inward facing planes: left, right, bottom, top, near, far
+struct Frustum {
+  Plane planes[6];
+
+  /// Extracts the planes of a view projection matrix with the 0..1 depth
+  /// range of Vulkan
+  static Frustum from_matrix(const Mat4 &view_projection);
+};
+
+EMBERS_ALWAYS_INLINE Mat4 operator*(const Mat4 &lhs, const Mat4 &rhs);
+EMBERS_ALWAYS_INLINE bool operator==(const Mat4 &lhs, const Mat4 &rhs);
+EMBERS_ALWAYS_INLINE bool operator!=(const Mat4 &lhs, const Mat4 &rhs);
+
+EMBERS_ALWAYS_INLINE Vec3 transform_point(const Mat4 &matrix, Vec3 point);
+EMBERS_ALWAYS_INLINE Vec3 translation_of(const Mat4 &matrix);
+
+EMBERS_ALWAYS_INLINE bool operator==(const Aabb &lhs, const Aabb &rhs);
+EMBERS_ALWAYS_INLINE bool operator!=(const Aabb &lhs, const Aabb &rhs);
+
+EMBERS_ALWAYS_INLINE Aabb merge(const Aabb &lhs, const Aabb &rhs);
+EMBERS_ALWAYS_INLINE f32  surface_area(const Aabb &box);
+EMBERS_ALWAYS_INLINE bool contains(const Aabb &outer, const Aabb &inner);
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &lhs, const Aabb &rhs);
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &box, const Sphere &sphere);
+/// Conservative, boxes near the corners outside of the frustum can pass
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &box, const Frustum &frustum);
+
+}  // namespace embers::math
+
+// implementation
+
+namespace embers::math {
+
+constexpr Mat4 Mat4::identity() {
+  return {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+}
+
+constexpr Mat4 Mat4::translation(Vec3 offset) {
+  Mat4 result  = identity();
+  result.m[12] = offset.x;
+  result.m[13] = offset.y;
+  result.m[14] = offset.z;
+  return result;
+}
+
+constexpr Aabb Aabb::around(Vec3 center, f32 radius) {
+  return {
+      {center.x - radius, center.y - radius, center.z - radius},
+      {center.x + radius, center.y + radius, center.z + radius}
+  };
+}
+
+inline Frustum Frustum::from_matrix(const Mat4 &view_projection) {
+  const f32 *m = view_projection.m;
+
+  // rows of the matrix, the planes are sums and differences of them
+  const auto row = [m](u32 i) {
+    return Plane{{m[i], m[4 + i], m[8 + i]}, m[12 + i]};
+  };
+  const auto add = [](Plane a, Plane b, f32 sign) {
+    return Plane{
+        {a.normal.x + sign * b.normal.x,
+         a.normal.y + sign * b.normal.y,
+         a.normal.z + sign * b.normal.z},
+        a.distance + sign * b.distance
+    };
+  };
+
+  Frustum frustum = {
+      {add(row(3), row(0), 1),
+       add(row(3), row(0), -1),
+       add(row(3), row(1), 1),
+       add(row(3), row(1), -1),
+       row(2),
+       add(row(3), row(2), -1)}
+  };
+  for (Plane &plane : frustum.planes) {
+    f32 length = std::sqrt(
+        plane.normal.x * plane.normal.x + plane.normal.y * plane.normal.y +
+        plane.normal.z * plane.normal.z
+    );
+    if (length > 0) {
+      plane.normal    = {
+          plane.normal.x / length,
+          plane.normal.y / length,
+          plane.normal.z / length
+      };
+      plane.distance /= length;
+    }
+  }
+  return frustum;
+}
+
+constexpr Mat4 Mat4::scale(Vec3 factors) {
+  Mat4 result  = identity();
+  result.m[0]  = factors.x;
+  result.m[5]  = factors.y;
+  result.m[10] = factors.z;
+  return result;
+}
+
+EMBERS_ALWAYS_INLINE Mat4 operator*(const Mat4 &lhs, const Mat4 &rhs) {
+  // every column of the result is a combination of the columns of lhs, the
+  // inner loop maps to 4 wide vector instructions
+  Mat4 result;
+  for (u32 column = 0; column < 4; ++column) {
+    for (u32 row = 0; row < 4; ++row) {
+      result.m[column * 4 + row] = lhs.m[row] * rhs.m[column * 4];
+    }
+    for (u32 k = 1; k < 4; ++k) {
+      f32 factor = rhs.m[column * 4 + k];
+      for (u32 row = 0; row < 4; ++row) {
+        result.m[column * 4 + row] += lhs.m[k * 4 + row] * factor;
+      }
+    }
+  }
+  return result;
+}
+
+EMBERS_ALWAYS_INLINE bool operator==(const Mat4 &lhs, const Mat4 &rhs) {
+  for (u32 i = 0; i < 16; ++i) {
+    if (lhs.m[i] != rhs.m[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+EMBERS_ALWAYS_INLINE bool operator!=(const Mat4 &lhs, const Mat4 &rhs) {
+  return !(lhs == rhs);
+}
+
+EMBERS_ALWAYS_INLINE Vec3 transform_point(const Mat4 &matrix, Vec3 point) {
+  const f32 *m = matrix.m;
+  return {
+      m[0] * point.x + m[4] * point.y + m[8] * point.z + m[12],
+      m[1] * point.x + m[5] * point.y + m[9] * point.z + m[13],
+      m[2] * point.x + m[6] * point.y + m[10] * point.z + m[14],
+  };
+}
+
+EMBERS_ALWAYS_INLINE Vec3 translation_of(const Mat4 &matrix) {
+  return {matrix.m[12], matrix.m[13], matrix.m[14]};
+}
+
+EMBERS_ALWAYS_INLINE bool operator==(const Aabb &lhs, const Aabb &rhs) {
+  return lhs.min.x == rhs.min.x && lhs.min.y == rhs.min.y &&
+         lhs.min.z == rhs.min.z && lhs.max.x == rhs.max.x &&
+         lhs.max.y == rhs.max.y && lhs.max.z == rhs.max.z;
+}
+
+EMBERS_ALWAYS_INLINE bool operator!=(const Aabb &lhs, const Aabb &rhs) {
+  return !(lhs == rhs);
+}
+
+EMBERS_ALWAYS_INLINE Aabb merge(const Aabb &lhs, const Aabb &rhs) {
+  return {
+      {std::fmin(lhs.min.x, rhs.min.x),
+       std::fmin(lhs.min.y, rhs.min.y),
+       std::fmin(lhs.min.z, rhs.min.z)},
+      {std::fmax(lhs.max.x, rhs.max.x),
+       std::fmax(lhs.max.y, rhs.max.y),
+       std::fmax(lhs.max.z, rhs.max.z)}
+  };
+}
+
+EMBERS_ALWAYS_INLINE f32 surface_area(const Aabb &box) {
+  f32 x = box.max.x - box.min.x;
+  f32 y = box.max.y - box.min.y;
+  f32 z = box.max.z - box.min.z;
+  return 2 * (x * y + y * z + z * x);
+}
+
+EMBERS_ALWAYS_INLINE bool contains(const Aabb &outer, const Aabb &inner) {
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+         outer.min.z <= inner.min.z && outer.max.x >= inner.max.x &&
+         outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &lhs, const Aabb &rhs) {
+  return lhs.min.x <= rhs.max.x && lhs.max.x >= rhs.min.x &&
+         lhs.min.y <= rhs.max.y && lhs.max.y >= rhs.min.y &&
+         lhs.min.z <= rhs.max.z && lhs.max.z >= rhs.min.z;
+}
+
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &box, const Sphere &sphere) {
+  // distance to the closest point of the box
+  Vec3 c = sphere.center;
+  f32  x = c.x - std::fmin(std::fmax(c.x, box.min.x), box.max.x);
+  f32  y = c.y - std::fmin(std::fmax(c.y, box.min.y), box.max.y);
+  f32  z = c.z - std::fmin(std::fmax(c.z, box.min.z), box.max.z);
+  return x * x + y * y + z * z <= sphere.radius * sphere.radius;
+}
+
+EMBERS_ALWAYS_INLINE bool overlaps(const Aabb &box, const Frustum &frustum) {
+  // the corner furthest along the normal decides
+  for (const Plane &plane : frustum.planes) {
+    f32 x = plane.normal.x >= 0 ? box.max.x : box.min.x;
+    f32 y = plane.normal.y >= 0 ? box.max.y : box.min.y;
+    f32 z = plane.normal.z >= 0 ? box.max.z : box.min.z;
+    if (plane.normal.x * x + plane.normal.y * y + plane.normal.z * z +
+            plane.distance <
+        0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace embers::math
\ No newline at end of file
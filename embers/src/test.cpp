@@ -1,3 +1,4 @@
+#include <GLFW/glfw3.h>
 #include <fmt/format.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
@@ -11,6 +12,9 @@
 #include "ecs/entity.hpp"
 #include "engine_config.hpp"
 #include "error_code.hpp"
+#include "jobs/frame_graph.hpp"
+#include "jobs/jobs.hpp"
+#include "jobs/topology.hpp"
 #include "platform.hpp"
 #include "vulkan/device.hpp"
 #include "vulkan/instance.hpp"
@@ -26,6 +30,20 @@ int embers::test::main() {
       embers::config::engine.version
   );
 
+  // the main thread gets a core of its own, it handles the window and
+  // submits and presents the frames
+  jobs::Topology  topology;
+  jobs::Placement placement = topology.place(1);
+  EMBERS_INFO(
+      "{} cpus, {} cores, {} cache domains, {} nodes, {} workers",
+      topology.cpus().size(),
+      topology.core_count(),
+      topology.cache_count(),
+      topology.node_count(),
+      placement.workers.size()
+  );
+  jobs::pin_thread(placement.dedicated[0]);
+
   embers::config::Platform config;
 
   auto platform = embers::Platform(config);
@@ -36,9 +54,50 @@ int embers::test::main() {
     return 1;
   }
 
+  jobs::System     jobs(placement);
+  jobs::FrameGraph frames(jobs, 2);
+
+  GLFWwindow   *window = (GLFWwindow *)platform.window_;
+  jobs::StageId input  = frames.add_on_main("input", [&](u64, u32) {
+    glfwPollEvents();
+    if (glfwWindowShouldClose(window)) {
+      frames.stop();
+    }
+  });
+  jobs::StageId simulation = frames.add("simulation", [](u64, u32) {});
+  jobs::StageId culling    = frames.add("culling", [](u64, u32) {});
+  jobs::StageId recording  = frames.add("recording", [](u64, u32) {});
+  jobs::StageId submission = frames.add_on_main("submission", [](u64, u32) {});
+  jobs::StageId present    = frames.add_on_main("present", [](u64, u32) {});
+  frames.add_dependency(input, simulation);
+  frames.add_dependency(simulation, culling);
+  frames.add_dependency(culling, recording);
+  frames.add_dependency(recording, submission);
+  frames.add_dependency(submission, present);
+
+  frames.run();
+
+  EMBERS_INFO(
+      "{} frames, {:.3f} ms per frame, {:.3f} ms between frames",
+      frames.frame(),
+      frames.frame_timing().average() * 1e3,
+      frames.interval().average() * 1e3
+  );
+  for (jobs::StageId stage = 0; stage < frames.stage_count(); ++stage) {
+    const jobs::Timing &timing = frames.timing(stage);
+    EMBERS_INFO(
+        "  {}: {:.3f} ms average, {:.3f} ms max",
+        frames.name(stage),
+        timing.average() * 1e3,
+        timing.max * 1e3
+    );
+  }
+
 #ifdef EMBERS_CONFIG_DEBUG
   EMBERS_DEBUG("Vulkan: {}", embers::containers::debug_allocator_info[0]);
   EMBERS_DEBUG("Logger: {}", embers::containers::debug_allocator_info[1]);
+  EMBERS_DEBUG("Ecs: {}", embers::containers::debug_allocator_info[2]);
+  EMBERS_DEBUG("Jobs: {}", embers::containers::debug_allocator_info[3]);
 
 #endif
 
@@ -0,0 +1,197 @@
+#include "commands.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <embers/logger.hpp>
+
+namespace embers::vulkan {
+
+Error CommandPools::last_error_ = Error::kUnknown;
+
+CommandPools::CommandPools(
+    const Device&       device,
+    Device::Queue       queue,
+    const jobs::System& jobs,
+    u32                 frames_in_flight
+)
+    : device_((VkDevice)device),
+      thread_count_(jobs.worker_count() + 1),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      pools_(new Pool[thread_count_ * frames_in_flight_]()) {
+  if (!(bool)device) {
+    EMBERS_FATAL("Can't init command pools; {} must be valid", "Vulkan device");
+    device_ = nullptr;
+    return;
+  }
+
+  // the pools are reset as a whole, not their buffers
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = device.queue_family(queue);
+  for (u32 i = 0; i < thread_count_ * frames_in_flight_; ++i) {
+    VkResult result =
+        vkCreateCommandPool(device_, &pool_info, nullptr, &pools_[i].pool);
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR("Unable to create command pool: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateCommands;
+      destroy();
+      return;
+    }
+  }
+  return;
+}
+
+CommandPools::~CommandPools() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void CommandPools::destroy() {
+  for (u32 i = 0; i < thread_count_ * frames_in_flight_; ++i) {
+    if (pools_[i].pool != nullptr) {
+      // frees its command buffers too
+      vkDestroyCommandPool(device_, pools_[i].pool, nullptr);
+    }
+  }
+  device_ = nullptr;
+  return;
+}
+
+CommandPools::Pool* CommandPools::pool(u32 slot) {
+  u32 thread = jobs::System::thread_index();
+  if (thread >= thread_count_) {
+    EMBERS_ERROR("Thread {} records commands without a pool", thread);
+    return nullptr;
+  }
+  return &pools_[(slot % frames_in_flight_) * thread_count_ + thread];
+}
+
+VkCommandBuffer CommandPools::take(Pool& pool, b8 secondary) {
+  Vector<VkCommandBuffer>& buffers =
+      secondary ? pool.secondaries : pool.primaries;
+  u32& count = secondary ? pool.secondary_count : pool.primary_count;
+
+  if (count == buffers.size()) {
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool        = pool.pool;
+    allocate_info.level              = secondary
+                                           ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                                           : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = kAllocationCount;
+
+    buffers.resize(count + kAllocationCount);
+    VkResult result =
+        vkAllocateCommandBuffers(device_, &allocate_info, &buffers[count]);
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR("Unable to allocate command buffers: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateCommands;
+      buffers.resize(count);
+      return nullptr;
+    }
+  }
+  return buffers[count++];
+}
+
+void CommandPools::reset(u32 slot) {
+  for (u32 thread = 0; thread < thread_count_; ++thread) {
+    Pool& pool = pools_[(slot % frames_in_flight_) * thread_count_ + thread];
+    if (pool.primary_count == 0 && pool.secondary_count == 0) {
+      continue;
+    }
+    vkResetCommandPool(device_, pool.pool, 0);
+    pool.primary_count   = 0;
+    pool.secondary_count = 0;
+  }
+  return;
+}
+
+VkCommandBuffer CommandPools::begin_primary(u32 slot) {
+  Pool* pool = this->pool(slot);
+  if (pool == nullptr) {
+    return nullptr;
+  }
+  VkCommandBuffer commands = take(*pool, false);
+  if (commands == nullptr) {
+    return nullptr;
+  }
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VkResult result  = vkBeginCommandBuffer(commands, &begin_info);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to begin command buffer: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateCommands;
+    return nullptr;
+  }
+  return commands;
+}
+
+VkCommandBuffer CommandPools::begin_secondary(
+    u32 slot, const Inheritance& inheritance
+) {
+  Pool* pool = this->pool(slot);
+  if (pool == nullptr) {
+    return nullptr;
+  }
+  VkCommandBuffer commands = take(*pool, true);
+  if (commands == nullptr) {
+    return nullptr;
+  }
+
+  VkCommandBufferInheritanceInfo inheritance_info = {};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass  = inheritance.render_pass;
+  inheritance_info.subpass     = inheritance.subpass;
+  inheritance_info.framebuffer = inheritance.framebuffer;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (inheritance.render_pass != nullptr) {
+    begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  }
+  begin_info.pInheritanceInfo = &inheritance_info;
+  VkResult result = vkBeginCommandBuffer(commands, &begin_info);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to begin command buffer: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateCommands;
+    return nullptr;
+  }
+  return commands;
+}
+
+b8 CommandPools::end(VkCommandBuffer commands) {
+  VkResult result = vkEndCommandBuffer(commands);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to record command buffer: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateCommands;
+    return false;
+  }
+  return true;
+}
+
+void CommandPools::execute(
+    VkCommandBuffer primary, const Vector<VkCommandBuffer>& secondaries
+) {
+  Vector<VkCommandBuffer> recorded;
+  recorded.reserve(secondaries.size());
+  std::copy_if(
+      secondaries.begin(),
+      secondaries.end(),
+      std::back_inserter(recorded),
+      [](VkCommandBuffer commands) { return commands != nullptr; }
+  );
+  if (!recorded.empty()) {
+    vkCmdExecuteCommands(primary, (u32)recorded.size(), recorded.data());
+  }
+  return;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
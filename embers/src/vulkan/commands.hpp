@@ -0,0 +1,156 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <memory>
+
+#include "../error_code.hpp"
+#include "../jobs/jobs.hpp"
+#include "../jobs/parallel.hpp"
+#include "common.hpp"
+#include "device.hpp"
+
+typedef struct VkCommandPool_T*   VkCommandPool;
+typedef struct VkCommandBuffer_T* VkCommandBuffer;
+typedef struct VkRenderPass_T*    VkRenderPass;
+typedef struct VkFramebuffer_T*   VkFramebuffer;
+
+namespace embers::vulkan {
+
+/// Render pass the secondary command buffers are executed within
+struct Inheritance {
+  VkRenderPass  render_pass;  // nullptr outside of render passes
+  u32           subpass;
+  VkFramebuffer framebuffer;  // nullptr when unknown
+};
+
+/// Command pools by frame slot and by thread of a jobs::System, so threads
+/// record without locking: a pool is only used by the thread it belongs
+/// to. Command buffers aren't reset one by one, reset(slot) resets every
+/// pool of the slot at once and their command buffers are handed out
+/// again.
+///
+/// A thread shouldn't wait on a jobs::Counter while it records, its job
+/// could resume on another thread while the first one uses the pool. That
+/// includes record(), which waits on the workers: command buffers begun
+/// before it aren't recorded into after it. The threads that aren't
+/// workers share one pool, only one of them records
+class CommandPools {
+ public:
+  constexpr static u32 kAllocationCount = 16;  // buffers allocated at once
+
+ private:
+  struct alignas(jobs::kCacheLine) Pool {
+    VkCommandPool           pool;
+    Vector<VkCommandBuffer> primaries;
+    Vector<VkCommandBuffer> secondaries;
+    u32                     primary_count;  // handed out since the reset
+    u32                     secondary_count;
+  };
+
+  static Error last_error_;
+
+  VkDevice                device_;  // doesn't own
+  u32                     thread_count_;
+  u32                     frames_in_flight_;
+  std::unique_ptr<Pool[]> pools_;  // by slot then thread
+
+  /// Pool of the calling thread for `slot`, nullptr for unknown threads
+  Pool*           pool(u32 slot);
+  VkCommandBuffer take(Pool& pool, b8 secondary);
+  void            destroy();
+
+ public:
+  CommandPools() = delete;
+  /// Pools of the family of `queue`, for the threads of `jobs`
+  CommandPools(
+      const Device&       device,
+      Device::Queue       queue,
+      const jobs::System& jobs,
+      u32                 frames_in_flight = 2
+  );
+  CommandPools(const CommandPools& other) = delete;
+  CommandPools(CommandPools&& other)      = delete;
+  ~CommandPools();
+
+  constexpr explicit operator bool() const;
+  CommandPools&      operator=(const CommandPools& rhs) = delete;
+  CommandPools&      operator=(CommandPools&& rhs)      = delete;
+
+  /// Command buffers of `slot` can be handed out again, the GPU is done
+  /// with them and no thread records any
+  void reset(u32 slot);
+
+  /// Primary command buffer begun for one submission, nullptr on failure
+  VkCommandBuffer begin_primary(u32 slot);
+  /// Secondary command buffer begun for one submission within
+  /// `inheritance`, nullptr on failure
+  VkCommandBuffer begin_secondary(u32 slot, const Inheritance& inheritance);
+  /// Ends the recording of `commands`, false on failure
+  b8              end(VkCommandBuffer commands);
+
+  /// `f(i, commands)` records the part i of [0, count) into a secondary
+  /// command buffer, in parallel on `jobs`. `secondaries` gets them in the
+  /// order of i whichever thread recorded them, nullptr for the failed
+  /// ones. The caller may return on another thread: the primary executing
+  /// them is begun afterwards, from the pool of that thread
+  template <typename F>
+  void record(
+      jobs::System&            jobs,
+      u32                      slot,
+      const Inheritance&       inheritance,
+      u32                      count,
+      Vector<VkCommandBuffer>& secondaries,
+      F&&                      f
+  );
+  /// Executes the `secondaries` of record() in order. Within a render pass,
+  /// `primary` began it with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+  void execute(
+      VkCommandBuffer primary, const Vector<VkCommandBuffer>& secondaries
+  );
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr CommandPools::operator bool() const { return device_ != nullptr; }
+
+template <typename F>
+void CommandPools::record(
+    jobs::System&            jobs,
+    u32                      slot,
+    const Inheritance&       inheritance,
+    u32                      count,
+    Vector<VkCommandBuffer>& secondaries,
+    F&&                      f
+) {
+  secondaries.assign(count, nullptr);
+  jobs::parallel_for(
+      jobs,
+      count,
+      [&](u32 first, u32 last) {
+        for (u32 i = first; i < last; ++i) {
+          VkCommandBuffer commands = begin_secondary(slot, inheritance);
+          if (commands == nullptr) {
+            continue;
+          }
+          f(i, commands);
+          if (end(commands)) {
+            secondaries[i] = commands;
+          }
+        }
+      },
+      1
+  );
+  return;
+}
+
+EMBERS_ALWAYS_INLINE Error CommandPools::get_last_error() {
+  return last_error_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -20,4 +20,11 @@ const char* required_device_extensions[1] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 };
 
+const char* optional_device_extensions[4] = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+    VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+};
+
 }  // namespace embers::vulkan
\ No newline at end of file
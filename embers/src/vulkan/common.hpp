@@ -18,6 +18,9 @@ extern const char* const debug_layers[1];
 
 extern const char* required_device_extensions[1];
 
+/// Enabled when present, see Device::Extension
+extern const char* optional_device_extensions[4];
+
 #ifdef EMBERS_CONFIG_DEBUG
 template <typename T>
 using Allocator = containers::with<
@@ -0,0 +1,435 @@
+#include "descriptors.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <embers/logger.hpp>
+
+namespace embers::vulkan {
+
+namespace {
+
+/// Descriptors of a frame pool per set it holds
+struct PoolRatio {
+  VkDescriptorType type;
+  u32              per_set;
+};
+
+constexpr PoolRatio kPoolRatios[] = {
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+};
+
+}  // namespace
+
+Error DescriptorAllocator::last_error_ = Error::kUnknown;
+
+DescriptorAllocator::DescriptorAllocator(
+    const Device& device, const jobs::System& jobs, u32 frames_in_flight
+)
+    : device_((VkDevice)device),
+      thread_count_(jobs.worker_count() + 1),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      pools_(new Pools[thread_count_ * frames_in_flight_]()) {
+  if (!(bool)device) {
+    EMBERS_FATAL(
+        "Can't init descriptor allocator; {} must be valid",
+        "Vulkan device"
+    );
+    device_ = nullptr;
+    return;
+  }
+  for (u32 i = 0; i < thread_count_ * frames_in_flight_; ++i) {
+    pools_[i].next_sets = kFirstPoolSets;
+  }
+  return;
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void DescriptorAllocator::destroy() {
+  for (u32 i = 0; i < thread_count_ * frames_in_flight_; ++i) {
+    for (VkDescriptorPool pool : pools_[i].pools) {
+      // frees its sets too
+      vkDestroyDescriptorPool(device_, pool, nullptr);
+    }
+  }
+  device_ = nullptr;
+  return;
+}
+
+DescriptorAllocator::Pools* DescriptorAllocator::pools(u32 slot) {
+  u32 thread = jobs::System::thread_index();
+  if (thread >= thread_count_) {
+    EMBERS_ERROR("Thread {} allocates descriptors without a pool", thread);
+    return nullptr;
+  }
+  return &pools_[(slot % frames_in_flight_) * thread_count_ + thread];
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(u32 sets) {
+  VkDescriptorPoolSize sizes[std::size(kPoolRatios)];
+  for (u32 i = 0; i < std::size(kPoolRatios); ++i) {
+    sizes[i].type            = kPoolRatios[i].type;
+    sizes[i].descriptorCount = kPoolRatios[i].per_set * sets;
+  }
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets       = sets;
+  pool_info.poolSizeCount = std::size(sizes);
+  pool_info.pPoolSizes    = sizes;
+
+  VkDescriptorPool pool   = nullptr;
+  VkResult         result =
+      vkCreateDescriptorPool(device_, &pool_info, nullptr, &pool);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create descriptor pool: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateDescriptors;
+    return nullptr;
+  }
+  return pool;
+}
+
+void DescriptorAllocator::reset(u32 slot) {
+  for (u32 thread = 0; thread < thread_count_; ++thread) {
+    Pools& pools = pools_[(slot % frames_in_flight_) * thread_count_ + thread];
+    for (u32 i = 0; i < pools.pools.size() && i <= pools.current; ++i) {
+      vkResetDescriptorPool(device_, pools.pools[i], 0);
+    }
+    pools.current = 0;
+  }
+  return;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(
+    u32 slot, VkDescriptorSetLayout layout
+) {
+  Pools* pools = this->pools(slot);
+  if (pools == nullptr) {
+    return nullptr;
+  }
+
+  VkDescriptorSetAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorSetCount = 1;
+  allocate_info.pSetLayouts        = &layout;
+  for (;;) {
+    b8 created = pools->current == pools->pools.size();
+    if (created) {
+      VkDescriptorPool pool = create_pool(pools->next_sets);
+      if (pool == nullptr) {
+        return nullptr;
+      }
+      pools->pools.push_back(pool);
+      pools->next_sets = std::min(pools->next_sets * 2, kMaxPoolSets);
+    }
+    allocate_info.descriptorPool = pools->pools[pools->current];
+
+    VkDescriptorSet set = nullptr;
+    VkResult        result =
+        vkAllocateDescriptorSets(device_, &allocate_info, &set);
+    if (result == VK_SUCCESS) {
+      return set;
+    }
+    // a new pool is too small for the layout
+    if (created || (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+                    result != VK_ERROR_FRAGMENTED_POOL)) {
+      EMBERS_ERROR("Unable to allocate descriptor set: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateDescriptors;
+      return nullptr;
+    }
+    ++pools->current;  // full until the slot is reset
+  }
+}
+
+Error BindlessDescriptors::last_error_ = Error::kUnknown;
+
+BindlessDescriptors::BindlessDescriptors(
+    const Device& device, u32 frames_in_flight
+)
+    : device_((VkDevice)device),
+      layout_(nullptr),
+      pool_(nullptr),
+      set_(nullptr),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      frame_(0),
+      capacity_{kMaxTextures, kMaxBuffers},
+      used_{0, 0} {
+  if (!(bool)device) {
+    EMBERS_FATAL(
+        "Can't init bindless descriptors; {} must be valid",
+        "Vulkan device"
+    );
+    device_ = nullptr;
+    return;
+  }
+  if (!device.has(Device::kDescriptorIndexing)) {
+    EMBERS_ERROR(
+        "Can't init bindless descriptors; {} isn't supported",
+        "descriptor indexing"
+    );
+    last_error_ = Error::kVulkanCreateDescriptors;
+    device_     = nullptr;
+    return;
+  }
+
+  // within the limits of sets updated after bind
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+  limits.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &limits;
+  vkGetPhysicalDeviceProperties2(device.physical_device(), &properties);
+  capacity_[kTexture] = std::min({
+      capacity_[kTexture],
+      limits.maxDescriptorSetUpdateAfterBindSampledImages,
+      limits.maxDescriptorSetUpdateAfterBindSamplers,
+      limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+      limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+  });
+  capacity_[kBuffer] = std::min({
+      capacity_[kBuffer],
+      limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+      limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+  });
+  // both bindings are seen by every stage and come from a single pool,
+  // scaled down together when they don't fit both
+  u64 total = (u64)capacity_[kTexture] + capacity_[kBuffer];
+  u64 limit = std::min(
+      limits.maxPerStageUpdateAfterBindResources,
+      limits.maxUpdateAfterBindDescriptorsInAllPools
+  );
+  if (total > limit) {
+    capacity_[kTexture] = (u32)(capacity_[kTexture] * limit / total);
+    capacity_[kBuffer]  = (u32)(capacity_[kBuffer] * limit / total);
+  }
+
+  VkDescriptorType types[kKindCount] = {
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+  };
+  VkDescriptorSetLayoutBinding bindings[kKindCount] = {};
+  VkDescriptorPoolSize         sizes[kKindCount]    = {};
+  for (u32 kind = 0; kind < kKindCount; ++kind) {
+    bindings[kind].binding         = kind;
+    bindings[kind].descriptorType  = types[kind];
+    bindings[kind].descriptorCount = capacity_[kind];
+    bindings[kind].stageFlags      = VK_SHADER_STAGE_ALL;
+    sizes[kind].type               = types[kind];
+    sizes[kind].descriptorCount    = capacity_[kind];
+  }
+
+  VkDescriptorBindingFlagsEXT binding_flags[kKindCount];
+  std::fill(
+      binding_flags,
+      binding_flags + kKindCount,
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+  );
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {};
+  flags_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  flags_info.bindingCount  = kKindCount;
+  flags_info.pBindingFlags = binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext = &flags_info;
+  layout_info.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  layout_info.bindingCount = kKindCount;
+  layout_info.pBindings    = bindings;
+  VkResult result =
+      vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &layout_);
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  pool_info.maxSets       = 1;
+  pool_info.poolSizeCount = kKindCount;
+  pool_info.pPoolSizes    = sizes;
+  if (result == VK_SUCCESS) {
+    result = vkCreateDescriptorPool(device_, &pool_info, nullptr, &pool_);
+  }
+
+  VkDescriptorSetAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorPool     = pool_;
+  allocate_info.descriptorSetCount = 1;
+  allocate_info.pSetLayouts        = &layout_;
+  if (result == VK_SUCCESS) {
+    result = vkAllocateDescriptorSets(device_, &allocate_info, &set_);
+  }
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create bindless descriptor set: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateDescriptors;
+    destroy();
+    return;
+  }
+
+  EMBERS_DEBUG(
+      "Bindless descriptor set of {} textures and {} buffers",
+      capacity_[kTexture],
+      capacity_[kBuffer]
+  );
+  return;
+}
+
+BindlessDescriptors::~BindlessDescriptors() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void BindlessDescriptors::destroy() {
+  if (pool_ != nullptr) {
+    vkDestroyDescriptorPool(device_, pool_, nullptr);
+  }
+  if (layout_ != nullptr) {
+    vkDestroyDescriptorSetLayout(device_, layout_, nullptr);
+  }
+  device_ = nullptr;
+  return;
+}
+
+u32 BindlessDescriptors::take(Kind kind) {
+  if (!free_[kind].empty()) {
+    u32 index = free_[kind].back();
+    free_[kind].pop_back();
+    return index;
+  }
+  if (used_[kind] == capacity_[kind]) {
+    EMBERS_ERROR(
+        "Bindless descriptor set is full, {} descriptors of the kind",
+        capacity_[kind]
+    );
+    last_error_ = Error::kVulkanDescriptorsFull;
+    return u32_MAX;
+  }
+  return used_[kind]++;
+}
+
+u32 BindlessDescriptors::add_texture(VkImageView view, VkSampler sampler) {
+  VkDescriptorImageInfo image_info = {};
+  image_info.sampler               = sampler;
+  image_info.imageView             = view;
+  image_info.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  u32                         index = take(kTexture);
+  if (index == u32_MAX) {
+    return u32_MAX;
+  }
+  VkWriteDescriptorSet write = {};
+  write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet               = set_;
+  write.dstBinding           = kTexture;
+  write.dstArrayElement      = index;
+  write.descriptorCount      = 1;
+  write.descriptorType       = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo           = &image_info;
+  vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+  return index;
+}
+
+u32 BindlessDescriptors::add_buffer(VkBuffer buffer, u64 offset, u64 size) {
+  VkDescriptorBufferInfo buffer_info = {};
+  buffer_info.buffer                 = buffer;
+  buffer_info.offset                 = offset;
+  buffer_info.range                  = size;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  u32                         index = take(kBuffer);
+  if (index == u32_MAX) {
+    return u32_MAX;
+  }
+  VkWriteDescriptorSet write = {};
+  write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet               = set_;
+  write.dstBinding           = kBuffer;
+  write.dstArrayElement      = index;
+  write.descriptorCount      = 1;
+  write.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo          = &buffer_info;
+  vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+  return index;
+}
+
+void BindlessDescriptors::remove(Kind kind, u32 index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index >= used_[kind]) {
+    EMBERS_ERROR("Bindless descriptor {} was never added", index);
+    return;
+  }
+#ifdef EMBERS_CONFIG_DEBUG
+  // it would be handed out twice
+  b8 removed =
+      std::find(free_[kind].begin(), free_[kind].end(), index) !=
+          free_[kind].end() ||
+      std::any_of(
+          retired_.begin(),
+          retired_.end(),
+          [kind, index](const Retired& retired) {
+            return retired.kind == kind && retired.index == index;
+          }
+      );
+  if (removed) {
+    EMBERS_ERROR("Bindless descriptor {} is removed twice", index);
+    return;
+  }
+#endif
+  retired_.push_back({kind, index, frame_});
+  return;
+}
+
+void BindlessDescriptors::next_frame() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++frame_;
+  // retired in frame order
+  auto done = std::find_if(
+      retired_.begin(),
+      retired_.end(),
+      [this](const Retired& retired) {
+        return retired.frame + frames_in_flight_ > frame_;
+      }
+  );
+  for (auto i = retired_.begin(); i != done; ++i) {
+    free_[i->kind].push_back(i->index);
+  }
+  retired_.erase(retired_.begin(), done);
+  return;
+}
+
+void BindlessDescriptors::bind(
+    VkCommandBuffer commands, VkPipelineLayout layout, u32 set, b8 compute
+) const {
+  vkCmdBindDescriptorSets(
+      commands,
+      compute ? VK_PIPELINE_BIND_POINT_COMPUTE
+              : VK_PIPELINE_BIND_POINT_GRAPHICS,
+      layout,
+      set,
+      1,
+      &set_,
+      0,
+      nullptr
+  );
+  return;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
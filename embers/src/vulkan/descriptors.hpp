@@ -0,0 +1,199 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <memory>
+#include <mutex>
+
+#include "../error_code.hpp"
+#include "../jobs/jobs.hpp"
+#include "common.hpp"
+#include "device.hpp"
+
+typedef struct VkDescriptorPool_T*      VkDescriptorPool;
+typedef struct VkDescriptorSet_T*       VkDescriptorSet;
+typedef struct VkDescriptorSetLayout_T* VkDescriptorSetLayout;
+typedef struct VkPipelineLayout_T*      VkPipelineLayout;
+typedef struct VkCommandBuffer_T*       VkCommandBuffer;
+typedef struct VkImageView_T*           VkImageView;
+typedef struct VkSampler_T*             VkSampler;
+typedef struct VkBuffer_T*              VkBuffer;
+
+namespace embers::vulkan {
+
+/// Descriptor sets that live for one frame, from pools by frame slot and by
+/// thread of a jobs::System like CommandPools. Sets aren't freed one by
+/// one, reset(slot) resets every pool of the slot at once.
+///
+/// A slot starts without pools, one is added each time the last one is
+/// full, twice as big up to kMaxPoolSets. They are kept across resets, so
+/// a slot stops allocating pools once it saw its busiest frame
+class DescriptorAllocator {
+ public:
+  constexpr static u32 kFirstPoolSets = 64;
+  constexpr static u32 kMaxPoolSets   = 4096;
+
+ private:
+  struct alignas(jobs::kCacheLine) Pools {
+    Vector<VkDescriptorPool> pools;
+    u32                      current;  // allocated from, the others are full
+    u32                      next_sets;  // of the next pool created
+  };
+
+  static Error last_error_;
+
+  VkDevice                 device_;  // doesn't own
+  u32                      thread_count_;
+  u32                      frames_in_flight_;
+  std::unique_ptr<Pools[]> pools_;  // by slot then thread
+
+  /// Pools of the calling thread for `slot`, nullptr for unknown threads
+  Pools*           pools(u32 slot);
+  VkDescriptorPool create_pool(u32 sets);
+  void             destroy();
+
+ public:
+  DescriptorAllocator() = delete;
+  /// Pools for the threads of `jobs`
+  DescriptorAllocator(
+      const Device&       device,
+      const jobs::System& jobs,
+      u32                 frames_in_flight = 2
+  );
+  DescriptorAllocator(const DescriptorAllocator& other) = delete;
+  DescriptorAllocator(DescriptorAllocator&& other)      = delete;
+  ~DescriptorAllocator();
+
+  constexpr explicit   operator bool() const;
+  DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+  DescriptorAllocator& operator=(DescriptorAllocator&& rhs)      = delete;
+
+  /// Sets of `slot` can be allocated again, the GPU is done with them
+  void reset(u32 slot);
+
+  /// Set of `layout` for one frame, nullptr on failure
+  VkDescriptorSet allocate(u32 slot, VkDescriptorSetLayout layout);
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+/// One descriptor set holding every texture and storage buffer, bound once
+/// per command buffer: draws pass indices into its arrays (by push
+/// constants or in their data) instead of binding sets of their own.
+/// Shaders declare
+///
+///   layout(set = 0, binding = 0) uniform sampler2D textures[];
+///   layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+///
+/// and index them with nonuniformEXT when the index varies.
+///
+/// Needs Device::kDescriptorIndexing. The set is partially bound and
+/// updated after bind, descriptors are added while it is in use. Removed
+/// indices are reused frames_in_flight frames later, once no frame can use
+/// them anymore. Thread safe
+class BindlessDescriptors {
+ public:
+  enum Kind : u8 {
+    kTexture,  // combined image sampler, binding 0
+    kBuffer,   // storage buffer, binding 1
+    kKindCount,
+  };
+
+  constexpr static u32 kMaxTextures = 65536;  // less if the device has less
+  constexpr static u32 kMaxBuffers  = 16384;
+
+ private:
+  struct Retired {
+    Kind kind;
+    u32  index;
+    u64  frame;  // it was removed at
+  };
+
+  static Error last_error_;
+
+  VkDevice              device_;  // doesn't own
+  VkDescriptorSetLayout layout_;
+  VkDescriptorPool      pool_;
+  VkDescriptorSet       set_;
+  u32                   frames_in_flight_;
+  u64                   frame_;
+  u32                   capacity_[kKindCount];
+  u32                   used_[kKindCount];  // indices ever handed out
+  Vector<u32>           free_[kKindCount];
+  Vector<Retired>       retired_;
+  std::mutex            mutex_;
+
+  /// Free index of `kind`, u32_MAX when all are taken
+  u32  take(Kind kind);
+  void destroy();
+
+ public:
+  BindlessDescriptors() = delete;
+  explicit BindlessDescriptors(const Device& device, u32 frames_in_flight = 2);
+  BindlessDescriptors(const BindlessDescriptors& other) = delete;
+  BindlessDescriptors(BindlessDescriptors&& other)      = delete;
+  ~BindlessDescriptors();
+
+  constexpr explicit   operator bool() const;
+  BindlessDescriptors& operator=(const BindlessDescriptors& rhs) = delete;
+  BindlessDescriptors& operator=(BindlessDescriptors&& rhs)      = delete;
+
+  /// Index of `view` sampled with `sampler` in shader read only layout,
+  /// u32_MAX when the set is full
+  u32  add_texture(VkImageView view, VkSampler sampler);
+  /// Index of `size` bytes of `buffer` from `offset`, u32_MAX when full
+  u32  add_buffer(VkBuffer buffer, u64 offset, u64 size);
+  /// `index` can be used by the frames in flight, it is reused once they
+  /// are done. Indices never handed out are ignored, and so are indices
+  /// removed twice in debug builds
+  void remove(Kind kind, u32 index);
+  /// Once a frame, makes the indices removed frames_in_flight frames ago
+  /// free again
+  void next_frame();
+
+  /// Binds the set as `set` of `layout`, for graphics or compute
+  void bind(
+      VkCommandBuffer  commands,
+      VkPipelineLayout layout,
+      u32              set     = 0,
+      b8               compute = false
+  ) const;
+
+  /// For the pipeline layouts of the shaders using the set
+  EMBERS_ALWAYS_INLINE VkDescriptorSetLayout layout() const;
+  EMBERS_ALWAYS_INLINE u32 capacity(Kind kind) const;
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr DescriptorAllocator::operator bool() const {
+  return device_ != nullptr;
+}
+
+EMBERS_ALWAYS_INLINE Error DescriptorAllocator::get_last_error() {
+  return last_error_;
+}
+
+constexpr BindlessDescriptors::operator bool() const {
+  return device_ != nullptr;
+}
+
+EMBERS_ALWAYS_INLINE VkDescriptorSetLayout
+BindlessDescriptors::layout() const {
+  return layout_;
+}
+
+EMBERS_ALWAYS_INLINE u32 BindlessDescriptors::capacity(Kind kind) const {
+  return capacity_[kind];
+}
+
+EMBERS_ALWAYS_INLINE Error BindlessDescriptors::get_last_error() {
+  return last_error_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <bitset>
 #include <cstddef>
+#include <cstring>
 #include <functional>
 #include <iterator>
 #include <unordered_set>
@@ -22,6 +23,12 @@ Device::Device(
 ) {
   auto             physical_devices = instance.get_device_list();
   VkPhysicalDevice physical_device  = instance.pick_device(physical_devices);
+  physical_device_                  = physical_device;
+  if (physical_device == nullptr) {
+    last_error_ = Error::kVulkanNoSuitableDevice;
+    device_     = nullptr;
+    return;
+  }
 
   // gather info about physical device
 
@@ -140,8 +147,51 @@ Device::Device(
   auto                     device_extensions =
       instance.get_device_extension_list(physical_device, config);
 
+  extensions_ = 0;
+  for (const char* extension : device_extensions) {
+    for (u32 i = 0; i < std::size(optional_device_extensions); ++i) {
+      if (strcmp(extension, optional_device_extensions[i]) == 0) {
+        extensions_ |= 1u << i;
+      }
+    }
+  }
+
+  // features of the extensions, queried then enabled as they are
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipeline_library = {};
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT      indexing         = {};
+  void*                                              features_chain   = nullptr;
+  pipeline_library.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  indexing.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if (has(kPipelineLibrary) && has(kGraphicsPipelineLibrary)) {
+    pipeline_library.pNext = features_chain;
+    features_chain         = &pipeline_library;
+  }
+  if (has(kDescriptorIndexing)) {
+    indexing.pNext = features_chain;
+    features_chain = &indexing;
+  }
+  if (features_chain != nullptr) {
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = features_chain;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+  }
+  if (pipeline_library.graphicsPipelineLibrary != VK_TRUE) {
+    extensions_ &= ~(1u << kGraphicsPipelineLibrary);
+  }
+  if (indexing.runtimeDescriptorArray != VK_TRUE ||
+      indexing.descriptorBindingPartiallyBound != VK_TRUE ||
+      indexing.descriptorBindingSampledImageUpdateAfterBind != VK_TRUE ||
+      indexing.descriptorBindingStorageBufferUpdateAfterBind != VK_TRUE ||
+      indexing.shaderSampledImageArrayNonUniformIndexing != VK_TRUE) {
+    extensions_ &= ~(1u << kDescriptorIndexing);
+  }
+
   VkDeviceCreateInfo device_create_info{};
   device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_create_info.pNext = features_chain;
   device_create_info.queueCreateInfoCount    = queue_count_for_family.size();
   device_create_info.pQueueCreateInfos       = device_queue_create_infos;
   device_create_info.enabledExtensionCount   = device_extensions.size();
@@ -161,30 +211,15 @@ Device::Device(
     return;
   }
 
-  vkGetDeviceQueue(
-      device_,
-      queues[0].family,
-      queues[0].index,
-      &queues_.graphics
-  );
-  vkGetDeviceQueue(
-      device_,
-      queues[1].family,
-      queues[1].index,
-      &queues_.transfer
-  );
-  vkGetDeviceQueue(
-      device_,
-      queues[2].family,
-      queues[2].index,
-      &queues_.present
-  );
-  vkGetDeviceQueue(
-      device_,
-      queues[3].family,
-      queues[3].index,
-      &queues_.compute
-  );
+  for (u32 i = 0; i < kQueueCount; ++i) {
+    queues_.family[i] = queues[i].family;
+    vkGetDeviceQueue(
+        device_,
+        queues[i].family,
+        queues[i].index,
+        &queues_.queue[i]
+    );
+  }
 }
 
 void Device::destroy() { vkDestroyDevice(device_, nullptr); }
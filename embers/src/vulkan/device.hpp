@@ -9,13 +9,32 @@ typedef struct VkQueue_T*  VkQueue;
 namespace embers::vulkan {
 
 class Device {
-  static Error last_error_;
-  VkDevice     device_;
+ public:
+  enum Queue : u8 {
+    kGraphics,
+    kTransfer,
+    kPresent,
+    kCompute,
+    kQueueCount,
+  };
+
+  /// Enabled when the device has them, in the order of
+  /// optional_device_extensions
+  enum Extension : u8 {
+    kMemoryBudget,
+    kPipelineLibrary,
+    kGraphicsPipelineLibrary,  // with its feature, needs kPipelineLibrary
+    kDescriptorIndexing,       // with the features bindless descriptors use
+  };
+
+ private:
+  static Error     last_error_;
+  VkDevice         device_;
+  VkPhysicalDevice physical_device_;
+  u32              extensions_;  // bit per Extension
   struct {
-    VkQueue graphics;
-    VkQueue transfer;
-    VkQueue present;
-    VkQueue compute;
+    VkQueue queue[kQueueCount];
+    u32     family[kQueueCount];
   } queues_;
 
   void destroy();
@@ -38,6 +57,11 @@ class Device {
   constexpr bool                    operator==(const Device& rhs) const;
   constexpr bool                    operator!=(const Device& rhs) const;
   EMBERS_ALWAYS_INLINE static Error get_last_error();
+
+  constexpr VkPhysicalDevice physical_device() const;
+  constexpr VkQueue          queue(Queue queue) const;
+  constexpr u32              queue_family(Queue queue) const;
+  constexpr b8               has(Extension extension) const;
 };
 
 }  // namespace embers::vulkan
@@ -45,7 +69,10 @@ class Device {
 namespace embers::vulkan {
 
 constexpr Device::Device(Device&& other)
-    : device_(other.device_), queues_(other.queues_) {
+    : device_(other.device_),
+      physical_device_(other.physical_device_),
+      extensions_(other.extensions_),
+      queues_(other.queues_) {
   other.device_ = nullptr;
   return;
 }
@@ -63,8 +90,11 @@ constexpr Device::operator bool() const { return device_ != nullptr; }
 constexpr Device::operator VkDevice() const { return device_; }
 
 constexpr Device& Device::operator=(Device&& rhs) {
-  device_     = rhs.device_;
-  rhs.device_ = nullptr;
+  device_          = rhs.device_;
+  physical_device_ = rhs.physical_device_;
+  extensions_      = rhs.extensions_;
+  queues_          = rhs.queues_;
+  rhs.device_      = nullptr;
   return *this;
 }
 
@@ -76,4 +106,17 @@ constexpr bool Device::operator!=(const Device& rhs) const {
 }
 EMBERS_ALWAYS_INLINE Error Device::get_last_error() { return last_error_; }
 
+constexpr VkPhysicalDevice Device::physical_device() const {
+  return physical_device_;
+}
+constexpr VkQueue Device::queue(Queue queue) const {
+  return queues_.queue[queue];
+}
+constexpr u32 Device::queue_family(Queue queue) const {
+  return queues_.family[queue];
+}
+constexpr b8 Device::has(Extension extension) const {
+  return (extensions_ & (1u << extension)) != 0;
+}
+
 }  // namespace embers::vulkan
\ No newline at end of file
@@ -46,7 +46,7 @@ Instance::Instance(const config::Platform& config) {
   app_info.applicationVersion = version_to_vk(config.version);
   app_info.pEngineName        = embers::config::engine.name;
   app_info.engineVersion      = version_to_vk(embers::config::engine.version);
-  app_info.apiVersion         = VK_API_VERSION_1_0;
+  app_info.apiVersion         = VK_API_VERSION_1_1;
 
   instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   instance_create_info.pApplicationInfo        = &app_info;
@@ -327,6 +327,9 @@ Vector<const char*> Instance::get_device_extension_list(
            config.instance.extensions.required.size}
   };
   Range optional_extensions[] = {
+      {optional_device_extensions,
+       optional_device_extensions +
+           sizeof(optional_device_extensions) / sizeof(const char*)},
       {config.instance.extensions.optional.array,
        config.instance.extensions.optional.array +
            config.instance.extensions.optional.size},
@@ -530,6 +533,18 @@ VkPhysicalDevice Instance::pick_device(const Vector<VkPhysicalDevice>& devices
   }
 
   for (std::size_t i = 0; i < devices.size(); ++i) {
+    // the *2 queries of features and properties are core from 1.1 on
+    if (properties[i].apiVersion < VK_API_VERSION_1_1) {
+      EMBERS_DEBUG(
+          "Device {} only supports Vulkan {}.{}, skip device",
+          properties[i].deviceName,
+          VK_VERSION_MAJOR(properties[i].apiVersion),
+          VK_VERSION_MINOR(properties[i].apiVersion)
+      );
+      rating[i] = 0;
+      continue;
+    }
+
     u32 extension_count = 0;
     vkEnumerateDeviceExtensionProperties(
         devices[i],
@@ -574,7 +589,10 @@ VkPhysicalDevice Instance::pick_device(const Vector<VkPhysicalDevice>& devices
   }
   const auto iter = std::max_element(rating.cbegin(), rating.cend());
   const auto pos  = std::distance(rating.cbegin(), iter);
-  // todo check not 0;
+  if (iter == rating.cend() || *iter == 0) {
+    EMBERS_ERROR("None of the {} devices is suitable", devices.size());
+    return nullptr;
+  }
   EMBERS_DEBUG("Picked device: {}", properties[pos].deviceName);
   return devices[pos];
 }
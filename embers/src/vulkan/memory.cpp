@@ -0,0 +1,677 @@
+#include "memory.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <bitset>
+#include <embers/logger.hpp>
+
+namespace embers::vulkan {
+
+namespace {
+
+struct Preference {
+  VkMemoryPropertyFlags required;
+  VkMemoryPropertyFlags preferred;
+  VkMemoryPropertyFlags avoided;
+};
+
+// by MemoryUsage
+constexpr Preference preferences[] = {
+    // kDevice
+    {0,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT},
+    // kRenderTarget
+    {0,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+         VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT},
+    // kUpload: write combined system memory
+    {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+     0,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+    // kReadback
+    {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+     VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+     0},
+    // kFrame: device local if the GPU memory is visible to the host
+    {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+     VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+};
+
+// memory needing care this allocator doesn't take
+constexpr VkMemoryPropertyFlags excluded =
+    VK_MEMORY_PROPERTY_PROTECTED_BIT |
+    VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD |
+    VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD;
+
+EMBERS_ALWAYS_INLINE u64 align_up(u64 value, u64 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+EMBERS_ALWAYS_INLINE i32 bit_count(VkMemoryPropertyFlags flags) {
+  return (i32)std::bitset<sizeof(VkMemoryPropertyFlags) * 8>(flags).count();
+}
+
+}  // namespace
+
+Error MemoryAllocator::last_error_ = Error::kUnknown;
+
+MemoryAllocator::MemoryAllocator(const Device& device, u32 frames_in_flight)
+    : device_((VkDevice)device),
+      physical_device_(device.physical_device()),
+      memory_budget_(device.has(Device::kMemoryBudget)),
+      granularity_(1),
+      atom_size_(1),
+      max_blocks_(0),
+      block_count_(0),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      frame_slot_(0),
+      free_record_(Suballocator::kNone) {
+  if (!(bool)device) {
+    EMBERS_FATAL(
+        "Can't init memory allocator; {} must be valid",
+        "Vulkan device"
+    );
+    device_ = nullptr;
+    return;
+  }
+
+  VkPhysicalDeviceProperties       properties = {};
+  VkPhysicalDeviceMemoryProperties memory     = {};
+  vkGetPhysicalDeviceProperties(physical_device_, &properties);
+  vkGetPhysicalDeviceMemoryProperties(physical_device_, &memory);
+  granularity_ = std::max<u64>(properties.limits.bufferImageGranularity, 1);
+  atom_size_   = std::max<u64>(properties.limits.nonCoherentAtomSize, 1);
+  max_blocks_  = properties.limits.maxMemoryAllocationCount;
+
+  heaps_.resize(memory.memoryHeapCount);
+  for (u32 i = 0; i < memory.memoryHeapCount; ++i) {
+    heaps_[i]      = {};
+    heaps_[i].size = memory.memoryHeaps[i].size;
+  }
+  types_.resize(memory.memoryTypeCount);
+  for (u32 i = 0; i < memory.memoryTypeCount; ++i) {
+    Type& type = types_[i];
+    type.flags = memory.memoryTypes[i].propertyFlags;
+    type.heap  = memory.memoryTypes[i].heapIndex;
+    type.frames.resize(frames_in_flight_);
+
+    // a power of two for the buddy blocks, small heaps get smaller blocks
+    type.block_size = kBlockSize;
+    while (type.block_size > heaps_[type.heap].size / 8 &&
+           type.block_size > kBuddyMinSize) {
+      type.block_size /= 2;
+    }
+  }
+  update_budget();
+  return;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  if (device_ == nullptr) {
+    return;
+  }
+  u32 leaked = 0;
+  for (const Record& record : records_) {
+    leaked += record.block != nullptr ? 1 : 0;
+  }
+  if (leaked != 0) {
+    EMBERS_ERROR("{} device memory allocations weren't freed", leaked);
+  }
+
+  const auto free_blocks = [this](Blocks& blocks) {
+    for (const std::unique_ptr<Block>& block : blocks) {
+      vkFreeMemory(device_, block->memory, nullptr);
+    }
+    blocks.clear();
+  };
+  for (Type& type : types_) {
+    free_blocks(type.general);
+    free_blocks(type.buddy);
+    for (Blocks& blocks : type.frames) {
+      free_blocks(blocks);
+    }
+  }
+  return;
+}
+
+u32 MemoryAllocator::rank_types(
+    u32 type_bits, MemoryUsage usage, u32* ranked
+) const {
+  const Preference& preference = preferences[(u32)usage];
+
+  i32 scores[VK_MAX_MEMORY_TYPES];
+  u32 count = 0;
+  for (u32 i = 0; i < types_.size(); ++i) {
+    VkMemoryPropertyFlags flags = types_[i].flags;
+    if ((type_bits & (1u << i)) == 0 ||
+        (flags & preference.required) != preference.required ||
+        (flags & excluded) != 0) {
+      continue;
+    }
+    scores[i] = bit_count(flags & preference.preferred) -
+                bit_count(flags & preference.avoided);
+    ranked[count++] = i;
+  }
+  // types come from the fastest, ties keep that order
+  std::stable_sort(ranked, ranked + count, [&scores](u32 a, u32 b) {
+    return scores[a] > scores[b];
+  });
+  return count;
+}
+
+MemoryAllocator::Blocks& MemoryAllocator::blocks_of(
+    u32 type, MemoryUsage usage
+) {
+  switch (usage) {
+    case MemoryUsage::kRenderTarget:
+      return types_[type].buddy;
+    case MemoryUsage::kFrame:
+      return types_[type].frames[frame_slot_];
+    default:
+      break;
+  }
+  return types_[type].general;
+}
+
+u64 MemoryAllocator::estimated_usage(const Heap& heap) const {
+  // blocks allocated or freed since the last query are accounted here
+  u64 usage = heap.usage + heap.block_bytes;
+  return usage > heap.usage_blocks ? usage - heap.usage_blocks : 0;
+}
+
+MemoryAllocator::Block* MemoryAllocator::place(
+    u32         type,
+    u64         size,
+    u64         alignment,
+    MemoryUsage usage,
+    b8          over_budget,
+    Region*     region
+) {
+  // big allocations get a block of their own
+  u64 block_size = types_[type].block_size;
+  b8  dedicated  = usage != MemoryUsage::kFrame && size > block_size / 2;
+  if (!dedicated) {
+    for (const std::unique_ptr<Block>& block : blocks_of(type, usage)) {
+      if (!block->dedicated &&
+          block->suballocator->allocate(size, alignment, region)) {
+        return block.get();
+      }
+    }
+  }
+
+  if (dedicated) {
+    block_size = align_up(size, atom_size_);
+  } else if (usage == MemoryUsage::kFrame) {
+    block_size = std::max(kFrameBlockSize, align_up(size, atom_size_));
+  }
+  const Heap& heap = heaps_[types_[type].heap];
+  if (!over_budget && estimated_usage(heap) + block_size > heap.budget) {
+    return nullptr;
+  }
+
+  Block* block = create_block(type, block_size, usage, dedicated);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  if (over_budget) {
+    EMBERS_WARN(
+        "Heap {} over budget: {} of {} bytes",
+        types_[type].heap,
+        estimated_usage(heap),
+        heap.budget
+    );
+  }
+  block->suballocator->allocate(size, alignment, region);
+  return block;
+}
+
+MemoryAllocator::Block* MemoryAllocator::create_block(
+    u32 type, u64 size, MemoryUsage usage, b8 dedicated
+) {
+  if (block_count_ >= max_blocks_) {
+    EMBERS_ERROR("maxMemoryAllocationCount of {} reached", max_blocks_);
+    return nullptr;
+  }
+
+  VkMemoryAllocateInfo allocate_info = {};
+  allocate_info.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocate_info.allocationSize       = size;
+  allocate_info.memoryTypeIndex      = type;
+
+  VkDeviceMemory memory = nullptr;
+  void*          mapped = nullptr;
+  VkResult       result = vkAllocateMemory(  //
+      device_,
+      &allocate_info,
+      nullptr,
+      &memory
+  );
+  if (result != VK_SUCCESS) {
+    // the heap is full, the next memory type may not be
+    EMBERS_DEBUG(
+        "vkAllocateMemory of {} bytes returned {}",
+        size,
+        (i32)result
+    );
+    return nullptr;
+  }
+  if ((types_[type].flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+    result = vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR(
+          "Unable to map device memory: vkMapMemory returned {}",
+          (i32)result
+      );
+      last_error_ = Error::kVulkanMapMemory;
+      vkFreeMemory(device_, memory, nullptr);
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<Block> block(new Block);
+  block->memory    = memory;
+  block->mapped    = (u8*)mapped;
+  block->type      = type;
+  block->usage     = usage;
+  block->dedicated = dedicated;
+  block->allocated = 0;
+  if (dedicated || usage == MemoryUsage::kFrame) {
+    block->suballocator.reset(new LinearSuballocator(size));
+  } else if (usage == MemoryUsage::kRenderTarget) {
+    block->suballocator.reset(
+        new BuddySuballocator(size, std::max(kBuddyMinSize, granularity_))
+    );
+  } else {
+    block->suballocator.reset(new TlsfSuballocator(size));
+  }
+
+  Heap& heap         = heaps_[types_[type].heap];
+  heap.block_bytes  += size;
+  heap.block_count++;
+  block_count_++;
+
+  Blocks& blocks = blocks_of(type, usage);
+  blocks.push_back(std::move(block));
+  return blocks.back().get();
+}
+
+void MemoryAllocator::destroy_block(Block* block) {
+  Heap& heap         = heaps_[types_[block->type].heap];
+  heap.block_bytes  -= block->suballocator->size();
+  heap.block_count--;
+  block_count_--;
+  vkFreeMemory(device_, block->memory, nullptr);
+
+  Blocks& blocks = blocks_of(block->type, block->usage);
+  blocks.erase(std::find_if(
+      blocks.begin(),
+      blocks.end(),
+      [block](const std::unique_ptr<Block>& x) { return x.get() == block; }
+  ));
+  return;
+}
+
+void MemoryAllocator::release_if_empty(Block* block) {
+  if (!block->suballocator->empty() || block->usage == MemoryUsage::kFrame) {
+    return;
+  }
+  // a spare block saves a driver call to allocations coming and going
+  Blocks& blocks = blocks_of(block->type, block->usage);
+  b8      spare  = block->dedicated;
+  for (const std::unique_ptr<Block>& other : blocks) {
+    spare |= other.get() != block && !other->dedicated &&
+             other->suballocator->empty();
+  }
+  if (spare) {
+    destroy_block(block);
+  }
+  return;
+}
+
+Allocation MemoryAllocator::make_allocation(
+    const Block* block, const Region& region, u32 id
+) const {
+  return {
+      block->memory,
+      region.offset,
+      region.size,
+      block->mapped != nullptr ? block->mapped + region.offset : nullptr,
+      block->type,
+      id,
+  };
+}
+
+Allocation MemoryAllocator::allocate(
+    const VkMemoryRequirements& requirements,
+    MemoryUsage                 usage,
+    Tiling                      tiling,
+    void*                       user_data
+) {
+  u64 size      = requirements.size;
+  u64 alignment = std::max<u64>(requirements.alignment, 1);
+  if (tiling == Tiling::kOptimal && granularity_ > 1) {
+    alignment = std::max(alignment, granularity_);
+    size      = align_up(size, granularity_);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  u32 ranked[VK_MAX_MEMORY_TYPES];
+  u32 count = rank_types(requirements.memoryTypeBits, usage, ranked);
+  if (count == 0) {
+    EMBERS_ERROR(
+        "No memory type for usage {} among types {:#x}",
+        (u32)usage,
+        requirements.memoryTypeBits
+    );
+    last_error_ = Error::kVulkanMemoryType;
+    return {};
+  }
+
+  // the best type within its budget, or over it
+  Block* block  = nullptr;
+  Region region = {};
+  for (u32 pass = 0; pass < 2 && block == nullptr; ++pass) {
+    for (u32 i = 0; i < count && block == nullptr; ++i) {
+      block = place(ranked[i], size, alignment, usage, pass == 1, &region);
+    }
+  }
+  if (block == nullptr) {
+    EMBERS_ERROR("Unable to allocate {} bytes of device memory", size);
+    last_error_ = Error::kVulkanAllocateMemory;
+    return {};
+  }
+
+  Heap& heap             = heaps_[types_[block->type].heap];
+  heap.allocation_bytes += region.size;
+  heap.allocation_count++;
+  block->allocated += region.size;
+
+  u32 id = kFrameAllocation;
+  if (usage != MemoryUsage::kFrame) {
+    if (free_record_ != Suballocator::kNone) {
+      id           = free_record_;
+      free_record_ = records_[id].next_free;
+    } else {
+      id = (u32)records_.size();
+      records_.emplace_back();
+    }
+    records_[id] = {block, region, alignment, user_data, Suballocator::kNone};
+  }
+  return make_allocation(block, region, id);
+}
+
+Allocation MemoryAllocator::allocate_buffer(
+    VkBuffer buffer, MemoryUsage usage, void* user_data
+) {
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+
+  Allocation allocation =
+      allocate(requirements, usage, Tiling::kLinear, user_data);
+  if (!allocation) {
+    return allocation;
+  }
+  VkResult result = vkBindBufferMemory(
+      device_,
+      buffer,
+      allocation.memory,
+      allocation.offset
+  );
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("vkBindBufferMemory returned {}", (i32)result);
+    last_error_ = Error::kVulkanAllocateMemory;
+    free(allocation);
+    return {};
+  }
+  return allocation;
+}
+
+Allocation MemoryAllocator::allocate_image(
+    VkImage image, MemoryUsage usage, Tiling tiling, void* user_data
+) {
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(device_, image, &requirements);
+
+  Allocation allocation = allocate(requirements, usage, tiling, user_data);
+  if (!allocation) {
+    return allocation;
+  }
+  VkResult result = vkBindImageMemory(
+      device_,
+      image,
+      allocation.memory,
+      allocation.offset
+  );
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("vkBindImageMemory returned {}", (i32)result);
+    last_error_ = Error::kVulkanAllocateMemory;
+    free(allocation);
+    return {};
+  }
+  return allocation;
+}
+
+void MemoryAllocator::free(const Allocation& allocation) {
+  if (!allocation || allocation.id == kFrameAllocation) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Record& record         = records_[allocation.id];
+  Block*  block          = record.block;
+  Heap&   heap           = heaps_[types_[block->type].heap];
+  heap.allocation_bytes -= record.region.size;
+  heap.allocation_count--;
+  block->allocated -= record.region.size;
+  block->suballocator->free(record.region);
+
+  record.block     = nullptr;
+  record.next_free = free_record_;
+  free_record_     = allocation.id;
+  release_if_empty(block);
+  return;
+}
+
+void MemoryAllocator::begin_frame(u32 slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  frame_slot_ = slot % frames_in_flight_;
+  for (Type& type : types_) {
+    Heap& heap = heaps_[type.heap];
+    for (const std::unique_ptr<Block>& block : type.frames[frame_slot_]) {
+      heap.allocation_bytes -= block->allocated;
+      heap.allocation_count -= block->suballocator->count();
+      block->allocated       = 0;
+      block->suballocator->reset();
+    }
+  }
+  return;
+}
+
+void MemoryAllocator::flush(const Allocation& allocation) {
+  if (allocation.mapped == nullptr ||
+      (types_[allocation.memory_type].flags &
+       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+    return;
+  }
+  // blocks are sized in atoms, the rounded range stays within
+  VkMappedMemoryRange range = {};
+  range.sType               = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory              = allocation.memory;
+  range.offset              = allocation.offset / atom_size_ * atom_size_;
+  range.size =
+      align_up(allocation.offset + allocation.size, atom_size_) - range.offset;
+  vkFlushMappedMemoryRanges(device_, 1, &range);
+  return;
+}
+
+void MemoryAllocator::invalidate(const Allocation& allocation) {
+  if (allocation.mapped == nullptr ||
+      (types_[allocation.memory_type].flags &
+       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+    return;
+  }
+  VkMappedMemoryRange range = {};
+  range.sType               = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory              = allocation.memory;
+  range.offset              = allocation.offset / atom_size_ * atom_size_;
+  range.size =
+      align_up(allocation.offset + allocation.size, atom_size_) - range.offset;
+  vkInvalidateMappedMemoryRanges(device_, 1, &range);
+  return;
+}
+
+void MemoryAllocator::update_budget() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!memory_budget_) {
+    for (Heap& heap : heaps_) {
+      heap.budget       = heap.size / 10 * 8;
+      heap.usage        = heap.block_bytes;
+      heap.usage_blocks = heap.block_bytes;
+    }
+    return;
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget     = {};
+  VkPhysicalDeviceMemoryProperties2         properties = {};
+  budget.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  properties.pNext = &budget;
+  vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+
+  for (u32 i = 0; i < heaps_.size(); ++i) {
+    heaps_[i].budget       = budget.heapBudget[i];
+    heaps_[i].usage        = budget.heapUsage[i];
+    heaps_[i].usage_blocks = heaps_[i].block_bytes;
+  }
+  return;
+}
+
+u32 MemoryAllocator::heap_count() const { return (u32)heaps_.size(); }
+
+HeapStats MemoryAllocator::heap_stats(u32 heap) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const Heap& h = heaps_[heap];
+  return {
+      h.size,
+      h.budget,
+      estimated_usage(h),
+      h.block_bytes,
+      h.allocation_bytes,
+      h.block_count,
+      h.allocation_count,
+  };
+}
+
+Vector<DefragmentationMove> MemoryAllocator::begin_defragmentation(
+    u64 max_bytes
+) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Vector<DefragmentationMove> moves;
+  u64                         bytes = 0;
+  for (u32 type = 0; type < types_.size(); ++type) {
+    Vector<Block*> blocks;
+    for (const std::unique_ptr<Block>& block : types_[type].general) {
+      if (!block->dedicated && !block->suballocator->empty()) {
+        blocks.push_back(block.get());
+      }
+    }
+    if (blocks.size() < 2) {
+      continue;
+    }
+    std::sort(blocks.begin(), blocks.end(), [](Block* a, Block* b) {
+      return a->suballocator->used() < b->suballocator->used();
+    });
+
+    Vector<Vector<u32>> owned(blocks.size());
+    for (u32 id = 0; id < records_.size(); ++id) {
+      auto iter = std::find(blocks.begin(), blocks.end(), records_[id].block);
+      if (iter != blocks.end()) {
+        owned[iter - blocks.begin()].push_back(id);
+      }
+    }
+
+    // a block is only emptied when all of its allocations find room in a
+    // more used block, and a block receiving allocations isn't emptied
+    u32 receiving = (u32)blocks.size();
+    for (u32 source = 0; source < receiving; ++source) {
+      size_t first_move   = moves.size();
+      size_t first_pend   = pending_.size();
+      u64    source_bytes = 0;
+      b8     moved_all    = true;
+
+      for (u32 id : owned[source]) {
+        const Record& record = records_[id];
+        Region        region = {};
+        u32           target = source;
+        for (u32 i = (u32)blocks.size() - 1; i > source; --i) {
+          if (blocks[i]->suballocator->allocate(
+                  record.region.size,
+                  record.alignment,
+                  &region
+              )) {
+            target = i;
+            break;
+          }
+        }
+        if (target == source) {
+          moved_all = false;
+          break;
+        }
+        receiving = std::min(receiving, target);
+        pending_.push_back({id, blocks[target], region});
+        moves.push_back({
+            make_allocation(record.block, record.region, id),
+            make_allocation(blocks[target], region, id),
+            record.user_data,
+        });
+        source_bytes += record.region.size;
+      }
+
+      if (!moved_all || bytes + source_bytes > max_bytes) {
+        for (size_t i = first_pend; i < pending_.size(); ++i) {
+          pending_[i].block->suballocator->free(pending_[i].region);
+        }
+        pending_.resize(first_pend);
+        moves.resize(first_move);
+        break;
+      }
+      bytes += source_bytes;
+    }
+  }
+  return moves;
+}
+
+void MemoryAllocator::end_defragmentation() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Vector<Block*> sources;
+  for (const Pending& move : pending_) {
+    Record& record = records_[move.id];
+    record.block->suballocator->free(record.region);
+    record.block->allocated -= record.region.size;
+    move.block->allocated   += move.region.size;
+    sources.push_back(record.block);
+
+    record.block  = move.block;
+    record.region = move.region;
+  }
+  pending_.clear();
+
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+  for (Block* block : sources) {
+    release_if_empty(block);
+  }
+  return;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <memory>
+#include <mutex>
+
+#include "../error_code.hpp"
+#include "common.hpp"
+#include "device.hpp"
+#include "suballocator.hpp"
+
+struct VkMemoryRequirements;
+typedef struct VkDeviceMemory_T* VkDeviceMemory;
+typedef struct VkBuffer_T*       VkBuffer;
+typedef struct VkImage_T*        VkImage;
+
+namespace embers::vulkan {
+
+/// What the memory is for, picks the memory type and the suballocator
+enum class MemoryUsage : u8 {
+  kDevice,        // read and written by the GPU only
+  kRenderTarget,  // attachments, big and recreated with the swapchain
+  kUpload,        // written by the CPU, copied from by the GPU
+  kReadback,      // written by the GPU, read by the CPU
+  kFrame,         // written by the CPU every frame, lives one frame
+};
+
+/// Linear and optimal resources can't share a page of bufferImageGranularity
+enum class Tiling : u8 {
+  kLinear,   // buffers, images of linear tiling
+  kOptimal,  // images of optimal tiling
+};
+
+struct Allocation {
+  VkDeviceMemory memory;
+  u64            offset;
+  u64            size;
+  void*          mapped;  // nullptr unless host visible
+  u32            memory_type;
+  u32            id;  // within the MemoryAllocator
+
+  constexpr explicit operator bool() const;
+};
+
+struct HeapStats {
+  u64 size;
+  u64 budget;  // for the process, VK_EXT_memory_budget or 80% of the heap
+  u64 usage;   // of the process, estimated since update_budget()
+  u64 block_bytes;
+  u64 allocation_bytes;
+  u32 block_count;
+  u32 allocation_count;
+};
+
+/// The resource bound to `from` is to be copied to a new resource bound to
+/// `to`, see MemoryAllocator::begin_defragmentation()
+struct DefragmentationMove {
+  Allocation from;
+  Allocation to;
+  void*      user_data;
+};
+
+/// Device memory in blocks of kBlockSize per memory type, allocations are
+/// placed within them so the driver is rarely called and the count of
+/// allocations stays far below maxMemoryAllocationCount. The suballocator
+/// of a block follows the usage:
+/// - kFrame goes to linear blocks per frame in flight, freed as a whole by
+///   begin_frame()
+/// - kRenderTarget goes to buddy blocks
+/// - the others to TLSF blocks
+///
+/// Allocations of more than half a block get a block of their own. Images
+/// of optimal tiling are aligned and padded to bufferImageGranularity, so
+/// no page holds resources of both tilings. New blocks go to the first
+/// memory type of the usage whose heap stays within its budget. Thread
+/// safe
+class MemoryAllocator {
+ public:
+  constexpr static u64 kBlockSize       = 256ull << 20;  // at most heap / 8
+  constexpr static u64 kFrameBlockSize  = 16ull << 20;
+  constexpr static u64 kBuddyMinSize    = 64ull << 10;
+  constexpr static u32 kFrameAllocation = u32_MAX;  // id of frame memory
+
+ private:
+  struct Block {
+    VkDeviceMemory                memory;
+    u8*                           mapped;
+    u32                           type;
+    MemoryUsage                   usage;
+    b8                            dedicated;
+    u64                           allocated;
+    std::unique_ptr<Suballocator> suballocator;
+  };
+  using Blocks = Vector<std::unique_ptr<Block>>;
+
+  struct Type {
+    u32            flags;  // VkMemoryPropertyFlags
+    u32            heap;
+    u64            block_size;
+    Blocks         general;
+    Blocks         buddy;
+    Vector<Blocks> frames;  // by frame slot
+  };
+
+  struct Heap {
+    u64 size;
+    u64 budget;
+    u64 usage;  // as of update_budget()
+    u64 usage_blocks;
+    u64 block_bytes;
+    u64 allocation_bytes;
+    u32 block_count;
+    u32 allocation_count;
+  };
+
+  struct Record {
+    Block* block;  // nullptr once freed
+    Region region;
+    u64    alignment;
+    void*  user_data;
+    u32    next_free;
+  };
+
+  struct Pending {
+    u32    id;
+    Block* block;
+    Region region;
+  };
+
+  static Error last_error_;
+
+  VkDevice           device_;  // doesn't own
+  VkPhysicalDevice   physical_device_;
+  b8                 memory_budget_;
+  u64                granularity_;
+  u64                atom_size_;  // of flushes of non coherent memory
+  u32                max_blocks_;
+  u32                block_count_;
+  u32                frames_in_flight_;
+  u32                frame_slot_;
+  Vector<Type>       types_;
+  Vector<Heap>       heaps_;
+  Vector<Record>     records_;
+  u32                free_record_;
+  Vector<Pending>    pending_;  // moves of the defragmentation
+  mutable std::mutex mutex_;
+
+  /// Memory types allowed by `type_bits` fitting `usage`, best first
+  u32     rank_types(u32 type_bits, MemoryUsage usage, u32* ranked) const;
+  Blocks& blocks_of(u32 type, MemoryUsage usage);
+  u64     estimated_usage(const Heap& heap) const;
+
+  /// In an existing block of `type` or a new one, within the budget of
+  /// its heap unless `over_budget`
+  Block* place(
+      u32         type,
+      u64         size,
+      u64         alignment,
+      MemoryUsage usage,
+      b8          over_budget,
+      Region*     region
+  );
+  Block* create_block(u32 type, u64 size, MemoryUsage usage, b8 dedicated);
+  void   destroy_block(Block* block);
+  /// Destroys `block` when it is empty, but one spare block per list
+  void   release_if_empty(Block* block);
+
+  Allocation make_allocation(const Block* block, const Region& region, u32 id)
+      const;
+
+ public:
+  MemoryAllocator() = delete;
+  explicit MemoryAllocator(const Device& device, u32 frames_in_flight = 2);
+  MemoryAllocator(const MemoryAllocator& other) = delete;
+  MemoryAllocator(MemoryAllocator&& other)      = delete;
+  ~MemoryAllocator();
+
+  constexpr explicit operator bool() const;
+  MemoryAllocator&   operator=(const MemoryAllocator& rhs) = delete;
+  MemoryAllocator&   operator=(MemoryAllocator&& rhs)      = delete;
+
+  /// Failed allocations have no memory
+  Allocation allocate(
+      const VkMemoryRequirements& requirements,
+      MemoryUsage                 usage,
+      Tiling                      tiling    = Tiling::kLinear,
+      void*                       user_data = nullptr
+  );
+  /// Allocates the memory of `buffer` and binds it
+  Allocation allocate_buffer(
+      VkBuffer buffer, MemoryUsage usage, void* user_data = nullptr
+  );
+  /// Allocates the memory of `image` and binds it
+  Allocation allocate_image(
+      VkImage     image,
+      MemoryUsage usage,
+      Tiling      tiling    = Tiling::kOptimal,
+      void*       user_data = nullptr
+  );
+  /// Frame memory is freed by begin_frame()
+  void free(const Allocation& allocation);
+
+  /// Frame memory of the frame that last used `slot` is freed, the next
+  /// frame allocations go to the blocks of `slot`
+  void begin_frame(u32 slot);
+
+  /// Makes CPU writes visible to the GPU, nothing for coherent memory
+  void flush(const Allocation& allocation);
+  /// Makes GPU writes visible to the CPU, nothing for coherent memory
+  void invalidate(const Allocation& allocation);
+
+  /// Queries the budgets and usages of the heaps again, once in a while
+  void      update_budget();
+  u32       heap_count() const;
+  HeapStats heap_stats(u32 heap) const;
+
+  /// Plans moving allocations out of the least used TLSF blocks into the
+  /// most used ones, at most `max_bytes` of them. Destinations are
+  /// reserved: the caller creates resources bound to them, records the
+  /// copies and, once the GPU is done, calls end_defragmentation(). The
+  /// allocations moved can't be freed in between
+  Vector<DefragmentationMove> begin_defragmentation(u64 max_bytes = u64_MAX);
+  /// The allocations moved now lie at `to`, blocks left empty are freed
+  void end_defragmentation();
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr Allocation::operator bool() const { return memory != nullptr; }
+
+constexpr MemoryAllocator::operator bool() const { return device_ != nullptr; }
+
+EMBERS_ALWAYS_INLINE Error MemoryAllocator::get_last_error() {
+  return last_error_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "pipeline_cache.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <embers/logger.hpp>
+
+#include "../io/file.hpp"
+#include "../jobs/jobs.hpp"
+
+namespace embers::vulkan {
+
+namespace {
+
+/// fnv-1a, catches files that were truncated or damaged
+u64 hash(const u8* data, u64 size) {
+  u64 hash = 0xcbf29ce484222325;
+  for (u64 i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+}  // namespace
+
+Error PipelineCache::last_error_ = Error::kUnknown;
+
+PipelineCache::PipelineCache(
+    const Device& device, const char* path, u32 thread_count
+)
+    : device_((VkDevice)device),
+      cache_(nullptr),
+      threads_(std::max(thread_count, 1u), nullptr),
+      path_(path),
+      loaded_size_(0),
+      created_(Clock::now()),
+      pipeline_count_(0),
+      compile_nanoseconds_(0) {
+  if (!(bool)device) {
+    EMBERS_FATAL(
+        "Can't init pipeline cache; {} must be valid",
+        "Vulkan device"
+    );
+    device_ = nullptr;
+    return;
+  }
+
+  Vector<u8> data = load(device.physical_device());
+
+  VkPipelineCacheCreateInfo info = {};
+  info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  info.initialDataSize = data.size();
+  info.pInitialData    = data.data();
+  VkResult result = vkCreatePipelineCache(device_, &info, nullptr, &cache_);
+  if (result != VK_SUCCESS && !data.empty()) {
+    EMBERS_WARN("Pipeline cache {} rejected: {}", path, (i32)result);
+    data.clear();
+    info.initialDataSize = 0;
+    info.pInitialData    = nullptr;
+    result = vkCreatePipelineCache(device_, &info, nullptr, &cache_);
+  }
+  // every thread starts as warm as the shared cache
+  for (VkPipelineCache& cache : threads_) {
+    if (result == VK_SUCCESS) {
+      result = vkCreatePipelineCache(device_, &info, nullptr, &cache);
+    }
+  }
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create pipeline cache: {}", (i32)result);
+    last_error_ = Error::kVulkanPipelineCache;
+    destroy();
+    return;
+  }
+
+  loaded_size_ = data.size();
+  if (warm()) {
+    EMBERS_INFO(
+        "Pipeline cache of {} bytes loaded from {} in {:.3f} ms",
+        loaded_size_,
+        path,
+        std::chrono::duration<f64, std::milli>(Clock::now() - created_)
+            .count()
+    );
+  } else {
+    EMBERS_INFO("No pipeline cache fits the device at {}, cold start", path);
+  }
+  return;
+}
+
+PipelineCache::~PipelineCache() {
+  if (device_ == nullptr) {
+    return;
+  }
+  report();
+  save();
+  destroy();
+  return;
+}
+
+void PipelineCache::destroy() {
+  for (VkPipelineCache cache : threads_) {
+    if (cache != nullptr) {
+      vkDestroyPipelineCache(device_, cache, nullptr);
+    }
+  }
+  if (cache_ != nullptr) {
+    vkDestroyPipelineCache(device_, cache_, nullptr);
+  }
+  device_ = nullptr;
+  return;
+}
+
+Vector<u8> PipelineCache::load(VkPhysicalDevice physical_device) const {
+  if (!io::file_exists(path_.c_str())) {
+    return {};
+  }
+  io::MappedFile file(path_.c_str());
+  if (!file) {
+    return {};
+  }
+
+  Header header = {};
+  if (file.size() >= sizeof(Header)) {
+    std::memcpy(&header, file.data(), sizeof(Header));
+  }
+  const u8* data = file.data() + sizeof(Header);
+  if (file.size() < sizeof(Header) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      header.size != file.size() - sizeof(Header) ||
+      header.hash != hash(data, header.size)) {
+    EMBERS_WARN("Pipeline cache {} is damaged, ignored", path_.c_str());
+    return {};
+  }
+
+  // written by the same driver for the same device
+  VkPipelineCacheHeaderVersionOne cache_header = {};
+  VkPhysicalDeviceProperties      properties   = {};
+  if (header.size >= sizeof(cache_header)) {
+    std::memcpy(&cache_header, data, sizeof(cache_header));
+  }
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  if (header.size < sizeof(cache_header) ||
+      cache_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      cache_header.vendorID != properties.vendorID ||
+      cache_header.deviceID != properties.deviceID ||
+      std::memcmp(
+          cache_header.pipelineCacheUUID,
+          properties.pipelineCacheUUID,
+          VK_UUID_SIZE
+      ) != 0) {
+    EMBERS_INFO(
+        "Pipeline cache {} is of another device or driver, ignored",
+        path_.c_str()
+    );
+    return {};
+  }
+  return Vector<u8>(data, data + header.size);
+}
+
+VkPipelineCache PipelineCache::get() const {
+  u32 thread = jobs::System::thread_index();
+  return thread < threads_.size() ? threads_[thread] : cache_;
+}
+
+void PipelineCache::count(f64 seconds) {
+  pipeline_count_.fetch_add(1, std::memory_order_relaxed);
+  compile_nanoseconds_.fetch_add(
+      (u64)(seconds * 1e9),
+      std::memory_order_relaxed
+  );
+  return;
+}
+
+void PipelineCache::report() const {
+  EMBERS_INFO(
+      "{} startup: {} pipelines created in {:.3f} s, {:.3f} s since the "
+      "pipeline cache was loaded",
+      warm() ? "Warm" : "Cold",
+      pipeline_count_.load(std::memory_order_relaxed),
+      (f64)compile_nanoseconds_.load(std::memory_order_relaxed) / 1e9,
+      std::chrono::duration<f64>(Clock::now() - created_).count()
+  );
+  return;
+}
+
+b8 PipelineCache::save() {
+  VkResult result = vkMergePipelineCaches(
+      device_,
+      cache_,
+      (u32)threads_.size(),
+      threads_.data()
+  );
+  size_t size = 0;
+  if (result == VK_SUCCESS) {
+    result = vkGetPipelineCacheData(device_, cache_, &size, nullptr);
+  }
+  Vector<u8> data(size);
+  if (result == VK_SUCCESS) {
+    result = vkGetPipelineCacheData(device_, cache_, &size, data.data());
+    data.resize(size);
+  }
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    EMBERS_ERROR("Unable to get pipeline cache data: {}", (i32)result);
+    last_error_ = Error::kVulkanPipelineCache;
+    return false;
+  }
+
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.size    = data.size();
+  header.hash    = hash(data.data(), data.size());
+
+  String temporary = path_ + ".tmp";
+  {
+    io::File file(temporary.c_str());
+    if (!file) {
+      last_error_ = io::File::get_last_error();
+      return false;
+    }
+    if (!file.write(&header, sizeof(header)) ||
+        !file.write(data.data(), data.size()) || !file.sync()) {
+      EMBERS_ERROR("Unable to write pipeline cache {}", temporary.c_str());
+      last_error_ = Error::kIoWriteFile;
+      return false;
+    }
+  }
+  if (!io::replace_file(temporary.c_str(), path_.c_str())) {
+    EMBERS_ERROR("Unable to replace {} with the new cache", path_.c_str());
+    last_error_ = Error::kIoWriteFile;
+    return false;
+  }
+  EMBERS_DEBUG(
+      "Pipeline cache of {} bytes written to {}",
+      data.size(),
+      path_.c_str()
+  );
+  return true;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "../error_code.hpp"
+#include "common.hpp"
+#include "device.hpp"
+
+typedef struct VkPipelineCache_T* VkPipelineCache;
+
+namespace embers::vulkan {
+
+/// VkPipelineCache kept on disk between runs, created right after the
+/// Device. The file is only used when written for the same vendor, device
+/// and pipelineCacheUUID (driver), anything else is a cold start.
+///
+/// Every thread of a jobs::System creates its pipelines with a cache of its
+/// own, save() merges them and writes the file atomically: a crash leaves
+/// the previous file. The time spent compiling pipelines is counted to
+/// compare cold and warm startups
+class PipelineCache {
+  using Clock  = std::chrono::steady_clock;
+  using String =
+      std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+
+  /// Of the file, followed by the data of the VkPipelineCache
+  struct Header {
+    char magic[8];
+    u32  version;
+    u32  reserved;
+    u64  size;  // of the data
+    u64  hash;  // fnv-1a of the data
+  };
+
+  static Error last_error_;
+
+  VkDevice                device_;  // doesn't own
+  VkPipelineCache         cache_;   // the thread caches are merged into it
+  Vector<VkPipelineCache> threads_;  // by jobs::System::thread_index()
+  String                  path_;
+  u64                     loaded_size_;  // 0 on cold starts
+  Clock::time_point       created_;
+  std::atomic<u64>        pipeline_count_;
+  std::atomic<u64>        compile_nanoseconds_;
+
+  /// Data of the file when it fits the device, empty otherwise
+  Vector<u8> load(VkPhysicalDevice physical_device) const;
+  void       destroy();
+
+ public:
+  constexpr static char kMagic[8] = {'E', 'M', 'B', 'E', 'R', 'S', 'P', 'C'};
+  constexpr static u32  kVersion  = 1;
+
+  PipelineCache() = delete;
+  /// Caches for `thread_count` threads, see jobs::System::thread_index()
+  PipelineCache(const Device& device, const char* path, u32 thread_count = 1);
+  PipelineCache(const PipelineCache& other) = delete;
+  PipelineCache(PipelineCache&& other)      = delete;
+  /// Logs report() and saves the cache
+  ~PipelineCache();
+
+  constexpr explicit operator bool() const;
+  PipelineCache&     operator=(const PipelineCache& rhs) = delete;
+  PipelineCache&     operator=(PipelineCache&& rhs)      = delete;
+
+  /// Cache of the calling thread, the shared one for unknown threads
+  VkPipelineCache get() const;
+  /// Whether the cache was loaded from the file
+  EMBERS_ALWAYS_INLINE b8 warm() const;
+
+  /// Counts a pipeline created in `seconds`
+  void count(f64 seconds);
+  /// Logs the pipelines created since the cache was, and how long it took.
+  /// Also logged when the cache is destroyed
+  void report() const;
+
+  /// Merges the thread caches and replaces the file, false on failure
+  b8 save();
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr PipelineCache::operator bool() const { return device_ != nullptr; }
+
+EMBERS_ALWAYS_INLINE b8 PipelineCache::warm() const {
+  return loaded_size_ != 0;
+}
+
+EMBERS_ALWAYS_INLINE Error PipelineCache::get_last_error() {
+  return last_error_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,477 @@
+#include "pipelines.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstring>
+#include <embers/logger.hpp>
+#include <type_traits>
+
+namespace embers::vulkan {
+
+static_assert(
+    std::has_unique_object_representations_v<GraphicsPipelineDesc>,
+    "GraphicsPipelineDesc is compared by its bytes, it can't have padding"
+);
+
+namespace {
+
+constexpr VkGraphicsPipelineLibraryFlagsEXT kParts[
+    PipelineCompiler::kPartCount
+] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+/// fnv-1a of `size` bytes, continuing `hash`
+u64 hash(u64 hash, const void* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ ((const u8*)data)[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+template <typename T>
+u64 mix(u64 seed, const T& value) {
+  return hash(seed, &value, sizeof(T));
+}
+
+/// Of the fields a part of the pipeline is built from
+u64 hash_part(const GraphicsPipelineDesc& desc, u32 part) {
+  u64 h = mix(0xcbf29ce484222325, part);
+  switch (kParts[part]) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+      h = mix(h, desc.topology);
+      h = mix(h, desc.binding_count);
+      h = mix(h, desc.bindings);
+      h = mix(h, desc.attribute_count);
+      h = mix(h, desc.attributes);
+      return h;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+      h = mix(h, desc.vertex);
+      h = mix(h, desc.cull_mode);
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+      h = mix(h, desc.fragment);
+      h = mix(h, desc.samples);
+      h = mix(h, desc.depth_test);
+      h = mix(h, desc.depth_write);
+      h = mix(h, desc.depth_compare);
+      break;
+    default:
+      h = mix(h, desc.samples);
+      h = mix(h, desc.blend);
+      h = mix(h, desc.color_attachment_count);
+      h = mix(h, desc.render_pass);
+      h = mix(h, desc.subpass);
+      return h;
+  }
+  // the shader parts
+  h = mix(h, desc.layout);
+  h = mix(h, desc.render_pass);
+  h = mix(h, desc.subpass);
+  h = mix(h, desc.constant_count);
+  h = mix(h, desc.constant_ids);
+  h = mix(h, desc.constants);
+  return h;
+}
+
+/// Create info of a pipeline from its desc, or of some of its parts
+struct CreateInfo {
+  using Desc = GraphicsPipelineDesc;
+
+  VkSpecializationMapEntry               constants[Desc::kMaxConstants];
+  VkSpecializationInfo                   specialization;
+  VkPipelineShaderStageCreateInfo        stages[2];  // vertex, fragment
+  VkVertexInputBindingDescription        bindings[Desc::kMaxBindings];
+  VkVertexInputAttributeDescription      attributes[Desc::kMaxAttributes];
+  VkPipelineVertexInputStateCreateInfo   vertex_input;
+  VkPipelineInputAssemblyStateCreateInfo input_assembly;
+  VkPipelineViewportStateCreateInfo      viewport;
+  VkPipelineRasterizationStateCreateInfo rasterization;
+  VkPipelineMultisampleStateCreateInfo   multisample;
+  VkPipelineDepthStencilStateCreateInfo  depth_stencil;
+  VkPipelineColorBlendAttachmentState    blends[Desc::kMaxColorAttachments];
+  VkPipelineColorBlendStateCreateInfo    blend;
+  VkDynamicState                         dynamic_states[2];
+  VkPipelineDynamicStateCreateInfo       dynamic;
+  VkGraphicsPipelineLibraryCreateInfoEXT library;
+  VkGraphicsPipelineCreateInfo           info;
+
+  CreateInfo() = delete;
+  /// Of the whole pipeline when `part` is u32_MAX
+  CreateInfo(const GraphicsPipelineDesc& desc, u32 part);
+  CreateInfo(const CreateInfo& other) = delete;
+  CreateInfo(CreateInfo&& other)      = delete;
+};
+
+CreateInfo::CreateInfo(const GraphicsPipelineDesc& desc, u32 part) {
+  for (u32 i = 0; i < desc.constant_count; ++i) {
+    constants[i].constantID = desc.constant_ids[i];
+    constants[i].offset     = i * sizeof(u32);
+    constants[i].size       = sizeof(u32);
+  }
+  specialization               = {};
+  specialization.mapEntryCount = desc.constant_count;
+  specialization.pMapEntries   = constants;
+  specialization.dataSize      = desc.constant_count * sizeof(u32);
+  specialization.pData         = desc.constants;
+
+  for (VkPipelineShaderStageCreateInfo& stage : stages) {
+    stage       = {};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.pName = "main";
+    stage.pSpecializationInfo = &specialization;
+  }
+  stages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = desc.vertex;
+  stages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = desc.fragment;
+
+  for (u32 i = 0; i < desc.binding_count; ++i) {
+    bindings[i].binding   = i;
+    bindings[i].stride    = desc.bindings[i].stride;
+    bindings[i].inputRate = desc.bindings[i].per_instance != 0
+                                ? VK_VERTEX_INPUT_RATE_INSTANCE
+                                : VK_VERTEX_INPUT_RATE_VERTEX;
+  }
+  for (u32 i = 0; i < desc.attribute_count; ++i) {
+    attributes[i].location = desc.attributes[i].location;
+    attributes[i].binding  = desc.attributes[i].binding;
+    attributes[i].format   = (VkFormat)desc.attributes[i].format;
+    attributes[i].offset   = desc.attributes[i].offset;
+  }
+  vertex_input = {};
+  vertex_input.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input.vertexBindingDescriptionCount   = desc.binding_count;
+  vertex_input.pVertexBindingDescriptions      = bindings;
+  vertex_input.vertexAttributeDescriptionCount = desc.attribute_count;
+  vertex_input.pVertexAttributeDescriptions    = attributes;
+
+  input_assembly = {};
+  input_assembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = (VkPrimitiveTopology)desc.topology;
+
+  viewport       = {};
+  viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport.viewportCount = 1;
+  viewport.scissorCount  = 1;
+
+  rasterization = {};
+  rasterization.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterization.cullMode    = desc.cull_mode;
+  rasterization.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterization.lineWidth   = 1.0f;
+
+  multisample = {};
+  multisample.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample.rasterizationSamples =
+      desc.samples != 0 ? (VkSampleCountFlagBits)desc.samples
+                        : VK_SAMPLE_COUNT_1_BIT;
+
+  depth_stencil = {};
+  depth_stencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil.depthTestEnable  = desc.depth_test != 0;
+  depth_stencil.depthWriteEnable = desc.depth_write != 0;
+  depth_stencil.depthCompareOp   = (VkCompareOp)desc.depth_compare;
+
+  for (u32 i = 0; i < desc.color_attachment_count; ++i) {
+    VkPipelineColorBlendAttachmentState& attachment = blends[i];
+    attachment                     = {};
+    attachment.blendEnable         = desc.blend != 0;
+    attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.colorBlendOp        = VK_BLEND_OP_ADD;
+    attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+    attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  }
+  blend       = {};
+  blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  blend.attachmentCount = desc.color_attachment_count;
+  blend.pAttachments    = blends;
+
+  dynamic_states[0] = VK_DYNAMIC_STATE_VIEWPORT;
+  dynamic_states[1] = VK_DYNAMIC_STATE_SCISSOR;
+  dynamic           = {};
+  dynamic.sType     = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic.dynamicStateCount = 2;
+  dynamic.pDynamicStates    = dynamic_states;
+
+  info                     = {};
+  info.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  info.stageCount          = desc.fragment != nullptr ? 2 : 1;
+  info.pStages             = stages;
+  info.pVertexInputState   = &vertex_input;
+  info.pInputAssemblyState = &input_assembly;
+  info.pViewportState      = &viewport;
+  info.pRasterizationState = &rasterization;
+  info.pMultisampleState   = &multisample;
+  info.pDepthStencilState  = &depth_stencil;
+  info.pColorBlendState    = &blend;
+  info.pDynamicState       = &dynamic;
+  info.layout              = desc.layout;
+  info.renderPass          = desc.render_pass;
+  info.subpass             = desc.subpass;
+  if (part == u32_MAX) {
+    return;
+  }
+
+  // the state of other parts is ignored, but the shader stages aren't
+  library = {};
+  library.sType =
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+  library.flags = kParts[part];
+  info.pNext    = &library;
+  info.flags    = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+               VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+  switch (kParts[part]) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+      info.stageCount = 1;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+      info.stageCount = desc.fragment != nullptr ? 1 : 0;
+      info.pStages    = &stages[1];
+      break;
+    default:
+      info.stageCount = 0;
+      info.pStages    = nullptr;
+      break;
+  }
+  return;
+}
+
+}  // namespace
+
+Error PipelineCompiler::last_error_ = Error::kUnknown;
+
+PipelineCompiler::PipelineCompiler(
+    const Device& device, PipelineCache& cache, jobs::System& jobs
+)
+    : device_((VkDevice)device),
+      cache_(&cache),
+      jobs_(&jobs),
+      libraries_(device.has(Device::kGraphicsPipelineLibrary)),
+      entries_(new Entry[kMaxPipelines]()),
+      entry_count_(0) {
+  if (!(bool)device || !(bool)cache) {
+    EMBERS_FATAL(
+        "Can't init pipeline compiler; {} must be valid",
+        "Vulkan device and pipeline cache"
+    );
+    device_ = nullptr;
+    return;
+  }
+  requests_.reserve(kMaxPipelines);
+  EMBERS_DEBUG(
+      "Pipelines are compiled {}",
+      libraries_ ? "from pipeline libraries" : "whole"
+  );
+  return;
+}
+
+PipelineCompiler::~PipelineCompiler() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void PipelineCompiler::destroy() {
+  jobs_->wait(pending_);
+  for (u32 i = 0; i < entry_count_; ++i) {
+    VkPipeline pipeline = entries_[i].pipeline.load(std::memory_order_acquire);
+    if (pipeline != nullptr) {
+      vkDestroyPipeline(device_, pipeline, nullptr);
+    }
+    if (entries_[i].unoptimized != nullptr) {
+      vkDestroyPipeline(device_, entries_[i].unoptimized, nullptr);
+    }
+  }
+  for (const auto& part : parts_) {
+    vkDestroyPipeline(device_, part.second, nullptr);
+  }
+  device_ = nullptr;
+  return;
+}
+
+PipelineHandle PipelineCompiler::request(
+    const GraphicsPipelineDesc& desc, PipelineHandle fallback
+) {
+  u64 key = hash(0xcbf29ce484222325, &desc, sizeof(desc));
+
+  PipelineHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto                        found = requests_.find(key);
+    if (found != requests_.end()) {
+      const GraphicsPipelineDesc& known = entries_[found->second].desc;
+      if (std::memcmp(&known, &desc, sizeof(desc)) == 0) {
+        return found->second;
+      }
+    }
+    // last_error_ isn't set, requests come from any thread
+    if (entry_count_ == kMaxPipelines) {
+      EMBERS_ERROR("Unable to request pipeline, {} were", kMaxPipelines);
+      return kNoPipeline;
+    }
+
+    handle         = entry_count_++;
+    Entry& entry   = entries_[handle];
+    entry.desc     = desc;
+    entry.fallback = fallback;
+    requests_.emplace(key, handle);
+  }
+  // run() may run other jobs while the ring is full, compile() among them
+  // takes the lock, and the caller may resume on another thread
+  jobs_->run([this, handle]() { compile(handle); }, &pending_);
+  return handle;
+}
+
+b8 PipelineCompiler::ready(PipelineHandle handle) const {
+  return handle < kMaxPipelines &&
+         entries_[handle].pipeline.load(std::memory_order_acquire) != nullptr;
+}
+
+VkPipeline PipelineCompiler::get(PipelineHandle handle) const {
+  if (handle >= kMaxPipelines) {
+    return nullptr;
+  }
+  const Entry& entry    = entries_[handle];
+  VkPipeline   pipeline = entry.pipeline.load(std::memory_order_acquire);
+  if (pipeline != nullptr || entry.fallback >= kMaxPipelines) {
+    return pipeline;
+  }
+  return entries_[entry.fallback].pipeline.load(std::memory_order_acquire);
+}
+
+void PipelineCompiler::wait() {
+  jobs_->wait(pending_);
+  return;
+}
+
+void PipelineCompiler::compile(PipelineHandle handle) {
+  Entry&            entry = entries_[handle];
+  Clock::time_point begin = Clock::now();
+
+  VkPipeline pipeline = nullptr;
+  if (libraries_) {
+    VkPipeline parts[kPartCount];
+    b8         built = true;
+    for (u32 i = 0; i < kPartCount; ++i) {
+      parts[i] = part(entry.desc, i);
+      built    = built && parts[i] != nullptr;
+    }
+    // the fast link is drawn with while the optimized one is built
+    pipeline = built ? link(entry.desc, parts, false) : nullptr;
+    if (pipeline != nullptr) {
+      entry.pipeline.store(pipeline, std::memory_order_release);
+      VkPipeline optimized = link(entry.desc, parts, true);
+      if (optimized != nullptr) {
+        entry.unoptimized = pipeline;
+        entry.pipeline.store(optimized, std::memory_order_release);
+      }
+    }
+  } else {
+    CreateInfo create(entry.desc, u32_MAX);
+    VkResult   result = vkCreateGraphicsPipelines(
+        device_,
+        cache_->get(),
+        1,
+        &create.info,
+        nullptr,
+        &pipeline
+    );
+    if (result != VK_SUCCESS) {
+      pipeline = nullptr;
+    }
+    entry.pipeline.store(pipeline, std::memory_order_release);
+  }
+
+  if (pipeline == nullptr) {
+    // not in last_error_, compiles run concurrently on the workers
+    EMBERS_ERROR("Unable to compile pipeline {}, kept its fallback", handle);
+    return;
+  }
+  cache_->count(std::chrono::duration<f64>(Clock::now() - begin).count());
+  return;
+}
+
+VkPipeline PipelineCompiler::part(const GraphicsPipelineDesc& desc, u32 part) {
+  u64 key = hash_part(desc, part);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto                        found = parts_.find(key);
+    if (found != parts_.end()) {
+      return found->second;
+    }
+  }
+
+  // built without the lock, two workers may build the same part at once
+  CreateInfo create(desc, part);
+  VkPipeline library = nullptr;
+  VkResult   result  = vkCreateGraphicsPipelines(
+      device_,
+      cache_->get(),
+      1,
+      &create.info,
+      nullptr,
+      &library
+  );
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to build pipeline library: {}", (i32)result);
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto inserted = parts_.emplace(key, library);
+  if (!inserted.second) {
+    vkDestroyPipeline(device_, library, nullptr);
+  }
+  return inserted.first->second;
+}
+
+VkPipeline PipelineCompiler::link(
+    const GraphicsPipelineDesc& desc, const VkPipeline* parts, b8 optimize
+) {
+  VkPipelineLibraryCreateInfoKHR libraries = {};
+  libraries.sType        = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  libraries.libraryCount = kPartCount;
+  libraries.pLibraries   = parts;
+
+  VkGraphicsPipelineCreateInfo info = {};
+  info.sType  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  info.pNext  = &libraries;
+  info.layout = desc.layout;
+  if (optimize) {
+    info.flags = VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+  }
+
+  VkPipeline pipeline = nullptr;
+  VkResult   result   = vkCreateGraphicsPipelines(
+      device_,
+      cache_->get(),
+      1,
+      &info,
+      nullptr,
+      &pipeline
+  );
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to link pipeline libraries: {}", (i32)result);
+    return nullptr;
+  }
+  return pipeline;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "../error_code.hpp"
+#include "../jobs/jobs.hpp"
+#include "common.hpp"
+#include "device.hpp"
+#include "pipeline_cache.hpp"
+
+typedef struct VkPipeline_T*       VkPipeline;
+typedef struct VkPipelineLayout_T* VkPipelineLayout;
+typedef struct VkRenderPass_T*     VkRenderPass;
+typedef struct VkShaderModule_T*   VkShaderModule;
+
+namespace embers::vulkan {
+
+using PipelineHandle = u32;
+
+constexpr PipelineHandle kNoPipeline = u32_MAX;
+
+/// Shaders and fixed function state of a graphics pipeline, viewport and
+/// scissor are dynamic. Every field is 4 or 8 bytes so that there is no
+/// padding: requests are told apart by their bytes
+struct GraphicsPipelineDesc {
+  constexpr static u32 kMaxBindings   = 4;
+  constexpr static u32 kMaxAttributes = 8;
+  constexpr static u32 kMaxConstants  = 8;
+  constexpr static u32 kMaxColorAttachments = 8;
+
+  struct Binding {
+    u32 stride;
+    u32 per_instance;
+  };
+
+  struct Attribute {
+    u32 location;
+    u32 binding;
+    u32 format;  // VkFormat
+    u32 offset;
+  };
+
+  VkPipelineLayout layout;
+  VkRenderPass     render_pass;
+  VkShaderModule   vertex;
+  VkShaderModule   fragment;  // nullptr for depth only passes
+  u32              subpass;
+  u32              topology;   // VkPrimitiveTopology
+  u32              cull_mode;  // VkCullModeFlags
+  u32              samples;    // VkSampleCountFlagBits, 0 for 1
+  u32              depth_test;
+  u32              depth_write;
+  u32              depth_compare;  // VkCompareOp
+  u32              blend;          // alpha blending of the color attachments
+  u32              color_attachment_count;  // up to kMaxColorAttachments
+  u32              binding_count;
+  Binding          bindings[kMaxBindings];
+  u32              attribute_count;
+  Attribute        attributes[kMaxAttributes];
+  // specialization constants of both shaders, 4 bytes each
+  u32              constant_count;
+  u32              constant_ids[kMaxConstants];
+  u32              constants[kMaxConstants];
+};
+
+/// Compiles graphics pipelines on the workers of a jobs::System, so that
+/// materials appearing mid-session don't stall a frame. request() returns
+/// at once, get() returns the pipeline of the fallback until the requested
+/// one is ready.
+///
+/// With VK_EXT_graphics_pipeline_library, pipelines are built from four
+/// parts (vertex input, pre-rasterization shaders, fragment shader,
+/// fragment output) shared by the pipelines that have them in common. A
+/// fast link of the parts is made ready first, then replaced by a link
+/// time optimized pipeline. Without it, pipelines are compiled whole.
+/// Either way the pipeline cache of the worker is used.
+///
+/// Pipelines live as long as the compiler
+class PipelineCompiler {
+ public:
+  constexpr static u32 kMaxPipelines = 1024;
+  constexpr static u32 kPartCount    = 4;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  template <typename T>
+  using Map = std::unordered_map<
+      u64,
+      T,
+      std::hash<u64>,
+      std::equal_to<u64>,
+      Allocator<std::pair<const u64, T>>>;
+
+  struct Entry {
+    GraphicsPipelineDesc    desc;
+    PipelineHandle          fallback;
+    std::atomic<VkPipeline> pipeline;     // nullptr until ready
+    VkPipeline              unoptimized;  // fast link, frames may use it
+  };
+
+  static Error last_error_;
+
+  VkDevice                 device_;  // doesn't own
+  PipelineCache*           cache_;
+  jobs::System*            jobs_;
+  b8                       libraries_;  // VK_EXT_graphics_pipeline_library
+  std::unique_ptr<Entry[]> entries_;
+  u32                      entry_count_;
+  Map<PipelineHandle>      requests_;  // by hash of the desc
+  Map<VkPipeline>          parts_;     // by hash of the part of the desc
+  std::mutex               mutex_;
+  jobs::Counter            pending_;
+
+  /// On a worker, makes the pipeline of `handle` ready
+  void       compile(PipelineHandle handle);
+  /// Library of `part` of `desc`, built once for every pipeline using it
+  VkPipeline part(const GraphicsPipelineDesc& desc, u32 part);
+  VkPipeline link(
+      const GraphicsPipelineDesc& desc, const VkPipeline* parts, b8 optimize
+  );
+  void destroy();
+
+ public:
+  PipelineCompiler() = delete;
+  PipelineCompiler(
+      const Device& device, PipelineCache& cache, jobs::System& jobs
+  );
+  PipelineCompiler(const PipelineCompiler& other) = delete;
+  PipelineCompiler(PipelineCompiler&& other)      = delete;
+  /// Waits for the pipelines being compiled
+  ~PipelineCompiler();
+
+  constexpr explicit operator bool() const;
+  PipelineCompiler&  operator=(const PipelineCompiler& rhs) = delete;
+  PipelineCompiler&  operator=(PipelineCompiler&& rhs)      = delete;
+
+  /// Starts compiling the pipeline of `desc` in the background, draws use
+  /// `fallback` until it is ready. The same desc gets the same handle,
+  /// kNoPipeline once kMaxPipelines were requested. Thread safe
+  PipelineHandle request(
+      const GraphicsPipelineDesc& desc, PipelineHandle fallback = kNoPipeline
+  );
+  /// Whether the pipeline of `handle` is compiled, never when it failed
+  b8             ready(PipelineHandle handle) const;
+  /// The pipeline of `handle` or of its fallback until it is ready,
+  /// nullptr when neither is
+  VkPipeline     get(PipelineHandle handle) const;
+  /// Waits until every requested pipeline is ready, for the fallbacks at
+  /// load time
+  void           wait();
+
+  EMBERS_ALWAYS_INLINE b8 uses_libraries() const;
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr PipelineCompiler::operator bool() const {
+  return device_ != nullptr;
+}
+
+EMBERS_ALWAYS_INLINE b8 PipelineCompiler::uses_libraries() const {
+  return libraries_;
+}
+
+EMBERS_ALWAYS_INLINE Error PipelineCompiler::get_last_error() {
+  return last_error_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
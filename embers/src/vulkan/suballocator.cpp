@@ -0,0 +1,401 @@
+#include "suballocator.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+namespace embers::vulkan {
+
+namespace {
+
+/// Index of the highest bit set, `value` isn't 0
+EMBERS_ALWAYS_INLINE u32 highest_bit(u64 value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return (u32)index;
+#else
+  return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+/// Index of the lowest bit set, `value` isn't 0
+EMBERS_ALWAYS_INLINE u32 lowest_bit(u64 value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (u32)index;
+#else
+  return (u32)__builtin_ctzll(value);
+#endif
+}
+
+EMBERS_ALWAYS_INLINE u64 align_up(u64 value, u64 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+Suballocator::Suballocator(u64 size) : size_(size), used_(0), count_(0) {}
+
+// linear
+
+LinearSuballocator::LinearSuballocator(u64 size)
+    : Suballocator(size), offset_(0) {}
+
+b8 LinearSuballocator::allocate(u64 size, u64 alignment, Region* region) {
+  u64 offset = align_up(offset_, std::max<u64>(alignment, 1));
+  if (offset > size_ || size > size_ - offset) {
+    return false;
+  }
+  offset_ = offset + size;
+  used_   = offset_;
+  count_++;
+  *region = {offset, size, kNone};
+  return true;
+}
+
+void LinearSuballocator::free(const Region&) {
+  if (--count_ == 0) {
+    reset();
+  }
+  return;
+}
+
+void LinearSuballocator::reset() {
+  offset_ = 0;
+  used_   = 0;
+  count_  = 0;
+  return;
+}
+
+u64 LinearSuballocator::largest_free() const { return size_ - offset_; }
+
+// buddy
+
+BuddySuballocator::BuddySuballocator(u64 size, u64 min_size)
+    : Suballocator(1ull << highest_bit(size)),
+      min_size_(std::min(min_size, size_)),
+      levels_(highest_bit(size_ / min_size_) + 1),
+      states_(((size_t)1 << levels_) - 1, kAbsent),
+      prev_(states_.size(), kNone),
+      next_(states_.size(), kNone),
+      heads_(levels_, kNone) {
+  states_[0] = kFree;
+  insert(0, 0);
+}
+
+void BuddySuballocator::insert(u32 node, u32 level) {
+  prev_[node] = kNone;
+  next_[node] = heads_[level];
+  if (heads_[level] != kNone) {
+    prev_[heads_[level]] = node;
+  }
+  heads_[level] = node;
+  return;
+}
+
+void BuddySuballocator::remove(u32 node, u32 level) {
+  if (prev_[node] != kNone) {
+    next_[prev_[node]] = next_[node];
+  } else {
+    heads_[level] = next_[node];
+  }
+  if (next_[node] != kNone) {
+    prev_[next_[node]] = prev_[node];
+  }
+  return;
+}
+
+b8 BuddySuballocator::allocate(u64 size, u64 alignment, Region* region) {
+  u64 need = std::max({size, alignment, min_size_});
+  if (need > size_) {
+    return false;
+  }
+  // the deepest level whose nodes hold `need` bytes
+  u32 level = highest_bit(size_ / need);
+
+  u32 found = level + 1;
+  for (u32 i = level + 1; i-- > 0;) {
+    if (heads_[i] != kNone) {
+      found = i;
+      break;
+    }
+  }
+  if (found > level) {
+    return false;
+  }
+
+  u32 node = heads_[found];
+  remove(node, found);
+  for (; found < level; ++found) {
+    states_[node]         = kSplit;
+    states_[2 * node + 2] = kFree;
+    insert(2 * node + 2, found + 1);
+    node = 2 * node + 1;
+  }
+  states_[node] = kUsed;
+
+  u64 node_size  = size_ >> level;
+  used_         += node_size;
+  count_++;
+  *region = {(node - ((1u << level) - 1)) * node_size, size, node};
+  return true;
+}
+
+void BuddySuballocator::free(const Region& region) {
+  u32 node  = region.node;
+  u32 level = highest_bit(node + 1);
+  used_    -= size_ >> level;
+  count_--;
+
+  // merge with the buddy as long as it is free as a whole
+  while (node != 0) {
+    u32 buddy = (node & 1) != 0 ? node + 1 : node - 1;
+    if (states_[buddy] != kFree) {
+      break;
+    }
+    remove(buddy, level);
+    states_[buddy] = kAbsent;
+    states_[node]  = kAbsent;
+    node           = (node - 1) / 2;
+    level--;
+  }
+  states_[node] = kFree;
+  insert(node, level);
+  return;
+}
+
+void BuddySuballocator::reset() {
+  std::fill(states_.begin(), states_.end(), (u8)kAbsent);
+  std::fill(heads_.begin(), heads_.end(), kNone);
+  states_[0] = kFree;
+  insert(0, 0);
+  used_  = 0;
+  count_ = 0;
+  return;
+}
+
+u64 BuddySuballocator::largest_free() const {
+  for (u32 level = 0; level < levels_; ++level) {
+    if (heads_[level] != kNone) {
+      return size_ >> level;
+    }
+  }
+  return 0;
+}
+
+// tlsf
+
+TlsfSuballocator::TlsfSuballocator(u64 size) : Suballocator(size) { reset(); }
+
+void TlsfSuballocator::mapping(u64 size, u32* first, u32* second) {
+  if (size < kSecondCount) {
+    *first  = 0;
+    *second = (u32)size;
+    return;
+  }
+  u32 log = highest_bit(size);
+  *first  = log - kSecondLog + 1;
+  *second = (u32)(size >> (log - kSecondLog)) - kSecondCount;
+  return;
+}
+
+u32 TlsfSuballocator::take_node() {
+  if (unused_ == kNone) {
+    nodes_.emplace_back();
+    return (u32)nodes_.size() - 1;
+  }
+  u32 node = unused_;
+  unused_  = nodes_[node].next_free;
+  return node;
+}
+
+void TlsfSuballocator::release_node(u32 node) {
+  nodes_[node].next_free = unused_;
+  unused_                = node;
+  return;
+}
+
+void TlsfSuballocator::insert(u32 node) {
+  u32 first, second;
+  mapping(nodes_[node].size, &first, &second);
+  u32& head = heads_[first * kSecondCount + second];
+
+  nodes_[node].free      = true;
+  nodes_[node].prev_free = kNone;
+  nodes_[node].next_free = head;
+  if (head != kNone) {
+    nodes_[head].prev_free = node;
+  }
+  head            = node;
+  first_         |= 1ull << first;
+  second_[first] |= 1u << second;
+  return;
+}
+
+void TlsfSuballocator::remove(u32 node) {
+  u32 first, second;
+  mapping(nodes_[node].size, &first, &second);
+  u32&  head = heads_[first * kSecondCount + second];
+  Node& n    = nodes_[node];
+
+  if (n.prev_free != kNone) {
+    nodes_[n.prev_free].next_free = n.next_free;
+  } else {
+    head = n.next_free;
+  }
+  if (n.next_free != kNone) {
+    nodes_[n.next_free].prev_free = n.prev_free;
+  }
+  n.free = false;
+  if (head == kNone) {
+    second_[first] &= ~(1u << second);
+    if (second_[first] == 0) {
+      first_ &= ~(1ull << first);
+    }
+  }
+  return;
+}
+
+u32 TlsfSuballocator::split(u32 node, u64 size) {
+  u32   back = take_node();
+  Node& n    = nodes_[node];
+
+  nodes_[back].offset        = n.offset + size;
+  nodes_[back].size          = n.size - size;
+  nodes_[back].prev_physical = node;
+  nodes_[back].next_physical = n.next_physical;
+  nodes_[back].free          = false;
+  if (n.next_physical != kNone) {
+    nodes_[n.next_physical].prev_physical = back;
+  }
+  n.next_physical = back;
+  n.size          = size;
+  return back;
+}
+
+u32 TlsfSuballocator::find(u64 size) const {
+  // round up to the next size class, every range of its list is big enough
+  if (size >= kSecondCount) {
+    size += (1ull << (highest_bit(size) - kSecondLog)) - 1;
+  }
+  u32 first, second;
+  mapping(size, &first, &second);
+  if (first >= kFirstCount) {
+    return kNone;
+  }
+
+  u32 second_map = second_[first] & (~0u << second);
+  if (second_map == 0) {
+    u64 first_map = first + 1 < 64 ? first_ & (~0ull << (first + 1)) : 0;
+    if (first_map == 0) {
+      return kNone;
+    }
+    first      = lowest_bit(first_map);
+    second_map = second_[first];
+  }
+  second = lowest_bit(second_map);
+  return heads_[first * kSecondCount + second];
+}
+
+b8 TlsfSuballocator::allocate(u64 size, u64 alignment, Region* region) {
+  size      = std::max<u64>(size, 1);
+  alignment = std::max<u64>(alignment, 1);
+  if (size > size_) {
+    return false;
+  }
+
+  // a range of `size` bytes is enough when its offset happens to be
+  // aligned, otherwise the worst case padding is looked for
+  u32 node = find(size);
+  if (node == kNone ||
+      align_up(nodes_[node].offset, alignment) + size >
+          nodes_[node].offset + nodes_[node].size) {
+    node = alignment > 1 ? find(size + alignment - 1) : kNone;
+    if (node == kNone) {
+      return false;
+    }
+  }
+  remove(node);
+
+  u64 offset = align_up(nodes_[node].offset, alignment);
+  if (offset > nodes_[node].offset) {
+    // the padding stays free, its physical neighbours are used as free
+    // ranges are always merged
+    u32 padding = node;
+    node        = split(padding, offset - nodes_[padding].offset);
+    insert(padding);
+  }
+  if (nodes_[node].size > size) {
+    insert(split(node, size));
+  }
+
+  used_ += size;
+  count_++;
+  *region = {offset, size, node};
+  return true;
+}
+
+void TlsfSuballocator::free(const Region& region) {
+  u32 node = region.node;
+  used_   -= nodes_[node].size;
+  count_--;
+
+  u32 next = nodes_[node].next_physical;
+  if (next != kNone && nodes_[next].free) {
+    remove(next);
+    nodes_[node].size          += nodes_[next].size;
+    nodes_[node].next_physical  = nodes_[next].next_physical;
+    if (nodes_[node].next_physical != kNone) {
+      nodes_[nodes_[node].next_physical].prev_physical = node;
+    }
+    release_node(next);
+  }
+  u32 prev = nodes_[node].prev_physical;
+  if (prev != kNone && nodes_[prev].free) {
+    remove(prev);
+    nodes_[prev].size          += nodes_[node].size;
+    nodes_[prev].next_physical  = nodes_[node].next_physical;
+    if (nodes_[prev].next_physical != kNone) {
+      nodes_[nodes_[prev].next_physical].prev_physical = prev;
+    }
+    release_node(node);
+    node = prev;
+  }
+  insert(node);
+  return;
+}
+
+void TlsfSuballocator::reset() {
+  nodes_.clear();
+  unused_ = kNone;
+  first_  = 0;
+  std::fill(std::begin(second_), std::end(second_), 0u);
+  std::fill(std::begin(heads_), std::end(heads_), kNone);
+
+  nodes_.push_back({0, size_, kNone, kNone, kNone, kNone, false});
+  insert(0);
+  used_  = 0;
+  count_ = 0;
+  return;
+}
+
+u64 TlsfSuballocator::largest_free() const {
+  if (first_ == 0) {
+    return 0;
+  }
+  u32 first  = highest_bit(first_);
+  u32 second = highest_bit(second_[first]);
+  u64 size   = 0;
+  for (u32 node = heads_[first * kSecondCount + second]; node != kNone;
+       node = nodes_[node].next_free) {
+    size = std::max(size, nodes_[node].size);
+  }
+  return size;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <embers/defines.hpp>
+
+#include "common.hpp"
+
+namespace embers::vulkan {
+
+/// Part of a block handed out by a Suballocator
+struct Region {
+  u64 offset;
+  u64 size;
+  u32 node;  // of the suballocator, to free the region
+};
+
+/// Placement of allocations within one block of device memory, only deals
+/// with offsets: the block itself belongs to the MemoryAllocator
+class Suballocator {
+ protected:
+  u64 size_;
+  u64 used_;
+  u32 count_;
+
+ public:
+  constexpr static u32 kNone = u32_MAX;
+
+  Suballocator() = delete;
+  explicit Suballocator(u64 size);
+  Suballocator(const Suballocator& other) = delete;
+  Suballocator(Suballocator&& other)      = delete;
+  virtual ~Suballocator()                 = default;
+
+  Suballocator& operator=(const Suballocator& rhs) = delete;
+  Suballocator& operator=(Suballocator&& rhs)      = delete;
+
+  /// False when no `size` bytes aligned to `alignment` are free
+  virtual b8   allocate(u64 size, u64 alignment, Region* region) = 0;
+  virtual void free(const Region& region)                        = 0;
+  /// Frees every region at once
+  virtual void reset()                                           = 0;
+  /// Largest region that may still fit, ignoring alignment
+  virtual u64  largest_free() const                              = 0;
+
+  EMBERS_ALWAYS_INLINE u64 size() const;
+  /// Bytes unavailable to further allocations, with the rounding of sizes
+  EMBERS_ALWAYS_INLINE u64 used() const;
+  EMBERS_ALWAYS_INLINE u32 count() const;
+  EMBERS_ALWAYS_INLINE b8  empty() const;
+};
+
+/// Bump allocation for memory that lives one frame, everything goes at once
+/// with reset(). Freed regions are only reused once all of them are
+class LinearSuballocator final : public Suballocator {
+  u64 offset_;
+
+ public:
+  explicit LinearSuballocator(u64 size);
+
+  b8   allocate(u64 size, u64 alignment, Region* region) override;
+  void free(const Region& region) override;
+  void reset() override;
+  u64  largest_free() const override;
+};
+
+/// Power of two regions split in halves and merged back with their buddy.
+/// Fast and fragmentation free for big allocations of similar sizes (render
+/// targets), wasteful for the others. The size of the block is rounded down
+/// to a power of two, regions are aligned to their size
+class BuddySuballocator final : public Suballocator {
+  enum State : u8 {
+    kAbsent,  // within a free or a used node
+    kFree,
+    kSplit,
+    kUsed,
+  };
+
+  u64         min_size_;
+  u32         levels_;  // the root is level 0, nodes of min_size_ the last
+  Vector<u8>  states_;  // by node, children of i are 2i + 1 and 2i + 2
+  Vector<u32> prev_;    // free lists by level through the nodes
+  Vector<u32> next_;
+  Vector<u32> heads_;
+
+  void insert(u32 node, u32 level);
+  void remove(u32 node, u32 level);
+
+ public:
+  /// `min_size` is a power of two, the smallest region handed out
+  BuddySuballocator(u64 size, u64 min_size);
+
+  b8   allocate(u64 size, u64 alignment, Region* region) override;
+  void free(const Region& region) override;
+  void reset() override;
+  u64  largest_free() const override;
+};
+
+/// Two-level segregated fit: free ranges are kept in lists by size class,
+/// a power of two split in kSecondCount linear steps, and two levels of
+/// bitmaps find a list holding a large enough range in constant time.
+/// Neighbouring free ranges are merged on free(). General purpose
+class TlsfSuballocator final : public Suballocator {
+ public:
+  constexpr static u32 kSecondLog   = 4;
+  constexpr static u32 kSecondCount = 1 << kSecondLog;
+  constexpr static u32 kFirstCount  = 64 - kSecondLog + 1;
+
+ private:
+  struct Node {
+    u64 offset;
+    u64 size;
+    u32 prev_physical;
+    u32 next_physical;
+    u32 prev_free;
+    u32 next_free;
+    b8  free;
+  };
+
+  Vector<Node> nodes_;
+  u32          unused_;  // list of nodes to reuse, through next_free
+  u64          first_;   // bitmap of the first levels with a free range
+  u32          second_[kFirstCount];
+  u32          heads_[kFirstCount * kSecondCount];
+
+  static void mapping(u64 size, u32* first, u32* second);
+
+  u32  take_node();
+  void release_node(u32 node);
+  void insert(u32 node);
+  void remove(u32 node);
+  /// Cuts `node` after `size` bytes, returns the node of the rest
+  u32  split(u32 node, u64 size);
+  /// A free node of at least `size` bytes, kNone if there is none
+  u32  find(u64 size) const;
+
+ public:
+  explicit TlsfSuballocator(u64 size);
+
+  b8   allocate(u64 size, u64 alignment, Region* region) override;
+  void free(const Region& region) override;
+  void reset() override;
+  u64  largest_free() const override;
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+EMBERS_ALWAYS_INLINE u64 Suballocator::size() const { return size_; }
+
+EMBERS_ALWAYS_INLINE u64 Suballocator::used() const { return used_; }
+
+EMBERS_ALWAYS_INLINE u32 Suballocator::count() const { return count_; }
+
+EMBERS_ALWAYS_INLINE b8 Suballocator::empty() const { return count_ == 0; }
+
+}  // namespace embers::vulkan
\ No newline at end of file
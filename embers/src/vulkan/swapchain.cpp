@@ -0,0 +1,469 @@
+#include "swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <embers/logger.hpp>
+#include <utility>
+
+namespace embers::vulkan {
+
+namespace {
+
+// in order of preference, of the sRGB nonlinear color space
+constexpr VkFormat preferred_formats[] = {
+    VK_FORMAT_B8G8R8A8_SRGB,
+    VK_FORMAT_R8G8B8A8_SRGB,
+};
+
+// by PresentMode, in order of preference, FIFO is always supported
+constexpr VkPresentModeKHR low_latency_modes[] = {
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+    VK_PRESENT_MODE_FIFO_KHR,
+};
+constexpr VkPresentModeKHR power_saving_modes[] = {
+    VK_PRESENT_MODE_FIFO_KHR,
+};
+
+}  // namespace
+
+Error Swapchain::last_error_ = Error::kUnknown;
+
+Swapchain::Swapchain(
+    const Device&  device,
+    const Surface& surface,
+    u32            width,
+    u32            height,
+    PresentMode    mode,
+    u32            frames_in_flight
+)
+    : device_((VkDevice)device),
+      physical_device_(device.physical_device()),
+      surface_((VkSurfaceKHR)surface),
+      present_queue_(device.queue(Device::kPresent)),
+      families_{
+          device.queue_family(Device::kGraphics),
+          device.queue_family(Device::kPresent),
+      },
+      mode_(mode),
+      format_(VK_FORMAT_UNDEFINED),
+      color_space_(VK_COLOR_SPACE_SRGB_NONLINEAR_KHR),
+      width_(width),
+      height_(height),
+      out_of_date_(true),
+      frames_in_flight_(std::max(frames_in_flight, 1u)),
+      frame_(0),
+      slots_(frames_in_flight_, Slot{nullptr, nullptr}),
+      current_{} {
+  if (!(bool)device || !(bool)surface) {
+    EMBERS_FATAL(
+        "Can't init swapchain; {} must be valid",
+        "Vulkan device and surface"
+    );
+    device_ = nullptr;
+    return;
+  }
+  if (!pick_format()) {
+    device_ = nullptr;
+    return;
+  }
+
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.flags             = VK_FENCE_CREATE_SIGNALED_BIT;
+  for (Slot& slot : slots_) {
+    VkResult result =
+        vkCreateSemaphore(device_, &semaphore_info, nullptr, &slot.acquired);
+    if (result == VK_SUCCESS) {
+      result = vkCreateFence(device_, &fence_info, nullptr, &slot.fence);
+    }
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR("Unable to create frame sync objects: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateSync;
+      destroy();
+      return;
+    }
+  }
+
+  // a minimized window gets its swapchain by a later acquire()
+  recreate();
+  return;
+}
+
+Swapchain::~Swapchain() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void Swapchain::destroy() {
+  for (Slot& slot : slots_) {
+    if (slot.fence != nullptr) {
+      vkWaitForFences(device_, 1, &slot.fence, VK_TRUE, u64_MAX);
+    }
+  }
+  // the presentation engine may still wait on semaphores
+  vkQueueWaitIdle(present_queue_);
+
+  release_retired(true);
+  destroy_images(current_);
+  for (Slot& slot : slots_) {
+    if (slot.acquired != nullptr) {
+      vkDestroySemaphore(device_, slot.acquired, nullptr);
+    }
+    if (slot.fence != nullptr) {
+      vkDestroyFence(device_, slot.fence, nullptr);
+    }
+  }
+  device_ = nullptr;
+  return;
+}
+
+b8 Swapchain::pick_format() {
+  u32 count = 0;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(
+      physical_device_,
+      surface_,
+      &count,
+      nullptr
+  );
+  Vector<VkSurfaceFormatKHR> formats(count);
+  VkResult                   result = vkGetPhysicalDeviceSurfaceFormatsKHR(
+      physical_device_,
+      surface_,
+      &count,
+      formats.data()
+  );
+  if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+    EMBERS_ERROR("Unable to get surface formats: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateSwapchain;
+    return false;
+  }
+  formats.resize(count);
+
+  format_      = formats[0].format;
+  color_space_ = formats[0].colorSpace;
+  if (count == 1 && formats[0].format == VK_FORMAT_UNDEFINED) {
+    // any format goes
+    format_ = preferred_formats[0];
+    return true;
+  }
+  for (VkFormat preferred : preferred_formats) {
+    auto found = std::find_if(
+        formats.begin(),
+        formats.end(),
+        [preferred](const VkSurfaceFormatKHR& format) {
+          return format.format == preferred &&
+                 format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        }
+    );
+    if (found != formats.end()) {
+      format_      = found->format;
+      color_space_ = found->colorSpace;
+      break;
+    }
+  }
+  return true;
+}
+
+b8 Swapchain::recreate() {
+  VkSurfaceCapabilitiesKHR capabilities = {};
+  VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+      physical_device_,
+      surface_,
+      &capabilities
+  );
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to get surface capabilities: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateSwapchain;
+    return false;
+  }
+
+  VkExtent2D extent = capabilities.currentExtent;
+  if (extent.width == u32_MAX) {
+    // the surface takes the extent of the swapchain
+    extent.width = std::clamp(
+        width_,
+        capabilities.minImageExtent.width,
+        capabilities.maxImageExtent.width
+    );
+    extent.height = std::clamp(
+        height_,
+        capabilities.minImageExtent.height,
+        capabilities.maxImageExtent.height
+    );
+  }
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+
+  u32 mode_count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(
+      physical_device_,
+      surface_,
+      &mode_count,
+      nullptr
+  );
+  Vector<VkPresentModeKHR> modes(mode_count);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(
+      physical_device_,
+      surface_,
+      &mode_count,
+      modes.data()
+  );
+  modes.resize(mode_count);
+  VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
+  if (mode_ == PresentMode::kLowLatency) {
+    for (VkPresentModeKHR preferred : low_latency_modes) {
+      if (std::find(modes.begin(), modes.end(), preferred) != modes.end()) {
+        mode = preferred;
+        break;
+      }
+    }
+  } else {
+    mode = power_saving_modes[0];
+  }
+
+  // one more than the minimum, not to wait on the driver to acquire
+  u32 image_count = capabilities.minImageCount + 1;
+  if (capabilities.maxImageCount != 0) {
+    image_count = std::min(image_count, capabilities.maxImageCount);
+  }
+
+  VkCompositeAlphaFlagBitsKHR composite_alpha =
+      VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  if ((capabilities.supportedCompositeAlpha & composite_alpha) == 0) {
+    // the lowest one supported
+    composite_alpha = (VkCompositeAlphaFlagBitsKHR)(
+        capabilities.supportedCompositeAlpha &
+        (~capabilities.supportedCompositeAlpha + 1)
+    );
+  }
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                            (capabilities.supportedUsageFlags &
+                             VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+  VkSwapchainCreateInfoKHR info = {};
+  info.sType                    = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  info.surface                  = surface_;
+  info.minImageCount            = image_count;
+  info.imageFormat              = (VkFormat)format_;
+  info.imageColorSpace          = (VkColorSpaceKHR)color_space_;
+  info.imageExtent              = extent;
+  info.imageArrayLayers         = 1;
+  info.imageUsage               = usage;
+  info.imageSharingMode         = VK_SHARING_MODE_EXCLUSIVE;
+  if (families_[0] != families_[1]) {
+    info.imageSharingMode      = VK_SHARING_MODE_CONCURRENT;
+    info.queueFamilyIndexCount = 2;
+    info.pQueueFamilyIndices   = families_;
+  }
+  info.preTransform   = capabilities.currentTransform;
+  info.compositeAlpha = composite_alpha;
+  info.presentMode    = mode;
+  info.clipped        = VK_TRUE;
+  info.oldSwapchain   = current_.swapchain;
+
+  Images images = {};
+  result = vkCreateSwapchainKHR(device_, &info, nullptr, &images.swapchain);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create swapchain: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateSwapchain;
+    return false;
+  }
+  // the driver may create more images than asked for
+  result = vkGetSwapchainImagesKHR(
+      device_,
+      images.swapchain,
+      &images.count,
+      nullptr
+  );
+  if (result == VK_SUCCESS) {
+    images.images.resize(images.count);
+    result = vkGetSwapchainImagesKHR(
+        device_,
+        images.swapchain,
+        &images.count,
+        images.images.data()
+    );
+  }
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to get swapchain images: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateSwapchain;
+    images.count = 0;
+    destroy_images(images);
+    return false;
+  }
+  images.views.resize(images.count, nullptr);
+  images.rendered.resize(images.count, nullptr);
+
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format                = (VkFormat)format_;
+  view_info.subresourceRange      = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (u32 i = 0; i < images.count; ++i) {
+    view_info.image = images.images[i];
+    result =
+        vkCreateImageView(device_, &view_info, nullptr, &images.views[i]);
+    if (result == VK_SUCCESS) {
+      result = vkCreateSemaphore(
+          device_,
+          &semaphore_info,
+          nullptr,
+          &images.rendered[i]
+      );
+    }
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR("Unable to create swapchain image views: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateSwapchain;
+      destroy_images(images);
+      return false;
+    }
+  }
+
+  // frames in flight may still render to the old images
+  if (current_.swapchain != nullptr) {
+    current_.retired = frame_;
+    retired_.push_back(std::move(current_));
+  }
+  current_     = std::move(images);
+  width_       = extent.width;
+  height_      = extent.height;
+  out_of_date_ = false;
+  EMBERS_DEBUG(
+      "Swapchain of {}x{}, {} images, present mode {}",
+      width_,
+      height_,
+      current_.count,
+      (i32)mode
+  );
+  return true;
+}
+
+void Swapchain::release_retired(b8 all) {
+  auto done = [this, all](Images& images) {
+    if (!all && frame_ < images.retired + frames_in_flight_) {
+      return false;
+    }
+    destroy_images(images);
+    return true;
+  };
+  retired_.erase(
+      std::remove_if(retired_.begin(), retired_.end(), done),
+      retired_.end()
+  );
+  return;
+}
+
+void Swapchain::destroy_images(Images& images) {
+  for (u32 i = 0; i < images.count; ++i) {
+    if (images.views[i] != nullptr) {
+      vkDestroyImageView(device_, images.views[i], nullptr);
+    }
+    if (images.rendered[i] != nullptr) {
+      vkDestroySemaphore(device_, images.rendered[i], nullptr);
+    }
+  }
+  if (images.swapchain != nullptr) {
+    vkDestroySwapchainKHR(device_, images.swapchain, nullptr);
+  }
+  images = {};
+  return;
+}
+
+b8 Swapchain::acquire(SwapchainFrame* frame) {
+  u32   slot_index = (u32)(frame_ % frames_in_flight_);
+  Slot& slot       = slots_[slot_index];
+  vkWaitForFences(device_, 1, &slot.fence, VK_TRUE, u64_MAX);
+  release_retired(false);
+
+  u32 image_index = 0;
+  for (u32 attempt = 0;; ++attempt) {
+    if ((out_of_date_ || current_.swapchain == nullptr) && !recreate()) {
+      return false;
+    }
+    VkResult result = vkAcquireNextImageKHR(
+        device_,
+        current_.swapchain,
+        u64_MAX,
+        slot.acquired,
+        nullptr,
+        &image_index
+    );
+    if (result == VK_SUCCESS) {
+      break;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+      // the image is acquired, recreated after this frame
+      out_of_date_ = true;
+      break;
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR && attempt == 0) {
+      out_of_date_ = true;
+      continue;
+    }
+    EMBERS_ERROR("Unable to acquire swapchain image: {}", (i32)result);
+    last_error_ = Error::kVulkanPresent;
+    return false;
+  }
+
+  vkResetFences(device_, 1, &slot.fence);
+  frame->slot        = slot_index;
+  frame->image_index = image_index;
+  frame->swapchain   = current_.swapchain;
+  frame->image       = current_.images[image_index];
+  frame->view        = current_.views[image_index];
+  frame->acquired    = slot.acquired;
+  frame->rendered    = current_.rendered[image_index];
+  frame->fence       = slot.fence;
+  frame_++;
+  return true;
+}
+
+b8 Swapchain::present(const SwapchainFrame& frame) {
+  VkPresentInfoKHR info   = {};
+  info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  info.waitSemaphoreCount = 1;
+  info.pWaitSemaphores    = &frame.rendered;
+  info.swapchainCount     = 1;
+  info.pSwapchains        = &frame.swapchain;
+  info.pImageIndices      = &frame.image_index;
+
+  VkResult result = vkQueuePresentKHR(present_queue_, &info);
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    out_of_date_ = true;
+    return true;
+  }
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to present swapchain image: {}", (i32)result);
+    last_error_ = Error::kVulkanPresent;
+    return false;
+  }
+  return true;
+}
+
+void Swapchain::resize(u32 width, u32 height) {
+  width_       = width;
+  height_      = height;
+  out_of_date_ = true;
+  return;
+}
+
+void Swapchain::set_present_mode(PresentMode mode) {
+  if (mode != mode_) {
+    mode_        = mode;
+    out_of_date_ = true;
+  }
+  return;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
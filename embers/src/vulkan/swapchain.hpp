@@ -0,0 +1,152 @@
+#pragma once
+
+#include <embers/defines.hpp>
+
+#include "../error_code.hpp"
+#include "common.hpp"
+#include "device.hpp"
+#include "surface.hpp"
+
+typedef struct VkSwapchainKHR_T* VkSwapchainKHR;
+typedef struct VkImage_T*        VkImage;
+typedef struct VkImageView_T*    VkImageView;
+typedef struct VkSemaphore_T*    VkSemaphore;
+typedef struct VkFence_T*        VkFence;
+
+namespace embers::vulkan {
+
+enum class PresentMode : u8 {
+  kLowLatency,   // MAILBOX, else IMMEDIATE, else FIFO
+  kPowerSaving,  // FIFO, one image per vertical blank
+};
+
+/// Image a frame renders to and what it synchronizes with, see
+/// Swapchain::acquire()
+struct SwapchainFrame {
+  u32            slot;  // of the frame in flight
+  u32            image_index;
+  VkSwapchainKHR swapchain;  // the image is of, presented on
+  VkImage        image;
+  VkImageView    view;
+  VkSemaphore    acquired;  // waited on before writing the image
+  VkSemaphore    rendered;  // signaled once the image is written
+  VkFence        fence;     // signaled by the last submission of the frame
+};
+
+/// Swapchain of a surface with frames_in_flight frames recorded and
+/// rendered at once. The frame of a slot waits for the fence of the frame
+/// that last used the slot, not for the device.
+///
+/// The swapchain is recreated when it is out of date, suboptimal, resized
+/// or of another present mode, with the old one as oldSwapchain. The old
+/// images are destroyed once the frames that used them are done, without
+/// vkDeviceWaitIdle. Not thread safe, frames are acquired and presented by
+/// one thread
+class Swapchain {
+  /// Of one VkSwapchainKHR, as many as the driver created
+  struct Images {
+    VkSwapchainKHR      swapchain;
+    u32                 count;
+    Vector<VkImage>     images;
+    Vector<VkImageView> views;
+    Vector<VkSemaphore> rendered;  // by image, presentation waits
+    u64                 retired;   // frame it was replaced at
+  };
+
+  struct Slot {
+    VkSemaphore acquired;
+    VkFence     fence;
+  };
+
+  static Error last_error_;
+
+  VkDevice         device_;  // doesn't own
+  VkPhysicalDevice physical_device_;
+  VkSurfaceKHR     surface_;
+  VkQueue          present_queue_;
+  u32              families_[2];  // graphics and present
+  PresentMode      mode_;
+  u32              format_;       // VkFormat
+  u32              color_space_;  // VkColorSpaceKHR
+  u32              width_;
+  u32              height_;
+  b8               out_of_date_;
+  u32              frames_in_flight_;
+  u64              frame_;
+  Vector<Slot>     slots_;
+  Images           current_;
+  Vector<Images>   retired_;
+
+  /// False while the surface has no area, minimized
+  b8   recreate();
+  b8   pick_format();
+  /// Destroys the retired images no frame in flight uses anymore
+  void release_retired(b8 all);
+  void destroy_images(Images& images);
+  void destroy();
+
+ public:
+  Swapchain() = delete;
+  /// `width` and `height` are used when the surface doesn't set the extent
+  Swapchain(
+      const Device&  device,
+      const Surface& surface,
+      u32            width,
+      u32            height,
+      PresentMode    mode             = PresentMode::kLowLatency,
+      u32            frames_in_flight = 2
+  );
+  Swapchain(const Swapchain& other) = delete;
+  Swapchain(Swapchain&& other)      = delete;
+  ~Swapchain();
+
+  constexpr explicit operator bool() const;
+  Swapchain&         operator=(const Swapchain& rhs) = delete;
+  Swapchain&         operator=(Swapchain&& rhs)      = delete;
+
+  /// Waits for the frame that last used the next slot and acquires an
+  /// image, recreating the swapchain when needed. Once it returns true, the
+  /// frame is submitted with `frame->fence` and presented. False when
+  /// there is nothing to render to, the frame is skipped
+  b8 acquire(SwapchainFrame* frame);
+  /// Presents the image of `frame` once `frame.rendered` is signaled
+  b8 present(const SwapchainFrame& frame);
+
+  /// The next acquire() recreates the swapchain
+  void resize(u32 width, u32 height);
+  void set_present_mode(PresentMode mode);
+
+  EMBERS_ALWAYS_INLINE u32 format() const;  // VkFormat
+  EMBERS_ALWAYS_INLINE u32 width() const;
+  EMBERS_ALWAYS_INLINE u32 height() const;
+  EMBERS_ALWAYS_INLINE u32 image_count() const;
+  EMBERS_ALWAYS_INLINE u32 frames_in_flight() const;
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr Swapchain::operator bool() const { return device_ != nullptr; }
+
+EMBERS_ALWAYS_INLINE u32 Swapchain::format() const { return format_; }
+
+EMBERS_ALWAYS_INLINE u32 Swapchain::width() const { return width_; }
+
+EMBERS_ALWAYS_INLINE u32 Swapchain::height() const { return height_; }
+
+EMBERS_ALWAYS_INLINE u32 Swapchain::image_count() const {
+  return current_.count;
+}
+
+EMBERS_ALWAYS_INLINE u32 Swapchain::frames_in_flight() const {
+  return frames_in_flight_;
+}
+
+EMBERS_ALWAYS_INLINE Error Swapchain::get_last_error() { return last_error_; }
+
+}  // namespace embers::vulkan
\ No newline at end of file
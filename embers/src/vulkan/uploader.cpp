@@ -0,0 +1,653 @@
+#include "uploader.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <embers/logger.hpp>
+#include <functional>
+#include <numeric>
+
+namespace embers::vulkan {
+
+namespace {
+
+EMBERS_ALWAYS_INLINE u64 align_up(u64 value, u64 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkImageMemoryBarrier image_barrier(
+    VkImage            image,
+    const ImageRegion& region,
+    VkImageLayout      old_layout,
+    VkImageLayout      new_layout,
+    VkAccessFlags      src_access,
+    VkAccessFlags      dst_access,
+    u32                src_family,
+    u32                dst_family
+) {
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask        = src_access;
+  barrier.dstAccessMask        = dst_access;
+  barrier.oldLayout            = old_layout;
+  barrier.newLayout            = new_layout;
+  barrier.srcQueueFamilyIndex  = src_family;
+  barrier.dstQueueFamilyIndex  = dst_family;
+  barrier.image                = image;
+  barrier.subresourceRange     = {
+      VK_IMAGE_ASPECT_COLOR_BIT,
+      region.mip_level,
+      1,
+      region.layer,
+      1,
+  };
+  return barrier;
+}
+
+VkBufferMemoryBarrier buffer_barrier(
+    VkBuffer      buffer,
+    u64           offset,
+    u64           size,
+    VkAccessFlags src_access,
+    VkAccessFlags dst_access,
+    u32           src_family,
+    u32           dst_family
+) {
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask         = src_access;
+  barrier.dstAccessMask         = dst_access;
+  barrier.srcQueueFamilyIndex   = src_family;
+  barrier.dstQueueFamilyIndex   = dst_family;
+  barrier.buffer                = buffer;
+  barrier.offset                = offset;
+  barrier.size                  = size;
+  return barrier;
+}
+
+}  // namespace
+
+Error Uploader::last_error_ = Error::kUnknown;
+
+Uploader::Uploader(
+    const Device& device, MemoryAllocator& memory, u64 ring_size
+)
+    : device_((VkDevice)device),
+      queue_(device.queue(Device::kTransfer)),
+      transfer_family_(device.queue_family(Device::kTransfer)),
+      graphics_family_(device.queue_family(Device::kGraphics)),
+      memory_(&memory),
+      ring_(nullptr),
+      ring_memory_{},
+      mapped_(nullptr),
+      ring_size_(align_up(std::max(ring_size, kAlignment), kAlignment)),
+      head_(0),
+      tail_(0),
+      pool_(nullptr),
+      batches_{},
+      submitted_(0),
+      completed_(0),
+      acquired_(0) {
+  if (!(bool)device || !(bool)memory) {
+    EMBERS_FATAL(
+        "Can't init uploader; {} must be valid",
+        "Vulkan device and memory allocator"
+    );
+    device_ = nullptr;
+    return;
+  }
+
+  VkBufferCreateInfo buffer_info = {};
+  buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size               = ring_size_;
+  buffer_info.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+  VkResult result = vkCreateBuffer(device_, &buffer_info, nullptr, &ring_);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create staging ring: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateBuffer;
+    destroy();
+    return;
+  }
+  ring_memory_ = memory_->allocate_buffer(ring_, MemoryUsage::kUpload);
+  if (!ring_memory_ || ring_memory_.mapped == nullptr) {
+    EMBERS_ERROR("Unable to allocate staging ring of {} bytes", ring_size_);
+    last_error_ = Error::kVulkanAllocateMemory;
+    destroy();
+    return;
+  }
+  mapped_ = (u8*)ring_memory_.mapped;
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = transfer_family_;
+  result = vkCreateCommandPool(device_, &pool_info, nullptr, &pool_);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to create transfer command pool: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateCommands;
+    destroy();
+    return;
+  }
+
+  VkCommandBuffer            commands[kBatches];
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool        = pool_;
+  allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = kBatches;
+  result = vkAllocateCommandBuffers(device_, &allocate_info, commands);
+  if (result != VK_SUCCESS) {
+    EMBERS_ERROR("Unable to allocate transfer commands: {}", (i32)result);
+    last_error_ = Error::kVulkanCreateCommands;
+    destroy();
+    return;
+  }
+
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (u32 i = 0; i < kBatches; ++i) {
+    batches_[i].commands = commands[i];
+    result =
+        vkCreateFence(device_, &fence_info, nullptr, &batches_[i].fence);
+    if (result != VK_SUCCESS) {
+      EMBERS_ERROR("Unable to create transfer fence: {}", (i32)result);
+      last_error_ = Error::kVulkanCreateSync;
+      destroy();
+      return;
+    }
+  }
+  return;
+}
+
+Uploader::~Uploader() {
+  if (device_ == nullptr) {
+    return;
+  }
+  destroy();
+  return;
+}
+
+void Uploader::destroy() {
+  for (Batch& batch : batches_) {
+    if (batch.pending && !batch.failed) {
+      vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, u64_MAX);
+    }
+    if (batch.fence != nullptr) {
+      vkDestroyFence(device_, batch.fence, nullptr);
+    }
+  }
+  if (pool_ != nullptr) {
+    vkDestroyCommandPool(device_, pool_, nullptr);
+  }
+  if (ring_memory_) {
+    memory_->free(ring_memory_);
+  }
+  if (ring_ != nullptr) {
+    vkDestroyBuffer(device_, ring_, nullptr);
+  }
+  device_ = nullptr;
+  return;
+}
+
+Uploader::Batch& Uploader::recording() {
+  return batches_[(submitted_ + 1) % kBatches];
+}
+
+u64 Uploader::reserve(u64 size, u64 alignment, b8& failed) {
+  for (;;) {
+    reclaim();
+    if (tail_ == head_) {
+      // idle, start over at the beginning of the ring
+      head_ = 0;
+      tail_ = 0;
+    }
+
+    // aligned in the ring, its size needn't be a multiple of the alignment
+    u64 physical = align_up(head_ % ring_size_, alignment);
+    u64 start    = head_ - head_ % ring_size_ + physical;
+    if (physical + size > ring_size_) {
+      // doesn't wrap around, skips the end of the ring
+      start += ring_size_ - physical;
+    }
+    if (start + size - tail_ <= ring_size_) {
+      head_ = start + size;
+      return start % ring_size_;
+    }
+
+    // full: hands over what was recorded and waits for the oldest batch
+    failed |= !submit_locked();
+    reclaim(completed_.load(std::memory_order_relaxed) + 1);
+  }
+}
+
+b8 Uploader::submit_locked() {
+  Batch& batch = recording();
+  if (batch.buffers.empty() && batch.images.empty()) {
+    return true;
+  }
+
+  record(batch);
+  VkResult result = vkEndCommandBuffer(batch.commands);
+  if (result == VK_SUCCESS) {
+    VkSubmitInfo submit_info       = {};
+    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers    = &batch.commands;
+    vkResetFences(device_, 1, &batch.fence);
+    result = vkQueueSubmit(queue_, 1, &submit_info, batch.fence);
+  }
+  b8 submitted = result == VK_SUCCESS;
+  if (!submitted) {
+    // takes its ticket anyway, reclaim() retires it without a fence
+    EMBERS_ERROR(
+        "Unable to submit {} uploads: {}",
+        batch.buffers.size() + batch.images.size(),
+        (i32)result
+    );
+    last_error_ = Error::kVulkanSubmit;
+    batch.buffers.clear();
+    batch.images.clear();
+  }
+  batch.ring_end = head_;
+  batch.pending  = true;
+  batch.failed   = !submitted;
+  submitted_++;
+
+  // the next batch is recorded in the slot of the oldest one
+  if (recording().pending) {
+    reclaim(submitted_ + 1 - kBatches);
+  }
+  return submitted;
+}
+
+void Uploader::reclaim(UploadTicket ticket) {
+  UploadTicket completed = completed_.load(std::memory_order_relaxed);
+  for (UploadTicket t = completed + 1; t <= submitted_; ++t) {
+    Batch& batch = batches_[t % kBatches];
+    if (batch.failed) {
+      // never submitted, nothing to wait for
+    } else if (t <= ticket) {
+      VkResult result =
+          vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, u64_MAX);
+      if (result != VK_SUCCESS) {
+        EMBERS_ERROR("Waiting for uploads returned {}", (i32)result);
+      }
+    } else if (vkGetFenceStatus(device_, batch.fence) != VK_SUCCESS) {
+      break;
+    }
+
+    tail_ = batch.ring_end;
+    if (transfers_ownership()) {
+      acquire_buffers_.insert(
+          acquire_buffers_.end(),
+          batch.buffers.begin(),
+          batch.buffers.end()
+      );
+      acquire_images_.insert(
+          acquire_images_.end(),
+          batch.images.begin(),
+          batch.images.end()
+      );
+    }
+    batch.buffers.clear();
+    batch.images.clear();
+    batch.pending = false;
+    batch.failed  = false;
+    completed_.store(t, std::memory_order_release);
+  }
+  return;
+}
+
+void Uploader::record(Batch& batch) {
+  u32 src_family = VK_QUEUE_FAMILY_IGNORED;
+  u32 dst_family = VK_QUEUE_FAMILY_IGNORED;
+  if (transfers_ownership()) {
+    src_family = transfer_family_;
+    dst_family = graphics_family_;
+  }
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(batch.commands, &begin_info);
+
+  // a copy replaces the whole subresource, only the last one of each is
+  // made: copies to the same subresource would race
+  size_t kept = 0;
+  for (size_t i = 0; i < batch.images.size(); ++i) {
+    const ImageCopy& copy     = batch.images[i];
+    b8               replaced = std::any_of(
+        batch.images.begin() + i + 1,
+        batch.images.end(),
+        [&copy](const ImageCopy& later) {
+          return later.image == copy.image &&
+                 later.region.mip_level == copy.region.mip_level &&
+                 later.region.layer == copy.region.layer;
+        }
+    );
+    if (!replaced) {
+      batch.images[kept++] = copy;
+    }
+  }
+  batch.images.erase(batch.images.begin() + kept, batch.images.end());
+
+  Vector<VkImageMemoryBarrier> images;
+  images.reserve(batch.images.size());
+  for (const ImageCopy& copy : batch.images) {
+    images.push_back(image_barrier(
+        copy.image,
+        copy.region,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED
+    ));
+  }
+  if (!images.empty()) {
+    vkCmdPipelineBarrier(
+        batch.commands,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        (u32)images.size(),
+        images.data()
+    );
+  }
+
+  // one copy command per destination buffer, split where a region overlaps
+  // one of the command: the regions of a copy mustn't overlap, and the
+  // later upload has to land last
+  std::stable_sort(
+      batch.buffers.begin(),
+      batch.buffers.end(),
+      [](const BufferCopy& lhs, const BufferCopy& rhs) {
+        return std::less<VkBuffer>()(lhs.buffer, rhs.buffer);
+      }
+  );
+  Vector<VkBufferCopy> regions;
+
+  auto copy_regions = [this, &batch, &regions](VkBuffer buffer) {
+    vkCmdCopyBuffer(
+        batch.commands,
+        ring_,
+        buffer,
+        (u32)regions.size(),
+        regions.data()
+    );
+    regions.clear();
+  };
+  for (size_t i = 0; i < batch.buffers.size();) {
+    VkBuffer buffer = batch.buffers[i].buffer;
+    size_t   first  = i;  // first region of the copy command
+    for (; i < batch.buffers.size() && batch.buffers[i].buffer == buffer;
+         ++i) {
+      const BufferCopy& copy     = batch.buffers[i];
+      b8                overlaps = std::any_of(
+          batch.buffers.begin() + first,
+          batch.buffers.begin() + i,
+          [&copy](const BufferCopy& other) {
+            return other.offset < copy.offset + copy.size &&
+                   copy.offset < other.offset + other.size;
+          }
+      );
+      if (overlaps) {
+        copy_regions(buffer);
+        VkBufferMemoryBarrier barrier = buffer_barrier(
+            buffer,
+            0,
+            VK_WHOLE_SIZE,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED
+        );
+        vkCmdPipelineBarrier(
+            batch.commands,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            nullptr,
+            1,
+            &barrier,
+            0,
+            nullptr
+        );
+        first = i;
+      }
+      regions.push_back({copy.source, copy.offset, copy.size});
+    }
+    copy_regions(buffer);
+  }
+
+  for (const ImageCopy& copy : batch.images) {
+    VkBufferImageCopy region = {};
+    region.bufferOffset      = copy.source;
+    region.imageSubresource  = {
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        copy.region.mip_level,
+        copy.region.layer,
+        1,
+    };
+    region.imageExtent = {
+        copy.region.width,
+        copy.region.height,
+        copy.region.depth,
+    };
+    vkCmdCopyBufferToImage(
+        batch.commands,
+        ring_,
+        copy.image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1,
+        &region
+    );
+  }
+
+  // releases to the graphics queue, acquire() records the other half
+  Vector<VkBufferMemoryBarrier> buffers;
+  if (transfers_ownership()) {
+    buffers.reserve(batch.buffers.size());
+    for (const BufferCopy& copy : batch.buffers) {
+      buffers.push_back(buffer_barrier(
+          copy.buffer,
+          copy.offset,
+          copy.size,
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+          0,
+          src_family,
+          dst_family
+      ));
+    }
+  }
+  images.clear();
+  for (const ImageCopy& copy : batch.images) {
+    images.push_back(image_barrier(
+        copy.image,
+        copy.region,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        0,
+        src_family,
+        dst_family
+    ));
+  }
+  if (!buffers.empty() || !images.empty()) {
+    vkCmdPipelineBarrier(
+        batch.commands,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        (u32)buffers.size(),
+        buffers.data(),
+        (u32)images.size(),
+        images.data()
+    );
+  }
+  return;
+}
+
+UploadTicket Uploader::upload_buffer(
+    VkBuffer buffer, u64 offset, const void* data, u64 size
+) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const u8* bytes = (const u8*)data;
+  b8        lost  = false;  // with a batch that failed to submit
+  while (size > 0) {
+    // halves of the ring, so one is filled while the other is copied from
+    u64 chunk  = std::min(size, ring_size_ / 2);
+    b8  failed = false;
+    u64 source = reserve(chunk, kAlignment, failed);
+    lost |= failed && bytes != data;
+    std::memcpy(mapped_ + source, bytes, chunk);
+    recording().buffers.push_back({buffer, source, offset, chunk});
+
+    bytes  += chunk;
+    offset += chunk;
+    size   -= chunk;
+  }
+  return lost ? 0 : submitted_ + 1;
+}
+
+UploadTicket Uploader::upload_image(
+    VkImage image, const ImageRegion& region, const void* data, u64 size
+) {
+  if (size > ring_size_) {
+    EMBERS_ERROR(
+        "Image upload of {} bytes doesn't fit the staging ring of {}",
+        size,
+        ring_size_
+    );
+    last_error_ = Error::kVulkanUploadSize;
+    return 0;
+  }
+  if (region.texel_size == 0) {
+    EMBERS_ERROR("Image upload of {} bytes without a texel size", size);
+    last_error_ = Error::kVulkanUploadSize;
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // bufferOffset is a multiple of the texel size, 3 and 12 bytes included.
+  // A failed submit in reserve() only drops the uploads before this one
+  b8  failed = false;
+  u64 source =
+      reserve(size, std::lcm(kAlignment, (u64)region.texel_size), failed);
+  std::memcpy(mapped_ + source, data, size);
+  recording().images.push_back({image, source, region});
+  return submitted_ + 1;
+}
+
+UploadTicket Uploader::submit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return submit_locked() ? submitted_ : 0;
+}
+
+b8 Uploader::done(UploadTicket ticket) {
+  if (ticket <= completed_.load(std::memory_order_acquire)) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  reclaim();
+  return ticket <= completed_.load(std::memory_order_relaxed);
+}
+
+void Uploader::wait(UploadTicket ticket) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ticket > submitted_) {
+    submit_locked();
+  }
+  reclaim(std::min(ticket, submitted_));
+  return;
+}
+
+UploadTicket Uploader::acquire(VkCommandBuffer commands) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  reclaim();
+  UploadTicket completed = completed_.load(std::memory_order_relaxed);
+  if (completed == acquired_) {
+    return acquired_;
+  }
+
+  if (!transfers_ownership()) {
+    // the fences made the writes available, this makes them visible
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(
+        commands,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr
+    );
+    acquired_ = completed;
+    return acquired_;
+  }
+
+  // must match the releases of record()
+  Vector<VkBufferMemoryBarrier> buffers;
+  buffers.reserve(acquire_buffers_.size());
+  for (const BufferCopy& copy : acquire_buffers_) {
+    buffers.push_back(buffer_barrier(
+        copy.buffer,
+        copy.offset,
+        copy.size,
+        0,
+        VK_ACCESS_MEMORY_READ_BIT,
+        transfer_family_,
+        graphics_family_
+    ));
+  }
+  Vector<VkImageMemoryBarrier> images;
+  images.reserve(acquire_images_.size());
+  for (const ImageCopy& copy : acquire_images_) {
+    images.push_back(image_barrier(
+        copy.image,
+        copy.region,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        0,
+        VK_ACCESS_SHADER_READ_BIT,
+        transfer_family_,
+        graphics_family_
+    ));
+  }
+  vkCmdPipelineBarrier(
+      commands,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      0,
+      nullptr,
+      (u32)buffers.size(),
+      buffers.data(),
+      (u32)images.size(),
+      images.data()
+  );
+  acquire_buffers_.clear();
+  acquire_images_.clear();
+  acquired_ = completed;
+  return acquired_;
+}
+
+}  // namespace embers::vulkan
\ No newline at end of file
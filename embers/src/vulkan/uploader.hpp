@@ -0,0 +1,170 @@
+#pragma once
+
+#include <embers/defines.hpp>
+#include <atomic>
+#include <mutex>
+
+#include "../error_code.hpp"
+#include "common.hpp"
+#include "device.hpp"
+#include "memory.hpp"
+
+typedef struct VkCommandPool_T*   VkCommandPool;
+typedef struct VkCommandBuffer_T* VkCommandBuffer;
+typedef struct VkFence_T*         VkFence;
+
+namespace embers::vulkan {
+
+/// Batch an upload went to, batches complete in order
+using UploadTicket = u64;
+
+/// Whole mip level of one layer of a color image, its texels tightly packed
+struct ImageRegion {
+  u32 width;
+  u32 height;
+  u32 depth;
+  u32 mip_level;
+  u32 layer;
+  u32 texel_size;  // in bytes, of a block for compressed formats
+};
+
+/// Streams data to device local buffers and images through a persistently
+/// mapped ring of upload memory. Uploads are copied into the ring and
+/// batched: a batch is recorded and submitted to the transfer queue as one
+/// command buffer by submit(), or when the ring runs out of room. Its ring
+/// space is reclaimed once its fence signals, the graphics queue never
+/// waits on the transfers.
+///
+/// When the transfer and graphics queues are of different families, the
+/// resources are released by the transfer queue and acquire() records the
+/// matching acquires into a graphics command buffer; uploaded images end in
+/// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL either way. Thread safe, the
+/// copies into the ring are made one thread at a time
+class Uploader {
+ public:
+  constexpr static u64 kRingSize  = 64ull << 20;
+  constexpr static u32 kBatches   = 4;  // in flight on the transfer queue
+  constexpr static u64 kAlignment = 16;  // of the data in the ring
+
+ private:
+  struct BufferCopy {
+    VkBuffer buffer;
+    u64      source;  // in the ring
+    u64      offset;
+    u64      size;
+  };
+
+  struct ImageCopy {
+    VkImage     image;
+    u64         source;  // in the ring
+    ImageRegion region;
+  };
+
+  struct Batch {
+    VkCommandBuffer    commands;
+    VkFence            fence;
+    u64                ring_end;  // head of the ring once submitted
+    b8                 pending;
+    b8                 failed;  // to submit, its fence never signals
+    Vector<BufferCopy> buffers;
+    Vector<ImageCopy>  images;
+  };
+
+  static Error last_error_;
+
+  VkDevice                  device_;  // doesn't own
+  VkQueue                   queue_;
+  u32                       transfer_family_;
+  u32                       graphics_family_;
+  MemoryAllocator*          memory_;
+  VkBuffer                  ring_;
+  Allocation                ring_memory_;
+  u8*                       mapped_;
+  u64                       ring_size_;
+  u64                       head_;  // ever growing, modulo ring_size_
+  u64                       tail_;
+  VkCommandPool             pool_;
+  Batch                     batches_[kBatches];  // ticket t in t % kBatches
+  UploadTicket              submitted_;
+  std::atomic<UploadTicket> completed_;
+  UploadTicket              acquired_;
+  Vector<BufferCopy>        acquire_buffers_;  // completed, not acquired
+  Vector<ImageCopy>         acquire_images_;
+  std::mutex                mutex_;
+
+  constexpr b8 transfers_ownership() const;
+  Batch&       recording();
+
+  /// Offset in the ring of `size` free bytes, submits the batch and waits
+  /// for older ones when the ring is full. `failed` is set when that submit
+  /// fails
+  u64  reserve(u64 size, u64 alignment, b8& failed);
+  /// Whether the batch being recorded was submitted. When it wasn't its
+  /// uploads are dropped, its ticket is done at once so that it never
+  /// stands for the next batch
+  b8   submit_locked();
+  /// Retires the batches whose fence signaled, waits for those up to
+  /// `ticket` first
+  void reclaim(UploadTicket ticket = 0);
+  void record(Batch& batch);
+  void destroy();
+
+ public:
+  Uploader() = delete;
+  Uploader(
+      const Device&    device,
+      MemoryAllocator& memory,
+      u64              ring_size = kRingSize
+  );
+  Uploader(const Uploader& other) = delete;
+  Uploader(Uploader&& other)      = delete;
+  ~Uploader();
+
+  constexpr explicit operator bool() const;
+  Uploader&          operator=(const Uploader& rhs) = delete;
+  Uploader&          operator=(Uploader&& rhs)      = delete;
+
+  /// `size` bytes of `data` to `buffer` at `offset`, uploads larger than
+  /// half the ring are split in several batches. 0 on failure, also when a
+  /// batch holding part of it failed to submit
+  UploadTicket upload_buffer(
+      VkBuffer buffer, u64 offset, const void* data, u64 size
+  );
+  /// `size` bytes of texels of `region` to `image`, the previous content of
+  /// the region is discarded. The texels fit the ring and their size is set
+  /// in `region`. 0 on failure
+  UploadTicket upload_image(
+      VkImage image, const ImageRegion& region, const void* data, u64 size
+  );
+
+  /// Submits the batch being recorded, returns the last ticket submitted or
+  /// 0 when the submit failed
+  UploadTicket submit();
+  /// Whether the transfers of `ticket` are done, without waiting
+  b8           done(UploadTicket ticket);
+  /// Submits `ticket` if needed and waits for its transfers
+  void         wait(UploadTicket ticket);
+
+  /// Records into `commands`, bound to the graphics queue, what makes the
+  /// completed uploads usable by the commands that follow. Returns the last
+  /// ticket whose resources may be used
+  UploadTicket acquire(VkCommandBuffer commands);
+
+  EMBERS_ALWAYS_INLINE static Error get_last_error();
+};
+
+}  // namespace embers::vulkan
+
+// implementation
+
+namespace embers::vulkan {
+
+constexpr Uploader::operator bool() const { return device_ != nullptr; }
+
+constexpr b8 Uploader::transfers_ownership() const {
+  return transfer_family_ != graphics_family_;
+}
+
+EMBERS_ALWAYS_INLINE Error Uploader::get_last_error() { return last_error_; }
+
+}  // namespace embers::vulkan
\ No newline at end of file